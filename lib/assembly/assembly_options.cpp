@@ -27,13 +27,20 @@ namespace Bempp {
 AssemblyOptions::AssemblyOptions()
     : m_assemblyMode(DENSE), m_verbosityLevel(VerbosityLevel::DEFAULT),
       m_singularIntegralCaching(true), m_sparseStorageOfLocalOperators(true),
-      m_jointAssembly(false), m_uniformQuadrature(true),
+      m_jointAssembly(false), m_tiledDenseAssembly(false),
+      m_denseAssemblyTileSize(AUTO), m_mixedPrecision(false), m_uniformQuadrature(true),
       m_blasInQuadrature(AUTO) {}
 
 void AssemblyOptions::switchToDenseMode() { m_assemblyMode = DENSE; }
 
 void AssemblyOptions::switchToHMatMode() { m_assemblyMode = HMAT; }
 
+void AssemblyOptions::switchToTreecodeMode(
+    const TreecodeOptions &treecodeOptions) {
+  m_assemblyMode = TREECODE;
+  m_treecodeOptions = treecodeOptions;
+}
+
 void AssemblyOptions::switchToAcaMode(const AcaOptions &acaOptions) {
   AcaOptions canonicalAcaOptions = acaOptions;
   if (!canonicalAcaOptions.globalAssemblyBeforeCompression) {
@@ -66,6 +73,10 @@ AssemblyOptions::Mode AssemblyOptions::assemblyMode() const {
 
 const AcaOptions &AssemblyOptions::acaOptions() const { return m_acaOptions; }
 
+const TreecodeOptions &AssemblyOptions::treecodeOptions() const {
+  return m_treecodeOptions;
+}
+
 // void AssemblyOptions::switchToOpenCl(const OpenClOptions& openClOptions)
 //{
 //    m_parallelizationOptions.switchToOpenCl(openClOptions);
@@ -121,6 +132,33 @@ void AssemblyOptions::enableJointAssembly(bool value) {
 
 bool AssemblyOptions::isJointAssemblyEnabled() const { return m_jointAssembly; }
 
+void AssemblyOptions::enableTiledDenseAssembly(bool value) {
+  m_tiledDenseAssembly = value;
+}
+
+bool AssemblyOptions::isTiledDenseAssemblyEnabled() const {
+  return m_tiledDenseAssembly;
+}
+
+void AssemblyOptions::setDenseAssemblyTileSize(int size) {
+  if (size != AUTO && size <= 0)
+    throw std::invalid_argument("AssemblyOptions::setDenseAssemblyTileSize(): "
+                                "size must be positive or equal to AUTO");
+  m_denseAssemblyTileSize = size;
+}
+
+int AssemblyOptions::denseAssemblyTileSize() const {
+  return m_denseAssemblyTileSize;
+}
+
+void AssemblyOptions::enableMixedPrecision(bool value) {
+  m_mixedPrecision = value;
+}
+
+bool AssemblyOptions::isMixedPrecisionEnabled() const {
+  return m_mixedPrecision;
+}
+
 void AssemblyOptions::enableBlasInQuadrature(Value value) {
   if (value != AUTO && value != YES && value != NO)
     throw std::invalid_argument("AssemblyOptions::enableBlasInQuadrature(): "
@@ -26,12 +26,14 @@
 #include "aca_options.hpp"
 
 #include "../common/deprecated.hpp"
+#include "../fiber/treecode_options.hpp"
 #include "../fiber/opencl_options.hpp"
 #include "../fiber/parallelization_options.hpp"
 #include "../fiber/verbosity_level.hpp"
 
 namespace Bempp {
 
+using Fiber::TreecodeOptions;
 using Fiber::OpenClOptions;
 using Fiber::ParallelizationOptions;
 using Fiber::VerbosityLevel;
@@ -61,7 +63,10 @@ public:
        (ACA). */
     ACA,
     /** \brief Assemble hierarchical matrices using the HMat library. */
-    HMAT
+    HMAT,
+    /** \brief Assemble near-field corrections only and apply the far field
+       with an octree Chebyshev treecode. */
+    TREECODE
   };
 
   /** \brief Use dense-matrix representations of weak forms of boundary integral
@@ -80,6 +85,38 @@ public:
   /** \brief Assemble using the HMat hierarchical matrix library. */
   void switchToHMatMode();
 
+  /** \brief Use matrix-free representations of weak forms of boundary
+   *  integral operators whose far field is applied with a treecode.
+   *
+   *  \param[in] treecodeOptions Parameters of the treecode.
+   *
+   *  In this mode the weak form is not stored as a matrix. The quadrature
+   *  points of the test and trial elements are sorted into an octree, with
+   *  all points of an element kept in the same leaf. Interactions of
+   *  neighbouring leaves are assembled exactly, with the singular and
+   *  near-singular quadrature rules of the quadrature strategy, and stored
+   *  in a sparse matrix; all other interactions are applied with the
+   *  Chebyshev-interpolation treecode used for potentials (see
+   *  EvaluationOptions::switchToTreecodeMode()) every time the operator acts
+   *  on a vector. Memory consumption thus grows linearly with the number of
+   *  elements. This is not a fast multipole method: only the target side is
+   *  interpolated, there are no multipole-to-multipole or
+   *  multipole-to-local translations, and far-field interactions are
+   *  recomputed at each application at a cost of order p<sup>3</sup> N log
+   *  N, where p is TreecodeOptions::expansionOrder (see
+   *  Fiber::ChebyshevTreecode). A matrix-vector product is therefore
+   *  usually much slower than with a stored H-matrix.
+   *
+   *  The mode is supported by integral operators whose integrands depend on
+   *  the test element only through the values of the test functions, i.e.
+   *  single-layer, double-layer and Laplace hypersingular operators. The
+   *  resulting operator supports only the application to vectors and not
+   *  its transpose. It refers to the kernels of the abstract operator, which
+   *  must therefore be kept alive as long as the weak form is used. */
+  void
+  switchToTreecodeMode(const TreecodeOptions &treecodeOptions =
+                           TreecodeOptions());
+
   /** \brief Use dense-matrix representations of weak forms of boundary integral
    *operators.
    *
@@ -95,8 +132,8 @@ public:
 
   /** \brief Current assembly mode.
    *
-   *  The assembly mode can be changed by calling switchToDenseMode() or
-   *  switchToAcaMode(). */
+   *  The assembly mode can be changed by calling switchToDenseMode(),
+   *  switchToAcaMode(), switchToHMatMode() or switchToTreecodeMode(). */
   Mode assemblyMode() const;
 
   /** \brief Return the current adaptive cross approximation (ACA) settings.
@@ -105,6 +142,12 @@ public:
    *  assemblyMode() returns ACA. */
   const AcaOptions &acaOptions() const;
 
+  /** \brief Return the current parameters of the treecode.
+   *
+   *  \note These settings are only used in the treecode assembly mode, i.e.
+   *  when assemblyMode() returns TREECODE. */
+  const TreecodeOptions &treecodeOptions() const;
+
   /** @}
     @name Parallelization
     @{ */
@@ -204,6 +247,63 @@ public:
    * See enableJointAssembly() for more information. */
   bool isJointAssemblyEnabled() const;
 
+  /** \brief Enable or disable tiled assembly of dense weak forms.
+   *
+   *  If <tt>value == true</tt>, the matrix of a weak form assembled in the
+   *  dense mode is split into square tiles sized to fit in the L2 cache.
+   *  Each element is owned by the tile row (for test elements) or column
+   *  (for trial elements) containing its smallest DOF, and the local weak
+   *  forms of each pair of elements are evaluated once, by the thread
+   *  processing the tile owning that pair. Tiles whose elements touch
+   *  disjoint rows and columns of the matrix are processed in parallel, so
+   *  that no locking is needed.
+   *
+   *  By default tiled assembly is disabled: the trial elements are
+   *  distributed among threads, which add their contributions to the matrix
+   *  one at a time. */
+  void enableTiledDenseAssembly(bool value = true);
+
+  /** \brief Return whether tiled assembly of dense weak forms is enabled.
+   *
+   * See enableTiledDenseAssembly() for more information. */
+  bool isTiledDenseAssemblyEnabled() const;
+
+  /** \brief Set the number of DOFs along each side of the tiles used in
+   *  tiled assembly of dense weak forms.
+   *
+   *  If \p size is AUTO (default), the tiles are sized to fit in half of
+   *  the L2 cache. Otherwise \p size must be positive.
+   *
+   *  See enableTiledDenseAssembly() for more information. */
+  void setDenseAssemblyTileSize(int size = AUTO);
+
+  /** \brief Return the number of DOFs along each side of the tiles used in
+   *  tiled assembly of dense weak forms.
+   *
+   *  See setDenseAssemblyTileSize() for more information. */
+  int denseAssemblyTileSize() const;
+
+  /** \brief Specify whether kernels may be evaluated in single precision.
+   *
+   *  If this option is set to true, the kernels of operators supporting
+   *  mixed-precision assembly (currently the single-layer, double-layer and
+   *  adjoint double-layer operators for the modified Helmholtz and Helmholtz
+   *  equations without interpolation) are evaluated in single precision
+   *  during regular quadrature, while geometrical data and sums remain in
+   *  the precision of the operator. This roughly halves the time spent in
+   *  kernel evaluation at the cost of a relative error of the order of the
+   *  single-precision machine epsilon, which is usually acceptable for
+   *  preconditioners. Singular integrals are always evaluated in full
+   *  precision. By default this option is set to false.
+   *
+   *  The option is read when an operator is constructed. */
+  void enableMixedPrecision(bool value = true);
+
+  /** \brief Return whether kernels may be evaluated in single precision.
+   *
+   * See enableMixedPrecision() for more information. */
+  bool isMixedPrecisionEnabled() const;
+
   /** \brief Specify whether BLAS matrix multiplication routines should be
    *  used during evaluation of elementary integrals.
    *
@@ -258,11 +358,15 @@ private:
   /** \cond */
   Mode m_assemblyMode;
   AcaOptions m_acaOptions;
+  TreecodeOptions m_treecodeOptions;
   ParallelizationOptions m_parallelizationOptions;
   VerbosityLevel::Level m_verbosityLevel;
   bool m_singularIntegralCaching;
   bool m_sparseStorageOfLocalOperators;
   bool m_jointAssembly;
+  bool m_tiledDenseAssembly;
+  int m_denseAssemblyTileSize;
+  bool m_mixedPrecision;
   bool m_uniformQuadrature;
   Value m_blasInQuadrature;
   /** \endcond */
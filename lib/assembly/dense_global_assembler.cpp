@@ -41,9 +41,13 @@
 
 #include "../common/armadillo_fwd.hpp"
 #include "../common/complex_aux.hpp"
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
+#include <unistd.h>
 
+#include <tbb/blocked_range2d.h>
 #include <tbb/parallel_for.h>
 #include <tbb/spin_mutex.h>
 #include <tbb/task_scheduler_init.h>
@@ -132,6 +136,183 @@ private:
   MutexType &m_mutex;
 };
 
+/** Elements owned by a range of global DOFs.
+ *
+ *  Each element with at least one DOF is owned by the range containing its
+ *  smallest global DOF. The elements owned by the range are stored in
+ *  elementIndices. For the i'th of them, entries offsets[i] to
+ *  offsets[i + 1] - 1 of localDofs, globalDofs and localDofWeights contain
+ *  its local DOFs, the global DOFs they are mapped to and their weights.
+ *  touchedRanges lists the ranges containing any of these global DOFs. */
+template <typename BasisFunctionType> struct DofRangeMap {
+  std::vector<int> elementIndices;
+  std::vector<int> offsets;
+  std::vector<int> localDofs;
+  std::vector<GlobalDofIndex> globalDofs;
+  std::vector<BasisFunctionType> localDofWeights;
+  std::vector<size_t> touchedRanges;
+};
+
+/** Split the global DOFs into consecutive ranges of \p rangeSize DOFs and
+ *  build a DofRangeMap for each of them. */
+template <typename BasisFunctionType>
+void buildDofRangeMaps(
+    const std::vector<std::vector<GlobalDofIndex>> &globalDofs,
+    const std::vector<std::vector<BasisFunctionType>> &localDofWeights,
+    size_t globalDofCount, size_t rangeSize,
+    std::vector<DofRangeMap<BasisFunctionType>> &maps) {
+  maps.clear();
+  maps.resize((globalDofCount + rangeSize - 1) / rangeSize);
+  const int elementCount = globalDofs.size();
+  for (int e = 0; e < elementCount; ++e) {
+    const int localDofCount = globalDofs[e].size();
+    GlobalDofIndex minGlobalDof = -1;
+    for (int localDof = 0; localDof < localDofCount; ++localDof) {
+      const GlobalDofIndex globalDof = globalDofs[e][localDof];
+      if (globalDof >= 0 && (minGlobalDof < 0 || globalDof < minGlobalDof))
+        minGlobalDof = globalDof;
+    }
+    if (minGlobalDof < 0)
+      continue;
+    DofRangeMap<BasisFunctionType> &map = maps[minGlobalDof / rangeSize];
+    map.elementIndices.push_back(e);
+    map.offsets.push_back(map.localDofs.size());
+    for (int localDof = 0; localDof < localDofCount; ++localDof) {
+      const GlobalDofIndex globalDof = globalDofs[e][localDof];
+      if (globalDof < 0)
+        continue;
+      map.localDofs.push_back(localDof);
+      map.globalDofs.push_back(globalDof);
+      map.localDofWeights.push_back(localDofWeights[e][localDof]);
+      map.touchedRanges.push_back(globalDof / rangeSize);
+    }
+  }
+  for (size_t i = 0; i < maps.size(); ++i) {
+    DofRangeMap<BasisFunctionType> &map = maps[i];
+    map.offsets.push_back(map.localDofs.size());
+    std::sort(map.touchedRanges.begin(), map.touchedRanges.end());
+    map.touchedRanges.erase(
+        std::unique(map.touchedRanges.begin(), map.touchedRanges.end()),
+        map.touchedRanges.end());
+  }
+}
+
+/** Colour the non-empty DOF range maps so that the maps of each colour touch
+ *  disjoint ranges of global DOFs. On output, colours[c] contains the
+ *  indices of the maps of colour c. */
+template <typename BasisFunctionType>
+void colourDofRangeMaps(const std::vector<DofRangeMap<BasisFunctionType>> &maps,
+                        std::vector<std::vector<size_t>> &colours) {
+  colours.clear();
+  // Colours of the maps and the already coloured maps touching each range
+  std::vector<size_t> mapColours(maps.size());
+  std::vector<std::vector<size_t>> rangeUsers(maps.size());
+  std::vector<bool> forbidden;
+  for (size_t i = 0; i < maps.size(); ++i) {
+    const DofRangeMap<BasisFunctionType> &map = maps[i];
+    if (map.elementIndices.empty())
+      continue;
+    forbidden.assign(colours.size(), false);
+    for (size_t r = 0; r < map.touchedRanges.size(); ++r) {
+      const std::vector<size_t> &users = rangeUsers[map.touchedRanges[r]];
+      for (size_t u = 0; u < users.size(); ++u)
+        forbidden[mapColours[users[u]]] = true;
+    }
+    const size_t colour =
+        std::find(forbidden.begin(), forbidden.end(), false) -
+        forbidden.begin();
+    if (colour == colours.size())
+      colours.push_back(std::vector<size_t>());
+    colours[colour].push_back(i);
+    mapColours[i] = colour;
+    for (size_t r = 0; r < map.touchedRanges.size(); ++r)
+      rangeUsers[map.touchedRanges[r]].push_back(i);
+  }
+}
+
+/** Default number of global DOFs along each side of a tile used in tiled
+ *  assembly. */
+template <typename ResultType> size_t defaultDenseAssemblyTileSize() {
+  size_t l2CacheSize = 256 * 1024;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  const long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (size > 0)
+    l2CacheSize = size;
+#endif
+  // Leave half of the cache to the local weak forms
+  return std::max<size_t>(
+      32, static_cast<size_t>(
+              std::sqrt(l2CacheSize / 2. / sizeof(ResultType))));
+}
+
+// Body of parallel loop over pairs of test and trial tiles of one colour
+// pair
+
+template <typename BasisFunctionType, typename ResultType>
+class TiledDenseWeakFormAssemblerLoopBody {
+public:
+  typedef DofRangeMap<BasisFunctionType> Map;
+
+  TiledDenseWeakFormAssemblerLoopBody(
+      const std::vector<Map> &testMaps, const std::vector<size_t> &testTiles,
+      const std::vector<Map> &trialMaps, const std::vector<size_t> &trialTiles,
+      Fiber::LocalAssemblerForIntegralOperators<ResultType> &assembler,
+      arma::Mat<ResultType> &result)
+      : m_testMaps(testMaps), m_testTiles(testTiles), m_trialMaps(trialMaps),
+        m_trialTiles(trialTiles), m_assembler(assembler), m_result(result) {}
+
+  void operator()(const tbb::blocked_range2d<size_t> &r) const {
+    std::vector<arma::Mat<ResultType>> localResult;
+    for (size_t testTile = r.rows().begin(); testTile != r.rows().end();
+         ++testTile)
+      for (size_t trialTile = r.cols().begin(); trialTile != r.cols().end();
+           ++trialTile)
+        assembleTile(m_testMaps[m_testTiles[testTile]],
+                     m_trialMaps[m_trialTiles[trialTile]], localResult);
+  }
+
+private:
+  void assembleTile(const Map &testMap, const Map &trialMap,
+                    std::vector<arma::Mat<ResultType>> &localResult) const {
+    const int testElementCount = testMap.elementIndices.size();
+    const int trialElementCount = trialMap.elementIndices.size();
+    for (int trialIndex = 0; trialIndex < trialElementCount; ++trialIndex) {
+      // Evaluate integrals over pairs of the current trial element and
+      // all the test elements owned by the tile
+      m_assembler.evaluateLocalWeakForms(
+          TEST_TRIAL, testMap.elementIndices,
+          trialMap.elementIndices[trialIndex], ALL_DOFS, localResult);
+
+      // Add the integrals to the matrix. No other thread writes to the
+      // ranges of rows and columns touched by these elements.
+      for (int trialEntry = trialMap.offsets[trialIndex];
+           trialEntry < trialMap.offsets[trialIndex + 1]; ++trialEntry) {
+        const int trialDof = trialMap.localDofs[trialEntry];
+        const BasisFunctionType trialWeight =
+            trialMap.localDofWeights[trialEntry];
+        ResultType *column = m_result.colptr(trialMap.globalDofs[trialEntry]);
+        for (int testIndex = 0; testIndex < testElementCount; ++testIndex) {
+          const arma::Mat<ResultType> &localWeakForm = localResult[testIndex];
+          for (int testEntry = testMap.offsets[testIndex];
+               testEntry < testMap.offsets[testIndex + 1]; ++testEntry)
+            column[testMap.globalDofs[testEntry]] +=
+                conj(testMap.localDofWeights[testEntry]) * trialWeight *
+                localWeakForm(testMap.localDofs[testEntry], trialDof);
+        }
+      }
+    }
+  }
+
+  const std::vector<Map> &m_testMaps;
+  const std::vector<size_t> &m_testTiles;
+  const std::vector<Map> &m_trialMaps;
+  const std::vector<size_t> &m_trialTiles;
+  typename Fiber::LocalAssemblerForIntegralOperators<ResultType> &m_assembler;
+  // No locking: the parts of the matrix written by different tasks do not
+  // overlap
+  arma::Mat<ResultType> &m_result;
+};
+
 /** Build a list of lists of global DOF indices corresponding to the local DOFs
  *  on each element of space.grid(). */
 template <typename BasisFunctionType>
@@ -209,7 +390,36 @@ DenseGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
       maxThreadCount = parallelOptions.maxThreadCount();
   }
   tbb::task_scheduler_init scheduler(maxThreadCount);
-  {
+  if (options.isTiledDenseAssemblyEnabled()) {
+    typedef TiledDenseWeakFormAssemblerLoopBody<BasisFunctionType, ResultType>
+    TiledBody;
+    const size_t tileSize =
+        options.denseAssemblyTileSize() == AssemblyOptions::AUTO
+            ? defaultDenseAssemblyTileSize<ResultType>()
+            : options.denseAssemblyTileSize();
+    std::vector<DofRangeMap<BasisFunctionType>> testMaps, trialMaps;
+    buildDofRangeMaps(testGlobalDofs, testLocalDofWeights,
+                      testSpace.globalDofCount(), tileSize, testMaps);
+    buildDofRangeMaps(trialGlobalDofs, trialLocalDofWeights,
+                      trialSpace.globalDofCount(), tileSize, trialMaps);
+    std::vector<std::vector<size_t>> testColours, trialColours;
+    colourDofRangeMaps(testMaps, testColours);
+    colourDofRangeMaps(trialMaps, trialColours);
+
+    // Every pair of elements is integrated once, by the task processing the
+    // pair of tiles owning these elements. The tasks of each pair of
+    // colours write to disjoint parts of the matrix and run in parallel.
+    Fiber::SerialBlasRegion region;
+    for (size_t testColour = 0; testColour < testColours.size(); ++testColour)
+      for (size_t trialColour = 0; trialColour < trialColours.size();
+           ++trialColour)
+        tbb::parallel_for(
+            tbb::blocked_range2d<size_t>(
+                0, testColours[testColour].size(), 1, 0,
+                trialColours[trialColour].size(), 1),
+            TiledBody(testMaps, testColours[testColour], trialMaps,
+                      trialColours[trialColour], assembler, result));
+  } else {
     Fiber::SerialBlasRegion region;
     tbb::parallel_for(tbb::blocked_range<size_t>(0, trialElementCount),
                       Body(testIndices, testGlobalDofs, trialGlobalDofs,
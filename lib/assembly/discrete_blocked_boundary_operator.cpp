@@ -24,6 +24,11 @@
 #include "discrete_blocked_boundary_operator.hpp"
 
 #include "discrete_aca_boundary_operator.hpp"
+#ifdef WITH_TRILINOS
+#include "discrete_hmat_boundary_operator.hpp"
+#include "discrete_sparse_boundary_operator.hpp"
+#include "../hmat/hmatrix.hpp"
+#endif // WITH_TRILINOS
 #ifdef WITH_AHMED
 #include "ahmed_aux.hpp"
 #endif
@@ -31,8 +36,13 @@
 #include "../fiber/_4d_array.hpp"
 #include "../fiber/explicit_instantiation.hpp"
 
+#include <algorithm>
 #include <numeric>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/partitioner.h>
 #ifdef WITH_TRILINOS
+#include <Epetra_CrsMatrix.h>
 #include <Thyra_DefaultSpmdVectorSpace_decl.hpp>
 #endif // WITH_TRILINOS
 
@@ -455,6 +465,54 @@ void checkConsistency(const blcluster *b) {
 
 } // namespace
 
+// Functions used in DiscreteBlockedBoundaryOperator::applyBuiltInImpl() and
+// applyBuiltInMultiVectorImpl().
+namespace {
+
+// Estimate the number of multiply-adds needed to apply an operator
+template <typename ValueType>
+double estimateApplicationCost(const DiscreteBoundaryOperator<ValueType> &op) {
+#ifdef WITH_TRILINOS
+  typedef DiscreteSparseBoundaryOperator<ValueType> SparseOp;
+  typedef DiscreteHMatBoundaryOperator<ValueType> HMatOp;
+  typedef hmat::DefaultHMatrixType<ValueType> HMatrix;
+  if (const SparseOp *sparseOp = dynamic_cast<const SparseOp *>(&op))
+    return sparseOp->epetraMatrix()->NumGlobalNonzeros();
+  if (const HMatOp *hmatOp = dynamic_cast<const HMatOp *>(&op))
+    if (const HMatrix *hMatrix =
+            dynamic_cast<const HMatrix *>(hmatOp->compressedMatrix().get()))
+      return hMatrix->memSizeKb() * 1024. / sizeof(ValueType);
+#endif // WITH_TRILINOS
+  // Dense matrices and operators of unknown structure
+  return static_cast<double>(op.rowCount()) * op.columnCount();
+}
+
+// Return the indices of the block rows of costs, sorted by decreasing total
+// cost. Scheduling the most expensive rows first balances the load.
+std::vector<size_t> blockRowOrder(const Fiber::_2dArray<double> &costs) {
+  std::vector<double> rowCosts(costs.extent(0), 0.);
+  for (size_t col = 0; col < costs.extent(1); ++col)
+    for (size_t row = 0; row < costs.extent(0); ++row)
+      rowCosts[row] += costs(row, col);
+  std::vector<size_t> order(rowCosts.size());
+  for (size_t row = 0; row < order.size(); ++row)
+    order[row] = row;
+  std::stable_sort(order.begin(), order.end(),
+                   [&rowCosts](size_t a, size_t b) {
+                     return rowCosts[a] > rowCosts[b];
+                   });
+  return order;
+}
+
+std::vector<size_t> chunkStarts(const std::vector<size_t> &chunkSizes) {
+  std::vector<size_t> starts(chunkSizes.size(), 0);
+  for (size_t i = 1; i < chunkSizes.size(); ++i)
+    starts[i] = starts[i - 1] + chunkSizes[i - 1];
+  return starts;
+}
+
+} // namespace
+
 template <typename ValueType>
 DiscreteBlockedBoundaryOperator<ValueType>::DiscreteBlockedBoundaryOperator(
     const Fiber::_2dArray<shared_ptr<const Base>> &blocks,
@@ -487,6 +545,17 @@ DiscreteBlockedBoundaryOperator<ValueType>::DiscreteBlockedBoundaryOperator(
               toString(rowCounts[row]) + ", " + toString(columnCounts[col]) +
               ")");
       }
+
+  Fiber::_2dArray<double> costs(blocks.extent(0), blocks.extent(1));
+  Fiber::_2dArray<double> transposedCosts(blocks.extent(1), blocks.extent(0));
+  for (size_t col = 0; col < blocks.extent(1); ++col)
+    for (size_t row = 0; row < blocks.extent(0); ++row) {
+      costs(row, col) =
+          blocks(row, col) ? estimateApplicationCost(*blocks(row, col)) : 0.;
+      transposedCosts(col, row) = costs(row, col);
+    }
+  m_blockRowOrder = blockRowOrder(costs);
+  m_blockColumnOrder = blockRowOrder(transposedCosts);
 #ifdef WITH_TRILINOS
   m_domainSpace = Thyra::defaultSpmdVectorSpace<ValueType>(
       std::accumulate(m_columnCounts.begin(), m_columnCounts.end(), 0));
@@ -813,41 +882,97 @@ void DiscreteBlockedBoundaryOperator<ValueType>::applyBuiltInImpl(
     const TranspositionMode trans, const arma::Col<ValueType> &x_in,
     arma::Col<ValueType> &y_inout, const ValueType alpha,
     const ValueType beta) const {
+  // The chunks of y_inout are independent, so they are computed in parallel,
+  // the most expensive ones first.
   bool transpose = (trans == TRANSPOSE || trans == CONJUGATE_TRANSPOSE);
-  size_t y_count = transpose ? m_columnCounts.size() : m_rowCounts.size();
-  size_t x_count = transpose ? m_rowCounts.size() : m_columnCounts.size();
-
-  for (int yi = 0, y_start = 0; yi < y_count; ++yi) {
-    size_t y_chunk_size = transpose ? m_columnCounts[yi] : m_rowCounts[yi];
-    arma::Col<ValueType> y_chunk(&y_inout[y_start], y_chunk_size,
-                                 false /* copy_aux_mem */);
-    for (int xi = 0, x_start = 0; xi < x_count; ++xi) {
-      size_t x_chunk_size = transpose ? m_rowCounts[xi] : m_columnCounts[xi];
-      shared_ptr<const Base> op =
-          transpose ? m_blocks(xi, yi) : m_blocks(yi, xi);
-      //            arma::Col<ValueType> x_chunk(&x_in[colStart],
-      // m_columnCounts[col],
-      //                                         false /* copy_aux_mem */);
-      if (xi == 0) {
-        // This branch ensures that the "y += beta * y" part is done
-        if (op)
-          //                    op->apply(trans, x_chunk, y_chunk, alpha, beta);
-          op->apply(trans, x_in.rows(x_start, x_start + x_chunk_size - 1),
-                    y_chunk, alpha, beta);
-        else {
+  const std::vector<size_t> &y_chunk_sizes =
+      transpose ? m_columnCounts : m_rowCounts;
+  const std::vector<size_t> &x_chunk_sizes =
+      transpose ? m_rowCounts : m_columnCounts;
+  const std::vector<size_t> &order =
+      transpose ? m_blockColumnOrder : m_blockRowOrder;
+  const std::vector<size_t> y_starts = chunkStarts(y_chunk_sizes);
+  const std::vector<size_t> x_starts = chunkStarts(x_chunk_sizes);
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, order.size(), 1),
+      [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+          const size_t yi = order[i];
+          const size_t y_chunk_size = y_chunk_sizes[yi];
+          if (y_chunk_size == 0)
+            continue;
+          arma::Col<ValueType> y_chunk(&y_inout[y_starts[yi]], y_chunk_size,
+                                       false /* copy_aux_mem */);
+          // The "y += beta * y" part is done by the first block
+          bool scaled = false;
+          for (size_t xi = 0; xi < x_chunk_sizes.size(); ++xi) {
+            shared_ptr<const Base> op =
+                transpose ? m_blocks(xi, yi) : m_blocks(yi, xi);
+            if (!op)
+              continue;
+            const size_t x_start = x_starts[xi];
+            op->apply(trans,
+                      x_in.rows(x_start, x_start + x_chunk_sizes[xi] - 1),
+                      y_chunk, alpha, scaled ? ValueType(1.) : beta);
+            scaled = true;
+          }
+          if (!scaled) {
+            if (beta == static_cast<ValueType>(0.))
+              y_chunk.fill(0.);
+            else
+              y_chunk *= beta;
+          }
+        }
+      },
+      tbb::simple_partitioner());
+}
+
+template <typename ValueType>
+void DiscreteBlockedBoundaryOperator<ValueType>::applyBuiltInMultiVectorImpl(
+    const TranspositionMode trans, const arma::Mat<ValueType> &x_in,
+    arma::Mat<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
+  // Same as applyBuiltInImpl(), but each block receives all columns at once.
+  // The rows of a chunk are not contiguous in memory, so the chunks of
+  // y_inout are copied.
+  bool transpose = (trans == TRANSPOSE || trans == CONJUGATE_TRANSPOSE);
+  const std::vector<size_t> &y_chunk_sizes =
+      transpose ? m_columnCounts : m_rowCounts;
+  const std::vector<size_t> &x_chunk_sizes =
+      transpose ? m_rowCounts : m_columnCounts;
+  const std::vector<size_t> &order =
+      transpose ? m_blockColumnOrder : m_blockRowOrder;
+  const std::vector<size_t> y_starts = chunkStarts(y_chunk_sizes);
+  const std::vector<size_t> x_starts = chunkStarts(x_chunk_sizes);
+
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, order.size(), 1),
+      [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+          const size_t yi = order[i];
+          const size_t y_start = y_starts[yi];
+          const size_t y_chunk_size = y_chunk_sizes[yi];
+          if (y_chunk_size == 0)
+            continue;
+          arma::Mat<ValueType> y_chunk;
           if (beta == static_cast<ValueType>(0.))
-            y_chunk.fill(0.);
+            y_chunk.zeros(y_chunk_size, y_inout.n_cols);
           else
-            y_chunk *= beta;
+            y_chunk = beta * y_inout.rows(y_start, y_start + y_chunk_size - 1);
+          for (size_t xi = 0; xi < x_chunk_sizes.size(); ++xi) {
+            shared_ptr<const Base> op =
+                transpose ? m_blocks(xi, yi) : m_blocks(yi, xi);
+            const size_t x_start = x_starts[xi];
+            if (op)
+              op->apply(trans,
+                        x_in.rows(x_start, x_start + x_chunk_sizes[xi] - 1),
+                        y_chunk, alpha, 1.);
+          }
+          y_inout.rows(y_start, y_start + y_chunk_size - 1) = y_chunk;
         }
-      } else if (op)
-        //                    op->apply(trans, x_chunk, y_chunk, alpha, 1.);
-        op->apply(trans, x_in.rows(x_start, x_start + x_chunk_size - 1),
-                  y_chunk, alpha, 1.);
-      x_start += x_chunk_size;
-    }
-    y_start += y_chunk_size;
-  }
+      },
+      tbb::simple_partitioner());
 }
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteBlockedBoundaryOperator);
@@ -50,7 +50,11 @@ namespace Bempp {
  *        L_{m1} & L_{m2} & \dots  & L_{mn}
  *      \end{bmatrix}
  *  \f]
- *  is composed of \f$m \times n\f$ discrete boundary operators \f$L_{ij}\f$. */
+ *  is composed of \f$m \times n\f$ discrete boundary operators \f$L_{ij}\f$.
+ *
+ *  The block rows of the operator are applied in parallel. They are
+ *  scheduled in the order of decreasing cost, estimated from the number of
+ *  stored entries of the blocks. */
 template <typename ValueType>
 class DiscreteBlockedBoundaryOperator
     : public DiscreteBoundaryOperator<ValueType> {
@@ -131,6 +135,11 @@ private:
                                 arma::Col<ValueType> &y_inout,
                                 const ValueType alpha,
                                 const ValueType beta) const;
+  virtual void applyBuiltInMultiVectorImpl(const TranspositionMode trans,
+                                           const arma::Mat<ValueType> &x_in,
+                                           arma::Mat<ValueType> &y_inout,
+                                           const ValueType alpha,
+                                           const ValueType beta) const;
 
 #ifdef WITH_AHMED
   void mergeHMatrices(unsigned currentLevel,
@@ -146,6 +155,9 @@ private:
   Fiber::_2dArray<shared_ptr<const Base>> m_blocks;
   std::vector<size_t> m_rowCounts;
   std::vector<size_t> m_columnCounts;
+  // Block rows (columns) sorted by decreasing cost of application
+  std::vector<size_t> m_blockRowOrder;
+  std::vector<size_t> m_blockColumnOrder;
 #ifdef WITH_TRILINOS
   Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> m_domainSpace;
   Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> m_rangeSpace;
@@ -31,6 +31,7 @@
 
 #include "../fiber/explicit_instantiation.hpp"
 
+#include <Thyra_DetachedMultiVectorView.hpp>
 #include <Thyra_DetachedSpmdVectorView.hpp>
 
 namespace Bempp {
@@ -74,6 +75,14 @@ void DiscreteBoundaryOperator<ValueType>::apply(
                                 "vectors x_in and y_inout must have "
                                 "the same number of columns");
 
+  applyBuiltInMultiVectorImpl(trans, x_in, y_inout, alpha, beta);
+}
+
+template <typename ValueType>
+void DiscreteBoundaryOperator<ValueType>::applyBuiltInMultiVectorImpl(
+    const TranspositionMode trans, const arma::Mat<ValueType> &x_in,
+    arma::Mat<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
   for (size_t i = 0; i < x_in.n_cols; ++i) {
     const arma::Col<ValueType> x_in_col = x_in.unsafe_col(i);
     arma::Col<ValueType> y_inout_col = y_inout.unsafe_col(i);
@@ -122,6 +131,35 @@ void DiscreteBoundaryOperator<ValueType>::applyImpl(
 
   const Ordinal colCount = X_in.domain()->dim();
 
+  if (colCount > 1) {
+    // Pass all columns at once, so that subclasses can use matrix-matrix
+    // products
+    Thyra::ConstDetachedMultiVectorView<ValueType> xView(X_in);
+    Thyra::DetachedMultiVectorView<ValueType> yView(*Y_inout);
+    const Ordinal xRowCount = xView.subDim();
+    const Ordinal yRowCount = yView.subDim();
+
+    arma::Mat<ValueType> xMat(xRowCount, colCount);
+    arma::Mat<ValueType> yMat(yRowCount, colCount);
+    for (Ordinal col = 0; col < colCount; ++col)
+      for (Ordinal row = 0; row < xRowCount; ++row)
+        xMat(row, col) = xView(row, col);
+    if (beta == static_cast<ValueType>(0.))
+      yMat.fill(0.);
+    else
+      for (Ordinal col = 0; col < colCount; ++col)
+        for (Ordinal row = 0; row < yRowCount; ++row)
+          yMat(row, col) = yView(row, col);
+
+    applyBuiltInMultiVectorImpl(static_cast<TranspositionMode>(M_trans), xMat,
+                                yMat, alpha, beta);
+
+    for (Ordinal col = 0; col < colCount; ++col)
+      for (Ordinal row = 0; row < yRowCount; ++row)
+        yView(row, col) = yMat(row, col);
+    return;
+  }
+
   // Loop over the input columns
 
   for (Ordinal col = 0; col < colCount; ++col) {
@@ -234,6 +234,18 @@ private:
                                 arma::Col<ValueType> &y_inout,
                                 const ValueType alpha,
                                 const ValueType beta) const = 0;
+
+  /** \brief Apply the operator to all columns of a matrix.
+   *
+   *  The arguments have been checked for consistency by the caller. The
+   *  default implementation calls applyBuiltInImpl() for each column.
+   *  Subclasses that can process several vectors more efficiently at once
+   *  should override it. */
+  virtual void applyBuiltInMultiVectorImpl(const TranspositionMode trans,
+                                           const arma::Mat<ValueType> &x_in,
+                                           arma::Mat<ValueType> &y_inout,
+                                           const ValueType alpha,
+                                           const ValueType beta) const;
 };
 
 /** \relates DiscreteBoundaryOperator
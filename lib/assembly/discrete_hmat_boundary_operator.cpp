@@ -22,6 +22,11 @@
 #include "../fiber/explicit_instantiation.hpp"
 #include <boost/numeric/conversion/converter.hpp>
 #include "../hmat/compressed_matrix.hpp"
+#include "../hmat/hmatrix.hpp"
+#include "../hmat/hmatrix_io.hpp"
+#include "../hmat/hmatrix_lu.hpp"
+
+#include <typeinfo>
 
 namespace Bempp {
 
@@ -59,6 +64,17 @@ void DiscreteHMatBoundaryOperator<ValueType>::applyBuiltInImpl(
     arma::Col<ValueType> &y_inout, const ValueType alpha,
     const ValueType beta) const {
 
+  applyBuiltInMultiVectorImpl(trans, x_in, y_inout, alpha, beta);
+}
+
+template <typename ValueType>
+void DiscreteHMatBoundaryOperator<ValueType>::applyBuiltInMultiVectorImpl(
+    const TranspositionMode trans, const arma::Mat<ValueType> &x_in,
+    arma::Mat<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
+
+  // The H-matrix processes all columns at once, so that its leaves are
+  // multiplied with matrix-matrix products.
   hmat::TransposeMode hmatTrans;
   if (trans == TranspositionMode::NO_TRANSPOSE)
     hmatTrans = hmat::NOTRANS;
@@ -83,6 +99,45 @@ DiscreteHMatBoundaryOperator<ValueType>::range() const {
   return m_rangeSpace;
 }
 
+template <typename ValueType>
+shared_ptr<const hmat::CompressedMatrix<ValueType>>
+DiscreteHMatBoundaryOperator<ValueType>::compressedMatrix() const {
+  return m_compressedMatrix;
+}
+
+template <typename ValueType>
+void DiscreteHMatBoundaryOperator<ValueType>::save(
+    const std::string &fileName) const {
+  shared_ptr<const hmat::DefaultHMatrixType<ValueType>> hMatrix =
+      boost::dynamic_pointer_cast<const hmat::DefaultHMatrixType<ValueType>>(
+          m_compressedMatrix);
+  if (!hMatrix)
+    throw std::invalid_argument("DiscreteHMatBoundaryOperator::save(): "
+                                "operator is not stored as an H-matrix");
+  hmat::saveHMatrix(*hMatrix, fileName);
+}
+
+template <typename ValueType>
+shared_ptr<DiscreteHMatBoundaryOperator<ValueType>>
+DiscreteHMatBoundaryOperator<ValueType>::load(const std::string &fileName) {
+  shared_ptr<hmat::CompressedMatrix<ValueType>> hMatrix =
+      hmat::loadHMatrix<ValueType, 2>(fileName);
+  return shared_ptr<DiscreteHMatBoundaryOperator<ValueType>>(
+      new DiscreteHMatBoundaryOperator<ValueType>(hMatrix));
+}
+
+template <typename ValueType>
+shared_ptr<const DiscreteHMatBoundaryOperator<ValueType>>
+DiscreteHMatBoundaryOperator<ValueType>::castToHMat(const shared_ptr<
+    const DiscreteBoundaryOperator<ValueType>> &discreteOperator) {
+  shared_ptr<const DiscreteHMatBoundaryOperator<ValueType>> result =
+      boost::dynamic_pointer_cast<const DiscreteHMatBoundaryOperator<ValueType>>(
+          discreteOperator);
+  if (result.get() == 0 && (discreteOperator.get() != 0))
+    throw std::bad_cast();
+  return result;
+}
+
 template <typename ValueType>
 bool DiscreteHMatBoundaryOperator<ValueType>::opSupportedImpl(
     Thyra::EOpTransp M_trans) const {
@@ -90,7 +145,53 @@ bool DiscreteHMatBoundaryOperator<ValueType>::opSupportedImpl(
           M_trans == Thyra::CONJTRANS);
 }
 
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType>>
+hmatOperatorApproximateLuInverse(
+    const shared_ptr<const DiscreteBoundaryOperator<ValueType>> &op,
+    double delta) {
+  shared_ptr<const DiscreteHMatBoundaryOperator<ValueType>> hmatOp =
+      DiscreteHMatBoundaryOperator<ValueType>::castToHMat(op);
+  shared_ptr<const hmat::DefaultHMatrixType<ValueType>> hMatrix =
+      boost::dynamic_pointer_cast<const hmat::DefaultHMatrixType<ValueType>>(
+          hmatOp->compressedMatrix());
+  if (!hMatrix)
+    throw std::invalid_argument("hmatOperatorApproximateLuInverse(): "
+                                "operator is not stored as an H-matrix");
+  shared_ptr<hmat::CompressedMatrix<ValueType>> lu(
+      new hmat::HMatrixLu<ValueType, 2>(*hMatrix, delta));
+  shared_ptr<const DiscreteBoundaryOperator<ValueType>> result(
+      new DiscreteHMatBoundaryOperator<ValueType>(lu));
+  return result;
+}
+
+template <typename ValueType>
+void saveHMatOperator(
+    const shared_ptr<const DiscreteBoundaryOperator<ValueType>> &op,
+    const std::string &fileName) {
+  DiscreteHMatBoundaryOperator<ValueType>::castToHMat(op)->save(fileName);
+}
+
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType>>
+loadHMatOperator(const std::string &fileName) {
+  return DiscreteHMatBoundaryOperator<ValueType>::load(fileName);
+}
+
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteHMatBoundaryOperator);
+
+#define INSTANTIATE_FREE_FUNCTIONS(RESULT)                                     \
+  template shared_ptr<const DiscreteBoundaryOperator<RESULT>>                  \
+  hmatOperatorApproximateLuInverse(                                            \
+      const shared_ptr<const DiscreteBoundaryOperator<RESULT>> &op,            \
+      double delta);                                                           \
+  template void saveHMatOperator(                                              \
+      const shared_ptr<const DiscreteBoundaryOperator<RESULT>> &op,            \
+      const std::string &fileName);                                            \
+  template shared_ptr<const DiscreteBoundaryOperator<RESULT>>                  \
+  loadHMatOperator(const std::string &fileName)
+
+FIBER_ITERATE_OVER_VALUE_TYPES(INSTANTIATE_FREE_FUNCTIONS);
 }
 
 
@@ -27,6 +27,7 @@
 #include "discrete_boundary_operator.hpp"
 #include "../common/armadillo_fwd.hpp"
 #include <Thyra_DefaultSpmdVectorSpace_decl.hpp>
+#include <string>
 
 namespace hmat {
 
@@ -36,6 +37,53 @@ template <typename ValueType> class CompressedMatrix;
 
 namespace Bempp {
 
+template <typename ValueType> class DiscreteHMatBoundaryOperator;
+
+/** \relates DiscreteHMatBoundaryOperator
+ *  \brief Approximate LU inverse of a discrete boundary operator stored as a
+ *  H-matrix.
+ *
+ *  The LU decomposition is computed with the H-arithmetic of the hmat
+ *  library. The result can be converted to a preconditioner with
+ *  discreteOperatorToPreconditioner().
+ *
+ *  A std::bad_cast exception is thrown if the input operator can not be cast
+ *  to DiscreteHMatBoundaryOperator.
+ *
+ *  \param[in] op Discrete boundary operator for which to compute the LU
+ *  inverse.
+ *  \param[in] delta Relative accuracy of the truncation of low-rank blocks
+ *  during the decomposition.
+ *
+ *  \return A shared pointer to a newly allocated discrete boundary operator
+ *  representing the (approximate) LU inverse of \p op. */
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType>>
+hmatOperatorApproximateLuInverse(
+    const shared_ptr<const DiscreteBoundaryOperator<ValueType>> &op,
+    double delta);
+
+/** \relates DiscreteHMatBoundaryOperator
+ *  \brief Save a discrete boundary operator stored as a H-matrix to a file.
+ *
+ *  See DiscreteHMatBoundaryOperator::save(). A std::bad_cast exception is
+ *  thrown if the operator can not be cast to DiscreteHMatBoundaryOperator. */
+template <typename ValueType>
+void saveHMatOperator(
+    const shared_ptr<const DiscreteBoundaryOperator<ValueType>> &op,
+    const std::string &fileName);
+
+/** \relates DiscreteHMatBoundaryOperator
+ *  \brief Load a discrete boundary operator saved with saveHMatOperator().
+ *
+ *  See DiscreteHMatBoundaryOperator::load(). */
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType>>
+loadHMatOperator(const std::string &fileName);
+
+/** \ingroup discrete_boundary_operators
+ *  \brief Discrete linear operator stored as a H-matrix of the hmat library.
+ */
 template <typename ValueType>
 class DiscreteHMatBoundaryOperator
     : public DiscreteBoundaryOperator<ValueType> {
@@ -54,6 +102,32 @@ public:
   Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> domain() const;
   Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> range() const;
 
+  shared_ptr<const hmat::CompressedMatrix<ValueType>> compressedMatrix() const;
+
+  /** \brief Save the H-matrix to a binary file.
+   *
+   *  The file stores the block cluster tree, the DOF permutations and the
+   *  data of all leaves. It can only be read on machines with the same byte
+   *  order. A std::invalid_argument exception is thrown if the operator does
+   *  not store an H-matrix, e.g. if it represents an H-LU inverse. */
+  void save(const std::string &fileName) const;
+
+  /** \brief Load an operator saved with save().
+   *
+   *  The file is mapped into memory and the entries of the H-matrix are used
+   *  without copying them. */
+  static shared_ptr<DiscreteHMatBoundaryOperator<ValueType>>
+  load(const std::string &fileName);
+
+  /** \brief Downcast a shared pointer to a DiscreteBoundaryOperator object to
+   *  a shared pointer to a DiscreteHMatBoundaryOperator.
+   *
+   *  If the object referenced by \p discreteOperator is not in fact a
+   *  DiscreteHMatBoundaryOperator, a std::bad_cast exception is thrown. */
+  static shared_ptr<const DiscreteHMatBoundaryOperator<ValueType>>
+  castToHMat(const shared_ptr<const DiscreteBoundaryOperator<ValueType>> &
+                 discreteOperator);
+
 protected:
   bool opSupportedImpl(Thyra::EOpTransp M_trans) const;
 
@@ -63,6 +137,12 @@ private:
                         arma::Col<ValueType> &y_inout, const ValueType alpha,
                         const ValueType beta) const override;
 
+  void applyBuiltInMultiVectorImpl(const TranspositionMode trans,
+                                   const arma::Mat<ValueType> &x_in,
+                                   arma::Mat<ValueType> &y_inout,
+                                   const ValueType alpha,
+                                   const ValueType beta) const override;
+
   shared_ptr<hmat::CompressedMatrix<ValueType>> m_compressedMatrix;
 
   Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_domainSpace;
@@ -35,6 +35,7 @@
 
 #include <Teuchos_RCP.hpp>
 #include <Thyra_SpmdVectorSpaceBase_decl.hpp>
+#include <tbb/mutex.h>
 
 /** \cond FORWARD_DECL */
 class Amesos_BaseSolver;
@@ -93,6 +94,8 @@ private:
   Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_space;
   int m_symmetry;
   std::unique_ptr<Amesos_BaseSolver> m_solver;
+  // All solves share m_problem and m_solver
+  mutable tbb::mutex m_solverMutex;
   /** \endcond */
 };
 
@@ -29,168 +29,202 @@
 #include "index_permutation.hpp"
 #include "sparse_to_h_matrix_converter.hpp"
 
+#include "../common/boost_make_shared_fwd.hpp"
 #include "../common/boost_shared_array_fwd.hpp"
 #include "../fiber/explicit_instantiation.hpp"
 #include "../fiber/parallelization_options.hpp"
 
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
 #include <Epetra_Map.h>
-#include <Epetra_Vector.h>
 #include <Epetra_CrsMatrix.h>
-#include <Epetra_SerialComm.h>
+#include <Epetra_Comm.h>
 #include <Thyra_DefaultSpmdVectorSpace_decl.hpp>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
 namespace Bempp {
 
 // Helper functions for the applyBuiltIn member function
 namespace {
 
+// Number of rows processed by a single task of the parallel matrix-vector
+// product; smaller matrices are multiplied serially
+const int CRS_ROWS_PER_TASK = 1024;
+
+// Compute y := alpha * A * x + beta * y for each column of x, where A is a
+// real matrix in the compressed-row format
 template <typename ValueType>
-void reallyApplyBuiltInImpl(const Epetra_CrsMatrix &mat,
-                            const TranspositionMode trans,
-                            const arma::Col<ValueType> &x_in,
-                            arma::Col<ValueType> &y_inout,
-                            const ValueType alpha, const ValueType beta);
-
-template <>
-void reallyApplyBuiltInImpl<double>(const Epetra_CrsMatrix &mat,
-                                    const TranspositionMode trans,
-                                    const arma::Col<double> &x_in,
-                                    arma::Col<double> &y_inout,
-                                    const double alpha, const double beta) {
-  if (trans == TRANSPOSE || trans == CONJUGATE_TRANSPOSE) {
-    assert(mat.NumGlobalRows() == static_cast<int>(x_in.n_rows));
-    assert(mat.NumGlobalCols() == static_cast<int>(y_inout.n_rows));
-  } else {
-    assert(mat.NumGlobalCols() == static_cast<int>(x_in.n_rows));
-    assert(mat.NumGlobalRows() == static_cast<int>(y_inout.n_rows));
+void multiplyCrs(int rowCount, const int *rowOffsets, const int *columnIndices,
+                 const double *values, const arma::Mat<ValueType> &x,
+                 arma::Mat<ValueType> &y, const ValueType alpha,
+                 const ValueType beta,
+                 const Fiber::ParallelizationOptions &parallelOptions) {
+  typedef typename Fiber::ScalarTraits<ValueType>::RealType RealType;
+  const size_t vectorCount = x.n_cols;
+  const bool overwrite = (beta == static_cast<ValueType>(0.));
+
+  int maxThreadCount = 1;
+  if (!parallelOptions.isOpenClEnabled()) {
+    if (parallelOptions.maxThreadCount() ==
+        Fiber::ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = parallelOptions.maxThreadCount();
   }
-
-  Epetra_Map map_x((int)x_in.n_rows, 0, Epetra_SerialComm());
-  Epetra_Map map_y((int)y_inout.n_rows, 0, Epetra_SerialComm());
-
-  Epetra_Vector vec_x(View, map_x, const_cast<double *>(x_in.memptr()));
-  // vec_temp will store the result of matrix * x_in
-  Epetra_Vector vec_temp(map_y, false /* no need to initialise to zero */);
-
-  mat.Multiply(trans == TRANSPOSE || trans == CONJUGATE_TRANSPOSE, vec_x,
-               vec_temp);
-
-  if (beta == 0.)
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
-      y_inout(i) = alpha * vec_temp[i];
-  else
-    for (size_t i = 0; i < y_inout.n_rows; ++i)
-      y_inout(i) = alpha * vec_temp[i] + beta * y_inout(i);
-}
-
-template <>
-void reallyApplyBuiltInImpl<float>(const Epetra_CrsMatrix &mat,
-                                   const TranspositionMode trans,
-                                   const arma::Col<float> &x_in,
-                                   arma::Col<float> &y_inout, const float alpha,
-                                   const float beta) {
-  // Copy the float vectors to double vectors
-  arma::Col<double> x_in_double(x_in.n_rows);
-  std::copy(x_in.begin(), x_in.end(), x_in_double.begin());
-  arma::Col<double> y_inout_double(y_inout.n_rows);
-  if (beta != 0.f)
-    std::copy(y_inout.begin(), y_inout.end(), y_inout_double.begin());
-
-  // Do the operation on the double vectors
-  reallyApplyBuiltInImpl<double>(mat, trans, x_in_double, y_inout_double, alpha,
-                                 beta);
-
-  // Copy the result back to the float vector
-  std::copy(y_inout_double.begin(), y_inout_double.end(), y_inout.begin());
+  tbb::task_scheduler_init scheduler(maxThreadCount);
+  tbb::parallel_for(
+      tbb::blocked_range<int>(0, rowCount, CRS_ROWS_PER_TASK),
+      [&](const tbb::blocked_range<int> &r) {
+        for (size_t v = 0; v < vectorCount; ++v) {
+          const ValueType *xCol = x.colptr(v);
+          ValueType *yCol = y.colptr(v);
+          for (int row = r.begin(); row != r.end(); ++row) {
+            ValueType sum = 0.;
+            for (int k = rowOffsets[row]; k < rowOffsets[row + 1]; ++k)
+              sum += static_cast<RealType>(values[k]) * xCol[columnIndices[k]];
+            yCol[row] =
+                overwrite ? alpha * sum : alpha * sum + beta * yCol[row];
+          }
+        }
+      });
 }
 
-template <>
-void reallyApplyBuiltInImpl<std::complex<float>>(
-    const Epetra_CrsMatrix &mat, const TranspositionMode trans,
-    const arma::Col<std::complex<float>> &x_in,
-    arma::Col<std::complex<float>> &y_inout, const std::complex<float> alpha,
-    const std::complex<float> beta) {
-  // Do the y_inout *= beta part
-  const std::complex<float> zero(0.f, 0.f);
-  if (beta == zero)
-    y_inout.fill(zero);
-  else
-    y_inout *= beta;
-
-  // Separate the real and imaginary components and store them in
-  // double-precision vectors
-  arma::Col<double> x_real(x_in.n_rows);
-  for (size_t i = 0; i < x_in.n_rows; ++i)
-    x_real(i) = x_in(i).real();
-  arma::Col<double> x_imag(x_in.n_rows);
-  for (size_t i = 0; i < x_in.n_rows; ++i)
-    x_imag(i) = x_in(i).imag();
-  arma::Col<double> y_real(y_inout.n_rows);
-  for (size_t i = 0; i < y_inout.n_rows; ++i)
-    y_real(i) = y_inout(i).real();
-  arma::Col<double> y_imag(y_inout.n_rows);
-  for (size_t i = 0; i < y_inout.n_rows; ++i)
-    y_imag(i) = y_inout(i).imag();
-
-  // Do the "+= alpha A x" part (in steps)
-  reallyApplyBuiltInImpl<double>(mat, trans, x_real, y_real, alpha.real(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_imag, y_real, -alpha.imag(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_real, y_imag, alpha.imag(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_imag, y_imag, alpha.real(), 1.);
-
-  // Copy the result back to the complex vector
-  for (size_t i = 0; i < y_inout.n_rows; ++i)
-    y_inout(i) = std::complex<float>(y_real(i), y_imag(i));
-}
-
-template <>
-void reallyApplyBuiltInImpl<std::complex<double>>(
-    const Epetra_CrsMatrix &mat, const TranspositionMode trans,
-    const arma::Col<std::complex<double>> &x_in,
-    arma::Col<std::complex<double>> &y_inout, const std::complex<double> alpha,
-    const std::complex<double> beta) {
-  // Do the y_inout *= beta part
-  const std::complex<double> zero(0., 0.);
-  if (beta == zero)
-    y_inout.fill(zero);
-  else
-    y_inout *= beta;
-
-  // Separate the real and imaginary components
-  arma::Col<double> x_real(arma::real(x_in));
-  arma::Col<double> x_imag(arma::imag(x_in));
-  arma::Col<double> y_real(arma::real(y_inout));
-  arma::Col<double> y_imag(arma::imag(y_inout));
-
-  // Do the "+= alpha A x" part (in steps)
-  reallyApplyBuiltInImpl<double>(mat, trans, x_real, y_real, alpha.real(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_imag, y_real, -alpha.imag(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_real, y_imag, alpha.imag(), 1.);
-  reallyApplyBuiltInImpl<double>(mat, trans, x_imag, y_imag, alpha.real(), 1.);
-
-  // Copy the result back to the complex vector
-  for (size_t i = 0; i < y_inout.n_rows; ++i)
-    y_inout(i) = std::complex<double>(y_real(i), y_imag(i));
+// Transpose a matrix stored in the compressed-row format
+void transposeCrs(int rowCount, int columnCount, const int *rowOffsets,
+                  const int *columnIndices, const double *values,
+                  std::vector<int> &transposedRowOffsets,
+                  std::vector<int> &transposedColumnIndices,
+                  std::vector<double> &transposedValues) {
+  const int entryCount = rowOffsets[rowCount];
+  transposedRowOffsets.assign(columnCount + 1, 0);
+  for (int k = 0; k < entryCount; ++k)
+    ++transposedRowOffsets[columnIndices[k] + 1];
+  for (int col = 0; col < columnCount; ++col)
+    transposedRowOffsets[col + 1] += transposedRowOffsets[col];
+
+  transposedColumnIndices.resize(entryCount);
+  transposedValues.resize(entryCount);
+  std::vector<int> next(transposedRowOffsets.begin(),
+                        transposedRowOffsets.end() - 1);
+  for (int row = 0; row < rowCount; ++row)
+    for (int k = rowOffsets[row]; k < rowOffsets[row + 1]; ++k) {
+      const int position = next[columnIndices[k]]++;
+      transposedColumnIndices[position] = row;
+      transposedValues[position] = values[k];
+    }
 }
 
 } // namespace
 
+/** \cond PRIVATE */
+template <typename ValueType>
+struct DiscreteSparseBoundaryOperator<ValueType>::CrsData {
+  int rowCount;
+  int columnCount;
+  const int *rowOffsets;
+  const int *columnIndices;
+  const double *values;
+  // Used if the arrays cannot be viewed directly in the Epetra matrix
+  std::vector<int> rowOffsetStorage;
+  std::vector<int> columnIndexStorage;
+  std::vector<double> valueStorage;
+};
+/** \endcond */
+
 template <typename ValueType>
 DiscreteSparseBoundaryOperator<ValueType>::DiscreteSparseBoundaryOperator(
     const shared_ptr<const Epetra_CrsMatrix> &mat, int symmetry,
     TranspositionMode trans, const shared_ptr<AhmedBemBlcluster> &blockCluster,
     const shared_ptr<IndexPermutation> &domainPermutation,
-    const shared_ptr<IndexPermutation> &rangePermutation)
+    const shared_ptr<IndexPermutation> &rangePermutation,
+    const Fiber::ParallelizationOptions &parallelizationOptions)
     : m_mat(mat), m_symmetry(symmetry), m_trans(trans),
       m_blockCluster(blockCluster), m_domainPermutation(domainPermutation),
-      m_rangePermutation(rangePermutation) {
+      m_rangePermutation(rangePermutation),
+      m_parallelizationOptions(parallelizationOptions) {
   m_domainSpace = Thyra::defaultSpmdVectorSpace<ValueType>(
       isTransposed() ? m_mat->NumGlobalRows() : m_mat->NumGlobalCols());
   m_rangeSpace = Thyra::defaultSpmdVectorSpace<ValueType>(
       isTransposed() ? m_mat->NumGlobalCols() : m_mat->NumGlobalRows());
+  initCrsData();
+}
+
+template <typename ValueType>
+void DiscreteSparseBoundaryOperator<ValueType>::initCrsData() {
+  shared_ptr<CrsData> crs = boost::make_shared<CrsData>();
+  crs->rowCount = m_mat->NumGlobalRows();
+  crs->columnCount = m_mat->NumGlobalCols();
+
+  int *rowOffsets = 0;
+  int *columnIndices = 0;
+  double *values = 0;
+  const Epetra_Map &rowMap = m_mat->RowMap();
+  const Epetra_Map &columnMap = m_mat->ColMap();
+  if (m_mat->Comm().NumProc() == 1 && m_mat->StorageOptimized() &&
+      rowMap.SameAs(m_mat->RangeMap()) &&
+      columnMap.SameAs(m_mat->DomainMap()) &&
+      m_mat->ExtractCrsDataPointers(rowOffsets, columnIndices, values) == 0) {
+    // Local indices coincide with global ones: use the arrays of the matrix
+    crs->rowOffsets = rowOffsets;
+    crs->columnIndices = columnIndices;
+    crs->values = values;
+  } else {
+    if (m_mat->Comm().NumProc() != 1)
+      throw std::runtime_error(
+          "DiscreteSparseBoundaryOperator::DiscreteSparseBoundaryOperator(): "
+          "distributed matrices are not supported");
+    // Copy the entries, translating local into global indices
+    const int localRowCount = m_mat->NumMyRows();
+    crs->rowOffsetStorage.assign(crs->rowCount + 1, 0);
+    for (int row = 0; row < localRowCount; ++row)
+      crs->rowOffsetStorage[rowMap.GID(row) + 1] = m_mat->NumMyEntries(row);
+    for (int row = 0; row < crs->rowCount; ++row)
+      crs->rowOffsetStorage[row + 1] += crs->rowOffsetStorage[row];
+    crs->columnIndexStorage.resize(crs->rowOffsetStorage.back());
+    crs->valueStorage.resize(crs->rowOffsetStorage.back());
+    for (int row = 0; row < localRowCount; ++row) {
+      int entryCount = 0;
+      double *rowValues = 0;
+      int *rowIndices = 0;
+      if (m_mat->ExtractMyRowView(row, entryCount, rowValues, rowIndices) != 0)
+        throw std::runtime_error(
+            "DiscreteSparseBoundaryOperator::DiscreteSparseBoundaryOperator(): "
+            "Epetra_CrsMatrix::ExtractMyRowView() failed");
+      const int offset = crs->rowOffsetStorage[rowMap.GID(row)];
+      for (int entry = 0; entry < entryCount; ++entry) {
+        crs->columnIndexStorage[offset + entry] =
+            columnMap.GID(rowIndices[entry]);
+        crs->valueStorage[offset + entry] = rowValues[entry];
+      }
+    }
+    crs->rowOffsets = crs->rowOffsetStorage.data();
+    crs->columnIndices = crs->columnIndexStorage.data();
+    crs->values = crs->valueStorage.data();
+  }
+  m_crs = crs;
+}
+
+template <typename ValueType>
+shared_ptr<const typename DiscreteSparseBoundaryOperator<ValueType>::CrsData>
+DiscreteSparseBoundaryOperator<ValueType>::transposedCrsData() const {
+  tbb::mutex::scoped_lock lock(m_transposedCrsMutex);
+  if (!m_transposedCrs) {
+    shared_ptr<CrsData> crs = boost::make_shared<CrsData>();
+    crs->rowCount = m_crs->columnCount;
+    crs->columnCount = m_crs->rowCount;
+    transposeCrs(m_crs->rowCount, m_crs->columnCount, m_crs->rowOffsets,
+                 m_crs->columnIndices, m_crs->values, crs->rowOffsetStorage,
+                 crs->columnIndexStorage, crs->valueStorage);
+    crs->rowOffsets = crs->rowOffsetStorage.data();
+    crs->columnIndices = crs->columnIndexStorage.data();
+    crs->values = crs->valueStorage.data();
+    m_transposedCrs = crs;
+  }
+  return m_transposedCrs;
 }
 
 template <typename ValueType>
@@ -325,13 +359,12 @@ DiscreteSparseBoundaryOperator<ValueType>::asDiscreteAcaBoundaryOperator(
 
   // Gather remaining data necessary to create the combined ACA operator
   const int symmetry = 0;
-  Fiber::ParallelizationOptions parallelOptions; // default options
 
   shared_ptr<const DiscreteBoundaryOperator<ValueType>> result(
       new DiscreteAcaBoundaryOperator<ValueType>(
           rowCount(), columnCount(), eps, trueMaximumRank, symmetry,
           m_blockCluster, mblocks, *m_domainPermutation, *m_rangePermutation,
-          parallelOptions));
+          m_parallelizationOptions));
   return result;
 }
 #endif // WITH_AHMED
@@ -389,26 +422,27 @@ void DiscreteSparseBoundaryOperator<ValueType>::applyBuiltInImpl(
     const TranspositionMode trans, const arma::Col<ValueType> &x_in,
     arma::Col<ValueType> &y_inout, const ValueType alpha,
     const ValueType beta) const {
-  TranspositionMode realTrans = trans;
-  bool transposed = isTransposed();
-  if (transposed)
-    switch (trans) {
-    case NO_TRANSPOSE:
-      realTrans = TRANSPOSE;
-      break;
-    case TRANSPOSE:
-      realTrans = NO_TRANSPOSE;
-      break;
-    case CONJUGATE:
-      realTrans = CONJUGATE_TRANSPOSE;
-      break;
-    case CONJUGATE_TRANSPOSE:
-      realTrans = CONJUGATE;
-      break;
-      // default: should not happen; anyway, don't change trans
-    }
+  // View the vectors as single-column matrices without copying them
+  const arma::Mat<ValueType> x(const_cast<ValueType *>(x_in.memptr()),
+                               x_in.n_rows, 1, false /* copy_aux_mem */);
+  arma::Mat<ValueType> y(y_inout.memptr(), y_inout.n_rows, 1,
+                         false /* copy_aux_mem */, true /* strict */);
+  applyBuiltInMultiVectorImpl(trans, x, y, alpha, beta);
+}
 
-  reallyApplyBuiltInImpl(*m_mat, realTrans, x_in, y_inout, alpha, beta);
+template <typename ValueType>
+void DiscreteSparseBoundaryOperator<ValueType>::applyBuiltInMultiVectorImpl(
+    const TranspositionMode trans, const arma::Mat<ValueType> &x_in,
+    arma::Mat<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
+  // The stored matrix is real, so conjugation does not change it
+  const bool transposeStored = (trans == TRANSPOSE ||
+                                trans == CONJUGATE_TRANSPOSE) != isTransposed();
+  shared_ptr<const CrsData> crs = transposeStored ? transposedCrsData() : m_crs;
+  assert(x_in.n_rows == static_cast<arma::uword>(crs->columnCount));
+  assert(y_inout.n_rows == static_cast<arma::uword>(crs->rowCount));
+  multiplyCrs(crs->rowCount, crs->rowOffsets, crs->columnIndices, crs->values,
+              x_in, y_inout, alpha, beta, m_parallelizationOptions);
 }
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteSparseBoundaryOperator);
@@ -33,11 +33,13 @@
 
 #include "../common/shared_ptr.hpp"
 #include "../common/boost_shared_array_fwd.hpp"
+#include "../fiber/parallelization_options.hpp"
 #include "../fiber/scalar_traits.hpp"
 
 #ifdef WITH_TRILINOS
 #include <Teuchos_RCP.hpp>
 #include <Thyra_SpmdVectorSpaceBase_decl.hpp>
+#include <tbb/mutex.h>
 /** \cond FORWARD_DECL */
 class Epetra_CrsMatrix;
 /** \endcond */
@@ -50,6 +52,13 @@ class IndexPermutation;
 
 /** \ingroup discrete_boundary_operators
  *  \brief Discrete boundary operator stored as a sparse matrix.
+ *
+ *  The operator is applied to vectors directly from the compressed-row
+ *  arrays of the Epetra matrix, in parallel over rows (with the number of
+ *  threads set by the parallelization options passed to the constructor) and
+ *  without allocating temporary vectors. Real and imaginary parts of complex
+ *  vectors are processed together. The transpose of the matrix, needed to
+ *  apply the transposed operator, is built on first use.
  */
 template <typename ValueType>
 class DiscreteSparseBoundaryOperator
@@ -71,7 +80,10 @@ public:
    *    in the Symmetry enumeration type.
    *  \param[in] trans
    *    If different from NO_TRANSPOSE, the discrete operator will represent
-   *    a transposed and/or complex-conjugated matrix \p mat. */
+   *    a transposed and/or complex-conjugated matrix \p mat.
+   *  \param[in] parallelizationOptions
+   *    Options controlling the number of threads used to apply the
+   *    operator. */
   DiscreteSparseBoundaryOperator(
       const shared_ptr<const Epetra_CrsMatrix> &mat, int symmetry = NO_SYMMETRY,
       TranspositionMode trans = NO_TRANSPOSE,
@@ -80,7 +92,9 @@ public:
       const shared_ptr<IndexPermutation> &domainPermutation =
           shared_ptr<IndexPermutation>(),
       const shared_ptr<IndexPermutation> &rangePermutation =
-          shared_ptr<IndexPermutation>());
+          shared_ptr<IndexPermutation>(),
+      const Fiber::ParallelizationOptions &parallelizationOptions =
+          Fiber::ParallelizationOptions());
 #else
   // This class cannot be used without Trilinos
 private:
@@ -151,8 +165,19 @@ private:
                                 arma::Col<ValueType> &y_inout,
                                 const ValueType alpha,
                                 const ValueType beta) const;
+  virtual void applyBuiltInMultiVectorImpl(const TranspositionMode trans,
+                                           const arma::Mat<ValueType> &x_in,
+                                           arma::Mat<ValueType> &y_inout,
+                                           const ValueType alpha,
+                                           const ValueType beta) const;
   bool isTransposed() const;
 
+#ifdef WITH_TRILINOS
+  struct CrsData;
+  void initCrsData();
+  shared_ptr<const CrsData> transposedCrsData() const;
+#endif
+
   // void constructAhmedMatrix(
   //         int* rowOffsets, int* colIndices, double* values,
   //         std::vector<unsigned int>& domain_o2p,
@@ -174,6 +199,12 @@ private:
   shared_ptr<IndexPermutation> m_domainPermutation, m_rangePermutation;
   Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_domainSpace;
   Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_rangeSpace;
+  // Compressed-row arrays of the stored matrix and, once needed, of its
+  // transpose
+  shared_ptr<const CrsData> m_crs;
+  mutable shared_ptr<const CrsData> m_transposedCrs;
+  mutable tbb::mutex m_transposedCrsMutex;
+  Fiber::ParallelizationOptions m_parallelizationOptions;
 #endif
   /** \endcond */
 };
@@ -0,0 +1,167 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_trilinos.hpp"
+
+#include "discrete_treecode_boundary_operator.hpp"
+#include "../fiber/explicit_instantiation.hpp"
+
+#include <stdexcept>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+#ifdef WITH_TRILINOS
+#include <Thyra_DefaultSpmdVectorSpace_decl.hpp>
+#endif
+
+namespace Bempp {
+
+template <typename ValueType>
+DiscreteTreecodeBoundaryOperator<ValueType>::DiscreteTreecodeBoundaryOperator(
+    unsigned int rowCount, unsigned int columnCount,
+    const std::vector<size_t> &rowOffsets,
+    const std::vector<unsigned int> &columnIndices,
+    const std::vector<ValueType> &values,
+    const shared_ptr<const FarField> &farField,
+    const ParallelizationOptions &parallelizationOptions)
+    : m_rowCount(rowCount), m_columnCount(columnCount),
+      m_rowOffsets(rowOffsets), m_columnIndices(columnIndices),
+      m_values(values), m_farField(farField),
+      m_parallelizationOptions(parallelizationOptions)
+#ifdef WITH_TRILINOS
+      ,
+      m_domainSpace(Thyra::defaultSpmdVectorSpace<ValueType>(columnCount)),
+      m_rangeSpace(Thyra::defaultSpmdVectorSpace<ValueType>(rowCount))
+#endif
+{
+  if (m_rowOffsets.size() != size_t(rowCount) + 1 ||
+      m_rowOffsets.back() != m_columnIndices.size() ||
+      m_columnIndices.size() != m_values.size())
+    throw std::invalid_argument(
+        "DiscreteTreecodeBoundaryOperator::DiscreteTreecodeBoundaryOperator(): "
+        "inconsistent near-field matrix");
+  if (!m_farField)
+    throw std::invalid_argument(
+        "DiscreteTreecodeBoundaryOperator::DiscreteTreecodeBoundaryOperator(): "
+        "farField must not be null");
+}
+
+template <typename ValueType>
+unsigned int DiscreteTreecodeBoundaryOperator<ValueType>::rowCount() const {
+  return m_rowCount;
+}
+
+template <typename ValueType>
+unsigned int DiscreteTreecodeBoundaryOperator<ValueType>::columnCount() const {
+  return m_columnCount;
+}
+
+template <typename ValueType>
+size_t
+DiscreteTreecodeBoundaryOperator<ValueType>::nearFieldNonzeroCount() const {
+  return m_values.size();
+}
+
+template <typename ValueType>
+void DiscreteTreecodeBoundaryOperator<ValueType>::addBlock(
+    const std::vector<int> &rows, const std::vector<int> &cols,
+    const ValueType alpha, arma::Mat<ValueType> &block) const {
+  throw std::runtime_error("DiscreteTreecodeBoundaryOperator::"
+                           "addBlock(): not implemented");
+}
+
+#ifdef WITH_TRILINOS
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>>
+DiscreteTreecodeBoundaryOperator<ValueType>::domain() const {
+  return m_domainSpace;
+}
+
+template <typename ValueType>
+Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>>
+DiscreteTreecodeBoundaryOperator<ValueType>::range() const {
+  return m_rangeSpace;
+}
+
+template <typename ValueType>
+bool DiscreteTreecodeBoundaryOperator<ValueType>::opSupportedImpl(
+    Thyra::EOpTransp M_trans) const {
+  return (M_trans == Thyra::NOTRANS);
+}
+#endif // WITH_TRILINOS
+
+template <typename ValueType>
+void DiscreteTreecodeBoundaryOperator<ValueType>::applyBuiltInImpl(
+    const TranspositionMode trans, const arma::Col<ValueType> &x_in,
+    arma::Col<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
+  const arma::Mat<ValueType> x(const_cast<ValueType *>(x_in.memptr()),
+                               x_in.n_rows, 1, false /* copy_aux_mem */);
+  arma::Mat<ValueType> y(y_inout.memptr(), y_inout.n_rows, 1,
+                         false /* copy_aux_mem */, true /* strict */);
+  applyBuiltInMultiVectorImpl(trans, x, y, alpha, beta);
+}
+
+template <typename ValueType>
+void DiscreteTreecodeBoundaryOperator<ValueType>::applyBuiltInMultiVectorImpl(
+    const TranspositionMode trans, const arma::Mat<ValueType> &x_in,
+    arma::Mat<ValueType> &y_inout, const ValueType alpha,
+    const ValueType beta) const {
+  if (trans != NO_TRANSPOSE)
+    throw std::invalid_argument(
+        "DiscreteTreecodeBoundaryOperator::applyBuiltInImpl(): "
+        "only the NO_TRANSPOSE mode is supported");
+
+  if (beta == static_cast<ValueType>(0.))
+    y_inout.fill(static_cast<ValueType>(0.));
+  else
+    y_inout *= beta;
+
+  // Near field: each task owns a range of rows of the output, so no
+  // synchronisation is needed
+  int maxThreadCount = 1;
+  if (!m_parallelizationOptions.isOpenClEnabled()) {
+    if (m_parallelizationOptions.maxThreadCount() ==
+        ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = m_parallelizationOptions.maxThreadCount();
+  }
+  tbb::task_scheduler_init scheduler(maxThreadCount);
+  const size_t vectorCount = x_in.n_cols;
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, m_rowCount, 256),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t row = r.begin(); row != r.end(); ++row)
+      for (size_t v = 0; v < vectorCount; ++v) {
+        ValueType sum = 0.;
+        for (size_t k = m_rowOffsets[row]; k < m_rowOffsets[row + 1]; ++k)
+          sum += m_values[k] * x_in(m_columnIndices[k], v);
+        y_inout(row, v) += alpha * sum;
+      }
+  });
+
+  // Far field
+  m_farField->apply(x_in, y_inout, alpha);
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_RESULT(DiscreteTreecodeBoundaryOperator);
+
+} // namespace Bempp
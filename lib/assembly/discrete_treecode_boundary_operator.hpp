@@ -0,0 +1,144 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "bempp/common/config_trilinos.hpp"
+
+#ifndef bempp_discrete_treecode_boundary_operator_hpp
+#define bempp_discrete_treecode_boundary_operator_hpp
+
+#include "../common/common.hpp"
+
+#include "discrete_boundary_operator.hpp"
+
+#include "../common/shared_ptr.hpp"
+#include "../fiber/parallelization_options.hpp"
+
+#include <vector>
+
+#ifdef WITH_TRILINOS
+#include <Teuchos_RCP.hpp>
+#include <Thyra_SpmdVectorSpaceBase_decl.hpp>
+#endif
+
+namespace Bempp {
+
+using Fiber::ParallelizationOptions;
+
+/** \ingroup discrete_boundary_operators
+ *  \brief Matrix-free discrete boundary operator whose far field is applied
+ *  with a treecode.
+ *
+ *  The operator is the sum of a sparse matrix, which contains the exact
+ *  interactions of neighbouring elements, and of a far-field term, which is
+ *  not stored but applied by a Chebyshev treecode every time the operator
+ *  acts on a vector. Objects of this class are created by the treecode
+ *  assembly mode (see AssemblyOptions::switchToTreecodeMode()).
+ *
+ *  Only the application of the operator itself, and not of its transpose, is
+ *  supported. */
+template <typename ValueType>
+class DiscreteTreecodeBoundaryOperator
+    : public DiscreteBoundaryOperator<ValueType> {
+public:
+  /** \brief Far-field part of the operator. */
+  class FarField {
+  public:
+    virtual ~FarField() {}
+
+    /** \brief Compute <tt>y += alpha * F * x</tt>, where \c F is the far-field
+     *  part of the operator.
+     *
+     *  Each column of \p x is a vector to which the operator is applied. */
+    virtual void apply(const arma::Mat<ValueType> &x, arma::Mat<ValueType> &y,
+                       ValueType alpha) const = 0;
+  };
+
+  /** \brief Constructor.
+   *
+   *  \param[in] rowCount Number of rows of the operator.
+   *  \param[in] columnCount Number of columns of the operator.
+   *  \param[in] rowOffsets, columnIndices, values
+   *    Near-field part of the operator stored in the compressed sparse row
+   *    format. \p rowOffsets should have <tt>rowCount + 1</tt> elements and
+   *    the column indices of each row should be sorted.
+   *  \param[in] farField Far-field part of the operator.
+   *  \param[in] parallelizationOptions
+   *    Options determining the number of threads used to apply the
+   *    near-field part of the operator. */
+  DiscreteTreecodeBoundaryOperator(
+      unsigned int rowCount, unsigned int columnCount,
+      const std::vector<size_t> &rowOffsets,
+      const std::vector<unsigned int> &columnIndices,
+      const std::vector<ValueType> &values,
+      const shared_ptr<const FarField> &farField,
+      const ParallelizationOptions &parallelizationOptions);
+
+  virtual unsigned int rowCount() const;
+  virtual unsigned int columnCount() const;
+
+  /** \brief Number of nonzero entries of the near-field part of the
+   *  operator. */
+  size_t nearFieldNonzeroCount() const;
+
+  virtual void addBlock(const std::vector<int> &rows,
+                        const std::vector<int> &cols, const ValueType alpha,
+                        arma::Mat<ValueType> &block) const;
+
+#ifdef WITH_TRILINOS
+public:
+  virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> domain() const;
+  virtual Teuchos::RCP<const Thyra::VectorSpaceBase<ValueType>> range() const;
+
+protected:
+  virtual bool opSupportedImpl(Thyra::EOpTransp M_trans) const;
+#endif
+
+private:
+  virtual void applyBuiltInImpl(const TranspositionMode trans,
+                                const arma::Col<ValueType> &x_in,
+                                arma::Col<ValueType> &y_inout,
+                                const ValueType alpha,
+                                const ValueType beta) const;
+
+  virtual void applyBuiltInMultiVectorImpl(const TranspositionMode trans,
+                                           const arma::Mat<ValueType> &x_in,
+                                           arma::Mat<ValueType> &y_inout,
+                                           const ValueType alpha,
+                                           const ValueType beta) const;
+
+private:
+  /** \cond PRIVATE */
+  unsigned int m_rowCount;
+  unsigned int m_columnCount;
+  std::vector<size_t> m_rowOffsets;
+  std::vector<unsigned int> m_columnIndices;
+  std::vector<ValueType> m_values;
+  shared_ptr<const FarField> m_farField;
+  ParallelizationOptions m_parallelizationOptions;
+#ifdef WITH_TRILINOS
+  Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_domainSpace;
+  Teuchos::RCP<const Thyra::SpmdVectorSpaceBase<ValueType>> m_rangeSpace;
+#endif
+  /** \endcond */
+};
+
+} // namespace Bempp
+
+#endif
@@ -25,6 +25,7 @@
 #include "dense_global_assembler.hpp"
 #include "discrete_boundary_operator.hpp"
 #include "context.hpp"
+#include "treecode_global_assembler.hpp"
 #include "local_assembler_construction_helper.hpp"
 #include "hmat_global_assembler.hpp"
 
@@ -127,6 +128,9 @@ ElementaryIntegralOperator<BasisFunctionType, KernelType, ResultType>::
   case AssemblyOptions::HMAT:
     return shared_ptr<DiscreteBoundaryOperator<ResultType>>(
         assembleWeakFormInHMatMode(assembler, context).release());
+  case AssemblyOptions::TREECODE:
+    return shared_ptr<DiscreteBoundaryOperator<ResultType>>(
+        assembleWeakFormInTreecodeMode(assembler, context).release());
   default:
     throw std::runtime_error(
         "ElementaryIntegralOperator::assembleWeakFormInternalImpl2(): "
@@ -186,6 +190,20 @@ ElementaryIntegralOperator<BasisFunctionType, KernelType, ResultType>::
                                             this->symmetry() & SYMMETRIC);
 }
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+ElementaryIntegralOperator<BasisFunctionType, KernelType, ResultType>::
+    assembleWeakFormInTreecodeMode(
+        LocalAssembler &assembler,
+        const Context<BasisFunctionType, ResultType> &context) const {
+  const Space<BasisFunctionType> &testSpace = *this->dualToRange();
+  const Space<BasisFunctionType> &trialSpace = *this->domain();
+  return TreecodeGlobalAssembler<BasisFunctionType, KernelType, ResultType>::
+      assembleDetachedWeakForm(testSpace, trialSpace, kernels(),
+                               testTransformations(), trialTransformations(),
+                               integral(), assembler, context);
+}
+
 /** \endcond */
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_KERNEL_AND_RESULT(
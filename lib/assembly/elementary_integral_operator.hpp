@@ -211,6 +211,10 @@ private:
   assembleWeakFormInHMatMode(
       LocalAssembler &assembler,
       const Context<BasisFunctionType, ResultType> &context) const;
+  std::unique_ptr<DiscreteBoundaryOperator<ResultType_>>
+  assembleWeakFormInTreecodeMode(
+      LocalAssembler &assembler,
+      const Context<BasisFunctionType, ResultType> &context) const;
 
   /** \endcond */
 };
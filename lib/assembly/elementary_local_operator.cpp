@@ -432,7 +432,8 @@ ElementaryLocalOperator<BasisFunctionType, ResultType>::
   return std::unique_ptr<DiscreteBoundaryOperator<ResultType>>(
       new DiscreteSparseBoundaryOperator<ResultType>(
           result, this->symmetry(), NO_TRANSPOSE, blockCluster,
-          trial_o2pPermutation, test_o2pPermutation));
+          trial_o2pPermutation, test_o2pPermutation,
+          options.parallelizationOptions()));
 #else // WITH_TRILINOS
   throw std::runtime_error(
       "ElementaryLocalOperator::assembleWeakFormInSparseMode(): "
@@ -24,6 +24,7 @@
 #include "assembled_potential_operator.hpp"
 #include "evaluation_options.hpp"
 #include "grid_function.hpp"
+#include "hmat_global_assembler.hpp"
 #include "interpolated_function.hpp"
 #include "local_assembler_construction_helper.hpp"
 #include "discrete_null_boundary_operator.hpp"
@@ -130,7 +131,15 @@ ElementaryPotentialOperator<BasisFunctionType, KernelType, ResultType>::
     arma::Mat<ResultType> result;
     evaluator->evaluate(Evaluator::FAR_FIELD, evaluationPoints, result);
     return result;
-  } else if (options.evaluationMode() == EvaluationOptions::ACA) {
+  } else if (options.evaluationMode() == EvaluationOptions::TREECODE) {
+    std::unique_ptr<Evaluator> evaluator =
+        makeEvaluator(argument, quadStrategy, options);
+    arma::Mat<ResultType> result;
+    evaluator->evaluateWithTreecode(evaluationPoints,
+                                    options.treecodeOptions(), result);
+    return result;
+  } else if (options.evaluationMode() == EvaluationOptions::ACA ||
+             options.evaluationMode() == EvaluationOptions::HMAT) {
     AssembledPotentialOperator<BasisFunctionType, ResultType> assembledOp =
         assemble(argument.space(), make_shared_from_ref(evaluationPoints),
                  quadStrategy, options);
@@ -276,6 +285,16 @@ ElementaryPotentialOperator<BasisFunctionType, KernelType, ResultType>::
     return shared_ptr<DiscreteBoundaryOperator<ResultType>>(
         assembleOperatorInAcaMode(space, evaluationPoints, assembler, options)
             .release());
+  case EvaluationOptions::HMAT:
+    return shared_ptr<DiscreteBoundaryOperator<ResultType>>(
+        assembleOperatorInHMatMode(space, evaluationPoints, assembler, options)
+            .release());
+  case EvaluationOptions::TREECODE:
+    throw std::invalid_argument(
+        "ElementaryPotentialOperator::assembleOperator(): "
+        "the treecode evaluation mode does not produce matrix "
+        "representations of potential operators; use evaluateAtPoints() "
+        "instead");
   default:
     throw std::runtime_error(
         "ElementaryPotentialOperator::assembleWeakFormInternalImpl(): "
@@ -388,6 +407,17 @@ ElementaryPotentialOperator<BasisFunctionType, KernelType, ResultType>::
       assemblePotentialOperator(evaluationPoints, space, assembler, options);
 }
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+ElementaryPotentialOperator<BasisFunctionType, KernelType, ResultType>::
+    assembleOperatorInHMatMode(
+        const Space<BasisFunctionType> &space,
+        const arma::Mat<CoordinateType> &evaluationPoints,
+        LocalAssembler &assembler, const EvaluationOptions &options) const {
+  return HMatGlobalAssembler<BasisFunctionType, ResultType>::
+      assemblePotentialOperator(evaluationPoints, space, assembler, options);
+}
+
 /** \endcond */
 
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_KERNEL_AND_RESULT(
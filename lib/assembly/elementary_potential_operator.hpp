@@ -195,6 +195,12 @@ private:
                             const arma::Mat<CoordinateType> &evaluationPoints,
                             LocalAssembler &assembler,
                             const EvaluationOptions &options) const;
+
+  std::unique_ptr<DiscreteBoundaryOperator<ResultType_>>
+  assembleOperatorInHMatMode(const Space<BasisFunctionType> &space,
+                             const arma::Mat<CoordinateType> &evaluationPoints,
+                             LocalAssembler &assembler,
+                             const EvaluationOptions &options) const;
   /** \endcond */
 };
 
@@ -20,6 +20,8 @@
 
 #include "evaluation_options.hpp"
 
+#include "../common/global_parameters.hpp"
+
 namespace Bempp {
 
 EvaluationOptions::EvaluationOptions()
@@ -32,12 +34,35 @@ void EvaluationOptions::switchToAcaMode(const AcaOptions &acaOptions) {
   m_acaOptions = acaOptions;
 }
 
+void EvaluationOptions::switchToHMatMode() {
+  switchToHMatMode(GlobalParameters::parameterList().sublist("HMatParameters"));
+}
+
+void EvaluationOptions::switchToHMatMode(const ParameterList &hMatParameters) {
+  m_evaluationMode = HMAT;
+  m_hMatParameters = hMatParameters;
+}
+
+void EvaluationOptions::switchToTreecodeMode(
+    const TreecodeOptions &treecodeOptions) {
+  m_evaluationMode = TREECODE;
+  m_treecodeOptions = treecodeOptions;
+}
+
 EvaluationOptions::Mode EvaluationOptions::evaluationMode() const {
   return m_evaluationMode;
 }
 
 const AcaOptions &EvaluationOptions::acaOptions() const { return m_acaOptions; }
 
+const ParameterList &EvaluationOptions::hMatParameters() const {
+  return m_hMatParameters;
+}
+
+const TreecodeOptions &EvaluationOptions::treecodeOptions() const {
+  return m_treecodeOptions;
+}
+
 // void EvaluationOptions::switchToOpenCl(const OpenClOptions& openClOptions)
 //{
 //    m_parallelizationOptions.switchToOpenCl(openClOptions);
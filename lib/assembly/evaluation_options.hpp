@@ -26,12 +26,15 @@
 #include "aca_options.hpp"
 
 #include "../common/deprecated.hpp"
+#include "../common/types.hpp"
+#include "../fiber/treecode_options.hpp"
 #include "../fiber/opencl_options.hpp"
 #include "../fiber/parallelization_options.hpp"
 #include "../fiber/verbosity_level.hpp"
 
 namespace Bempp {
 
+using Fiber::TreecodeOptions;
 using Fiber::OpenClOptions;
 using Fiber::ParallelizationOptions;
 using Fiber::VerbosityLevel;
@@ -57,7 +60,11 @@ public:
     DENSE,
     /** \brief Assemble hierarchical matrices using adaptive cross approximation
        (ACA). */
-    ACA
+    ACA,
+    /** \brief Assemble hierarchical matrices using the HMat library. */
+    HMAT,
+    /** \brief Evaluate potentials with an octree Chebyshev treecode. */
+    TREECODE
   };
 
   /** \brief Use dense-matrix representations of elementary potential operators.
@@ -117,10 +124,53 @@ public:
    */
   void switchToAcaMode(const AcaOptions &acaOptions);
 
+  /** \brief Use the HMat library to obtain hierarchical-matrix
+   *  representations of potential operators.
+   *
+   *  The parameters of the H-matrix are taken from the "HMatParameters"
+   *  sublist of GlobalParameters::parameterList(). */
+  void switchToHMatMode();
+
+  /** \brief Use the HMat library to obtain hierarchical-matrix
+   *  representations of potential operators.
+   *
+   *  \param[in] hMatParameters Parameters of the H-matrix, with the same
+   *  entries as the "HMatParameters" sublist of
+   *  GlobalParameters::parameterList(). The "HMatAssemblyMode" entry is
+   *  ignored.
+   *
+   *  In this mode, evaluation of potentials entails the construction of a
+   *  rectangular H-matrix whose rows are clustered by the positions of the
+   *  evaluation points and whose columns are clustered by the bounding boxes
+   *  of the DOFs of the charge distribution. Otherwise it works as the ACA
+   *  mode; as there, a value of the "eta" parameter smaller than the one
+   *  used for boundary operators is usually more efficient. */
+  void switchToHMatMode(const ParameterList &hMatParameters);
+
+  /** \brief Use the treecode mode to evaluate potentials.
+   *
+   *  \param[in] treecodeOptions Parameters of the treecode.
+   *
+   *  In this mode, PotentialOperator::evaluateAtPoints() and
+   *  evaluateOnGrid() do not form any matrix. The quadrature points of the
+   *  charge distribution and the evaluation points are sorted into an
+   *  octree; potentials of distant boxes are approximated by Chebyshev
+   *  interpolation and those of neighbouring boxes are summed directly, as
+   *  in the dense mode. Unlike a fast multipole method, the treecode has no
+   *  source-side expansions, so the cost grows as N log N with the number N
+   *  of points, with a constant proportional to the cube of
+   *  TreecodeOptions::expansionOrder (see Fiber::ChebyshevTreecode). The
+   *  method is accurate for the Laplace and modified Helmholtz potentials
+   *  and for Helmholtz potentials at low frequencies.
+   *
+   *  PotentialOperator::assemble() is not available in this mode. */
+  void switchToTreecodeMode(
+      const TreecodeOptions &treecodeOptions = TreecodeOptions());
+
   /** \brief Return current evaluation mode.
    *
-   *  The evaluation mode can be changed by calling switchToDenseMode() or
-   *  switchToAcaMode(). */
+   *  The evaluation mode can be changed by calling switchToDenseMode(),
+   *  switchToAcaMode(), switchToHMatMode() or switchToTreecodeMode(). */
   Mode evaluationMode() const;
 
   /** \brief Return the current adaptive cross approximation (ACA) settings.
@@ -129,6 +179,18 @@ public:
    *  evaluationMode() returns ACA. */
   const AcaOptions &acaOptions() const;
 
+  /** \brief Return the current parameters of the HMat library.
+   *
+   *  \note These settings are only used in the HMAT evaluation mode, i.e.
+   *  when evaluationMode() returns HMAT. */
+  const ParameterList &hMatParameters() const;
+
+  /** \brief Return the current parameters of the treecode.
+   *
+   *  \note These settings are only used in the treecode evaluation mode,
+   *  i.e. when evaluationMode() returns TREECODE. */
+  const TreecodeOptions &treecodeOptions() const;
+
   /** @}
     @name Parallelization
     @{ */
@@ -172,6 +234,8 @@ private:
   /** \cond */
   Mode m_evaluationMode;
   AcaOptions m_acaOptions;
+  ParameterList m_hMatParameters;
+  TreecodeOptions m_treecodeOptions;
   ParallelizationOptions m_parallelizationOptions;
   VerbosityLevel::Level m_verbosityLevel;
   /** \endcond */
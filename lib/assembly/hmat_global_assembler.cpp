@@ -29,7 +29,9 @@
 #include "discrete_boundary_operator_composition.hpp"
 #include "discrete_sparse_boundary_operator.hpp"
 #include "weak_form_hmat_assembly_helper.hpp"
+#include "potential_operator_hmat_assembly_helper.hpp"
 #include "discrete_hmat_boundary_operator.hpp"
+#include "symmetry.hpp"
 
 #include "../common/armadillo_fwd.hpp"
 #include "../common/auto_timer.hpp"
@@ -37,7 +39,9 @@
 #include "../common/to_string.hpp"
 #include "../fiber/explicit_instantiation.hpp"
 #include "../fiber/local_assembler_for_integral_operators.hpp"
+#include "../fiber/local_assembler_for_potential_operators.hpp"
 #include "../fiber/scalar_traits.hpp"
+#include "../fiber/serial_blas_region.hpp"
 #include "../fiber/shared_ptr.hpp"
 #include "../space/space.hpp"
 #include "../common/bounding_box.hpp"
@@ -103,29 +107,71 @@ private:
   std::vector<BoundingBox<CoordinateType>> m_bemppBoundingBoxes;
 };
 
+// Rows of a potential operator correspond to the components of the potential
+// at the evaluation points; all components at a point share its position.
+template <typename CoordinateType>
+class PointsHMatGeometryInterface : public hmat::GeometryInterface {
+
+public:
+  PointsHMatGeometryInterface(const arma::Mat<CoordinateType> &points,
+                              int componentCount)
+      : m_points(points), m_componentCount(componentCount), m_counter(0) {}
+
+  shared_ptr<const hmat::GeometryDataType> next() override {
+
+    if (m_counter == numberOfEntities())
+      return shared_ptr<hmat::GeometryDataType>();
+
+    const std::size_t pointIndex = m_counter / m_componentCount;
+    const double x = m_points(0, pointIndex);
+    const double y = m_points(1, pointIndex);
+    const double z = m_points(2, pointIndex);
+    m_counter++;
+    return shared_ptr<hmat::GeometryDataType>(new hmat::GeometryDataType(
+        hmat::BoundingBox(x, x, y, y, z, z),
+        std::array<double, 3>({{x, y, z}})));
+  }
+
+  std::size_t numberOfEntities() const override {
+    return m_points.n_cols * m_componentCount;
+  }
+  void reset() override { m_counter = 0; }
+
+private:
+  const arma::Mat<CoordinateType> &m_points;
+  std::size_t m_componentCount;
+  std::size_t m_counter;
+};
+
 template <typename BasisFunctionType>
 shared_ptr<hmat::DefaultBlockClusterTreeType>
 generateBlockClusterTree(const Space<BasisFunctionType> &testSpace,
                          const Space<BasisFunctionType> &trialSpace,
-                         int minBlockSize, int maxBlockSize, double eta) {
+                         int minBlockSize, int maxBlockSize, double eta,
+                         bool shareClusterTree) {
 
   hmat::Geometry testGeometry;
-  hmat::Geometry trialGeometry;
 
   auto testSpaceGeometryInterface = shared_ptr<hmat::GeometryInterface>(
       new SpaceHMatGeometryInterface<BasisFunctionType>(testSpace));
 
-  auto trialSpaceGeometryInterface = shared_ptr<hmat::GeometryInterface>(
-      new SpaceHMatGeometryInterface<BasisFunctionType>(trialSpace));
-
   hmat::fillGeometry(testGeometry, *testSpaceGeometryInterface);
-  hmat::fillGeometry(trialGeometry, *trialSpaceGeometryInterface);
 
   auto testClusterTree = shared_ptr<hmat::DefaultClusterTreeType>(
       new hmat::DefaultClusterTreeType(testGeometry, minBlockSize));
 
-  auto trialClusterTree = shared_ptr<hmat::DefaultClusterTreeType>(
-      new hmat::DefaultClusterTreeType(trialGeometry, minBlockSize));
+  auto trialClusterTree = testClusterTree;
+  if (!shareClusterTree) {
+    hmat::Geometry trialGeometry;
+
+    auto trialSpaceGeometryInterface = shared_ptr<hmat::GeometryInterface>(
+        new SpaceHMatGeometryInterface<BasisFunctionType>(trialSpace));
+
+    hmat::fillGeometry(trialGeometry, *trialSpaceGeometryInterface);
+
+    trialClusterTree = shared_ptr<hmat::DefaultClusterTreeType>(
+        new hmat::DefaultClusterTreeType(trialGeometry, minBlockSize));
+  }
 
   shared_ptr<hmat::DefaultBlockClusterTreeType> blockClusterTree(
       new hmat::DefaultBlockClusterTreeType(testClusterTree, trialClusterTree,
@@ -134,6 +180,48 @@ generateBlockClusterTree(const Space<BasisFunctionType> &testSpace,
 
   return blockClusterTree;
 }
+
+// Create the compressor selected in the HMat parameter list
+template <typename ResultType>
+std::unique_ptr<hmat::HMatrixCompressor<ResultType, 2>>
+makeCompressor(const ParameterList &hMatParameterList,
+               const hmat::DataAccessor<ResultType, 2> &helper) {
+  auto compressionAlgorithm =
+      hMatParameterList.template get<std::string>("compressionAlgorithm");
+  auto eps = hMatParameterList.template get<double>("eps");
+  auto maxRank = hMatParameterList.template get<unsigned int>("maxRank");
+  auto resizeThreshold =
+      hMatParameterList.template get<unsigned int>("resizeThreshold");
+
+  std::unique_ptr<hmat::HMatrixCompressor<ResultType, 2>> compressor;
+  if (compressionAlgorithm == "aca")
+    compressor.reset(new hmat::HMatrixAcaCompressor<ResultType, 2>(
+        helper, eps, maxRank, resizeThreshold, hmat::PARTIAL_PIVOTING));
+  else if (compressionAlgorithm == "aca+")
+    compressor.reset(new hmat::HMatrixAcaCompressor<ResultType, 2>(
+        helper, eps, maxRank, resizeThreshold, hmat::ACA_PLUS));
+  else if (compressionAlgorithm == "dense")
+    compressor.reset(new hmat::HMatrixDenseCompressor<ResultType, 2>(helper));
+  else
+    throw std::invalid_argument(
+        "HMatGlobalAssembler: compressionAlgorithm has unsupported value");
+  return compressor;
+}
+
+// Initialize TBB with the number of threads given in the options
+std::unique_ptr<tbb::task_scheduler_init>
+makeScheduler(const ParallelizationOptions &parallelOptions) {
+  int maxThreadCount = 1;
+  if (!parallelOptions.isOpenClEnabled()) {
+    if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = parallelOptions.maxThreadCount();
+  }
+  return std::unique_ptr<tbb::task_scheduler_init>(
+      new tbb::task_scheduler_init(maxThreadCount));
+}
+
 } // end anonymous namespace
 template <typename BasisFunctionType, typename ResultType>
 std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
@@ -177,9 +265,30 @@ HMatGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
   auto maxBlockSize =
       hMatParameterList.template get<unsigned int>("maxBlockSize");
   auto eta = hMatParameterList.template get<double>("eta");
+  auto eps = hMatParameterList.template get<double>("eps");
+  auto recompress = hMatParameterList.template get<bool>("recompress");
+  auto coarsening = hMatParameterList.template get<bool>("coarsening");
+
+  // Only the upper block triangle of symmetric and Hermitian operators is
+  // assembled. Non-symmetric Hermitian operators only occur for complex
+  // results; for real results SYMMETRIC takes precedence.
+  hmat::MatrixSymmetry hMatSymmetry = hmat::NOSYMM;
+  if (symmetry & SYMMETRIC)
+    hMatSymmetry = hmat::SYMM;
+  else if (symmetry & HERMITIAN)
+    hMatSymmetry = hmat::HERM;
+
+  if (hMatSymmetry != hmat::NOSYMM &&
+      actualTestSpace->globalDofCount() != actualTrialSpace->globalDofCount())
+    throw std::invalid_argument(
+        "HMatGlobalAssembler::assembleDetachedWeakForm(): "
+        "you cannot generate a symmetric weak form "
+        "using test and trial spaces with different "
+        "numbers of DOFs");
 
   auto blockClusterTree = generateBlockClusterTree(
-      *actualTestSpace, *actualTrialSpace, minBlockSize, maxBlockSize, eta);
+      *actualTestSpace, *actualTrialSpace, minBlockSize, maxBlockSize, eta,
+      hMatSymmetry != hmat::NOSYMM || &testSpace == &trialSpace);
 
   // blockClusterTree->writeToPdfFile("tree.pdf", 1024, 1024);
 
@@ -187,13 +296,35 @@ HMatGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
       *actualTestSpace, *actualTrialSpace, blockClusterTree, localAssemblers,
       sparseTermsToAdd, denseTermMultipliers, sparseTermMultipliers);
 
-  // hmat::HMatrixDenseCompressor<ResultType, 2> compressor(helper);
-  // shared_ptr<hmat::CompressedMatrix<ResultType>> hMatrix(
-  //    new hmat::DefaultHMatrixType<ResultType>(blockClusterTree, compressor));
-
-  hmat::HMatrixAcaCompressor<ResultType, 2> compressor(helper, 1E-3, 30);
-  shared_ptr<hmat::CompressedMatrix<ResultType>> hMatrix(
-      new hmat::DefaultHMatrixType<ResultType>(blockClusterTree, compressor));
+  auto compressor = makeCompressor(hMatParameterList, helper);
+
+  auto scheduler = makeScheduler(options.parallelizationOptions());
+
+  shared_ptr<hmat::DefaultHMatrixType<ResultType>> hMatrix;
+  {
+    Fiber::SerialBlasRegion region; // if possible, ensure that BLAS is
+                                    // single-threaded
+    hMatrix.reset(new hmat::DefaultHMatrixType<ResultType>(
+        blockClusterTree, *compressor, hMatSymmetry));
+
+    if (recompress) {
+      const double memSizeBefore = hMatrix->memSizeKb();
+      hMatrix->recompress(eps);
+      if (verbosityAtLeastDefault)
+        std::cout << "HMat recompression reduced the storage from "
+                  << memSizeBefore / 1024. << " MB to "
+                  << hMatrix->memSizeKb() / 1024. << " MB." << std::endl;
+    }
+
+    if (coarsening) {
+      const double memSizeBefore = hMatrix->memSizeKb();
+      hMatrix->coarsen(eps);
+      if (verbosityAtLeastDefault)
+        std::cout << "HMat coarsening reduced the storage from "
+                  << memSizeBefore / 1024. << " MB to "
+                  << hMatrix->memSizeKb() / 1024. << " MB." << std::endl;
+    }
+  }
 
   return std::unique_ptr<DiscreteBoundaryOperator<ResultType>>(
       new DiscreteHMatBoundaryOperator<ResultType>(hMatrix));
@@ -223,6 +354,102 @@ HMatGlobalAssembler<BasisFunctionType, ResultType>::assembleDetachedWeakForm(
                                   sparseTermsMultipliers, context, symmetry);
 }
 
+template <typename BasisFunctionType, typename ResultType>
+std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+HMatGlobalAssembler<BasisFunctionType, ResultType>::assemblePotentialOperator(
+    const arma::Mat<CoordinateType> &points,
+    const Space<BasisFunctionType> &trialSpace,
+    const std::vector<LocalAssemblerForPotentialOperators *> &localAssemblers,
+    const std::vector<ResultType> &termMultipliers,
+    const EvaluationOptions &options) {
+
+  if (localAssemblers.empty())
+    throw std::invalid_argument(
+        "HMatGlobalAssembler::assemblePotentialOperator(): "
+        "the 'localAssemblers' vector must not be empty");
+  if (points.n_rows != 3)
+    throw std::invalid_argument(
+        "HMatGlobalAssembler::assemblePotentialOperator(): "
+        "evaluation points must be three-dimensional");
+
+  const ParameterList &hMatParameterList = options.hMatParameters();
+  const bool verbosityAtLeastHigh =
+      (options.verbosityLevel() >= VerbosityLevel::HIGH);
+
+  auto minBlockSize =
+      hMatParameterList.template get<unsigned int>("minBlockSize");
+  auto maxBlockSize =
+      hMatParameterList.template get<unsigned int>("maxBlockSize");
+  auto eta = hMatParameterList.template get<double>("eta");
+  auto eps = hMatParameterList.template get<double>("eps");
+  auto recompress = hMatParameterList.template get<bool>("recompress");
+  auto coarsening = hMatParameterList.template get<bool>("coarsening");
+
+  const int componentCount = localAssemblers[0]->resultDimension();
+
+  hmat::Geometry pointGeometry;
+  PointsHMatGeometryInterface<CoordinateType> pointGeometryInterface(
+      points, componentCount);
+  hmat::fillGeometry(pointGeometry, pointGeometryInterface);
+  auto pointClusterTree = shared_ptr<hmat::DefaultClusterTreeType>(
+      new hmat::DefaultClusterTreeType(pointGeometry, minBlockSize));
+
+  hmat::Geometry trialGeometry;
+  SpaceHMatGeometryInterface<BasisFunctionType> trialGeometryInterface(
+      trialSpace);
+  hmat::fillGeometry(trialGeometry, trialGeometryInterface);
+  auto trialClusterTree = shared_ptr<hmat::DefaultClusterTreeType>(
+      new hmat::DefaultClusterTreeType(trialGeometry, minBlockSize));
+
+  shared_ptr<hmat::DefaultBlockClusterTreeType> blockClusterTree(
+      new hmat::DefaultBlockClusterTreeType(pointClusterTree, trialClusterTree,
+                                            maxBlockSize,
+                                            hmat::StandardAdmissibility(eta)));
+
+  PotentialOperatorHMatAssemblyHelper<BasisFunctionType, ResultType> helper(
+      trialSpace, blockClusterTree, localAssemblers, termMultipliers);
+
+  auto compressor = makeCompressor(hMatParameterList, helper);
+
+  auto scheduler = makeScheduler(options.parallelizationOptions());
+
+  shared_ptr<hmat::DefaultHMatrixType<ResultType>> hMatrix;
+  {
+    Fiber::SerialBlasRegion region; // if possible, ensure that BLAS is
+                                    // single-threaded
+    hMatrix.reset(new hmat::DefaultHMatrixType<ResultType>(blockClusterTree,
+                                                           *compressor));
+
+    if (recompress)
+      hMatrix->recompress(eps);
+    if (coarsening)
+      hMatrix->coarsen(eps);
+  }
+
+  if (verbosityAtLeastHigh)
+    std::cout << "HMat potential operator: " << points.n_cols
+              << " points, " << trialSpace.globalDofCount() << " DOFs, "
+              << hMatrix->memSizeKb() / 1024. << " MB." << std::endl;
+
+  return std::unique_ptr<DiscreteBoundaryOperator<ResultType>>(
+      new DiscreteHMatBoundaryOperator<ResultType>(hMatrix));
+}
+
+template <typename BasisFunctionType, typename ResultType>
+std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+HMatGlobalAssembler<BasisFunctionType, ResultType>::assemblePotentialOperator(
+    const arma::Mat<CoordinateType> &points,
+    const Space<BasisFunctionType> &trialSpace,
+    LocalAssemblerForPotentialOperators &localAssembler,
+    const EvaluationOptions &options) {
+  std::vector<LocalAssemblerForPotentialOperators *> localAssemblers(
+      1, &localAssembler);
+  std::vector<ResultType> termMultipliers(1, 1.0);
+
+  return assemblePotentialOperator(points, trialSpace, localAssemblers,
+                                   termMultipliers, options);
+}
+
 FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_AND_RESULT(HMatGlobalAssembler);
 
 } // namespace Bempp
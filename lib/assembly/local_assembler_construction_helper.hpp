@@ -35,25 +35,60 @@
 
 #include "../common/boost_make_shared_fwd.hpp"
 
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <tbb/mutex.h>
+#include <utility>
+
 namespace Bempp {
 
 /** \ingroup weak_form_assembly_internal
  *  \brief Utility functions used during weak-form assembly.
  */
 struct LocalAssemblerConstructionHelper {
+  /** \brief Collect the raw geometry of the grid of a space.
+   *
+   *  Operators defined on the same grid receive the same RawGridGeometry
+   *  object as long as one of them is alive, so that geometrical data
+   *  derived from it (see Fiber::GeometricalDataStore) can be shared. */
   template <typename CoordinateType, typename BasisFunctionType>
   static void collectGridData(
       const Space<BasisFunctionType> &space,
       shared_ptr<Fiber::RawGridGeometry<CoordinateType>> &rawGeometry,
       shared_ptr<GeometryFactory> &geometryFactory) {
     typedef Fiber::RawGridGeometry<CoordinateType> RawGridGeometry;
+    // Grids are immutable and spaces use their leaf views
+    typedef std::map<const Grid *, std::pair<boost::weak_ptr<const Grid>,
+                                             boost::weak_ptr<RawGridGeometry>>>
+    Registry;
+
+    static Registry registry;
+    static tbb::mutex mutex;
 
-    rawGeometry = boost::make_shared<RawGridGeometry>(space.gridDimension(),
-                                                      space.worldDimension());
-    const GridView &view = space.gridView();
-    view.getRawElementData(
-        rawGeometry->vertices(), rawGeometry->elementCornerIndices(),
-        rawGeometry->auxData(), rawGeometry->domainIndices());
+    const shared_ptr<const Grid> grid = space.grid();
+    tbb::mutex::scoped_lock lock(mutex);
+    typename Registry::iterator it = registry.find(grid.get());
+    if (it != registry.end() && !it->second.first.expired())
+      rawGeometry = it->second.second.lock();
+    else
+      rawGeometry.reset();
+    if (!rawGeometry) {
+      // Forget the geometries that are no longer used
+      for (it = registry.begin(); it != registry.end();)
+        if (it->second.second.expired())
+          registry.erase(it++);
+        else
+          ++it;
+      rawGeometry = boost::make_shared<RawGridGeometry>(
+          space.gridDimension(), space.worldDimension());
+      const GridView &view = space.gridView();
+      view.getRawElementData(
+          rawGeometry->vertices(), rawGeometry->elementCornerIndices(),
+          rawGeometry->auxData(), rawGeometry->domainIndices());
+      registry[grid.get()] = std::make_pair(boost::weak_ptr<const Grid>(grid),
+                                            boost::weak_ptr<RawGridGeometry>(
+                                                rawGeometry));
+    }
     geometryFactory = space.elementGeometryFactory();
   }
 
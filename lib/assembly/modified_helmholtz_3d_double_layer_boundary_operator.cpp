@@ -97,7 +97,9 @@ modifiedHelmholtz3dDoubleLayerBoundaryOperator(
                TransformationFunctor(), TransformationFunctor(), integral));
   else
     newOp.reset(new Op(domain, range, dualToRange, label, symmetry,
-                       NoninterpolatedKernelFunctor(waveNumber),
+                       NoninterpolatedKernelFunctor(
+                           waveNumber,
+                           assemblyOptions.isMixedPrecisionEnabled()),
                        TransformationFunctor(), TransformationFunctor(),
                        integral));
   return BoundaryOperator<BasisFunctionType, ResultType>(context, newOp);
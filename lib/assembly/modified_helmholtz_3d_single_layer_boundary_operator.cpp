@@ -100,7 +100,9 @@ modifiedHelmholtz3dSingleLayerBoundaryOperator(
                TransformationFunctor(), TransformationFunctor(), integral));
   else
     newOp.reset(new Op(domain, range, dualToRange, label, symmetry,
-                       NoninterpolatedKernelFunctor(waveNumber),
+                       NoninterpolatedKernelFunctor(
+                           waveNumber,
+                           assemblyOptions.isMixedPrecisionEnabled()),
                        TransformationFunctor(), TransformationFunctor(),
                        integral));
   return BoundaryOperator<BasisFunctionType, ResultType>(context, newOp);
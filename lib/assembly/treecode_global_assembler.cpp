@@ -0,0 +1,547 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "treecode_global_assembler.hpp"
+
+#include "assembly_options.hpp"
+#include "context.hpp"
+#include "discrete_treecode_boundary_operator.hpp"
+#include "local_assembler_construction_helper.hpp"
+
+#include "../common/armadillo_fwd.hpp"
+#include "../common/boost_make_shared_fwd.hpp"
+#include "../common/complex_aux.hpp"
+#include "../fiber/_2d_array.hpp"
+#include "../fiber/basis_data.hpp"
+#include "../fiber/collection_of_2d_arrays.hpp"
+#include "../fiber/collection_of_3d_arrays.hpp"
+#include "../fiber/collection_of_kernels.hpp"
+#include "../fiber/collection_of_shapeset_transformations.hpp"
+#include "../fiber/explicit_instantiation.hpp"
+#include "../fiber/geometrical_data.hpp"
+#include "../fiber/local_assembler_for_integral_operators.hpp"
+#include "../fiber/numerical_quadrature.hpp"
+#include "../fiber/chebyshev_treecode.hpp"
+#include "../fiber/raw_grid_geometry.hpp"
+#include "../fiber/serial_blas_region.hpp"
+#include "../fiber/shapeset.hpp"
+#include "../fiber/test_kernel_trial_integral.hpp"
+#include "../fiber/weak_form_kernel_trial_integral.hpp"
+#include "../grid/entity.hpp"
+#include "../grid/entity_iterator.hpp"
+#include "../grid/geometry.hpp"
+#include "../grid/geometry_factory.hpp"
+#include "../grid/grid_view.hpp"
+#include "../grid/mapper.hpp"
+#include "../space/space.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+#include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
+
+namespace Bempp {
+
+namespace {
+
+/** Build a list of lists of global DOF indices corresponding to the local DOFs
+ *  on each element of space.grid(). */
+template <typename BasisFunctionType>
+void
+gatherGlobalDofs(const Space<BasisFunctionType> &space,
+                 std::vector<std::vector<GlobalDofIndex>> &globalDofs,
+                 std::vector<std::vector<BasisFunctionType>> &localDofWeights) {
+  const GridView &view = space.gridView();
+  const int elementCount = view.entityCount(0);
+
+  globalDofs.clear();
+  globalDofs.resize(elementCount);
+  localDofWeights.clear();
+  localDofWeights.resize(elementCount);
+
+  const Mapper &mapper = view.elementMapper();
+  std::unique_ptr<EntityIterator<0>> it = view.entityIterator<0>();
+  while (!it->finished()) {
+    const Entity<0> &element = it->entity();
+    const int elementIndex = mapper.entityIndex(element);
+    space.getGlobalDofs(element, globalDofs[elementIndex],
+                        localDofWeights[elementIndex]);
+    it->next();
+  }
+}
+
+/** Quadrature points of all elements of a space and the values of the
+ *  transformed shape functions at these points. */
+template <typename BasisFunctionType, typename CoordinateType>
+struct QuadratureData {
+  Fiber::GeometricalData<CoordinateType> geomData;
+  // Raw quadrature weights (without integration elements)
+  std::vector<CoordinateType> weights;
+  // The points of element e have indices from pointOffsets[e] to
+  // pointOffsets[e + 1] - 1
+  std::vector<size_t> pointOffsets;
+  // Components of all transformations of the shape functions. The values on
+  // element e start at valueOffsets[e] and are ordered by point, function
+  // and component, the component changing fastest.
+  std::vector<BasisFunctionType> values;
+  std::vector<size_t> valueOffsets;
+  int componentCount;
+  std::vector<std::vector<GlobalDofIndex>> globalDofs;
+  std::vector<std::vector<BasisFunctionType>> localDofWeights;
+};
+
+template <typename BasisFunctionType, typename CoordinateType>
+void collectQuadratureData(
+    const Space<BasisFunctionType> &space,
+    const Fiber::CollectionOfShapesetTransformations<CoordinateType> &
+        transformations,
+    size_t geomDeps, int orderIncrement,
+    QuadratureData<BasisFunctionType, CoordinateType> &data) {
+  typedef Fiber::RawGridGeometry<CoordinateType> RawGridGeometry;
+  typedef std::vector<const Fiber::Shapeset<BasisFunctionType> *>
+  ShapesetPtrVector;
+  typedef GeometryFactory::Geometry Geometry;
+  typedef std::pair<arma::Mat<CoordinateType>, std::vector<CoordinateType>>
+  Rule;
+
+  shared_ptr<RawGridGeometry> rawGeometry;
+  shared_ptr<GeometryFactory> geometryFactory;
+  shared_ptr<ShapesetPtrVector> shapesets;
+  LocalAssemblerConstructionHelper::collectGridData(space, rawGeometry,
+                                                    geometryFactory);
+  LocalAssemblerConstructionHelper::collectShapesets(space, shapesets);
+  if (rawGeometry->worldDimension() != 3)
+    throw std::invalid_argument(
+        "TreecodeGlobalAssembler::assembleDetachedWeakForm(): "
+        "the treecode assembly mode is only available for grids embedded in "
+        "three-dimensional space");
+  gatherGlobalDofs(space, data.globalDofs, data.localDofWeights);
+
+  size_t basisDeps = 0;
+  size_t elementGeomDeps =
+      geomDeps | Fiber::GLOBALS | Fiber::INTEGRATION_ELEMENTS;
+  transformations.addDependencies(basisDeps, elementGeomDeps);
+  const int transformationCount = transformations.transformationCount();
+  data.componentCount = 0;
+  for (int transf = 0; transf < transformationCount; ++transf)
+    data.componentCount += transformations.resultDimension(transf);
+  const int componentCount = data.componentCount;
+
+  // Quadrature rules, one per element type and order
+  const int elementCount = rawGeometry->elementCount();
+  std::map<std::pair<int, int>, Rule> rules;
+  std::vector<const Rule *> elementRules(elementCount);
+  data.pointOffsets.resize(elementCount + 1);
+  data.valueOffsets.resize(elementCount + 1);
+  data.pointOffsets[0] = 0;
+  data.valueOffsets[0] = 0;
+  for (int e = 0; e < elementCount; ++e) {
+    const Fiber::Shapeset<BasisFunctionType> &shapeset = *(*shapesets)[e];
+    const std::pair<int, int> key(rawGeometry->elementCornerCount(e),
+                                  shapeset.order() + orderIncrement);
+    typename std::map<std::pair<int, int>, Rule>::iterator it =
+        rules.find(key);
+    if (it == rules.end()) {
+      it = rules.insert(std::make_pair(key, Rule())).first;
+      Fiber::fillSingleQuadraturePointsAndWeights(
+          key.first, key.second, it->second.first, it->second.second);
+    }
+    elementRules[e] = &it->second;
+    const size_t pointCount = it->second.second.size();
+    data.pointOffsets[e + 1] = data.pointOffsets[e] + pointCount;
+    data.valueOffsets[e + 1] =
+        data.valueOffsets[e] + componentCount * shapeset.size() * pointCount;
+  }
+
+  const size_t pointCount = data.pointOffsets.back();
+  data.geomData.globals.set_size(3, pointCount);
+  data.geomData.integrationElements.set_size(pointCount);
+  if (geomDeps & Fiber::NORMALS)
+    data.geomData.normals.set_size(3, pointCount);
+  data.geomData.domainIndex = 0;
+  data.weights.resize(pointCount);
+  data.values.resize(data.valueOffsets.back());
+
+  // Each element writes to its own ranges of the arrays
+  tbb::parallel_for(tbb::blocked_range<int>(0, elementCount),
+                    [&](const tbb::blocked_range<int> &r) {
+    std::unique_ptr<Geometry> geometry(geometryFactory->make());
+    Fiber::GeometricalData<CoordinateType> geomData;
+    Fiber::BasisData<BasisFunctionType> basisData;
+    Fiber::CollectionOf3dArrays<BasisFunctionType> transfValues;
+    for (int e = r.begin(); e != r.end(); ++e) {
+      const Rule &rule = *elementRules[e];
+      const Fiber::Shapeset<BasisFunctionType> &shapeset = *(*shapesets)[e];
+      rawGeometry->setupGeometry(e, *geometry);
+      geometry->getData(elementGeomDeps, rule.first, geomData);
+      shapeset.evaluate(basisDeps, rule.first, ALL_DOFS, basisData);
+      transformations.evaluate(basisData, geomData, transfValues);
+
+      const size_t offset = data.pointOffsets[e];
+      const size_t localPointCount = rule.second.size();
+      for (size_t point = 0; point < localPointCount; ++point) {
+        data.geomData.globals.col(offset + point) = geomData.globals.col(point);
+        data.geomData.integrationElements(offset + point) =
+            geomData.integrationElements(point);
+        if (geomDeps & Fiber::NORMALS)
+          data.geomData.normals.col(offset + point) =
+              geomData.normals.col(point);
+        data.weights[offset + point] = rule.second[point];
+      }
+
+      const size_t functionCount = shapeset.size();
+      size_t index = data.valueOffsets[e];
+      for (size_t point = 0; point < localPointCount; ++point)
+        for (size_t fun = 0; fun < functionCount; ++fun)
+          for (int transf = 0; transf < transformationCount; ++transf)
+            for (size_t dim = 0; dim < transfValues[transf].extent(0); ++dim)
+              data.values[index++] = transfValues[transf](dim, fun, point);
+    }
+  });
+}
+
+/** Far-field part of a weak form evaluated with the treecode. */
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class TreecodeFarField
+    : public DiscreteTreecodeBoundaryOperator<ResultType>::FarField {
+public:
+  typedef typename Fiber::ScalarTraits<ResultType>::RealType CoordinateType;
+  typedef QuadratureData<BasisFunctionType, CoordinateType> Data;
+  typedef Fiber::WeakFormKernelTrialIntegral<BasisFunctionType, KernelType,
+                                             ResultType> Integral;
+
+  TreecodeFarField(
+      const shared_ptr<const Data> &testData,
+      const shared_ptr<const Data> &trialData,
+      const std::vector<int> &trialDimensions,
+      const Fiber::CollectionOfKernels<KernelType> &kernels,
+      const Fiber::CollectionOfShapesetTransformations<CoordinateType> &
+          testTransformations,
+      const Fiber::TestKernelTrialIntegral<BasisFunctionType, KernelType,
+                                           ResultType> &integral,
+      const Fiber::TreecodeOptions &options)
+      : m_testData(testData), m_trialData(trialData),
+        m_trialDimensions(trialDimensions),
+        m_integral(integral, testTransformations),
+        m_treecode(testData->geomData.globals, testData->pointOffsets,
+                   trialData->geomData, trialData->pointOffsets,
+                   trialData->weights, kernels, m_integral, options) {}
+
+  void getNearFieldElements(
+      std::vector<std::vector<size_t>> &trialElements) const {
+    m_treecode.getNearFieldClusters(trialElements);
+  }
+
+  virtual void apply(const arma::Mat<ResultType> &x, arma::Mat<ResultType> &y,
+                     ResultType alpha) const {
+    const Data &test = *m_testData;
+    const Data &trial = *m_trialData;
+    const size_t trialElementCount = trial.globalDofs.size();
+    const size_t testElementCount = test.globalDofs.size();
+    const size_t trialPointCount = trial.weights.size();
+    const size_t testPointCount = test.weights.size();
+
+    Fiber::SerialBlasRegion region;
+    Fiber::CollectionOf2dArrays<ResultType> charges(m_trialDimensions.size());
+    for (size_t transf = 0; transf < m_trialDimensions.size(); ++transf)
+      charges[transf].set_size(m_trialDimensions[transf], trialPointCount);
+    arma::Mat<ResultType> potentials(test.componentCount, testPointCount);
+    std::vector<std::vector<ResultType>> elementSums(testElementCount);
+
+    for (size_t v = 0; v < x.n_cols; ++v) {
+      // Values of the argument at the trial quadrature points
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, trialElementCount),
+                        [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t e = r.begin(); e != r.end(); ++e) {
+          const std::vector<GlobalDofIndex> &dofs = trial.globalDofs[e];
+          const std::vector<BasisFunctionType> &dofWeights =
+              trial.localDofWeights[e];
+          const BasisFunctionType *values =
+              trial.values.data() + trial.valueOffsets[e];
+          for (size_t point = trial.pointOffsets[e];
+               point < trial.pointOffsets[e + 1]; ++point) {
+            for (size_t transf = 0, c = 0; transf < m_trialDimensions.size();
+                 ++transf)
+              for (int dim = 0; dim < m_trialDimensions[transf]; ++dim, ++c) {
+                ResultType sum = 0.;
+                for (size_t fun = 0; fun < dofs.size(); ++fun)
+                  if (dofs[fun] >= 0)
+                    sum += values[fun * trial.componentCount + c] *
+                           dofWeights[fun] * x(dofs[fun], v);
+                charges[transf](dim, point) = sum;
+              }
+            values += dofs.size() * trial.componentCount;
+          }
+        }
+      });
+
+      potentials.fill(0.);
+      m_treecode.evaluateFarField(charges, potentials);
+
+      // Projection on the test functions. Elements share DOFs, so the
+      // integrals over each element are computed in parallel and added to
+      // y serially afterwards.
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, testElementCount),
+                        [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t e = r.begin(); e != r.end(); ++e) {
+          const size_t functionCount = test.globalDofs[e].size();
+          std::vector<ResultType> &sums = elementSums[e];
+          sums.assign(functionCount, 0.);
+          const BasisFunctionType *values =
+              test.values.data() + test.valueOffsets[e];
+          for (size_t point = test.pointOffsets[e];
+               point < test.pointOffsets[e + 1]; ++point) {
+            const CoordinateType weight =
+                test.weights[point] * test.geomData.integrationElements(point);
+            for (size_t fun = 0; fun < functionCount; ++fun) {
+              ResultType pointSum = 0.;
+              for (int c = 0; c < test.componentCount; ++c)
+                pointSum += conj(values[c]) * potentials(c, point);
+              sums[fun] += pointSum * weight;
+              values += test.componentCount;
+            }
+          }
+        }
+      });
+      for (size_t e = 0; e < testElementCount; ++e) {
+        const std::vector<GlobalDofIndex> &dofs = test.globalDofs[e];
+        const std::vector<BasisFunctionType> &dofWeights =
+            test.localDofWeights[e];
+        for (size_t fun = 0; fun < dofs.size(); ++fun)
+          if (dofs[fun] >= 0)
+            y(dofs[fun], v) +=
+                alpha * conj(dofWeights[fun]) * elementSums[e][fun];
+      }
+    }
+  }
+
+private:
+  shared_ptr<const Data> m_testData;
+  shared_ptr<const Data> m_trialData;
+  std::vector<int> m_trialDimensions;
+  Integral m_integral;
+  Fiber::ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>
+      m_treecode;
+};
+
+template <typename ValueType> struct SparseEntry {
+  GlobalDofIndex row;
+  GlobalDofIndex column;
+  ValueType value;
+};
+
+template <typename ValueType>
+bool hasSmallerColumn(const std::pair<unsigned int, ValueType> &a,
+                      const std::pair<unsigned int, ValueType> &b) {
+  return a.first < b.first;
+}
+
+} // namespace
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+TreecodeGlobalAssembler<BasisFunctionType, KernelType, ResultType>::
+    assembleDetachedWeakForm(
+        const Space<BasisFunctionType> &testSpace,
+        const Space<BasisFunctionType> &trialSpace,
+        const CollectionOfKernels &kernels,
+        const CollectionOfShapesetTransformations &testTransformations,
+        const CollectionOfShapesetTransformations &trialTransformations,
+        const TestKernelTrialIntegral &integral,
+        LocalAssemblerForIntegralOperators &assembler,
+        const Context<BasisFunctionType, ResultType> &context) {
+  typedef QuadratureData<BasisFunctionType, CoordinateType> Data;
+  typedef TreecodeFarField<BasisFunctionType, KernelType, ResultType> FarField;
+
+  const AssemblyOptions &options = context.assemblyOptions();
+  const TreecodeOptions &treecodeOptions = options.treecodeOptions();
+
+  // The treecode evaluates the kernels at test points described by their
+  // global coordinates only
+  size_t kernelTestGeomDeps = 0, trialGeomDeps = 0;
+  kernels.addGeometricalDependencies(kernelTestGeomDeps, trialGeomDeps);
+  if (kernelTestGeomDeps & ~size_t(Fiber::GLOBALS))
+    throw std::invalid_argument(
+        "TreecodeGlobalAssembler::assembleDetachedWeakForm(): "
+        "the treecode assembly mode is not available for operators whose "
+        "kernels depend on other test data than global coordinates");
+  const typename FarField::Integral weakFormIntegral(integral,
+                                                     testTransformations);
+  weakFormIntegral.addGeometricalDependencies(trialGeomDeps);
+  if (trialGeomDeps & ~size_t(Fiber::GLOBALS | Fiber::INTEGRATION_ELEMENTS |
+                              Fiber::NORMALS))
+    throw std::invalid_argument(
+        "TreecodeGlobalAssembler::assembleDetachedWeakForm(): "
+        "the treecode assembly mode is not available for operators whose "
+        "integrands depend on other trial data than global coordinates, "
+        "normals and integration elements");
+  std::vector<int> trialDimensions(trialTransformations.transformationCount());
+  for (size_t transf = 0; transf < trialDimensions.size(); ++transf)
+    trialDimensions[transf] = trialTransformations.resultDimension(transf);
+
+  const ParallelizationOptions &parallelOptions =
+      options.parallelizationOptions();
+  int maxThreadCount = 1;
+  if (!parallelOptions.isOpenClEnabled()) {
+    if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = parallelOptions.maxThreadCount();
+  }
+  tbb::task_scheduler_init scheduler(maxThreadCount);
+
+  shared_ptr<Data> testData = boost::make_shared<Data>();
+  shared_ptr<Data> trialData = boost::make_shared<Data>();
+  collectQuadratureData(testSpace, testTransformations, 0,
+                        treecodeOptions.quadratureOrderIncrement, *testData);
+  collectQuadratureData(trialSpace, trialTransformations, trialGeomDeps,
+                        treecodeOptions.quadratureOrderIncrement, *trialData);
+  shared_ptr<FarField> farField = boost::make_shared<FarField>(
+      testData, trialData, trialDimensions, kernels, testTransformations,
+      integral, treecodeOptions);
+
+  // Exact local weak forms of the pairs of elements not treated by the treecode
+  std::vector<std::vector<size_t>> nearElements;
+  farField->getNearFieldElements(nearElements);
+  const size_t testElementCount = testData->globalDofs.size();
+  std::vector<std::vector<SparseEntry<ResultType>>> elementEntries(
+      testElementCount);
+  {
+    Fiber::SerialBlasRegion region;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, testElementCount),
+                      [&](const tbb::blocked_range<size_t> &r) {
+      std::vector<int> testIndices(1), trialIndices;
+      Fiber::_2dArray<arma::Mat<ResultType>> localResult;
+      for (size_t testIndex = r.begin(); testIndex != r.end(); ++testIndex) {
+        const std::vector<size_t> &near = nearElements[testIndex];
+        if (near.empty())
+          continue;
+        testIndices[0] = testIndex;
+        trialIndices.assign(near.begin(), near.end());
+        assembler.evaluateLocalWeakForms(testIndices, trialIndices,
+                                         localResult);
+
+        const std::vector<GlobalDofIndex> &testDofs =
+            testData->globalDofs[testIndex];
+        const std::vector<BasisFunctionType> &testDofWeights =
+            testData->localDofWeights[testIndex];
+        std::vector<SparseEntry<ResultType>> &entries =
+            elementEntries[testIndex];
+        for (size_t i = 0; i < near.size(); ++i) {
+          const std::vector<GlobalDofIndex> &trialDofs =
+              trialData->globalDofs[near[i]];
+          const std::vector<BasisFunctionType> &trialDofWeights =
+              trialData->localDofWeights[near[i]];
+          const arma::Mat<ResultType> &local = localResult(0, i);
+          for (size_t trialDof = 0; trialDof < trialDofs.size(); ++trialDof) {
+            if (trialDofs[trialDof] < 0)
+              continue;
+            for (size_t testDof = 0; testDof < testDofs.size(); ++testDof) {
+              if (testDofs[testDof] < 0)
+                continue;
+              SparseEntry<ResultType> entry;
+              entry.row = testDofs[testDof];
+              entry.column = trialDofs[trialDof];
+              entry.value = conj(testDofWeights[testDof]) *
+                            trialDofWeights[trialDof] *
+                            local(testDof, trialDof);
+              entries.push_back(entry);
+            }
+          }
+        }
+      }
+    });
+  }
+
+  // Conversion to the compressed sparse row format
+  const size_t rowCount = testSpace.globalDofCount();
+  std::vector<size_t> rowOffsets(rowCount + 1, 0);
+  for (size_t e = 0; e < testElementCount; ++e)
+    for (size_t i = 0; i < elementEntries[e].size(); ++i)
+      ++rowOffsets[elementEntries[e][i].row + 1];
+  for (size_t row = 0; row < rowCount; ++row)
+    rowOffsets[row + 1] += rowOffsets[row];
+
+  typedef std::pair<unsigned int, ResultType> RowEntry;
+  std::vector<RowEntry> rowEntries(rowOffsets.back());
+  {
+    std::vector<size_t> next(rowOffsets.begin(), rowOffsets.end() - 1);
+    for (size_t e = 0; e < testElementCount; ++e) {
+      for (size_t i = 0; i < elementEntries[e].size(); ++i) {
+        const SparseEntry<ResultType> &entry = elementEntries[e][i];
+        rowEntries[next[entry.row]++] = RowEntry(entry.column, entry.value);
+      }
+      std::vector<SparseEntry<ResultType>>().swap(elementEntries[e]);
+    }
+  }
+
+  // Sort the entries of each row and merge duplicates
+  std::vector<size_t> rowNonzeroCounts(rowCount);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, rowCount),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t row = r.begin(); row != r.end(); ++row) {
+      const typename std::vector<RowEntry>::iterator begin =
+          rowEntries.begin() + rowOffsets[row];
+      const typename std::vector<RowEntry>::iterator end =
+          rowEntries.begin() + rowOffsets[row + 1];
+      std::sort(begin, end, hasSmallerColumn<ResultType>);
+      size_t count = 0;
+      for (typename std::vector<RowEntry>::iterator it = begin; it != end;
+           ++it)
+        if (count > 0 && (begin + count - 1)->first == it->first)
+          (begin + count - 1)->second += it->second;
+        else
+          *(begin + count++) = *it;
+      rowNonzeroCounts[row] = count;
+    }
+  });
+
+  std::vector<size_t> nearRowOffsets(rowCount + 1, 0);
+  for (size_t row = 0; row < rowCount; ++row)
+    nearRowOffsets[row + 1] = nearRowOffsets[row] + rowNonzeroCounts[row];
+  std::vector<unsigned int> columnIndices(nearRowOffsets.back());
+  std::vector<ResultType> values(nearRowOffsets.back());
+  for (size_t row = 0; row < rowCount; ++row)
+    for (size_t i = 0; i < rowNonzeroCounts[row]; ++i) {
+      const RowEntry &entry = rowEntries[rowOffsets[row] + i];
+      columnIndices[nearRowOffsets[row] + i] = entry.first;
+      values[nearRowOffsets[row] + i] = entry.second;
+    }
+
+  if (options.verbosityLevel() >= VerbosityLevel::HIGH)
+    std::cout << "Treecode assembly: " << values.size()
+              << " near-field entries, " << testData->weights.size()
+              << " test and " << trialData->weights.size()
+              << " trial quadrature points" << std::endl;
+
+  return std::unique_ptr<DiscreteBoundaryOperator<ResultType>>(
+      new DiscreteTreecodeBoundaryOperator<ResultType>(
+          rowCount, trialSpace.globalDofCount(), nearRowOffsets,
+          columnIndices, values, farField, parallelOptions));
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS_KERNEL_AND_RESULT(
+    TreecodeGlobalAssembler);
+
+} // namespace Bempp
@@ -0,0 +1,90 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef bempp_treecode_global_assembler_hpp
+#define bempp_treecode_global_assembler_hpp
+
+#include "../common/common.hpp"
+
+#include "../fiber/scalar_traits.hpp"
+
+#include <memory>
+
+namespace Fiber {
+
+/** \cond FORWARD_DECL */
+template <typename ResultType> class LocalAssemblerForIntegralOperators;
+template <typename CoordinateType> class CollectionOfShapesetTransformations;
+template <typename KernelType> class CollectionOfKernels;
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class TestKernelTrialIntegral;
+/** \endcond */
+
+} // namespace Fiber
+
+namespace Bempp {
+
+/** \cond FORWARD_DECL */
+template <typename ValueType> class DiscreteBoundaryOperator;
+template <typename BasisFunctionType> class Space;
+template <typename BasisFunctionType, typename ResultType> class Context;
+/** \endcond */
+
+/** \ingroup weak_form_assembly_internal
+ *  \brief Treecode-mode assembler.
+ *
+ *  Produces a DiscreteTreecodeBoundaryOperator. The quadrature points of the
+ *  test and trial elements are sorted into an octree (see
+ *  Fiber::ChebyshevTreecode), with the points of each element forming a
+ *  cluster. The local weak forms of
+ *  pairs of elements lying in neighbouring leaves are calculated by the
+ *  local assembler and stored in a sparse matrix. The remaining
+ *  interactions are evaluated by the treecode with a regular quadrature rule
+ *  whenever the operator is applied.
+ *
+ *  The returned operator refers to \p kernels, \p testTransformations and
+ *  \p integral, which must therefore outlive it. */
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class TreecodeGlobalAssembler {
+public:
+  typedef typename Fiber::ScalarTraits<ResultType>::RealType CoordinateType;
+  typedef Fiber::LocalAssemblerForIntegralOperators<ResultType>
+  LocalAssemblerForIntegralOperators;
+  typedef Fiber::CollectionOfKernels<KernelType> CollectionOfKernels;
+  typedef Fiber::CollectionOfShapesetTransformations<CoordinateType>
+  CollectionOfShapesetTransformations;
+  typedef Fiber::TestKernelTrialIntegral<BasisFunctionType, KernelType,
+                                         ResultType> TestKernelTrialIntegral;
+
+  static std::unique_ptr<DiscreteBoundaryOperator<ResultType>>
+  assembleDetachedWeakForm(
+      const Space<BasisFunctionType> &testSpace,
+      const Space<BasisFunctionType> &trialSpace,
+      const CollectionOfKernels &kernels,
+      const CollectionOfShapesetTransformations &testTransformations,
+      const CollectionOfShapesetTransformations &trialTransformations,
+      const TestKernelTrialIntegral &integral,
+      LocalAssemblerForIntegralOperators &assembler,
+      const Context<BasisFunctionType, ResultType> &context);
+};
+
+} // namespace Bempp
+
+#endif
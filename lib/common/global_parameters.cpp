@@ -95,7 +95,7 @@ ParameterList GlobalParameters::parameterList() {
 
   quadratureOrders.sublist("far").remove("maxRelDist");
 
-  ParameterList& hmatParameters = parameters.sublist("HMat");
+  ParameterList& hmatParameters = parameters.sublist("HMatParameters");
 
   hmatParameters.set("HMatAssemblyMode", std::string("GlobalAssembly"),
                      "(string) Specifies assembly mode. Allowed values are "
@@ -113,6 +113,35 @@ ParameterList GlobalParameters::parameterList() {
   hmatParameters.set("eta", static_cast<double>(1.2),
                      "(double) Specifies the block separation parameter eta");
 
+  hmatParameters.set(
+      "compressionAlgorithm", std::string("aca"),
+      "(string) Specifies how admissible blocks are compressed. Allowed "
+      "values are aca (partially pivoted ACA), aca+ (ACA with reference "
+      "row and column) and dense.");
+
+  hmatParameters.set("eps", static_cast<double>(1E-3),
+                     "(double) Specifies the relative accuracy of the low-rank "
+                     "approximation of admissible blocks.");
+
+  hmatParameters.set(
+      "maxRank", static_cast<unsigned int>(30),
+      "(unsigned int) Specifies the maximum rank of an admissible block.");
+
+  hmatParameters.set(
+      "resizeThreshold", static_cast<unsigned int>(10),
+      "(unsigned int) Specifies by how many columns the low-rank factors "
+      "are enlarged when they run out of space during compression.");
+
+  hmatParameters.set(
+      "recompress", false,
+      "(bool) If true then the ranks of the low-rank blocks are truncated "
+      "to the accuracy eps by QR and SVD decompositions after compression.");
+
+  hmatParameters.set(
+      "coarsening", false,
+      "(bool) If true then sibling low-rank blocks are merged into a single "
+      "low-rank block whenever this reduces the storage.");
+
   Teuchos::writeParameterListToXmlFile(parameters,"parameters.xml");
  
   return parameters;
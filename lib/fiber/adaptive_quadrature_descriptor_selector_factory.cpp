@@ -0,0 +1,64 @@
+// Copyright (C) 2011-2012 by the Bem++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "adaptive_quadrature_descriptor_selector_factory.hpp"
+
+#include "adaptive_quadrature_descriptor_selector_for_integral_operators.hpp"
+#include "explicit_instantiation.hpp"
+
+#include "../common/boost_make_shared_fwd.hpp"
+
+namespace Fiber {
+
+template <typename BasisFunctionType>
+AdaptiveQuadratureDescriptorSelectorFactory<BasisFunctionType>::
+    AdaptiveQuadratureDescriptorSelectorFactory(
+        CoordinateType relativeTolerance,
+        std::complex<CoordinateType> waveNumber, int maxOrder,
+        const AccuracyOptionsEx &accuracyOptions)
+    : Base(accuracyOptions), m_accuracyOptions(accuracyOptions),
+      m_relativeTolerance(relativeTolerance), m_waveNumber(waveNumber),
+      m_maxOrder(maxOrder) {}
+
+template <typename BasisFunctionType>
+shared_ptr<QuadratureDescriptorSelectorForIntegralOperators<
+    typename AdaptiveQuadratureDescriptorSelectorFactory<
+        BasisFunctionType>::CoordinateType>>
+AdaptiveQuadratureDescriptorSelectorFactory<BasisFunctionType>::
+    makeQuadratureDescriptorSelectorForIntegralOperators(
+        const shared_ptr<const RawGridGeometry<CoordinateType>> &
+            testRawGeometry,
+        const shared_ptr<const RawGridGeometry<CoordinateType>> &
+            trialRawGeometry,
+        const shared_ptr<const std::vector<
+            const Shapeset<BasisFunctionType> *>> &testShapesets,
+        const shared_ptr<const std::vector<
+            const Shapeset<BasisFunctionType> *>> &trialShapesets) const {
+  typedef AdaptiveQuadratureDescriptorSelectorForIntegralOperators<
+      BasisFunctionType> Selector;
+  return boost::make_shared<Selector>(
+      testRawGeometry, trialRawGeometry, testShapesets, trialShapesets,
+      m_accuracyOptions, m_relativeTolerance, m_waveNumber, m_maxOrder);
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS(
+    AdaptiveQuadratureDescriptorSelectorFactory);
+
+} // namespace Fiber
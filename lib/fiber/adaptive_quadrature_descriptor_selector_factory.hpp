@@ -0,0 +1,85 @@
+// Copyright (C) 2011-2012 by the Bem++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_adaptive_quadrature_descriptor_selector_factory_hpp
+#define fiber_adaptive_quadrature_descriptor_selector_factory_hpp
+
+#include "default_quadrature_descriptor_selector_factory.hpp"
+
+#include <complex>
+
+namespace Fiber {
+
+/** \ingroup quadrature
+ *  \brief Builder of quadrature descriptor selectors choosing the orders of
+ *  regular rules for boundary integral operators adaptively.
+ *
+ *  The selectors used during the discretization of boundary integral
+ *  operators are instances of
+ *  AdaptiveQuadratureDescriptorSelectorForIntegralOperators; all other
+ *  selectors are those built by DefaultQuadratureDescriptorSelectorFactory.
+ *  Pass an instance of this class to the constructor of
+ *  NumericalQuadratureStrategy to use it. */
+template <typename BasisFunctionType>
+class AdaptiveQuadratureDescriptorSelectorFactory
+    : public DefaultQuadratureDescriptorSelectorFactory<BasisFunctionType> {
+  typedef DefaultQuadratureDescriptorSelectorFactory<BasisFunctionType> Base;
+
+public:
+  typedef typename Base::CoordinateType CoordinateType;
+
+  /** \brief Constructor.
+   *
+   *  \param[in] relativeTolerance
+   *    Target relative error of regular quadrature rules.
+   *  \param[in] waveNumber
+   *    Wave number \f$\kappa\f$ of the kernel, assumed to behave like
+   *    \f$\exp(-\kappa |x - y|) / |x - y|\f$ (see
+   *    AdaptiveQuadratureDescriptorSelectorForIntegralOperators).
+   *  \param[in] maxOrder
+   *    Upper bound on the orders of regular quadrature rules.
+   *  \param[in] accuracyOptions
+   *    Options used by all other quadrature descriptor selectors and for
+   *    singular integrals. */
+  explicit AdaptiveQuadratureDescriptorSelectorFactory(
+      CoordinateType relativeTolerance,
+      std::complex<CoordinateType> waveNumber = 0., int maxOrder = 20,
+      const AccuracyOptionsEx &accuracyOptions = AccuracyOptionsEx());
+
+  virtual shared_ptr<
+      QuadratureDescriptorSelectorForIntegralOperators<CoordinateType>>
+  makeQuadratureDescriptorSelectorForIntegralOperators(
+      const shared_ptr<const RawGridGeometry<CoordinateType>> &testRawGeometry,
+      const shared_ptr<const RawGridGeometry<CoordinateType>> &trialRawGeometry,
+      const shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>> &
+          testShapesets,
+      const shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>> &
+          trialShapesets) const;
+
+private:
+  AccuracyOptionsEx m_accuracyOptions;
+  CoordinateType m_relativeTolerance;
+  std::complex<CoordinateType> m_waveNumber;
+  int m_maxOrder;
+};
+
+} // namespace Fiber
+
+#endif
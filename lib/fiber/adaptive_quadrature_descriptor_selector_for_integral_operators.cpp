@@ -0,0 +1,179 @@
+// Copyright (C) 2011-2012 by the Bem++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "adaptive_quadrature_descriptor_selector_for_integral_operators.hpp"
+
+#include "default_local_assembler_for_operators_on_surfaces_utilities.hpp"
+#include "default_quadrature_descriptor_selector_for_integral_operators.hpp"
+#include "explicit_instantiation.hpp"
+#include "raw_grid_geometry.hpp"
+#include "shapeset.hpp"
+
+#include "../common/boost_make_shared_fwd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Fiber {
+
+template <typename BasisFunctionType>
+AdaptiveQuadratureDescriptorSelectorForIntegralOperators<BasisFunctionType>::
+    AdaptiveQuadratureDescriptorSelectorForIntegralOperators(
+        const shared_ptr<const RawGridGeometry<CoordinateType>> &
+            testRawGeometry,
+        const shared_ptr<const RawGridGeometry<CoordinateType>> &
+            trialRawGeometry,
+        const shared_ptr<const std::vector<
+            const Shapeset<BasisFunctionType> *>> &testShapesets,
+        const shared_ptr<const std::vector<
+            const Shapeset<BasisFunctionType> *>> &trialShapesets,
+        const AccuracyOptionsEx &accuracyOptions,
+        CoordinateType relativeTolerance,
+        std::complex<CoordinateType> waveNumber, int maxOrder)
+    : m_testShapesets(testShapesets), m_trialShapesets(trialShapesets),
+      m_relativeTolerance(relativeTolerance), m_waveNumber(waveNumber),
+      m_maxOrder(maxOrder) {
+  if (!(relativeTolerance > 0.))
+    throw std::invalid_argument(
+        "AdaptiveQuadratureDescriptorSelectorForIntegralOperators::"
+        "AdaptiveQuadratureDescriptorSelectorForIntegralOperators(): "
+        "relativeTolerance must be positive");
+  if (maxOrder < 0)
+    throw std::invalid_argument(
+        "AdaptiveQuadratureDescriptorSelectorForIntegralOperators::"
+        "AdaptiveQuadratureDescriptorSelectorForIntegralOperators(): "
+        "maxOrder must not be negative");
+
+  typedef DefaultQuadratureDescriptorSelectorForIntegralOperators<
+      BasisFunctionType> DefaultSelector;
+  m_defaultSelector = boost::make_shared<DefaultSelector>(
+      testRawGeometry, trialRawGeometry, testShapesets, trialShapesets,
+      accuracyOptions);
+
+  std::vector<CoordinateType> elementSizesSquared;
+  CoordinateType averageTestElementSize;
+  Utilities::precalculateElementSizesAndCentersForSingleGrid(
+      *testRawGeometry, elementSizesSquared, m_testElementCenters,
+      averageTestElementSize);
+  m_testElementSizes.resize(elementSizesSquared.size());
+  for (size_t e = 0; e < elementSizesSquared.size(); ++e)
+    m_testElementSizes[e] = std::sqrt(elementSizesSquared[e]);
+  if (testRawGeometry.get() == trialRawGeometry.get()) {
+    m_trialElementSizes = m_testElementSizes;
+    m_trialElementCenters = m_testElementCenters;
+    m_averageElementSize = averageTestElementSize;
+  } else {
+    CoordinateType averageTrialElementSize;
+    Utilities::precalculateElementSizesAndCentersForSingleGrid(
+        *trialRawGeometry, elementSizesSquared, m_trialElementCenters,
+        averageTrialElementSize);
+    m_trialElementSizes.resize(elementSizesSquared.size());
+    for (size_t e = 0; e < elementSizesSquared.size(); ++e)
+      m_trialElementSizes[e] = std::sqrt(elementSizesSquared[e]);
+    m_averageElementSize =
+        (averageTestElementSize + averageTrialElementSize) / 2.;
+  }
+}
+
+template <typename BasisFunctionType>
+DoubleQuadratureDescriptor
+AdaptiveQuadratureDescriptorSelectorForIntegralOperators<
+    BasisFunctionType>::quadratureDescriptor(int testElementIndex,
+                                             int trialElementIndex,
+                                             CoordinateType nominalDistance)
+    const {
+  DoubleQuadratureDescriptor desc = m_defaultSelector->quadratureDescriptor(
+      testElementIndex, trialElementIndex, nominalDistance);
+  if (desc.topology.type != ElementPairTopology::Disjoint)
+    return desc;
+
+  const CoordinateType elementSize =
+      std::max(m_testElementSizes[testElementIndex],
+               m_trialElementSizes[trialElementIndex]);
+  CoordinateType distance;
+  if (nominalDistance < 0.) {
+    const int dimWorld = m_testElementCenters.n_rows;
+    CoordinateType distanceSquared = 0.;
+    for (int d = 0; d < dimWorld; ++d) {
+      CoordinateType diff = m_trialElementCenters(d, trialElementIndex) -
+                            m_testElementCenters(d, testElementIndex);
+      distanceSquared += diff * diff;
+    }
+    distance = std::sqrt(distanceSquared);
+  } else
+    distance = nominalDistance / m_averageElementSize * elementSize;
+
+  const int testBasisOrder = (*m_testShapesets)[testElementIndex]->order();
+  const int trialBasisOrder = (*m_trialShapesets)[trialElementIndex]->order();
+  const int maxDegree =
+      std::max(0, m_maxOrder - std::max(testBasisOrder, trialBasisOrder));
+  const int degree =
+      kernelApproximationDegree(elementSize, distance, maxDegree);
+  desc.testOrder = testBasisOrder + degree;
+  desc.trialOrder = trialBasisOrder + degree;
+  return desc;
+}
+
+template <typename BasisFunctionType>
+int AdaptiveQuadratureDescriptorSelectorForIntegralOperators<
+    BasisFunctionType>::kernelApproximationDegree(CoordinateType elementSize,
+                                                  CoordinateType distance,
+                                                  int maxDegree) const {
+  // Gap between the elements in units of half the element size. Disjoint
+  // elements may touch at their boundaries, in which case the estimate of a
+  // small gap is used.
+  const CoordinateType gap =
+      std::max(CoordinateType(2.) * (distance - elementSize) / elementSize,
+               CoordinateType(0.1));
+  const CoordinateType maxEllipseParameter =
+      1. + gap + std::sqrt(gap * (2. + gap));
+  const CoordinateType oscillation =
+      std::abs(std::imag(m_waveNumber)) * elementSize / 4.;
+  const CoordinateType decay =
+      std::max(std::real(m_waveNumber), CoordinateType(0.)) *
+      std::max(distance - elementSize, CoordinateType(0.));
+  const CoordinateType logTolerance = std::log(m_relativeTolerance) + decay;
+  if (logTolerance >= 0.)
+    return 0;
+
+  for (int degree = 0; degree < maxDegree; ++degree) {
+    const CoordinateType n = degree + 1;
+    // Minimise oscillation * (r - 1/r) - n * log(r) over the admissible r
+    CoordinateType r = maxEllipseParameter;
+    if (oscillation > 0.) {
+      const CoordinateType discriminant =
+          n * n - 4. * oscillation * oscillation;
+      if (discriminant <= 0.)
+        continue; // the bound is not smaller than 1 for any ellipse
+      r = std::min(r, (n + std::sqrt(discriminant)) / (2. * oscillation));
+    }
+    const CoordinateType logError =
+        oscillation * (r - 1. / r) - n * std::log(r);
+    if (logError <= logTolerance)
+      return degree;
+  }
+  return maxDegree;
+}
+
+FIBER_INSTANTIATE_CLASS_TEMPLATED_ON_BASIS(
+    AdaptiveQuadratureDescriptorSelectorForIntegralOperators);
+
+} // namespace Fiber
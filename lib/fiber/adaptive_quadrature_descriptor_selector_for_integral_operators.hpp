@@ -0,0 +1,131 @@
+// Copyright (C) 2011-2012 by the Bem++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_adaptive_quadrature_descriptor_selector_for_integral_operators_hpp
+#define fiber_adaptive_quadrature_descriptor_selector_for_integral_operators_hpp
+
+#include "quadrature_descriptor_selector_for_integral_operators.hpp"
+
+#include "../common/armadillo_fwd.hpp"
+#include "../common/shared_ptr.hpp"
+#include "accuracy_options.hpp"
+#include "scalar_traits.hpp"
+
+#include <complex>
+#include <vector>
+
+namespace Fiber {
+
+template <typename BasisFunctionType> class Shapeset;
+template <typename CoordinateType> class RawGridGeometry;
+template <typename BasisFunctionType>
+class DefaultLocalAssemblerForOperatorsOnSurfacesUtilities;
+
+/** \ingroup quadrature
+ *  \brief Quadrature descriptor selector choosing the orders of regular
+ *  quadrature rules from a priori error estimates.
+ *
+ *  The kernel is assumed to behave like
+ *  \f$\exp(-\kappa |x - y|) / |x - y|\f$ with a complex wave number
+ *  \f$\kappa\f$; use \f$\kappa = 0\f$ for the Laplace equation and
+ *  \f$\kappa = -\mathrm{i} k\f$ for the Helmholtz equation with wave number
+ *  \f$k\f$. For a pair of disjoint elements of size \f$h\f$ whose centres
+ *  lie a distance \f$d\f$ apart, the kernel is analytic in the Bernstein
+ *  ellipse of parameter \f$\rho\f$ determined by the distance \f$d - h\f$
+ *  between the elements, where it grows at most like
+ *  \f$\exp(|\mathrm{Im}\,\kappa| h (r - 1/r) / 4)\f$ for ellipses of
+ *  parameter \f$r \le \rho\f$. The error of a rule integrating polynomials
+ *  of degree \f$p\f$ exactly is therefore bounded by a multiple of
+ *  \f[ \min_{1 < r \le \rho} \exp(|\mathrm{Im}\,\kappa| h (r - 1/r) / 4)\,
+ *      r^{-(p + 1)}. \f]
+ *  The smallest \f$p\f$ for which this bound does not exceed the target
+ *  tolerance is added to the polynomial orders of the test and trial
+ *  shape functions. The tolerance is relative to the entries for
+ *  neighbouring elements, so it is loosened by the factor
+ *  \f$\exp(\mathrm{Re}\,\kappa\, (d - h))\f$ by which the kernel decays
+ *  between them (the estimate used by
+ *  CollectionOfKernels::estimateRelativeScale()).
+ *
+ *  Singular integrals are handled as in
+ *  DefaultQuadratureDescriptorSelectorForIntegralOperators. */
+template <typename BasisFunctionType>
+class AdaptiveQuadratureDescriptorSelectorForIntegralOperators
+    : public QuadratureDescriptorSelectorForIntegralOperators<
+          typename ScalarTraits<BasisFunctionType>::RealType> {
+public:
+  typedef typename ScalarTraits<BasisFunctionType>::RealType CoordinateType;
+
+  /** \brief Constructor.
+   *
+   *  \param[in] relativeTolerance Target relative quadrature error.
+   *  \param[in] waveNumber Wave number \f$\kappa\f$ of the kernel.
+   *  \param[in] maxOrder Upper bound on the orders of regular rules.
+   *
+   *  The remaining parameters are as in
+   *  DefaultQuadratureDescriptorSelectorForIntegralOperators, whose
+   *  \p accuracyOptions control only the singular rules here. */
+  AdaptiveQuadratureDescriptorSelectorForIntegralOperators(
+      const shared_ptr<const RawGridGeometry<CoordinateType>> &testRawGeometry,
+      const shared_ptr<const RawGridGeometry<CoordinateType>> &trialRawGeometry,
+      const shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>> &
+          testShapesets,
+      const shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>> &
+          trialShapesets,
+      const AccuracyOptionsEx &accuracyOptions,
+      CoordinateType relativeTolerance,
+      std::complex<CoordinateType> waveNumber, int maxOrder);
+
+  virtual DoubleQuadratureDescriptor
+  quadratureDescriptor(int testElementIndex, int trialElementIndex,
+                       CoordinateType nominalDistance) const;
+
+  /** \brief Return the smallest degree \em p for which the error estimate of
+   *  a pair of elements of size \p elementSize whose centres lie a distance
+   *  \p distance apart does not exceed the tolerance, or \p maxDegree if
+   *  there is no such \em p not larger than \p maxDegree. */
+  int kernelApproximationDegree(CoordinateType elementSize,
+                                CoordinateType distance, int maxDegree) const;
+
+private:
+  /** \cond PRIVATE */
+  typedef DefaultLocalAssemblerForOperatorsOnSurfacesUtilities<
+      BasisFunctionType> Utilities;
+
+  shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>>
+  m_testShapesets;
+  shared_ptr<const std::vector<const Shapeset<BasisFunctionType> *>>
+  m_trialShapesets;
+  shared_ptr<const QuadratureDescriptorSelectorForIntegralOperators<
+      CoordinateType>> m_defaultSelector;
+  CoordinateType m_relativeTolerance;
+  std::complex<CoordinateType> m_waveNumber;
+  int m_maxOrder;
+
+  std::vector<CoordinateType> m_testElementSizes;
+  std::vector<CoordinateType> m_trialElementSizes;
+  arma::Mat<CoordinateType> m_testElementCenters;
+  arma::Mat<CoordinateType> m_trialElementCenters;
+  CoordinateType m_averageElementSize;
+  /** \endcond */
+};
+
+} // namespace Fiber
+
+#endif
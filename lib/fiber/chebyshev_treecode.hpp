@@ -0,0 +1,233 @@
+// Copyright (C) 2011-2012 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_chebyshev_treecode_hpp
+#define fiber_chebyshev_treecode_hpp
+
+#include "../common/common.hpp"
+
+#include "treecode_options.hpp"
+#include "scalar_traits.hpp"
+#include "../common/armadillo_fwd.hpp"
+
+#include <vector>
+
+namespace Fiber {
+
+/** \cond FORWARD_DECL */
+template <typename T> class CollectionOf2dArrays;
+template <typename ValueType> class CollectionOfKernels;
+template <typename CoordinateType> class GeometricalData;
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class KernelTrialIntegral;
+/** \endcond */
+
+/** \brief Treecode evaluation of potentials with Chebyshev interpolation at
+ *  the evaluation points.
+ *
+ *  The quadrature points of the charge distribution and the evaluation
+ *  points are sorted into a common octree. For each pair of well-separated
+ *  boxes, the potential generated by the quadrature points of the source box
+ *  is evaluated at the tensor-product Chebyshev nodes of the bounding box of
+ *  the evaluation points in the target box. The resulting polynomial
+ *  interpolants of the far field are passed down the tree and evaluated at
+ *  the evaluation points in the leaves. Potentials of neighbouring leaves are
+ *  summed directly.
+ *
+ *  Only the target side is interpolated: there are no source-side
+ *  (multipole) expansions, so each well-separated pair of boxes costs
+ *  p<sup>3</sup> times the number of quadrature points in the source box,
+ *  where p is TreecodeOptions::expansionOrder. Every source box appears in a
+ *  bounded number of interaction lists per level, hence the far field costs
+ *  O(p<sup>3</sup> N<sub>s</sub> L) kernel evaluations and the
+ *  interpolation O(p<sup>3</sup> N<sub>t</sub>) operations, where
+ *  N<sub>s</sub> and N<sub>t</sub> are the numbers of quadrature and
+ *  evaluation points and L, of order log(N<sub>s</sub> + N<sub>t</sub>), is
+ *  the depth of the octree. This is asymptotically worse than the O(N) of a
+ *  fast multipole method and carries a large constant.
+ *
+ *  In exchange, only the kernels and the integral of the potential operator
+ *  are used, and the source quadrature points keep their normals and other
+ *  geometrical data. The method thus applies to any kernel that is smooth
+ *  with respect to the evaluation point away from the surface, e.g. to
+ *  double-layer kernels. The interpolants are accurate for non-oscillatory
+ *  kernels, i.e. those of the Laplace and modified Helmholtz equations and
+ *  those of the Helmholtz equation if the boxes are small compared to the
+ *  wavelength.
+ *
+ *  Points can be grouped into clusters, e.g. the quadrature points of a
+ *  single element, that are never split between boxes. The interactions of
+ *  clusters lying in neighbouring leaves can then be excluded from the
+ *  evaluation and computed separately; see getNearFieldClusters(). */
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class ChebyshevTreecode {
+public:
+  typedef typename ScalarTraits<ResultType>::RealType CoordinateType;
+  typedef KernelTrialIntegral<BasisFunctionType, KernelType, ResultType>
+  Integral;
+
+  /** \brief Constructor.
+   *
+   *  \p trialGeomData and \p weights describe the quadrature points of the
+   *  charge distribution in the format used by KernelTrialIntegral::evaluate().
+   *  All arguments must outlive the object. */
+  ChebyshevTreecode(const arma::Mat<CoordinateType> &points,
+            const GeometricalData<CoordinateType> &trialGeomData,
+            const std::vector<CoordinateType> &weights,
+            const CollectionOfKernels<KernelType> &kernels,
+            const Integral &integral, const TreecodeOptions &options);
+
+  /** \brief Constructor.
+   *
+   *  The evaluation points with indices from <tt>pointClusterOffsets[i]</tt>
+   *  to <tt>pointClusterOffsets[i + 1] - 1</tt> form the <em>i</em>th
+   *  target cluster; \p trialClusterOffsets defines the source clusters in
+   *  the same way. The remaining arguments are as in the other
+   *  constructor. */
+  ChebyshevTreecode(const arma::Mat<CoordinateType> &points,
+            const std::vector<size_t> &pointClusterOffsets,
+            const GeometricalData<CoordinateType> &trialGeomData,
+            const std::vector<size_t> &trialClusterOffsets,
+            const std::vector<CoordinateType> &weights,
+            const CollectionOfKernels<KernelType> &kernels,
+            const Integral &integral, const TreecodeOptions &options);
+
+  /** \brief Add the values of the potential at the evaluation points to the
+   *  corresponding columns of \p result.
+   *
+   *  \p trialTransfValues contains the values of the charge distribution at
+   *  the quadrature points in the format used by
+   *  KernelTrialIntegral::evaluate(). */
+  void evaluate(const CollectionOf2dArrays<ResultType> &trialTransfValues,
+                arma::Mat<ResultType> &result) const;
+
+  /** \brief Add the values of the potential at the evaluation points to the
+   *  corresponding columns of \p result, omitting the contributions of
+   *  the clusters returned by getNearFieldClusters(). */
+  void evaluateFarField(
+      const CollectionOf2dArrays<ResultType> &trialTransfValues,
+      arma::Mat<ResultType> &result) const;
+
+  /** \brief Return the pairs of clusters interacting directly.
+   *
+   *  On output, <tt>sourceClusters[i]</tt> contains the indices of the
+   *  source clusters whose potential at the points of the <em>i</em>th
+   *  target cluster is summed directly rather than interpolated. */
+  void getNearFieldClusters(
+      std::vector<std::vector<size_t>> &sourceClusters) const;
+
+private:
+  struct Node {
+    // Cell of the octree, used to subdivide the clusters
+    CoordinateType center[3];
+    CoordinateType halfWidth;
+    // Bounding boxes of the points, used for admissibility and interpolation
+    CoordinateType sourceCenter[3], sourceHalfWidths[3];
+    CoordinateType targetCenter[3], targetHalfWidths[3];
+    // Ranges of m_sourceClusterPermutation and m_targetClusterPermutation
+    size_t sourceClusterBegin, sourceClusterEnd;
+    size_t targetClusterBegin, targetClusterEnd;
+    // Ranges of m_sourcePermutation and m_targetPermutation
+    size_t sourceBegin, sourceEnd;
+    size_t targetBegin, targetEnd;
+    int level;
+    int parent;
+    std::vector<int> children;
+    // Source boxes interacting with this box through its interpolant
+    std::vector<int> farList;
+    // Source leaves whose potential is summed directly
+    std::vector<int> nearList;
+  };
+
+  void init(const std::vector<size_t> &pointClusterOffsets,
+            const std::vector<size_t> &trialClusterOffsets);
+  void buildTree(int nodeIndex);
+  void sortByOctant(const arma::Mat<CoordinateType> &coordinates,
+                    const CoordinateType *center,
+                    std::vector<size_t> &permutation, size_t begin,
+                    size_t end, size_t *offsets) const;
+  void computeBoundingBox(const arma::Mat<CoordinateType> &coordinates,
+                          const std::vector<size_t> &permutation,
+                          size_t begin, size_t end, CoordinateType minHalfWidth,
+                          CoordinateType *center,
+                          CoordinateType *halfWidths) const;
+  void findInteractions(int targetIndex, int sourceIndex);
+  bool isAdmissible(const Node &target, const Node &source) const;
+
+  void evaluateImpl(const CollectionOf2dArrays<ResultType> &trialTransfValues,
+                    bool nearField, arma::Mat<ResultType> &result) const;
+  void processNode(int nodeIndex,
+                   const CollectionOf2dArrays<ResultType> &trialTransfValues,
+                   bool nearField,
+                   std::vector<arma::Mat<ResultType>> &expansions,
+                   arma::Mat<ResultType> &result) const;
+  void gatherSources(size_t begin, size_t end,
+                     const CollectionOf2dArrays<ResultType> &trialTransfValues,
+                     GeometricalData<CoordinateType> &geomData,
+                     CollectionOf2dArrays<ResultType> &transfValues,
+                     std::vector<CoordinateType> &weights) const;
+  void addPotential(const Node &source,
+                    const CollectionOf2dArrays<ResultType> &trialTransfValues,
+                    const arma::Mat<CoordinateType> &points,
+                    arma::Mat<ResultType> &values) const;
+  void chebyshevNodes(const Node &node,
+                      arma::Mat<CoordinateType> &nodes) const;
+  void interpolationWeights(CoordinateType t, CoordinateType *weights) const;
+  void transferExpansion(const Node &parent,
+                         const arma::Mat<ResultType> &parentExpansion,
+                         const Node &child,
+                         arma::Mat<ResultType> &childExpansion) const;
+  void evaluateExpansion(const Node &node,
+                         const arma::Mat<ResultType> &expansion,
+                         const arma::Mat<CoordinateType> &targets,
+                         arma::Mat<ResultType> &values) const;
+
+private:
+  const arma::Mat<CoordinateType> &m_points;
+  const GeometricalData<CoordinateType> &m_trialGeomData;
+  const std::vector<CoordinateType> &m_weights;
+  const CollectionOfKernels<KernelType> &m_kernels;
+  const Integral &m_integral;
+  TreecodeOptions m_options;
+  int m_componentCount;
+
+  // Cluster centroids and offsets of the points belonging to the clusters
+  arma::Mat<CoordinateType> m_sourceClusterCenters;
+  arma::Mat<CoordinateType> m_targetClusterCenters;
+  std::vector<size_t> m_sourceClusterOffsets;
+  std::vector<size_t> m_targetClusterOffsets;
+  std::vector<size_t> m_sourceClusterPermutation;
+  std::vector<size_t> m_targetClusterPermutation;
+
+  std::vector<size_t> m_sourcePermutation;
+  std::vector<size_t> m_targetPermutation;
+  std::vector<Node> m_nodes;
+  std::vector<std::vector<int>> m_levels;
+
+  // Chebyshev nodes x_k and values T_j(x_k) of the Chebyshev polynomials
+  std::vector<CoordinateType> m_chebyshevNodes;
+  arma::Mat<CoordinateType> m_chebyshevPolynomials;
+};
+
+} // namespace Fiber
+
+#include "chebyshev_treecode_imp.hpp"
+
+#endif
@@ -0,0 +1,708 @@
+// Copyright (C) 2011-2012 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "chebyshev_treecode.hpp" // keep IDEs happy
+
+#include "collection_of_2d_arrays.hpp"
+#include "collection_of_4d_arrays.hpp"
+#include "collection_of_kernels.hpp"
+#include "geometrical_data.hpp"
+#include "kernel_trial_integral.hpp"
+
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace Fiber {
+
+namespace {
+
+template <typename CoordinateType>
+void clusterCenters(const arma::Mat<CoordinateType> &points,
+                    const std::vector<size_t> &offsets,
+                    arma::Mat<CoordinateType> &centers) {
+  const size_t clusterCount = offsets.size() - 1;
+  centers.set_size(3, clusterCount);
+  centers.fill(0.);
+  for (size_t c = 0; c < clusterCount; ++c) {
+    for (size_t i = offsets[c]; i < offsets[c + 1]; ++i)
+      for (int dim = 0; dim < 3; ++dim)
+        centers(dim, c) += points(dim, i);
+    if (offsets[c + 1] > offsets[c])
+      for (int dim = 0; dim < 3; ++dim)
+        centers(dim, c) /= offsets[c + 1] - offsets[c];
+  }
+}
+
+// Expand a permutation of clusters into a permutation of points. On output,
+// starts[i] is the position of the first point of the cluster with position
+// i in the cluster permutation.
+inline void expandPermutation(const std::vector<size_t> &clusterPermutation,
+                              const std::vector<size_t> &offsets,
+                              std::vector<size_t> &permutation,
+                              std::vector<size_t> &starts) {
+  permutation.clear();
+  permutation.reserve(offsets.back());
+  starts.resize(clusterPermutation.size() + 1);
+  for (size_t i = 0; i < clusterPermutation.size(); ++i) {
+    starts[i] = permutation.size();
+    const size_t c = clusterPermutation[i];
+    for (size_t point = offsets[c]; point < offsets[c + 1]; ++point)
+      permutation.push_back(point);
+  }
+  starts.back() = permutation.size();
+}
+
+inline void checkClusterOffsets(const std::vector<size_t> &offsets,
+                                size_t pointCount) {
+  if (offsets.empty() || offsets.front() != 0 ||
+      offsets.back() != pointCount)
+    throw std::invalid_argument("ChebyshevTreecode::ChebyshevTreecode(): "
+                                "invalid cluster offsets");
+  for (size_t i = 1; i < offsets.size(); ++i)
+    if (offsets[i] < offsets[i - 1])
+      throw std::invalid_argument("ChebyshevTreecode::ChebyshevTreecode(): "
+                                  "invalid cluster offsets");
+}
+
+} // namespace
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::ChebyshevTreecode(
+    const arma::Mat<CoordinateType> &points,
+    const GeometricalData<CoordinateType> &trialGeomData,
+    const std::vector<CoordinateType> &weights,
+    const CollectionOfKernels<KernelType> &kernels, const Integral &integral,
+    const TreecodeOptions &options)
+    : m_points(points), m_trialGeomData(trialGeomData), m_weights(weights),
+      m_kernels(kernels), m_integral(integral), m_options(options),
+      m_componentCount(integral.resultDimension()) {
+  // Each point forms a separate cluster
+  std::vector<size_t> pointClusterOffsets(points.n_cols + 1);
+  for (size_t i = 0; i < pointClusterOffsets.size(); ++i)
+    pointClusterOffsets[i] = i;
+  std::vector<size_t> trialClusterOffsets(trialGeomData.globals.n_cols + 1);
+  for (size_t i = 0; i < trialClusterOffsets.size(); ++i)
+    trialClusterOffsets[i] = i;
+  init(pointClusterOffsets, trialClusterOffsets);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::ChebyshevTreecode(
+    const arma::Mat<CoordinateType> &points,
+    const std::vector<size_t> &pointClusterOffsets,
+    const GeometricalData<CoordinateType> &trialGeomData,
+    const std::vector<size_t> &trialClusterOffsets,
+    const std::vector<CoordinateType> &weights,
+    const CollectionOfKernels<KernelType> &kernels, const Integral &integral,
+    const TreecodeOptions &options)
+    : m_points(points), m_trialGeomData(trialGeomData), m_weights(weights),
+      m_kernels(kernels), m_integral(integral), m_options(options),
+      m_componentCount(integral.resultDimension()) {
+  init(pointClusterOffsets, trialClusterOffsets);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::init(
+    const std::vector<size_t> &pointClusterOffsets,
+    const std::vector<size_t> &trialClusterOffsets) {
+  if (m_options.expansionOrder < 1 || m_options.maxPointsPerLeaf < 1 ||
+      m_options.eta <= 0.)
+    throw std::invalid_argument("ChebyshevTreecode::ChebyshevTreecode(): "
+                                "invalid treecode options");
+  const arma::Mat<CoordinateType> &sources = m_trialGeomData.globals;
+  if (m_points.n_rows != 3 || sources.n_rows != 3)
+    throw std::invalid_argument("ChebyshevTreecode::ChebyshevTreecode(): "
+                                "points must be three-dimensional");
+  checkClusterOffsets(pointClusterOffsets, m_points.n_cols);
+  checkClusterOffsets(trialClusterOffsets, sources.n_cols);
+
+  m_targetClusterOffsets = pointClusterOffsets;
+  m_sourceClusterOffsets = trialClusterOffsets;
+  clusterCenters(m_points, m_targetClusterOffsets, m_targetClusterCenters);
+  clusterCenters(sources, m_sourceClusterOffsets, m_sourceClusterCenters);
+  const size_t targetClusterCount = m_targetClusterOffsets.size() - 1;
+  const size_t sourceClusterCount = m_sourceClusterOffsets.size() - 1;
+
+  // Bounding cube of all cluster centres
+  CoordinateType lower[3], upper[3];
+  for (int dim = 0; dim < 3; ++dim) {
+    lower[dim] = std::numeric_limits<CoordinateType>::max();
+    upper[dim] = -std::numeric_limits<CoordinateType>::max();
+    for (size_t i = 0; i < sourceClusterCount; ++i) {
+      lower[dim] = std::min(lower[dim], m_sourceClusterCenters(dim, i));
+      upper[dim] = std::max(upper[dim], m_sourceClusterCenters(dim, i));
+    }
+    for (size_t i = 0; i < targetClusterCount; ++i) {
+      lower[dim] = std::min(lower[dim], m_targetClusterCenters(dim, i));
+      upper[dim] = std::max(upper[dim], m_targetClusterCenters(dim, i));
+    }
+  }
+
+  Node root;
+  root.halfWidth = 0.;
+  for (int dim = 0; dim < 3; ++dim) {
+    root.center[dim] = (lower[dim] + upper[dim]) / 2;
+    root.halfWidth = std::max(root.halfWidth, (upper[dim] - lower[dim]) / 2);
+  }
+  // Make sure that no centre lies on the boundary of the cube
+  root.halfWidth = root.halfWidth > 0. ? 1.001 * root.halfWidth : 1.;
+  root.sourceClusterBegin = root.targetClusterBegin = 0;
+  root.sourceClusterEnd = sourceClusterCount;
+  root.targetClusterEnd = targetClusterCount;
+  root.level = 0;
+  root.parent = -1;
+
+  m_sourceClusterPermutation.resize(sourceClusterCount);
+  for (size_t i = 0; i < sourceClusterCount; ++i)
+    m_sourceClusterPermutation[i] = i;
+  m_targetClusterPermutation.resize(targetClusterCount);
+  for (size_t i = 0; i < targetClusterCount; ++i)
+    m_targetClusterPermutation[i] = i;
+
+  m_nodes.push_back(root);
+  buildTree(0);
+
+  // Ranges of points and their bounding boxes
+  std::vector<size_t> sourceStarts, targetStarts;
+  expandPermutation(m_sourceClusterPermutation, m_sourceClusterOffsets,
+                    m_sourcePermutation, sourceStarts);
+  expandPermutation(m_targetClusterPermutation, m_targetClusterOffsets,
+                    m_targetPermutation, targetStarts);
+  for (size_t n = 0; n < m_nodes.size(); ++n) {
+    Node &node = m_nodes[n];
+    node.sourceBegin = sourceStarts[node.sourceClusterBegin];
+    node.sourceEnd = sourceStarts[node.sourceClusterEnd];
+    node.targetBegin = targetStarts[node.targetClusterBegin];
+    node.targetEnd = targetStarts[node.targetClusterEnd];
+    // Boxes of points lying in a plane must not be flat, since the
+    // interpolation coordinates are scaled by their half-widths
+    const CoordinateType minHalfWidth = 1e-3 * node.halfWidth;
+    computeBoundingBox(sources, m_sourcePermutation, node.sourceBegin,
+                       node.sourceEnd, minHalfWidth, node.sourceCenter,
+                       node.sourceHalfWidths);
+    computeBoundingBox(m_points, m_targetPermutation, node.targetBegin,
+                       node.targetEnd, minHalfWidth, node.targetCenter,
+                       node.targetHalfWidths);
+  }
+
+  findInteractions(0, 0);
+
+  for (size_t n = 0; n < m_nodes.size(); ++n) {
+    const size_t level = m_nodes[n].level;
+    if (m_levels.size() <= level)
+      m_levels.resize(level + 1);
+    m_levels[level].push_back(n);
+  }
+
+  const int order = m_options.expansionOrder;
+  m_chebyshevNodes.resize(order);
+  m_chebyshevPolynomials.set_size(order, order);
+  for (int k = 0; k < order; ++k) {
+    const CoordinateType angle = M_PI * (2 * k + 1) / (2 * order);
+    m_chebyshevNodes[k] = cos(angle);
+    for (int j = 0; j < order; ++j)
+      m_chebyshevPolynomials(j, k) = cos(j * angle);
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::buildTree(
+    int nodeIndex) {
+  // Copy the data, since m_nodes grows below
+  const Node node = m_nodes[nodeIndex];
+  size_t pointCount = 0;
+  for (size_t i = node.sourceClusterBegin; i < node.sourceClusterEnd; ++i) {
+    const size_t c = m_sourceClusterPermutation[i];
+    pointCount += m_sourceClusterOffsets[c + 1] - m_sourceClusterOffsets[c];
+  }
+  for (size_t i = node.targetClusterBegin; i < node.targetClusterEnd; ++i) {
+    const size_t c = m_targetClusterPermutation[i];
+    pointCount += m_targetClusterOffsets[c + 1] - m_targetClusterOffsets[c];
+  }
+  const size_t clusterCount =
+      (node.sourceClusterEnd - node.sourceClusterBegin) +
+      (node.targetClusterEnd - node.targetClusterBegin);
+  if (pointCount <= static_cast<size_t>(m_options.maxPointsPerLeaf) ||
+      clusterCount <= 1 || node.level >= m_options.maxLevel)
+    return;
+
+  size_t sourceOffsets[9], targetOffsets[9];
+  sortByOctant(m_sourceClusterCenters, node.center,
+               m_sourceClusterPermutation, node.sourceClusterBegin,
+               node.sourceClusterEnd, sourceOffsets);
+  sortByOctant(m_targetClusterCenters, node.center,
+               m_targetClusterPermutation, node.targetClusterBegin,
+               node.targetClusterEnd, targetOffsets);
+
+  for (int octant = 0; octant < 8; ++octant) {
+    if (sourceOffsets[octant] == sourceOffsets[octant + 1] &&
+        targetOffsets[octant] == targetOffsets[octant + 1])
+      continue;
+    Node child;
+    child.halfWidth = node.halfWidth / 2;
+    for (int dim = 0; dim < 3; ++dim)
+      child.center[dim] = node.center[dim] + (((octant >> dim) & 1)
+                                                  ? child.halfWidth
+                                                  : -child.halfWidth);
+    child.sourceClusterBegin = sourceOffsets[octant];
+    child.sourceClusterEnd = sourceOffsets[octant + 1];
+    child.targetClusterBegin = targetOffsets[octant];
+    child.targetClusterEnd = targetOffsets[octant + 1];
+    child.level = node.level + 1;
+    child.parent = nodeIndex;
+
+    const int childIndex = m_nodes.size();
+    m_nodes.push_back(child);
+    m_nodes[nodeIndex].children.push_back(childIndex);
+    buildTree(childIndex);
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::sortByOctant(
+    const arma::Mat<CoordinateType> &coordinates, const CoordinateType *center,
+    std::vector<size_t> &permutation, size_t begin, size_t end,
+    size_t *offsets) const {
+  std::vector<unsigned char> octants(end - begin);
+  size_t counts[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (size_t i = begin; i < end; ++i) {
+    const size_t index = permutation[i];
+    unsigned char octant = 0;
+    for (int dim = 0; dim < 3; ++dim)
+      if (coordinates(dim, index) >= center[dim])
+        octant |= 1 << dim;
+    octants[i - begin] = octant;
+    ++counts[octant];
+  }
+
+  offsets[0] = begin;
+  for (int octant = 0; octant < 8; ++octant)
+    offsets[octant + 1] = offsets[octant] + counts[octant];
+
+  size_t positions[8];
+  std::copy(offsets, offsets + 8, positions);
+  std::vector<size_t> sorted(end - begin);
+  for (size_t i = begin; i < end; ++i)
+    sorted[positions[octants[i - begin]]++ - begin] = permutation[i];
+  std::copy(sorted.begin(), sorted.end(), permutation.begin() + begin);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    computeBoundingBox(
+        const arma::Mat<CoordinateType> &coordinates,
+        const std::vector<size_t> &permutation, size_t begin, size_t end,
+        CoordinateType minHalfWidth, CoordinateType *center,
+        CoordinateType *halfWidths) const {
+  for (int dim = 0; dim < 3; ++dim) {
+    CoordinateType lower = std::numeric_limits<CoordinateType>::max();
+    CoordinateType upper = -std::numeric_limits<CoordinateType>::max();
+    for (size_t i = begin; i < end; ++i) {
+      lower = std::min(lower, coordinates(dim, permutation[i]));
+      upper = std::max(upper, coordinates(dim, permutation[i]));
+    }
+    if (begin == end)
+      lower = upper = 0.;
+    center[dim] = (lower + upper) / 2;
+    halfWidths[dim] = std::max(minHalfWidth, (upper - lower) / 2);
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    findInteractions(int targetIndex, int sourceIndex) {
+  const Node &target = m_nodes[targetIndex];
+  const Node &source = m_nodes[sourceIndex];
+  if (target.targetBegin == target.targetEnd ||
+      source.sourceBegin == source.sourceEnd)
+    return;
+
+  if (isAdmissible(target, source))
+    m_nodes[targetIndex].farList.push_back(sourceIndex);
+  else if (target.children.empty() && source.children.empty())
+    m_nodes[targetIndex].nearList.push_back(sourceIndex);
+  else if (source.children.empty() ||
+           (!target.children.empty() &&
+            target.halfWidth >= source.halfWidth))
+    for (size_t i = 0; i < target.children.size(); ++i)
+      findInteractions(target.children[i], sourceIndex);
+  else
+    for (size_t i = 0; i < source.children.size(); ++i)
+      findInteractions(targetIndex, source.children[i]);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+bool ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::isAdmissible(
+    const Node &target, const Node &source) const {
+  CoordinateType distanceSq = 0.;
+  CoordinateType targetDiameterSq = 0., sourceDiameterSq = 0.;
+  for (int dim = 0; dim < 3; ++dim) {
+    const CoordinateType gap =
+        std::abs(target.targetCenter[dim] - source.sourceCenter[dim]) -
+        target.targetHalfWidths[dim] - source.sourceHalfWidths[dim];
+    if (gap > 0.)
+      distanceSq += gap * gap;
+    targetDiameterSq +=
+        4. * target.targetHalfWidths[dim] * target.targetHalfWidths[dim];
+    sourceDiameterSq +=
+        4. * source.sourceHalfWidths[dim] * source.sourceHalfWidths[dim];
+  }
+  return distanceSq > 0. &&
+         std::max(targetDiameterSq, sourceDiameterSq) <=
+             m_options.eta * m_options.eta * distanceSq;
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::evaluate(
+    const CollectionOf2dArrays<ResultType> &trialTransfValues,
+    arma::Mat<ResultType> &result) const {
+  evaluateImpl(trialTransfValues, true /* near field */, result);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    evaluateFarField(
+        const CollectionOf2dArrays<ResultType> &trialTransfValues,
+        arma::Mat<ResultType> &result) const {
+  evaluateImpl(trialTransfValues, false /* near field */, result);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    getNearFieldClusters(
+        std::vector<std::vector<size_t>> &sourceClusters) const {
+  sourceClusters.clear();
+  sourceClusters.resize(m_targetClusterOffsets.size() - 1);
+  for (size_t n = 0; n < m_nodes.size(); ++n) {
+    const Node &target = m_nodes[n];
+    for (size_t i = 0; i < target.nearList.size(); ++i) {
+      const Node &source = m_nodes[target.nearList[i]];
+      for (size_t t = target.targetClusterBegin; t < target.targetClusterEnd;
+           ++t) {
+        std::vector<size_t> &clusters =
+            sourceClusters[m_targetClusterPermutation[t]];
+        for (size_t s = source.sourceClusterBegin; s < source.sourceClusterEnd;
+             ++s)
+          clusters.push_back(m_sourceClusterPermutation[s]);
+      }
+    }
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::evaluateImpl(
+    const CollectionOf2dArrays<ResultType> &trialTransfValues, bool nearField,
+    arma::Mat<ResultType> &result) const {
+  if (result.n_rows != static_cast<arma::uword>(m_componentCount) ||
+      result.n_cols != m_points.n_cols)
+    throw std::invalid_argument("ChebyshevTreecode::evaluate(): "
+                                "result has incorrect dimensions");
+
+  // Interpolants of the far field, stored only for two consecutive levels.
+  // Boxes on the same level contain disjoint sets of evaluation points, so
+  // they can be processed in parallel.
+  std::vector<arma::Mat<ResultType>> expansions(m_nodes.size());
+  for (size_t level = 0; level < m_levels.size(); ++level) {
+    const std::vector<int> &nodes = m_levels[level];
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nodes.size()),
+                      [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i < r.end(); ++i)
+        processNode(nodes[i], trialTransfValues, nearField, expansions,
+                    result);
+    });
+    if (level > 0)
+      for (size_t i = 0; i < m_levels[level - 1].size(); ++i)
+        expansions[m_levels[level - 1][i]].reset();
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::processNode(
+    int nodeIndex, const CollectionOf2dArrays<ResultType> &trialTransfValues,
+    bool nearField, std::vector<arma::Mat<ResultType>> &expansions,
+    arma::Mat<ResultType> &result) const {
+  const Node &node = m_nodes[nodeIndex];
+  const size_t targetCount = node.targetEnd - node.targetBegin;
+  if (targetCount == 0)
+    return;
+  const size_t order = m_options.expansionOrder;
+  const size_t nodeCount = order * order * order;
+
+  arma::Mat<CoordinateType> targets(3, targetCount);
+  for (size_t i = 0; i < targetCount; ++i)
+    targets.col(i) = m_points.col(m_targetPermutation[node.targetBegin + i]);
+  arma::Mat<ResultType> values(m_componentCount, targetCount);
+  values.fill(0.);
+  bool valuesChanged = false;
+
+  arma::Mat<ResultType> &expansion = expansions[nodeIndex];
+  if (node.parent >= 0 && !expansions[node.parent].is_empty())
+    transferExpansion(m_nodes[node.parent], expansions[node.parent], node,
+                      expansion);
+
+  if (!node.farList.empty()) {
+    if (targetCount > nodeCount) {
+      arma::Mat<CoordinateType> nodes;
+      chebyshevNodes(node, nodes);
+      if (expansion.is_empty()) {
+        expansion.set_size(m_componentCount, nodeCount);
+        expansion.fill(0.);
+      }
+      for (size_t i = 0; i < node.farList.size(); ++i)
+        addPotential(m_nodes[node.farList[i]], trialTransfValues, nodes,
+                     expansion);
+    } else {
+      // Interpolation would cost more than direct evaluation
+      for (size_t i = 0; i < node.farList.size(); ++i)
+        addPotential(m_nodes[node.farList[i]], trialTransfValues, targets,
+                     values);
+      valuesChanged = true;
+    }
+  }
+  if (nearField)
+    for (size_t i = 0; i < node.nearList.size(); ++i) {
+      addPotential(m_nodes[node.nearList[i]], trialTransfValues, targets,
+                   values);
+      valuesChanged = true;
+    }
+  if (node.children.empty() && !expansion.is_empty()) {
+    evaluateExpansion(node, expansion, targets, values);
+    valuesChanged = true;
+  }
+
+  if (valuesChanged)
+    for (size_t i = 0; i < targetCount; ++i)
+      result.col(m_targetPermutation[node.targetBegin + i]) += values.col(i);
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    gatherSources(
+        size_t begin, size_t end,
+        const CollectionOf2dArrays<ResultType> &trialTransfValues,
+        GeometricalData<CoordinateType> &geomData,
+        CollectionOf2dArrays<ResultType> &transfValues,
+        std::vector<CoordinateType> &weights) const {
+  const size_t count = end - begin;
+  const size_t *indices = &m_sourcePermutation[begin];
+  const GeometricalData<CoordinateType> &source = m_trialGeomData;
+
+  if (!source.globals.is_empty()) {
+    geomData.globals.set_size(source.globals.n_rows, count);
+    for (size_t i = 0; i < count; ++i)
+      geomData.globals.col(i) = source.globals.col(indices[i]);
+  }
+  if (!source.integrationElements.is_empty()) {
+    geomData.integrationElements.set_size(count);
+    for (size_t i = 0; i < count; ++i)
+      geomData.integrationElements(i) = source.integrationElements(indices[i]);
+  }
+  if (!source.normals.is_empty()) {
+    geomData.normals.set_size(source.normals.n_rows, count);
+    for (size_t i = 0; i < count; ++i)
+      geomData.normals.col(i) = source.normals.col(indices[i]);
+  }
+  if (!source.jacobiansTransposed.is_empty()) {
+    const _3dArray<CoordinateType> &jt = source.jacobiansTransposed;
+    geomData.jacobiansTransposed.set_size(jt.extent(0), jt.extent(1), count);
+    for (size_t i = 0; i < count; ++i)
+      for (size_t c = 0; c < jt.extent(1); ++c)
+        for (size_t r = 0; r < jt.extent(0); ++r)
+          geomData.jacobiansTransposed(r, c, i) = jt(r, c, indices[i]);
+  }
+  if (!source.jacobianInversesTransposed.is_empty()) {
+    const _3dArray<CoordinateType> &jit = source.jacobianInversesTransposed;
+    geomData.jacobianInversesTransposed.set_size(jit.extent(0),
+                                                 jit.extent(1), count);
+    for (size_t i = 0; i < count; ++i)
+      for (size_t c = 0; c < jit.extent(1); ++c)
+        for (size_t r = 0; r < jit.extent(0); ++r)
+          geomData.jacobianInversesTransposed(r, c, i) =
+              jit(r, c, indices[i]);
+  }
+  geomData.domainIndex = source.domainIndex;
+
+  transfValues.set_size(trialTransfValues.size());
+  for (size_t transf = 0; transf < trialTransfValues.size(); ++transf) {
+    const _2dArray<ResultType> &values = trialTransfValues[transf];
+    transfValues[transf].set_size(values.extent(0), count);
+    for (size_t i = 0; i < count; ++i)
+      for (size_t dim = 0; dim < values.extent(0); ++dim)
+        transfValues[transf](dim, i) = values(dim, indices[i]);
+  }
+
+  weights.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    weights[i] = m_weights[indices[i]];
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::addPotential(
+    const Node &source,
+    const CollectionOf2dArrays<ResultType> &trialTransfValues,
+    const arma::Mat<CoordinateType> &points,
+    arma::Mat<ResultType> &values) const {
+  // Sources are processed in chunks to limit the size of the arrays of
+  // kernel values
+  const size_t chunkSize = 1024;
+
+  GeometricalData<CoordinateType> evalPointGeomData;
+  evalPointGeomData.globals = points;
+  GeometricalData<CoordinateType> sourceGeomData;
+  CollectionOf2dArrays<ResultType> sourceTransfValues;
+  std::vector<CoordinateType> sourceWeights;
+  CollectionOf4dArrays<KernelType> kernelValues;
+  _2dArray<ResultType> chunkValues;
+
+  for (size_t begin = source.sourceBegin; begin < source.sourceEnd;
+       begin += chunkSize) {
+    const size_t end = std::min(begin + chunkSize, source.sourceEnd);
+    gatherSources(begin, end, trialTransfValues, sourceGeomData,
+                  sourceTransfValues, sourceWeights);
+    m_kernels.evaluateOnGrid(evalPointGeomData, sourceGeomData, kernelValues);
+    m_integral.evaluate(sourceGeomData, kernelValues, sourceTransfValues,
+                        sourceWeights, chunkValues);
+    for (size_t point = 0; point < points.n_cols; ++point)
+      for (int c = 0; c < m_componentCount; ++c)
+        values(c, point) += chunkValues(c, point);
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    chebyshevNodes(const Node &node, arma::Mat<CoordinateType> &nodes) const {
+  const size_t order = m_options.expansionOrder;
+  nodes.set_size(3, order * order * order);
+  for (size_t c = 0; c < order; ++c)
+    for (size_t b = 0; b < order; ++b)
+      for (size_t a = 0; a < order; ++a) {
+        const size_t index = a + order * (b + order * c);
+        nodes(0, index) = node.targetCenter[0] +
+                          node.targetHalfWidths[0] * m_chebyshevNodes[a];
+        nodes(1, index) = node.targetCenter[1] +
+                          node.targetHalfWidths[1] * m_chebyshevNodes[b];
+        nodes(2, index) = node.targetCenter[2] +
+                          node.targetHalfWidths[2] * m_chebyshevNodes[c];
+      }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    interpolationWeights(CoordinateType t, CoordinateType *weights) const {
+  // Lagrange polynomials at the Chebyshev nodes, written as
+  // 1/p + 2/p sum_{j=1}^{p-1} T_j(x_k) T_j(t)
+  const int order = m_options.expansionOrder;
+  t = std::max(CoordinateType(-1.), std::min(CoordinateType(1.), t));
+  for (int k = 0; k < order; ++k)
+    weights[k] = CoordinateType(1.) / order;
+  CoordinateType previous = 1., current = t;
+  for (int j = 1; j < order; ++j) {
+    for (int k = 0; k < order; ++k)
+      weights[k] += CoordinateType(2.) / order *
+                    m_chebyshevPolynomials(j, k) * current;
+    const CoordinateType next = 2. * t * current - previous;
+    previous = current;
+    current = next;
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    transferExpansion(
+        const Node &parent, const arma::Mat<ResultType> &parentExpansion,
+        const Node &child, arma::Mat<ResultType> &childExpansion) const {
+  const size_t order = m_options.expansionOrder;
+  const size_t nodeCount = order * order * order;
+
+  // weights[dim](i, a): a-th Lagrange polynomial of the parent at the i-th
+  // Chebyshev node of the child
+  arma::Mat<CoordinateType> weights[3];
+  for (int dim = 0; dim < 3; ++dim) {
+    weights[dim].set_size(order, order);
+    std::vector<CoordinateType> w(order);
+    for (size_t i = 0; i < order; ++i) {
+      interpolationWeights((child.targetCenter[dim] +
+                            child.targetHalfWidths[dim] * m_chebyshevNodes[i] -
+                            parent.targetCenter[dim]) /
+                               parent.targetHalfWidths[dim],
+                           &w[0]);
+      for (size_t a = 0; a < order; ++a)
+        weights[dim](i, a) = w[a];
+    }
+  }
+
+  // Apply the tensor-product interpolation one dimension at a time
+  arma::Mat<ResultType> input = parentExpansion, output(m_componentCount,
+                                                        nodeCount);
+  const size_t strides[3] = {1, order, order * order};
+  for (int dim = 0; dim < 3; ++dim) {
+    output.fill(0.);
+    const size_t stride = strides[dim];
+    for (size_t index = 0; index < nodeCount; ++index) {
+      const size_t i = (index / stride) % order;
+      const size_t base = index - i * stride;
+      for (size_t a = 0; a < order; ++a) {
+        const CoordinateType w = weights[dim](i, a);
+        for (int c = 0; c < m_componentCount; ++c)
+          output(c, index) += w * input(c, base + a * stride);
+      }
+    }
+    input.swap(output);
+  }
+
+  if (childExpansion.is_empty())
+    childExpansion = input;
+  else
+    childExpansion += input;
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void ChebyshevTreecode<BasisFunctionType, KernelType, ResultType>::
+    evaluateExpansion(
+        const Node &node, const arma::Mat<ResultType> &expansion,
+        const arma::Mat<CoordinateType> &targets,
+        arma::Mat<ResultType> &values) const {
+  const size_t order = m_options.expansionOrder;
+  std::vector<CoordinateType> w[3];
+  for (int dim = 0; dim < 3; ++dim)
+    w[dim].resize(order);
+  for (size_t point = 0; point < targets.n_cols; ++point) {
+    for (int dim = 0; dim < 3; ++dim)
+      interpolationWeights((targets(dim, point) - node.targetCenter[dim]) /
+                               node.targetHalfWidths[dim],
+                           &w[dim][0]);
+    for (size_t c = 0; c < order; ++c)
+      for (size_t b = 0; b < order; ++b) {
+        const CoordinateType wyz = w[1][b] * w[2][c];
+        for (size_t a = 0; a < order; ++a) {
+          const CoordinateType weight = w[0][a] * wyz;
+          const size_t index = a + order * (b + order * c);
+          for (int comp = 0; comp < m_componentCount; ++comp)
+            values(comp, point) += weight * expansion(comp, index);
+        }
+      }
+  }
+}
+
+} // namespace Fiber
@@ -23,6 +23,7 @@
 
 #include "../common/common.hpp"
 
+#include "../common/armadillo_fwd.hpp"
 #include "scalar_traits.hpp"
 
 #include <utility>
@@ -139,6 +140,53 @@ public:
                  const GeometricalData<CoordinateType> &trialGeomData,
                  CollectionOf4dArrays<ValueType> &result) const = 0;
 
+  /** \brief Integrate a scalar kernel against scalar test and trial
+   *  functions on a tensor grid of points.
+   *
+   *  \param[in] testGeomData
+   *    Geometrical data related to \f$m\f$ points on the test element.
+   *  \param[in] trialGeomData
+   *    Geometrical data related to \f$n\f$ points on the trial element.
+   *  \param[in] weightedTestValues
+   *    Matrix \f$t\f$ with \f$m\f$ rows and one column per test function,
+   *    containing the function values multiplied by the quadrature weights
+   *    and integration elements.
+   *  \param[in] weightedTrialValues
+   *    Matrix \f$u\f$ with \f$n\f$ rows and one column per trial function,
+   *    defined analogously.
+   *  \param[out] result
+   *    On output, <tt>result(i, j)</tt> should contain
+   *    \f$\sum_{p, q} t_{pi} K(x_p, y_q) u_{qj}\f$, where \f$K\f$ is the
+   *    only kernel of the collection.
+   *
+   *  Implementations accumulate the sums without storing the kernel values on
+   *  the whole grid. The function returns false and leaves \p result
+   *  untouched if the collection does not support this operation; the caller
+   *  should then use evaluateOnGrid(). The default implementation always
+   *  returns false. */
+  virtual bool
+  integrateOnGrid(const GeometricalData<CoordinateType> &testGeomData,
+                  const GeometricalData<CoordinateType> &trialGeomData,
+                  const arma::Mat<CoordinateType> &weightedTestValues,
+                  const arma::Mat<CoordinateType> &weightedTrialValues,
+                  arma::Mat<ValueType> &result) const {
+    return false;
+  }
+
+  /** \brief Return true if the kernels are invariant under rigid motions.
+   *
+   *  A collection of kernels is invariant under rigid motions if the kernel
+   *  values do not change when the test and trial points are subjected to the
+   *  same translation and proper rotation (with the normals rotated
+   *  accordingly). This holds, for example, for kernels depending only on the
+   *  distance between the points and on the angles between the normals and
+   *  the vector joining the points.
+   *
+   *  If this function returns true, local assemblers may reuse the local
+   *  weak form calculated for one pair of elements for all congruent pairs
+   *  of elements. The default implementation returns false. */
+  virtual bool isInvariantUnderRigidMotions() const { return false; }
+
   /** \brief Currently unused. */
   virtual std::pair<const char *, int> evaluateClCode() const {
     throw std::runtime_error("CollectionOfKernels::evaluateClCode(): "
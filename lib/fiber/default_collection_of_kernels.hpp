@@ -78,6 +78,28 @@ namespace Fiber {
         // defined, the kernel behaves as if its estimated magnitude was 1
         // everywhere.
         CoordinateType estimateRelativeScale(CoordinateType distance) const;
+
+        // (Optional)
+        // Evaluate a collection consisting of a single scalar kernel at all
+        // pairs of test and trial points at once. The geometrical data are
+        // given in structure-of-arrays layout, so that the loop over test
+        // points can be vectorized. The value for test point i and trial
+        // point j should be written to result[i + j * testGeomData.pointCount].
+        // If this function is defined, evaluateOnGrid() calls it instead of
+        // evaluate(), and integrateOnGrid() is supported for test and trial
+        // shapesets with one or three functions (e.g. P0 and P1 on
+        // triangles).
+        void evaluateBatch(
+                const BatchedGeometricalData<CoordinateType>& testGeomData,
+                const BatchedGeometricalData<CoordinateType>& trialGeomData,
+                ValueType* result) const;
+
+        // (Optional)
+        // Return true if the kernels are invariant under rigid motions (see
+        // CollectionOfKernels::isInvariantUnderRigidMotions()). If this
+        // function is not defined, the kernels are assumed not to be
+        // invariant.
+        bool isInvariantUnderRigidMotions() const;
     };
     \endcode
 
@@ -113,6 +135,15 @@ public:
                  const GeometricalData<CoordinateType> &trialGeomData,
                  CollectionOf4dArrays<ValueType> &result) const;
 
+  virtual bool
+  integrateOnGrid(const GeometricalData<CoordinateType> &testGeomData,
+                  const GeometricalData<CoordinateType> &trialGeomData,
+                  const arma::Mat<CoordinateType> &weightedTestValues,
+                  const arma::Mat<CoordinateType> &weightedTrialValues,
+                  arma::Mat<ValueType> &result) const;
+
+  virtual bool isInvariantUnderRigidMotions() const;
+
   virtual std::pair<const char *, int> evaluateClCode() const;
 
   virtual CoordinateType estimateRelativeScale(CoordinateType distance) const;
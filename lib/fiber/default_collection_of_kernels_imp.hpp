@@ -27,8 +27,10 @@
 #include "collection_of_4d_arrays.hpp"
 #include "geometrical_data.hpp"
 
+#include <armadillo>
 #include <boost/utility/enable_if.hpp>
 #include <stdexcept>
+#include <vector>
 
 #define FIBER_HAS_MEM_FUNC(func, name)                                         \
   template <typename T, typename Sign> struct name {                           \
@@ -116,6 +118,210 @@ estimateRelativeScaleInternal(const Functor &functor,
 //   return 1.;
 //}
 
+FIBER_HAS_MEM_FUNC(isInvariantUnderRigidMotions,
+                   hasIsInvariantUnderRigidMotions);
+
+template <typename Functor>
+typename boost::enable_if<
+    hasIsInvariantUnderRigidMotions<Functor, bool (Functor::*)() const>,
+    bool>::type
+isInvariantUnderRigidMotionsInternal(const Functor &functor) {
+  return functor.isInvariantUnderRigidMotions();
+}
+
+template <typename Functor>
+typename boost::disable_if<
+    hasIsInvariantUnderRigidMotions<Functor, bool (Functor::*)() const>,
+    bool>::type
+isInvariantUnderRigidMotionsInternal(const Functor &functor) {
+  return false;
+}
+
+FIBER_HAS_MEM_FUNC(evaluateBatch, hasEvaluateBatch);
+
+template <typename Functor> struct EvaluateBatchSignature {
+  typedef void (Functor::*type)(
+      const BatchedGeometricalData<typename Functor::CoordinateType> &,
+      const BatchedGeometricalData<typename Functor::CoordinateType> &,
+      typename Functor::ValueType *) const;
+};
+
+template <typename CoordinateType>
+BatchedGeometricalData<CoordinateType>
+makeBatchedGeometricalData(const GeometricalData<CoordinateType> &geomData,
+                           arma::Mat<CoordinateType> &globals,
+                           arma::Mat<CoordinateType> &normals) {
+  // After transposition each column holds one component of all points
+  globals = geomData.globals.t();
+  normals = geomData.normals.t();
+
+  BatchedGeometricalData<CoordinateType> result;
+  result.pointCount = geomData.pointCount();
+  for (size_t dim = 0; dim < 3; ++dim) {
+    result.globals[dim] = dim < globals.n_cols ? globals.colptr(dim) : 0;
+    result.normals[dim] = dim < normals.n_cols ? normals.colptr(dim) : 0;
+  }
+  return result;
+}
+
+template <typename Functor>
+typename boost::enable_if<
+    hasEvaluateBatch<Functor, typename EvaluateBatchSignature<Functor>::type>,
+    void>::type
+evaluateOnGridInternal(
+    const Functor &functor,
+    const GeometricalData<typename Functor::CoordinateType> &testGeomData,
+    const GeometricalData<typename Functor::CoordinateType> &trialGeomData,
+    CollectionOf4dArrays<typename Functor::ValueType> &result) {
+  typedef typename Functor::CoordinateType CoordinateType;
+  assert(result.size() == 1);
+  assert(functor.kernelRowCount(0) == 1 && functor.kernelColCount(0) == 1);
+
+  arma::Mat<CoordinateType> testGlobals, testNormals;
+  arma::Mat<CoordinateType> trialGlobals, trialNormals;
+  functor.evaluateBatch(
+      makeBatchedGeometricalData(testGeomData, testGlobals, testNormals),
+      makeBatchedGeometricalData(trialGeomData, trialGlobals, trialNormals),
+      result[0].begin());
+}
+
+template <typename Functor>
+typename boost::disable_if<
+    hasEvaluateBatch<Functor, typename EvaluateBatchSignature<Functor>::type>,
+    void>::type
+evaluateOnGridInternal(
+    const Functor &functor,
+    const GeometricalData<typename Functor::CoordinateType> &testGeomData,
+    const GeometricalData<typename Functor::CoordinateType> &trialGeomData,
+    CollectionOf4dArrays<typename Functor::ValueType> &result) {
+  const size_t testPointCount = testGeomData.pointCount();
+  const size_t trialPointCount = trialGeomData.pointCount();
+
+#pragma ivdep
+  for (size_t trialIndex = 0; trialIndex < trialPointCount; ++trialIndex)
+    for (size_t testIndex = 0; testIndex < testPointCount; ++testIndex)
+      functor.evaluate(testGeomData.const_slice(testIndex),
+                       trialGeomData.const_slice(trialIndex),
+                       result.slice(testIndex, trialIndex).self());
+}
+
+// Kernel values are computed for one trial point at a time and immediately
+// contracted with the test functions, so that the sums for all pairs of
+// functions stay in registers.
+template <int TestDofCount, int TrialDofCount, typename Functor>
+void integrateOnGridFused(
+    const Functor &functor,
+    const BatchedGeometricalData<typename Functor::CoordinateType> &testData,
+    const BatchedGeometricalData<typename Functor::CoordinateType> &trialData,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTestValues,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTrialValues,
+    arma::Mat<typename Functor::ValueType> &result) {
+  typedef typename Functor::CoordinateType CoordinateType;
+  typedef typename Functor::ValueType ValueType;
+
+  const size_t testPointCount = testData.pointCount;
+  const size_t trialPointCount = trialData.pointCount;
+
+  const size_t maxStackPointCount = 64;
+  ValueType stackKernelValues[maxStackPointCount];
+  std::vector<ValueType> heapKernelValues;
+  ValueType *kernelValues = stackKernelValues;
+  if (testPointCount > maxStackPointCount) {
+    heapKernelValues.resize(testPointCount);
+    kernelValues = &heapKernelValues[0];
+  }
+
+  ValueType sums[TestDofCount][TrialDofCount];
+  for (int i = 0; i < TestDofCount; ++i)
+    for (int j = 0; j < TrialDofCount; ++j)
+      sums[i][j] = 0.;
+
+  BatchedGeometricalData<CoordinateType> trialPoint = trialData;
+  trialPoint.pointCount = 1;
+  for (size_t q = 0; q < trialPointCount; ++q) {
+    for (size_t dim = 0; dim < 3; ++dim) {
+      if (trialData.globals[dim])
+        trialPoint.globals[dim] = trialData.globals[dim] + q;
+      if (trialData.normals[dim])
+        trialPoint.normals[dim] = trialData.normals[dim] + q;
+    }
+    functor.evaluateBatch(testData, trialPoint, kernelValues);
+
+    for (int i = 0; i < TestDofCount; ++i) {
+      const CoordinateType *testValues = weightedTestValues.colptr(i);
+      ValueType testSum = 0.;
+      for (size_t p = 0; p < testPointCount; ++p)
+        testSum += testValues[p] * kernelValues[p];
+      for (int j = 0; j < TrialDofCount; ++j)
+        sums[i][j] += testSum * weightedTrialValues(q, j);
+    }
+  }
+
+  result.set_size(TestDofCount, TrialDofCount);
+  for (int i = 0; i < TestDofCount; ++i)
+    for (int j = 0; j < TrialDofCount; ++j)
+      result(i, j) = sums[i][j];
+}
+
+template <typename Functor>
+typename boost::enable_if<
+    hasEvaluateBatch<Functor, typename EvaluateBatchSignature<Functor>::type>,
+    bool>::type
+integrateOnGridInternal(
+    const Functor &functor,
+    const GeometricalData<typename Functor::CoordinateType> &testGeomData,
+    const GeometricalData<typename Functor::CoordinateType> &trialGeomData,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTestValues,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTrialValues,
+    arma::Mat<typename Functor::ValueType> &result) {
+  typedef typename Functor::CoordinateType CoordinateType;
+  assert(weightedTestValues.n_rows == testGeomData.pointCount());
+  assert(weightedTrialValues.n_rows == trialGeomData.pointCount());
+
+  // The number of functions is fixed at compile time for the common
+  // shapesets only
+  const int testDofCount = weightedTestValues.n_cols;
+  const int trialDofCount = weightedTrialValues.n_cols;
+  if ((testDofCount != 1 && testDofCount != 3) ||
+      (trialDofCount != 1 && trialDofCount != 3))
+    return false;
+
+  arma::Mat<CoordinateType> testGlobals, testNormals;
+  arma::Mat<CoordinateType> trialGlobals, trialNormals;
+  BatchedGeometricalData<CoordinateType> testData =
+      makeBatchedGeometricalData(testGeomData, testGlobals, testNormals);
+  BatchedGeometricalData<CoordinateType> trialData =
+      makeBatchedGeometricalData(trialGeomData, trialGlobals, trialNormals);
+
+  if (testDofCount == 1 && trialDofCount == 1)
+    integrateOnGridFused<1, 1>(functor, testData, trialData,
+                               weightedTestValues, weightedTrialValues, result);
+  else if (testDofCount == 1)
+    integrateOnGridFused<1, 3>(functor, testData, trialData,
+                               weightedTestValues, weightedTrialValues, result);
+  else if (trialDofCount == 1)
+    integrateOnGridFused<3, 1>(functor, testData, trialData,
+                               weightedTestValues, weightedTrialValues, result);
+  else
+    integrateOnGridFused<3, 3>(functor, testData, trialData,
+                               weightedTestValues, weightedTrialValues, result);
+  return true;
+}
+
+template <typename Functor>
+typename boost::disable_if<
+    hasEvaluateBatch<Functor, typename EvaluateBatchSignature<Functor>::type>,
+    bool>::type
+integrateOnGridInternal(
+    const Functor &functor,
+    const GeometricalData<typename Functor::CoordinateType> &testGeomData,
+    const GeometricalData<typename Functor::CoordinateType> &trialGeomData,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTestValues,
+    const arma::Mat<typename Functor::CoordinateType> &weightedTrialValues,
+    arma::Mat<typename Functor::ValueType> &result) {
+  return false;
+}
+
 template <typename Functor>
 void DefaultCollectionOfKernels<Functor>::addGeometricalDependencies(
     size_t &testGeomDeps, size_t &trialGeomDeps) const {
@@ -154,12 +360,24 @@ void DefaultCollectionOfKernels<Functor>::evaluateOnGrid(
     result[k].set_size(m_functor.kernelRowCount(k), m_functor.kernelColCount(k),
                        testPointCount, trialPointCount);
 
-#pragma ivdep
-  for (size_t trialIndex = 0; trialIndex < trialPointCount; ++trialIndex)
-    for (size_t testIndex = 0; testIndex < testPointCount; ++testIndex)
-      m_functor.evaluate(testGeomData.const_slice(testIndex),
-                         trialGeomData.const_slice(trialIndex),
-                         result.slice(testIndex, trialIndex).self());
+  evaluateOnGridInternal(m_functor, testGeomData, trialGeomData, result);
+}
+
+template <typename Functor>
+bool DefaultCollectionOfKernels<Functor>::integrateOnGrid(
+    const GeometricalData<CoordinateType> &testGeomData,
+    const GeometricalData<CoordinateType> &trialGeomData,
+    const arma::Mat<CoordinateType> &weightedTestValues,
+    const arma::Mat<CoordinateType> &weightedTrialValues,
+    arma::Mat<ValueType> &result) const {
+  return integrateOnGridInternal(m_functor, testGeomData, trialGeomData,
+                                 weightedTestValues, weightedTrialValues,
+                                 result);
+}
+
+template <typename Functor>
+bool DefaultCollectionOfKernels<Functor>::isInvariantUnderRigidMotions() const {
+  return isInvariantUnderRigidMotionsInternal(m_functor);
 }
 
 template <typename Functor>
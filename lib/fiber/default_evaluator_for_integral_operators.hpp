@@ -79,6 +79,10 @@ public:
   virtual void evaluate(Region region, const arma::Mat<CoordinateType> &points,
                         arma::Mat<ResultType> &result) const;
 
+  virtual void evaluateWithTreecode(const arma::Mat<CoordinateType> &points,
+                                    const TreecodeOptions &options,
+                                    arma::Mat<ResultType> &result) const;
+
 private:
   void cacheTrialData();
   void calcTrialData(Region region, int kernelTrialGeomDeps,
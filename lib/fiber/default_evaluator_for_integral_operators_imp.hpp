@@ -31,6 +31,7 @@
 #include "collection_of_4d_arrays.hpp"
 #include "kernel_trial_integral.hpp"
 #include "numerical_quadrature.hpp"
+#include "chebyshev_treecode.hpp"
 #include "opencl_handler.hpp"
 #include "raw_grid_geometry.hpp"
 #include "serial_blas_region.hpp"
@@ -221,6 +222,42 @@ void DefaultEvaluatorForIntegralOperators<
   //    }
 }
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+void DefaultEvaluatorForIntegralOperators<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::evaluateWithTreecode(
+    const arma::Mat<CoordinateType> &points, const TreecodeOptions &options,
+    arma::Mat<ResultType> &result) const {
+  // The octree is only defined in three dimensions
+  if (points.n_rows != 3 || m_farFieldTrialGeomData.globals.n_rows != 3) {
+    evaluate(EvaluatorForIntegralOperators<ResultType>::FAR_FIELD, points,
+             result);
+    return;
+  }
+
+  result.set_size(m_integral->resultDimension(), points.n_cols);
+  result.fill(0.);
+
+  int maxThreadCount = 1;
+  if (!m_parallelizationOptions.isOpenClEnabled()) {
+    if (m_parallelizationOptions.maxThreadCount() ==
+        ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = m_parallelizationOptions.maxThreadCount();
+  }
+  tbb::task_scheduler_init scheduler(maxThreadCount);
+
+  ChebyshevTreecode<BasisFunctionType, KernelType, ResultType> treecode(
+      points, m_farFieldTrialGeomData, m_farFieldWeights, *m_kernels,
+      *m_integral, options);
+  {
+    Fiber::SerialBlasRegion region;
+    treecode.evaluate(m_farFieldTrialTransfValues, result);
+  }
+}
+
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 void
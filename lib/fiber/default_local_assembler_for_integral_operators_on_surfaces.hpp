@@ -117,43 +117,28 @@ private:
   typedef DefaultLocalAssemblerForOperatorsOnSurfacesUtilities<
       BasisFunctionType> Utilities;
 
-  /** \brief Alternative comparison functor for pairs.
+  /** \brief List of element index pairs.
    *
-   *  This functor can be used to sort pairs according to the second member
-   *  and then, in case of equality, according to the first member. */
-  template <typename T1, typename T2> struct alternative_less {
-    bool operator()(const std::pair<T1, T2> &a,
-                    const std::pair<T1, T2> &b) const {
-      return a.second < b.second ||
-             (!(b.second < a.second) && a.first < b.first);
-    }
-  };
-
-  /** \brief Comparison functor for element-index pairs.
-   *
-   *  This functor sorts element index pairs first after the trial element
-   *  index (second member) and then, in case of equality, after the test
-   *  element index (first member) */
-  typedef alternative_less<typename ElementIndexPair::first_type,
-                           typename ElementIndexPair::second_type>
-  ElementIndexPairCompare;
-
-  /** \brief Set of element index pairs.
-   *
-   *  The alternative sorting (first after the trial element index) is used
-   *  because profiling has shown that evaluateLocalWeakForms is called more
-   *  often in the TEST_TRIAL mode (with a single trial element index) than
-   *  in the TRIAL_TEST mode. Therefore the singular integral cache is
-   *  indexed with trial element index, and this sorting mode makes it easier
-   *  to construct such cache. */
-  typedef std::set<ElementIndexPair, ElementIndexPairCompare>
-  ElementIndexPairSet;
+   *  The pairs are sorted first after the trial element index (second
+   *  member) and then, in case of equality, after the test element index
+   *  (first member). Profiling has shown that evaluateLocalWeakForms is
+   *  called more often in the TEST_TRIAL mode (with a single trial element
+   *  index) than in the TRIAL_TEST mode. Therefore the singular integral
+   *  cache is indexed with trial element index, and this sorting mode makes
+   *  it easier to construct such cache. */
+  typedef std::vector<ElementIndexPair> ElementIndexPairVector;
 
   bool testAndTrialGridsAreIdentical() const;
 
   void cacheSingularLocalWeakForms();
-  void findPairsOfAdjacentElements(ElementIndexPairSet &pairs) const;
-  void cacheLocalWeakForms(const ElementIndexPairSet &elementIndexPairs);
+  void findPairsOfAdjacentElements(ElementIndexPairVector &pairs) const;
+  void cacheLocalWeakForms(const ElementIndexPairVector &elementIndexPairs);
+  const ResultType *findCachedLocalWeakForm(int testElementIndex,
+                                            int trialElementIndex) const;
+  bool canReuseLocalWeakFormsOfCongruentPairs() const;
+  bool pairShapeSignature(int testElementIndex, int trialElementIndex,
+                          CoordinateType quantum,
+                          std::vector<long long> &signature) const;
 
   const Integrator &selectIntegrator(int testElementIndex,
                                      int trialElementIndex,
@@ -189,21 +174,20 @@ private:
   IntegratorMap m_testKernelTrialIntegrators;
   mutable tbb::mutex m_integratorCreationMutex;
 
-  enum {
-    INVALID_INDEX = INT_MAX
-  };
-  typedef _2dArray<std::pair<int, arma::Mat<ResultType>>> Cache;
   /** \brief Singular integral cache.
    *
    *  This cache stores the preevaluated local weak forms expressed by
-   *  singular integrals. A particular item it stored in r'th row and c'th
-   *  column stores, in its second member, the local weak form calculated for
-   *  the test element with index it.first and the trial element with index
-   *  c. In each column, the items are sorted after increasing test element
-   *  index. At the end of each column there can be unused items with test
-   *  element index set to INVALID_INDEX (= INT_MAX, so that the sorting is
-   *  preserved). */
-  Cache m_cache;
+   *  singular integrals in compressed sparse column format. The local weak
+   *  forms of the test elements adjacent to the trial element with index c
+   *  occupy the positions from m_cacheColumnOffsets[c] to
+   *  m_cacheColumnOffsets[c + 1] - 1; at position p, m_cacheTestElementIndices
+   *  contains the index of the test element, sorted increasingly in each
+   *  column, and m_cacheValueOffsets the offset in m_cacheValues of the
+   *  first entry of the local weak form, stored in column-major order. */
+  std::vector<size_t> m_cacheColumnOffsets;
+  std::vector<int> m_cacheTestElementIndices;
+  std::vector<size_t> m_cacheValueOffsets;
+  std::vector<ResultType> m_cacheValues;
   /** \endcond */
 };
 
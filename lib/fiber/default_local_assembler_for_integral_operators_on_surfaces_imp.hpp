@@ -26,12 +26,19 @@
 #include "double_quadrature_rule_family.hpp"
 #include "nonseparable_numerical_test_kernel_trial_integrator.hpp"
 #include "quadrature_descriptor_selector_for_integral_operators.hpp"
+#include "raw_grid_geometry.hpp"
 #include "separable_numerical_test_kernel_trial_integrator.hpp"
 #include "serial_blas_region.hpp"
 
 #include <tbb/parallel_for.h>
 #include <tbb/task_scheduler_init.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+
 #include "../common/auto_timer.hpp"
 
 namespace Fiber {
@@ -50,7 +57,7 @@ public:
       const std::vector<ElementIndexPair> &activeElementPairs,
       const Shapeset<BasisFunctionType> &activeTestShapeset,
       const Shapeset<BasisFunctionType> &activeTrialShapeset,
-      const std::vector<arma::Mat<ResultType> *> &localResult)
+      const std::vector<ResultType *> &localResult)
       : m_activeIntegrator(activeIntegrator),
         m_activeElementPairs(activeElementPairs),
         m_activeTestBasis(activeTestShapeset),
@@ -60,11 +67,18 @@ public:
     // copy the relevant subset of m_activeElementPairs into
     // localActiveElementPairs
     std::vector<ElementIndexPair> localActiveElementPairs(
-        &m_activeElementPairs[r.begin()], &m_activeElementPairs[r.end()]);
-    std::vector<arma::Mat<ResultType> *> localLocalResult(
-        &m_localResult[r.begin()], &m_localResult[r.end()]);
+        m_activeElementPairs.begin() + r.begin(),
+        m_activeElementPairs.begin() + r.end());
+    std::vector<arma::Mat<ResultType>> localLocalResult(r.size());
+    std::vector<arma::Mat<ResultType> *> localLocalResultPtrs(r.size());
+    for (size_t i = 0; i < r.size(); ++i)
+      localLocalResultPtrs[i] = &localLocalResult[i];
     m_activeIntegrator.integrate(localActiveElementPairs, m_activeTestBasis,
-                                 m_activeTrialBasis, localLocalResult);
+                                 m_activeTrialBasis, localLocalResultPtrs);
+    // move the results to their final location in the cache
+    for (size_t i = 0; i < r.size(); ++i)
+      std::copy(localLocalResult[i].begin(), localLocalResult[i].end(),
+                m_localResult[r.begin() + i]);
   }
 
 private:
@@ -72,7 +86,7 @@ private:
   const std::vector<ElementIndexPair> &m_activeElementPairs;
   const Shapeset<BasisFunctionType> &m_activeTestBasis;
   const Shapeset<BasisFunctionType> &m_activeTrialBasis;
-  const std::vector<arma::Mat<ResultType> *> &m_localResult;
+  const std::vector<ResultType *> &m_localResult;
 };
 
 } // namespace
@@ -179,34 +193,27 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
   std::vector<QuadVariant> quadVariants(elementACount);
   for (int i = 0; i < elementACount; ++i) {
     // Try to find matrix in cache
-    const arma::Mat<ResultType> *cachedLocalWeakForm = 0;
-    if (callVariant == TEST_TRIAL) {
-      const int testElementIndex = elementIndicesA[i];
-      const int trialElementIndex = elementIndexB;
-      for (size_t n = 0; n < m_cache.extent(0); ++n)
-        if (m_cache(n, trialElementIndex).first == testElementIndex) {
-          cachedLocalWeakForm = &m_cache(n, trialElementIndex).second;
-          break;
-        }
-    } else {
-      const int testElementIndex = elementIndexB;
-      const int trialElementIndex = elementIndicesA[i];
-      for (size_t n = 0; n < m_cache.extent(0); ++n)
-        if (m_cache(n, trialElementIndex).first == testElementIndex) {
-          cachedLocalWeakForm = &m_cache(n, trialElementIndex).second;
-          break;
-        }
-    }
-
-    if (cachedLocalWeakForm) { // Matrix found in cache
+    const int testElementIndex =
+        callVariant == TEST_TRIAL ? elementIndicesA[i] : elementIndexB;
+    const int trialElementIndex =
+        callVariant == TEST_TRIAL ? elementIndexB : elementIndicesA[i];
+    const ResultType *cachedValues =
+        findCachedLocalWeakForm(testElementIndex, trialElementIndex);
+
+    if (cachedValues) { // Matrix found in cache
       quadVariants[i] = CACHED;
+      const arma::Mat<ResultType> cachedLocalWeakForm(
+          const_cast<ResultType *>(cachedValues),
+          (*m_testShapesets)[testElementIndex]->size(),
+          (*m_trialShapesets)[trialElementIndex]->size(), false /* copy */,
+          true /* strict */);
       if (localDofIndexB == ALL_DOFS)
-        result[i] = *cachedLocalWeakForm;
+        result[i] = cachedLocalWeakForm;
       else {
         if (callVariant == TEST_TRIAL)
-          result[i] = cachedLocalWeakForm->col(localDofIndexB);
+          result[i] = cachedLocalWeakForm.col(localDofIndexB);
         else
-          result[i] = cachedLocalWeakForm->row(localDofIndexB);
+          result[i] = cachedLocalWeakForm.row(localDofIndexB);
       }
     } else {
       const Integrator *integrator =
@@ -291,17 +298,14 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
       const int activeTestElementIndex = testElementIndices[testIndex];
       const int activeTrialElementIndex = trialElementIndices[trialIndex];
       // Try to find matrix in cache
-      const arma::Mat<ResultType> *cachedLocalWeakForm = 0;
-      for (size_t n = 0; n < m_cache.extent(0); ++n)
-        if (m_cache(n, activeTrialElementIndex).first ==
-            activeTestElementIndex) {
-          cachedLocalWeakForm = &m_cache(n, activeTrialElementIndex).second;
-          break;
-        }
+      const ResultType *cachedValues = findCachedLocalWeakForm(
+          activeTestElementIndex, activeTrialElementIndex);
 
-      if (cachedLocalWeakForm) { // Matrix found in cache
+      if (cachedValues) { // Matrix found in cache
         quadVariants(testIndex, trialIndex) = CACHED;
-        result(testIndex, trialIndex) = *cachedLocalWeakForm;
+        result(testIndex, trialIndex) = arma::Mat<ResultType>(
+            cachedValues, (*m_testShapesets)[activeTestElementIndex]->size(),
+            (*m_trialShapesets)[activeTrialElementIndex]->size());
       } else {
         const Integrator *integrator =
             &selectIntegrator(activeTestElementIndex, activeTrialElementIndex,
@@ -376,18 +380,29 @@ template <typename BasisFunctionType, typename KernelType, typename ResultType,
 void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
     BasisFunctionType, KernelType, ResultType,
     GeometryFactory>::cacheSingularLocalWeakForms() {
-  ElementIndexPairSet elementIndexPairs;
+  int maxThreadCount = 1;
+  if (!m_parallelizationOptions.isOpenClEnabled()) {
+    if (m_parallelizationOptions.maxThreadCount() ==
+        ParallelizationOptions::AUTO)
+      maxThreadCount = tbb::task_scheduler_init::automatic;
+    else
+      maxThreadCount = m_parallelizationOptions.maxThreadCount();
+  }
+  tbb::task_scheduler_init scheduler(maxThreadCount);
+
+  ElementIndexPairVector elementIndexPairs;
   findPairsOfAdjacentElements(elementIndexPairs);
   cacheLocalWeakForms(elementIndexPairs);
 }
 
 /** \brief Fill \p pairs with the list of pairs of indices of elements
-        sharing at least one vertex. */
+        sharing at least one vertex, sorted after the trial element index
+        first. */
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
     BasisFunctionType, KernelType, ResultType,
-    GeometryFactory>::findPairsOfAdjacentElements(ElementIndexPairSet &pairs)
+    GeometryFactory>::findPairsOfAdjacentElements(ElementIndexPairVector &pairs)
     const {
   pairs.clear();
 
@@ -404,34 +419,78 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
   const int elementCount = elementCornerIndices.n_cols;
   const int maxCornerCount = elementCornerIndices.n_rows;
 
-  typedef std::vector<int> ElementIndexVector;
-  // ith entry: set of elements sharing vertex number i
-  std::vector<ElementIndexVector> elementsAdjacentToVertex(vertexCount);
-
+  // Elements sharing vertex number v, in compressed sparse row format:
+  // vertexElements[vertexOffsets[v]] to vertexElements[vertexOffsets[v + 1] -
+  // 1], sorted increasingly
+  std::vector<size_t> vertexOffsets(vertexCount + 1, 0);
   for (int e = 0; e < elementCount; ++e)
     for (int v = 0; v < maxCornerCount; ++v) {
       const int index = elementCornerIndices(v, e);
       if (index >= 0)
-        elementsAdjacentToVertex[index].push_back(e);
+        ++vertexOffsets[index + 1];
     }
-
-  // Loop over vertex indices
-  for (int v = 0; v < vertexCount; ++v) {
-    const ElementIndexVector &adjacentElements = elementsAdjacentToVertex[v];
-    // Add to pairs each pair of elements adjacent to vertex v
-    const int adjacentElementCount = adjacentElements.size();
-    for (int e1 = 0; e1 < adjacentElementCount; ++e1)
-      for (int e2 = 0; e2 < adjacentElementCount; ++e2)
-        pairs.insert(
-            ElementIndexPair(adjacentElements[e1], adjacentElements[e2]));
+  std::partial_sum(vertexOffsets.begin(), vertexOffsets.end(),
+                   vertexOffsets.begin());
+  std::vector<int> vertexElements(vertexOffsets.back());
+  {
+    std::vector<size_t> positions(vertexOffsets.begin(),
+                                  vertexOffsets.end() - 1);
+    for (int e = 0; e < elementCount; ++e)
+      for (int v = 0; v < maxCornerCount; ++v) {
+        const int index = elementCornerIndices(v, e);
+        if (index >= 0)
+          vertexElements[positions[index]++] = e;
+      }
   }
+
+  // Sorted list of elements sharing at least one vertex with element e
+  auto findAdjacentElements = [&](int e, std::vector<int> &adjacentElements) {
+    adjacentElements.clear();
+    for (int v = 0; v < maxCornerCount; ++v) {
+      const int index = elementCornerIndices(v, e);
+      if (index >= 0)
+        adjacentElements.insert(adjacentElements.end(),
+                                vertexElements.begin() + vertexOffsets[index],
+                                vertexElements.begin() +
+                                    vertexOffsets[index + 1]);
+    }
+    std::sort(adjacentElements.begin(), adjacentElements.end());
+    adjacentElements.erase(
+        std::unique(adjacentElements.begin(), adjacentElements.end()),
+        adjacentElements.end());
+  };
+
+  // Count the pairs with each (trial) element, then write them directly to
+  // their final positions
+  std::vector<size_t> pairOffsets(elementCount + 1, 0);
+  tbb::parallel_for(tbb::blocked_range<int>(0, elementCount),
+                    [&](const tbb::blocked_range<int> &r) {
+    std::vector<int> adjacentElements;
+    for (int e = r.begin(); e != r.end(); ++e) {
+      findAdjacentElements(e, adjacentElements);
+      pairOffsets[e + 1] = adjacentElements.size();
+    }
+  });
+  std::partial_sum(pairOffsets.begin(), pairOffsets.end(),
+                   pairOffsets.begin());
+
+  pairs.resize(pairOffsets.back());
+  tbb::parallel_for(tbb::blocked_range<int>(0, elementCount),
+                    [&](const tbb::blocked_range<int> &r) {
+    std::vector<int> adjacentElements;
+    for (int e = r.begin(); e != r.end(); ++e) {
+      findAdjacentElements(e, adjacentElements);
+      for (size_t n = 0; n < adjacentElements.size(); ++n)
+        pairs[pairOffsets[e] + n] = ElementIndexPair(adjacentElements[n], e);
+    }
+  });
 }
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
     BasisFunctionType, KernelType, ResultType,
-    GeometryFactory>::cacheLocalWeakForms(const ElementIndexPairSet &
+    GeometryFactory>::cacheLocalWeakForms(const ElementIndexPairVector &
                                               elementIndexPairs) {
   tbb::tick_count start = tbb::tick_count::now();
 
@@ -441,51 +500,77 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
   if (m_verbosityLevel >= VerbosityLevel::DEFAULT)
     std::cout << "Precalculating singular integrals..." << std::endl;
 
-  // Get the maximum number of neighbours a trial element can have.
-  // This will be used to allocate a cache of correct size.
-  // This loops assumes that elementIndexPairs are sorted after the trial
-  // element index first.
-  size_t maxNeighbourCount = 0;
-  for (typename ElementIndexPairSet::const_iterator it =
-           elementIndexPairs.begin();
-       it != elementIndexPairs.end(); /* nothing */) {
-    int curTrialElementIndex = it->second;
-    size_t neighbourCount = 1;
-    for (++it;
-         it != elementIndexPairs.end() && it->second == curTrialElementIndex;
-         ++it) {
-      ++neighbourCount;
-    }
-    maxNeighbourCount = std::max(maxNeighbourCount, neighbourCount);
+  // Build the index of the cache and allocate storage for all local weak
+  // forms at once. This assumes that elementIndexPairs are sorted after the
+  // trial element index first.
+  const int elementPairCount = elementIndexPairs.size();
+  const size_t trialElementCount = m_trialRawGeometry->elementCount();
+  m_cacheColumnOffsets.assign(trialElementCount + 1, 0);
+  m_cacheTestElementIndices.resize(elementPairCount);
+  m_cacheValueOffsets.resize(elementPairCount);
+  size_t valueCount = 0;
+  for (int pairIndex = 0; pairIndex < elementPairCount; ++pairIndex) {
+    const int testElementIndex = elementIndexPairs[pairIndex].first;
+    const int trialElementIndex = elementIndexPairs[pairIndex].second;
+    ++m_cacheColumnOffsets[trialElementIndex + 1];
+    m_cacheTestElementIndices[pairIndex] = testElementIndex;
+    m_cacheValueOffsets[pairIndex] = valueCount;
+    valueCount += (*m_testShapesets)[testElementIndex]->size() *
+                  (*m_trialShapesets)[trialElementIndex]->size();
   }
+  std::partial_sum(m_cacheColumnOffsets.begin(), m_cacheColumnOffsets.end(),
+                   m_cacheColumnOffsets.begin());
+  m_cacheValues.resize(valueCount);
 
-  // Allocate cache and initialize all test element indices to INVALID_INDEX
-  size_t trialElementCount = m_trialRawGeometry->elementCount();
-  m_cache.set_size(maxNeighbourCount, trialElementCount);
-  for (size_t trialIndex = 0; trialIndex < trialElementCount; ++trialIndex)
-    for (size_t nborIndex = 0; nborIndex < maxNeighbourCount; ++nborIndex)
-      m_cache(nborIndex, trialIndex).first = INVALID_INDEX;
-
-  // Find cached matrices; select integrators to calculate non-cached ones
+  // Select integrators
   typedef Fiber::Shapeset<BasisFunctionType> Shapeset;
   typedef boost::tuples::tuple<const Integrator *, const Shapeset *,
                                const Shapeset *> QuadVariant;
-  const int elementPairCount = elementIndexPairs.size();
   std::vector<QuadVariant> quadVariants(elementPairCount);
-
-  typedef typename ElementIndexPairSet::const_iterator ElementIndexPairIterator;
-  typedef typename std::vector<QuadVariant>::iterator QuadVariantIterator;
-  {
-    ElementIndexPairIterator pairIt = elementIndexPairs.begin();
-    QuadVariantIterator qvIt = quadVariants.begin();
-    for (; pairIt != elementIndexPairs.end(); ++pairIt, ++qvIt) {
-      const int testElementIndex = pairIt->first;
-      const int trialElementIndex = pairIt->second;
+  tbb::parallel_for(tbb::blocked_range<int>(0, elementPairCount),
+                    [&](const tbb::blocked_range<int> &r) {
+    for (int pairIndex = r.begin(); pairIndex != r.end(); ++pairIndex) {
+      const int testElementIndex = elementIndexPairs[pairIndex].first;
+      const int trialElementIndex = elementIndexPairs[pairIndex].second;
       const Integrator *integrator =
           &selectIntegrator(testElementIndex, trialElementIndex);
-      *qvIt = QuadVariant(integrator, (*m_testShapesets)[testElementIndex],
-                          (*m_trialShapesets)[trialElementIndex]);
+      quadVariants[pairIndex] =
+          QuadVariant(integrator, (*m_testShapesets)[testElementIndex],
+                      (*m_trialShapesets)[trialElementIndex]);
     }
+  });
+
+  // If the kernels are invariant under rigid motions, the local weak forms of
+  // congruent pairs of elements integrated with the same quadrature variant
+  // are identical. In that case only one pair of each such group, its
+  // representative, is integrated.
+  std::vector<int> representatives(elementPairCount);
+  for (int pairIndex = 0; pairIndex < elementPairCount; ++pairIndex)
+    representatives[pairIndex] = pairIndex;
+  if (canReuseLocalWeakFormsOfCongruentPairs()) {
+    const arma::Mat<CoordinateType> &vertices = m_testRawGeometry->vertices();
+    const CoordinateType extent = arma::norm(
+        arma::max(vertices, 1) - arma::min(vertices, 1), 2);
+    const CoordinateType quantum =
+        100 * std::numeric_limits<CoordinateType>::epsilon() * extent;
+
+    typedef std::pair<QuadVariant, std::vector<long long>> Congruence;
+    typedef std::map<Congruence, int> CongruenceMap;
+    CongruenceMap representativePairs;
+    Congruence congruence;
+    for (int pairIndex = 0; pairIndex < elementPairCount; ++pairIndex) {
+      congruence.first = quadVariants[pairIndex];
+      if (pairShapeSignature(elementIndexPairs[pairIndex].first,
+                             elementIndexPairs[pairIndex].second, quantum,
+                             congruence.second))
+        representatives[pairIndex] =
+            representativePairs.insert(std::make_pair(congruence, pairIndex))
+                .first->second;
+    }
+    if (m_verbosityLevel >= VerbosityLevel::HIGH)
+      std::cout << "Found " << representativePairs.size()
+                << " noncongruent pairs of elements among " << elementPairCount
+                << " pairs of adjacent elements" << std::endl;
   }
 
   // Integration will proceed in batches of element pairs having the same
@@ -497,21 +582,9 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
   QuadVariantSet uniqueQuadVariants(quadVariants.begin(), quadVariants.end());
 
   std::vector<ElementIndexPair> activeElementPairs;
-  std::vector<arma::Mat<ResultType> *> activeLocalResults;
+  std::vector<ResultType *> activeLocalResults;
   activeElementPairs.reserve(elementPairCount);
   activeLocalResults.reserve(elementPairCount);
-  // m_cache.rehash(int(elementIndexPairs.size() / m_cache.max_load_factor() +
-  // 1));
-
-  int maxThreadCount = 1;
-  if (!m_parallelizationOptions.isOpenClEnabled()) {
-    if (m_parallelizationOptions.maxThreadCount() ==
-        ParallelizationOptions::AUTO)
-      maxThreadCount = tbb::task_scheduler_init::automatic;
-    else
-      maxThreadCount = m_parallelizationOptions.maxThreadCount();
-  }
-  tbb::task_scheduler_init scheduler(maxThreadCount);
 
   // Now loop over unique quadrature variants
   for (typename QuadVariantSet::const_iterator it = uniqueQuadVariants.begin();
@@ -525,27 +598,13 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
     // according to the current quadrature variant
     activeElementPairs.clear();
     activeLocalResults.clear();
-    {
-      ElementIndexPairIterator pairIt = elementIndexPairs.begin();
-      QuadVariantIterator qvIt = quadVariants.begin();
-      size_t neighbourIndex = 0;                    // Cache row index
-      size_t curTrialElementIndex = pairIt->second; // Cache column index
-      for (; pairIt != elementIndexPairs.end(); ++pairIt, ++qvIt) {
-        if (pairIt->second != curTrialElementIndex) {
-          // Go to the next column of cache
-          curTrialElementIndex = pairIt->second;
-          neighbourIndex = 0;
-        }
-        if (*qvIt == activeQuadVariant) {
-          activeElementPairs.push_back(*pairIt);
-          m_cache(neighbourIndex, curTrialElementIndex).first = pairIt->first;
-          activeLocalResults.push_back(
-              &m_cache(neighbourIndex, curTrialElementIndex).second);
-        }
-        // Increment cache row index
-        ++neighbourIndex;
+    for (int pairIndex = 0; pairIndex < elementPairCount; ++pairIndex)
+      if (quadVariants[pairIndex] == activeQuadVariant &&
+          representatives[pairIndex] == pairIndex) {
+        activeElementPairs.push_back(elementIndexPairs[pairIndex]);
+        activeLocalResults.push_back(
+            &m_cacheValues[m_cacheValueOffsets[pairIndex]]);
       }
-    }
 
     // Integrate!
     // Old serial version
@@ -562,12 +621,121 @@ void DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
                activeTrialShapeset, activeLocalResults));
     }
   }
+
+  // Copy the local weak forms of the representatives to the congruent pairs
+  for (int pairIndex = 0; pairIndex < elementPairCount; ++pairIndex)
+    if (representatives[pairIndex] != pairIndex) {
+      const size_t representativeOffset =
+          m_cacheValueOffsets[representatives[pairIndex]];
+      const size_t size =
+          (*m_testShapesets)[elementIndexPairs[pairIndex].first]->size() *
+          (*m_trialShapesets)[elementIndexPairs[pairIndex].second]->size();
+      std::copy(m_cacheValues.begin() + representativeOffset,
+                m_cacheValues.begin() + representativeOffset + size,
+                m_cacheValues.begin() + m_cacheValueOffsets[pairIndex]);
+    }
+
   tbb::tick_count end = tbb::tick_count::now();
   if (m_verbosityLevel >= VerbosityLevel::DEFAULT)
     std::cout << "Precalculation of singular integrals took "
               << (end - start).seconds() << " s" << std::endl;
 }
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+inline const ResultType *DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::findCachedLocalWeakForm(int testElementIndex,
+                                              int trialElementIndex) const {
+  if (m_cacheColumnOffsets.empty())
+    return 0;
+  const std::vector<int>::const_iterator begin =
+      m_cacheTestElementIndices.begin() +
+      m_cacheColumnOffsets[trialElementIndex];
+  const std::vector<int>::const_iterator end =
+      m_cacheTestElementIndices.begin() +
+      m_cacheColumnOffsets[trialElementIndex + 1];
+  const std::vector<int>::const_iterator it =
+      std::lower_bound(begin, end, testElementIndex);
+  if (it == end || *it != testElementIndex)
+    return 0;
+  return &m_cacheValues
+      [m_cacheValueOffsets[it - m_cacheTestElementIndices.begin()]];
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+bool DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::canReuseLocalWeakFormsOfCongruentPairs() const {
+  // The shape signature assumes flat elements in 3D fully determined by
+  // their corners
+  const RawGridGeometry<CoordinateType> &rawGeometry = *m_testRawGeometry;
+  return m_kernels->isInvariantUnderRigidMotions() &&
+         testAndTrialGridsAreIdentical() && rawGeometry.gridDimension() == 2 &&
+         rawGeometry.worldDimension() == 3 &&
+         rawGeometry.auxData().n_rows == 0;
+}
+
+/** \brief Compute a signature of the shape of a pair of elements.
+ *
+ *  The coordinates of the corners of both elements are expressed in a
+ *  right-handed frame attached to the test element (origin at its first
+ *  corner, first axis along its first edge, third axis along its normal) and
+ *  rounded to multiples of \p quantum. They encode the edge lengths and angles
+ *  of both elements and their relative position. Pairs with equal signatures
+ *  are therefore congruent up to a translation and a proper rotation, with
+ *  corresponding corners having the same local indices.
+ *
+ *  Returns false if the test element is degenerate. */
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+bool DefaultLocalAssemblerForIntegralOperatorsOnSurfaces<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::pairShapeSignature(int testElementIndex,
+                                         int trialElementIndex,
+                                         CoordinateType quantum,
+                                         std::vector<long long> &signature)
+    const {
+  typedef typename arma::Col<CoordinateType>::template fixed<3> Vector;
+
+  const RawGridGeometry<CoordinateType> &rawGeometry = *m_testRawGeometry;
+  const arma::Mat<CoordinateType> &vertices = rawGeometry.vertices();
+  const arma::Mat<int> &cornerIndices = rawGeometry.elementCornerIndices();
+
+  const Vector origin = vertices.col(cornerIndices(0, testElementIndex));
+  Vector axis0 = vertices.col(cornerIndices(1, testElementIndex)) - origin;
+  const Vector edge1 =
+      vertices.col(cornerIndices(2, testElementIndex)) - origin;
+  Vector axis2 = arma::cross(axis0, edge1);
+  const CoordinateType length0 = arma::norm(axis0, 2);
+  const CoordinateType length2 = arma::norm(axis2, 2);
+  if (length0 == 0 || length2 == 0)
+    return false;
+  axis0 /= length0;
+  axis2 /= length2;
+  const Vector axis1 = arma::cross(axis2, axis0);
+
+  const int elementIndices[2] = {testElementIndex, trialElementIndex};
+  signature.clear();
+  for (int i = 0; i < 2; ++i) {
+    const int cornerCount = rawGeometry.elementCornerCount(elementIndices[i]);
+    signature.push_back(cornerCount);
+    for (int corner = 0; corner < cornerCount; ++corner) {
+      const Vector diff =
+          vertices.col(cornerIndices(corner, elementIndices[i])) - origin;
+      signature.push_back(std::floor(arma::dot(diff, axis0) / quantum + 0.5));
+      signature.push_back(std::floor(arma::dot(diff, axis1) / quantum + 0.5));
+      signature.push_back(std::floor(arma::dot(diff, axis2) / quantum + 0.5));
+    }
+  }
+  if (!rawGeometry.domainIndices().empty()) {
+    signature.push_back(rawGeometry.domainIndex(testElementIndex));
+    signature.push_back(rawGeometry.domainIndex(trialElementIndex));
+  }
+  return true;
+}
+
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 const TestKernelTrialIntegrator<BasisFunctionType, KernelType, ResultType> &
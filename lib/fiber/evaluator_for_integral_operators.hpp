@@ -22,6 +22,7 @@
 #define fiber_evaluator_for_integral_operators_hpp
 
 #include "../common/armadillo_fwd.hpp"
+#include "treecode_options.hpp"
 #include "scalar_traits.hpp"
 
 #include "../common/common.hpp"
@@ -41,6 +42,16 @@ public:
 
   virtual void evaluate(Region region, const arma::Mat<CoordinateType> &points,
                         arma::Mat<ResultType> &result) const = 0;
+
+  /** \brief Evaluate the potential at \p points in the treecode mode, i.e.
+   *  with ChebyshevTreecode.
+   *
+   *  The default implementation calls evaluate() with region FAR_FIELD. */
+  virtual void evaluateWithTreecode(const arma::Mat<CoordinateType> &points,
+                                    const TreecodeOptions &options,
+                                    arma::Mat<ResultType> &result) const {
+    evaluate(FAR_FIELD, points, result);
+  }
 };
 
 } // namespace Fiber
@@ -139,6 +139,22 @@ private:
   int m_point;
 };
 
+/** \brief Geometrical data of a block of points in structure-of-arrays
+ *  layout.
+ *
+ *  This structure is passed to kernel functors providing a batched
+ *  evaluation interface (see DefaultCollectionOfKernels). Component \p dim
+ *  of the global coordinates of point \p p is <tt>globals[dim][p]</tt>, and
+ *  likewise for the normals. The values of each component are stored
+ *  contiguously, so that loops over points can be vectorized. Pointers to
+ *  data that were not requested by the functor are null.
+ */
+template <typename CoordinateType> struct BatchedGeometricalData {
+  size_t pointCount;
+  const CoordinateType *globals[3];
+  const CoordinateType *normals[3];
+};
+
 } // namespace Fiber
 
 #endif
@@ -0,0 +1,248 @@
+// Copyright (C) 2011-2012 by the Bem++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_geometrical_data_store_hpp
+#define fiber_geometrical_data_store_hpp
+
+#include "../common/common.hpp"
+
+#include "geometrical_data.hpp"
+#include "raw_grid_geometry.hpp"
+#include "shared_ptr.hpp"
+#include "../common/armadillo_fwd.hpp"
+
+#include <algorithm>
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <memory>
+#include <new>
+#include <tbb/mutex.h>
+#include <utility>
+#include <vector>
+
+namespace Fiber {
+
+/** \brief Geometrical data of all elements of a grid at a fixed set of local
+ *  points.
+ *
+ *  Each type of geometrical data (global coordinates, integration elements,
+ *  Jacobians, normals) is stored in a single contiguous array, in which the
+ *  blocks belonging to consecutive elements follow each other. The
+ *  GeometricalData objects returned by elementData() refer to these arrays
+ *  without owning them.
+ *
+ *  Stores should be obtained from get(), which shares them between all
+ *  integrators working on the same RawGridGeometry object with the same local
+ *  points. In particular, the operators making up a Calderon projector
+ *  evaluate the geometry of each element only once per quadrature rule. */
+template <typename CoordinateType> class GeometricalDataStore {
+public:
+  /** \brief Constructor.
+   *
+   *  Evaluate the geometrical data of types \p geomDeps (a combination of
+   *  the flags defined in GeometricalDataType) at the points \p localPoints
+   *  of each element of \p rawGeometry. */
+  template <typename GeometryFactory>
+  GeometricalDataStore(const GeometryFactory &geometryFactory,
+                       const RawGridGeometry<CoordinateType> &rawGeometry,
+                       const arma::Mat<CoordinateType> &localPoints,
+                       size_t geomDeps);
+
+  /** \brief Return a store containing at least the geometrical data of types
+   *  \p geomDeps at the points \p localPoints of each element of
+   *  \p rawGeometry.
+   *
+   *  An existing store is returned if one is still in use; otherwise a new
+   *  one is created. New stores always contain the global coordinates,
+   *  integration elements and (on grids of codimension 1) normals, so that
+   *  they can be shared by operators with different kernels. This function
+   *  is thread-safe. */
+  template <typename GeometryFactory>
+  static shared_ptr<const GeometricalDataStore>
+  get(const GeometryFactory &geometryFactory,
+      const RawGridGeometry<CoordinateType> &rawGeometry,
+      const arma::Mat<CoordinateType> &localPoints, size_t geomDeps);
+
+  /** \brief Types of geometrical data contained in the store. */
+  size_t geometricalDependencies() const { return m_geomDeps; }
+
+  /** \brief Number of elements. */
+  int elementCount() const { return m_elementData.size(); }
+
+  /** \brief Geometrical data of the element \p elementIndex. */
+  const GeometricalData<CoordinateType> &elementData(int elementIndex) const {
+    return m_elementData[elementIndex];
+  }
+
+private:
+  GeometricalDataStore(const GeometricalDataStore &);
+  GeometricalDataStore &operator=(const GeometricalDataStore &);
+
+  template <typename Array>
+  static void storeBlock(const Array &block, int elementIndex,
+                         int elementCount, std::vector<CoordinateType> &array);
+  template <typename Array, typename... Args>
+  static void makeView(Array &view, Args... args);
+
+  size_t m_geomDeps;
+  std::vector<CoordinateType> m_globals;
+  std::vector<CoordinateType> m_integrationElements;
+  std::vector<CoordinateType> m_jacobiansTransposed;
+  std::vector<CoordinateType> m_jacobianInversesTransposed;
+  std::vector<CoordinateType> m_normals;
+  std::vector<GeometricalData<CoordinateType>> m_elementData;
+};
+
+template <typename CoordinateType>
+template <typename GeometryFactory>
+GeometricalDataStore<CoordinateType>::GeometricalDataStore(
+    const GeometryFactory &geometryFactory,
+    const RawGridGeometry<CoordinateType> &rawGeometry,
+    const arma::Mat<CoordinateType> &localPoints, size_t geomDeps)
+    : m_geomDeps(geomDeps) {
+  const int elementCount = rawGeometry.elementCount();
+  m_elementData.resize(elementCount);
+  if (elementCount == 0)
+    return;
+
+  typedef typename GeometryFactory::Geometry Geometry;
+  std::unique_ptr<Geometry> geometry = geometryFactory.make();
+  GeometricalData<CoordinateType> data;
+  for (int e = 0; e < elementCount; ++e) {
+    rawGeometry.setupGeometry(e, *geometry);
+    geometry->getData(geomDeps, localPoints, data);
+    if (geomDeps & GLOBALS)
+      storeBlock(data.globals, e, elementCount, m_globals);
+    if (geomDeps & INTEGRATION_ELEMENTS)
+      storeBlock(data.integrationElements, e, elementCount,
+                 m_integrationElements);
+    if (geomDeps & JACOBIANS_TRANSPOSED)
+      storeBlock(data.jacobiansTransposed, e, elementCount,
+                 m_jacobiansTransposed);
+    if (geomDeps & JACOBIAN_INVERSES_TRANSPOSED)
+      storeBlock(data.jacobianInversesTransposed, e, elementCount,
+                 m_jacobianInversesTransposed);
+    if (geomDeps & NORMALS)
+      storeBlock(data.normals, e, elementCount, m_normals);
+    if (geomDeps & DOMAIN_INDEX)
+      m_elementData[e].domainIndex = rawGeometry.domainIndex(e);
+  }
+
+  // All elements share the shapes of the arrays obtained for the last one.
+  // The arrays are not resized any more, so the views remain valid.
+  for (int e = 0; e < elementCount; ++e) {
+    GeometricalData<CoordinateType> &view = m_elementData[e];
+    if (!m_globals.empty())
+      makeView(view.globals,
+               &m_globals[e * data.globals.n_elem], data.globals.n_rows,
+               data.globals.n_cols, false /* copy_aux_mem */,
+               true /* strict */);
+    if (!m_integrationElements.empty())
+      makeView(view.integrationElements,
+               &m_integrationElements[e * data.integrationElements.n_elem],
+               data.integrationElements.n_elem, false /* copy_aux_mem */,
+               true /* strict */);
+    if (!m_jacobiansTransposed.empty()) {
+      const _3dArray<CoordinateType> &jt = data.jacobiansTransposed;
+      makeView(view.jacobiansTransposed, jt.extent(0), jt.extent(1),
+               jt.extent(2),
+               &m_jacobiansTransposed[e * (jt.end() - jt.begin())],
+               true /* strict */);
+    }
+    if (!m_jacobianInversesTransposed.empty()) {
+      const _3dArray<CoordinateType> &jit = data.jacobianInversesTransposed;
+      makeView(view.jacobianInversesTransposed, jit.extent(0), jit.extent(1),
+               jit.extent(2),
+               &m_jacobianInversesTransposed[e * (jit.end() - jit.begin())],
+               true /* strict */);
+    }
+    if (!m_normals.empty())
+      makeView(view.normals, &m_normals[e * data.normals.n_elem],
+               data.normals.n_rows, data.normals.n_cols,
+               false /* copy_aux_mem */, true /* strict */);
+  }
+}
+
+template <typename CoordinateType>
+template <typename GeometryFactory>
+shared_ptr<const GeometricalDataStore<CoordinateType>>
+GeometricalDataStore<CoordinateType>::get(
+    const GeometryFactory &geometryFactory,
+    const RawGridGeometry<CoordinateType> &rawGeometry,
+    const arma::Mat<CoordinateType> &localPoints, size_t geomDeps) {
+  // The integrators holding a store refer to its raw geometry, so the address
+  // of the latter cannot be reused while the store is in use.
+  typedef std::pair<const RawGridGeometry<CoordinateType> *,
+                    std::vector<CoordinateType>> Key;
+  typedef std::multimap<Key, boost::weak_ptr<const GeometricalDataStore>>
+  Registry;
+
+  static Registry registry;
+  static tbb::mutex mutex;
+
+  const Key key(&rawGeometry, std::vector<CoordinateType>(localPoints.begin(),
+                                                          localPoints.end()));
+  tbb::mutex::scoped_lock lock(mutex);
+  typedef typename Registry::iterator Iterator;
+  for (Iterator it = registry.begin(); it != registry.end();) {
+    shared_ptr<const GeometricalDataStore> store = it->second.lock();
+    if (!store) // forget the stores that are no longer used
+      registry.erase(it++);
+    else if (it->first == key &&
+             (store->geometricalDependencies() & geomDeps) == geomDeps)
+      return store;
+    else
+      ++it;
+  }
+
+  size_t storedDeps = geomDeps | GLOBALS | INTEGRATION_ELEMENTS;
+  if (rawGeometry.worldDimension() == rawGeometry.gridDimension() + 1)
+    storedDeps |= NORMALS;
+  shared_ptr<const GeometricalDataStore> store(new GeometricalDataStore(
+      geometryFactory, rawGeometry, localPoints, storedDeps));
+  registry.insert(std::make_pair(key, store));
+  return store;
+}
+
+template <typename CoordinateType>
+template <typename Array>
+void GeometricalDataStore<CoordinateType>::storeBlock(
+    const Array &block, int elementIndex, int elementCount,
+    std::vector<CoordinateType> &array) {
+  const size_t blockSize = block.end() - block.begin();
+  if (array.empty())
+    array.resize(blockSize * elementCount);
+  std::copy(block.begin(), block.end(),
+            array.begin() + blockSize * elementIndex);
+}
+
+template <typename CoordinateType>
+template <typename Array, typename... Args>
+void GeometricalDataStore<CoordinateType>::makeView(Array &view,
+                                                    Args... args) {
+  // Neither Armadillo matrices nor _3dArrays can be redirected to external
+  // memory after construction, so the empty array is reconstructed in place
+  view.~Array();
+  new (&view) Array(args...);
+}
+
+} // namespace Fiber
+
+#endif
@@ -4,20 +4,28 @@
 #include "../common/common.hpp"
 #include "scalar_traits.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <vector>
 
 namespace Fiber {
 
+/** \brief Cubic Hermite interpolation of a function tabulated at
+ *  equidistant points.
+ *
+ *  The polynomial coefficients of each interval are precomputed and stored
+ *  contiguously, so that evaluating the interpolant requires a single
+ *  memory access to a block of four values. */
 template <typename ValueType> class HermiteInterpolator {
 public:
   typedef typename ScalarTraits<ValueType>::RealType CoordinateType;
 
-  HermiteInterpolator() : m_start(0.), m_end(0.), m_n(0), m_interval(0.) {}
+  HermiteInterpolator()
+      : m_start(0.), m_end(0.), m_n(0), m_interval(0.), m_inverseInterval(0.) {}
 
-  CoordinateType rangeStart() { return m_start; }
-  CoordinateType rangeEnd() { return m_end; }
+  CoordinateType rangeStart() const { return m_start; }
+  CoordinateType rangeEnd() const { return m_end; }
 
   void initialize(CoordinateType start, CoordinateType end,
                   const std::vector<ValueType> &values,
@@ -36,28 +44,53 @@ public:
     m_end = end;
     m_n = values.size();
     m_interval = (end - start) / (m_n - 1);
-    m_values = values;
-    m_derivatives = derivatives;
+    m_inverseInterval = 1. / m_interval;
+
+    // Adapted from the chfev routine from SLATEC
+    m_coefficients.resize(4 * (m_n - 1));
+    for (int n = 0; n < m_n - 1; ++n) {
+      const ValueType f_1 = values[n];
+      const ValueType f_2 = values[n + 1];
+      const ValueType d_1 = derivatives[n] * m_interval;
+      const ValueType d_2 = derivatives[n + 1] * m_interval;
+      const ValueType Delta = f_2 - f_1;
+      const ValueType Delta_1 = d_1 - Delta;
+      const ValueType Delta_2 = d_2 - Delta;
+      m_coefficients[4 * n] = f_1;
+      m_coefficients[4 * n + 1] = d_1;
+      m_coefficients[4 * n + 2] = -(Delta_1 + Delta_1 + Delta_2);
+      m_coefficients[4 * n + 3] = Delta_1 + Delta_2;
+    }
   }
 
   ValueType evaluate(CoordinateType x) const {
     assert(x >= m_start && x <= m_end);
-    CoordinateType fpn;
-    const CoordinateType t = std::modf((x - m_start) / m_interval, &fpn);
-    const int n = int(fpn);
-    assert(n >= 0 && n < m_n);
-    assert(t >= 0 && t <= 1);
-    // Adapted from the chfev routine from SLATEC
-    const ValueType f_1 = m_values[n];
-    const ValueType f_2 = m_values[n + 1];
-    const ValueType d_1 = m_derivatives[n] * m_interval;
-    const ValueType d_2 = m_derivatives[n + 1] * m_interval;
-    const ValueType Delta = f_2 - f_1;
-    const ValueType Delta_1 = d_1 - Delta;
-    const ValueType Delta_2 = d_2 - Delta;
-    const ValueType c_2 = -(Delta_1 + Delta_1 + Delta_2);
-    const ValueType c_3 = Delta_1 + Delta_2;
-    return f_1 + t * (d_1 + t * (c_2 + t * c_3));
+    const CoordinateType s = (x - m_start) * m_inverseInterval;
+    // The last interval is closed on the right
+    const int n = std::min(int(s), m_n - 2);
+    const CoordinateType t = s - n;
+    assert(n >= 0 && n < m_n - 1);
+    const ValueType *c = &m_coefficients[4 * n];
+    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+  }
+
+  /** \brief Evaluate the interpolant at \p count points.
+   *
+   *  On output, <tt>result[i]</tt> contains the value of the interpolant at
+   *  <tt>x[i]</tt>. The loop contains no branches, so that it can be
+   *  vectorized by the compiler. */
+  void evaluate(const CoordinateType *x, size_t count,
+                ValueType *result) const {
+    const ValueType *coefficients = &m_coefficients[0];
+    const int lastInterval = m_n - 2;
+    for (size_t i = 0; i < count; ++i) {
+      assert(x[i] >= m_start && x[i] <= m_end);
+      const CoordinateType s = (x[i] - m_start) * m_inverseInterval;
+      const int n = std::min(int(s), lastInterval);
+      const CoordinateType t = s - n;
+      const ValueType *c = coefficients + 4 * n;
+      result[i] = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+    }
   }
 
 private:
@@ -65,8 +98,10 @@ private:
   CoordinateType m_start, m_end;
   int m_n;
   CoordinateType m_interval;
-  std::vector<ValueType> m_values;
-  std::vector<ValueType> m_derivatives;
+  CoordinateType m_inverseInterval;
+  // Coefficients of the cubic polynomial on each interval, interval by
+  // interval
+  std::vector<ValueType> m_coefficients;
   /** \endcond */
 };
 
@@ -21,6 +21,14 @@
 #include "initialize_interpolator_for_modified_helmholtz_3d_kernels.hpp"
 #include "explicit_instantiation.hpp"
 
+#include "../common/complex_aux.hpp"
+
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <tbb/mutex.h>
+
 namespace Fiber {
 
 template <typename ValueType>
@@ -43,10 +51,48 @@ void initializeInterpolatorForModifiedHelmholtz3dKernels(
   interpolator.initialize(minDist, maxDist, values, derivatives);
 }
 
+template <typename ValueType>
+shared_ptr<const HermiteInterpolator<ValueType>>
+sharedInterpolatorForModifiedHelmholtz3dKernels(
+    ValueType waveNumber, typename ScalarTraits<ValueType>::RealType maxDist,
+    int interpPtsPerWavelength) {
+  typedef typename ScalarTraits<ValueType>::RealType CoordinateType;
+  typedef HermiteInterpolator<ValueType> Interpolator;
+  typedef boost::tuple<CoordinateType, CoordinateType, CoordinateType, int>
+  Key;
+  typedef std::map<Key, boost::weak_ptr<const Interpolator>> Registry;
+
+  static Registry registry;
+  static tbb::mutex mutex;
+
+  const Key key(realPart(waveNumber), imagPart(waveNumber), maxDist,
+                interpPtsPerWavelength);
+  tbb::mutex::scoped_lock lock(mutex);
+  shared_ptr<const Interpolator> interpolator = registry[key].lock();
+  if (!interpolator) {
+    // Forget the tables that are no longer used
+    for (typename Registry::iterator it = registry.begin();
+         it != registry.end();)
+      if (it->second.expired() && it->first != key)
+        registry.erase(it++);
+      else
+        ++it;
+    shared_ptr<Interpolator> newInterpolator(new Interpolator);
+    initializeInterpolatorForModifiedHelmholtz3dKernels(
+        waveNumber, maxDist, interpPtsPerWavelength, *newInterpolator);
+    interpolator = newInterpolator;
+    registry[key] = interpolator;
+  }
+  return interpolator;
+}
+
 #define INSTANTIATE_FUNCTION(KERNEL)                                           \
   template void initializeInterpolatorForModifiedHelmholtz3dKernels(           \
       KERNEL, ScalarTraits<KERNEL>::RealType, int,                             \
-      HermiteInterpolator<KERNEL> &);
+      HermiteInterpolator<KERNEL> &);                                          \
+  template shared_ptr<const HermiteInterpolator<KERNEL>>                       \
+  sharedInterpolatorForModifiedHelmholtz3dKernels(                             \
+      KERNEL, ScalarTraits<KERNEL>::RealType, int);
 
 FIBER_ITERATE_OVER_KERNEL_TYPES(INSTANTIATE_FUNCTION);
 
@@ -3,6 +3,7 @@
 
 #include "../common/common.hpp"
 #include "hermite_interpolator.hpp"
+#include "shared_ptr.hpp"
 
 namespace Fiber {
 
@@ -11,6 +12,19 @@ void initializeInterpolatorForModifiedHelmholtz3dKernels(
     ValueType waveNumber, typename ScalarTraits<ValueType>::RealType maxDist,
     int interpPtsPerWavelength, HermiteInterpolator<ValueType> &interpolator);
 
+/** \brief Return an interpolator initialized by
+ *  initializeInterpolatorForModifiedHelmholtz3dKernels().
+ *
+ *  Interpolators are shared between all callers requesting the same wave
+ *  number, maximum distance and number of points per wavelength, so that
+ *  kernels of different operators use a single table. A table is released
+ *  when no kernel refers to it any more. This function is thread-safe. */
+template <typename ValueType>
+shared_ptr<const HermiteInterpolator<ValueType>>
+sharedInterpolatorForModifiedHelmholtz3dKernels(
+    ValueType waveNumber, typename ScalarTraits<ValueType>::RealType maxDist,
+    int interpPtsPerWavelength);
+
 } // namespace Fiber
 
 #endif
@@ -56,6 +56,8 @@ public:
     trialGeomDeps |= GLOBALS;
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
   void evaluate(const ConstGeometricalDataSlice<CoordinateType> &testGeomData,
                 const ConstGeometricalDataSlice<CoordinateType> &trialGeomData,
@@ -75,6 +77,41 @@ public:
     result[0](0, 0) = -numeratorSum / (static_cast<CoordinateType>(4. * M_PI) *
                                        distanceSq * distance);
   }
+
+  void evaluateBatch(
+      const BatchedGeometricalData<CoordinateType> &testGeomData,
+      const BatchedGeometricalData<CoordinateType> &trialGeomData,
+      ValueType *result) const {
+    const size_t testPointCount = testGeomData.pointCount;
+    const CoordinateType *testX = testGeomData.globals[0];
+    const CoordinateType *testY = testGeomData.globals[1];
+    const CoordinateType *testZ = testGeomData.globals[2];
+    const CoordinateType *testNormalX = testGeomData.normals[0];
+    const CoordinateType *testNormalY = testGeomData.normals[1];
+    const CoordinateType *testNormalZ = testGeomData.normals[2];
+    const CoordinateType factor =
+        static_cast<CoordinateType>(-1. / (4. * M_PI));
+
+    for (size_t trialIndex = 0; trialIndex < trialGeomData.pointCount;
+         ++trialIndex) {
+      const CoordinateType trialX = trialGeomData.globals[0][trialIndex];
+      const CoordinateType trialY = trialGeomData.globals[1][trialIndex];
+      const CoordinateType trialZ = trialGeomData.globals[2][trialIndex];
+      ValueType *column = result + trialIndex * testPointCount;
+      for (size_t testIndex = 0; testIndex < testPointCount; ++testIndex) {
+        const CoordinateType diffX = testX[testIndex] - trialX;
+        const CoordinateType diffY = testY[testIndex] - trialY;
+        const CoordinateType diffZ = testZ[testIndex] - trialZ;
+        const CoordinateType distanceSq =
+            diffX * diffX + diffY * diffY + diffZ * diffZ;
+        const CoordinateType numerator = diffX * testNormalX[testIndex] +
+                                         diffY * testNormalY[testIndex] +
+                                         diffZ * testNormalZ[testIndex];
+        column[testIndex] =
+            factor * numerator / (sqrt(distanceSq) * distanceSq);
+      }
+    }
+  }
 };
 
 } // namespace Fiber
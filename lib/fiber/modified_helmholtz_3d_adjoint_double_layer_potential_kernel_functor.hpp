@@ -50,9 +50,14 @@ public:
   typedef ValueType_ ValueType;
   typedef typename ScalarTraits<ValueType>::RealType CoordinateType;
 
+  /** \brief Constructor.
+   *
+   *  If \p mixedPrecision is true, evaluateBatch() evaluates the kernel in
+   *  single precision; the geometrical data are still processed in
+   *  CoordinateType. */
   explicit ModifiedHelmholtz3dAdjointDoubleLayerPotentialKernelFunctor(
-      ValueType waveNumber)
-      : m_waveNumber(waveNumber) {}
+      ValueType waveNumber, bool mixedPrecision = false)
+      : m_waveNumber(waveNumber), m_mixedPrecision(mixedPrecision) {}
 
   int kernelCount() const { return 1; }
   int kernelRowCount(int /* kernelIndex */) const { return 1; }
@@ -64,6 +69,8 @@ public:
     trialGeomDeps |= GLOBALS;
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   ValueType waveNumber() const { return m_waveNumber; }
 
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
@@ -87,12 +94,69 @@ public:
         exp(-m_waveNumber * distance);
   }
 
+  void evaluateBatch(
+      const BatchedGeometricalData<CoordinateType> &testGeomData,
+      const BatchedGeometricalData<CoordinateType> &trialGeomData,
+      ValueType *result) const {
+    if (m_mixedPrecision)
+      evaluateBatchImpl<typename ScalarTraits<ValueType>::SinglePrecisionType>(
+          testGeomData, trialGeomData, result);
+    else
+      evaluateBatchImpl<ValueType>(testGeomData, trialGeomData, result);
+  }
+
   CoordinateType estimateRelativeScale(CoordinateType distance) const {
     return exp(-realPart(m_waveNumber) * distance);
   }
 
 private:
+  // Differences of coordinates are computed in CoordinateType, the kernel
+  // values in EvaluationType
+  template <typename EvaluationType>
+  void evaluateBatchImpl(
+      const BatchedGeometricalData<CoordinateType> &testGeomData,
+      const BatchedGeometricalData<CoordinateType> &trialGeomData,
+      ValueType *result) const {
+    const size_t testPointCount = testGeomData.pointCount;
+    const CoordinateType *testX = testGeomData.globals[0];
+    const CoordinateType *testY = testGeomData.globals[1];
+    const CoordinateType *testZ = testGeomData.globals[2];
+    const CoordinateType *testNormalX = testGeomData.normals[0];
+    const CoordinateType *testNormalY = testGeomData.normals[1];
+    const CoordinateType *testNormalZ = testGeomData.normals[2];
+    typedef typename ScalarTraits<EvaluationType>::RealType EvaluationRealType;
+    const EvaluationType waveNumber = static_cast<EvaluationType>(m_waveNumber);
+    const EvaluationRealType factor =
+        static_cast<EvaluationRealType>(-1. / (4. * M_PI));
+
+    for (size_t trialIndex = 0; trialIndex < trialGeomData.pointCount;
+         ++trialIndex) {
+      const CoordinateType trialX = trialGeomData.globals[0][trialIndex];
+      const CoordinateType trialY = trialGeomData.globals[1][trialIndex];
+      const CoordinateType trialZ = trialGeomData.globals[2][trialIndex];
+      ValueType *column = result + trialIndex * testPointCount;
+      for (size_t testIndex = 0; testIndex < testPointCount; ++testIndex) {
+        const CoordinateType diffX = testX[testIndex] - trialX;
+        const CoordinateType diffY = testY[testIndex] - trialY;
+        const CoordinateType diffZ = testZ[testIndex] - trialZ;
+        const CoordinateType distanceSq =
+            diffX * diffX + diffY * diffY + diffZ * diffZ;
+        const CoordinateType numerator = diffX * testNormalX[testIndex] +
+                                         diffY * testNormalY[testIndex] +
+                                         diffZ * testNormalZ[testIndex];
+        const EvaluationRealType evaluationDistanceSq =
+            static_cast<EvaluationRealType>(distanceSq);
+        const EvaluationRealType distance = sqrt(evaluationDistanceSq);
+        column[testIndex] = static_cast<ValueType>(
+            factor * static_cast<EvaluationRealType>(numerator) /
+            evaluationDistanceSq * (waveNumber + 1 / distance) *
+            expm(waveNumber * distance));
+      }
+    }
+  }
+
   ValueType m_waveNumber;
+  bool m_mixedPrecision;
 };
 
 } // namespace Fiber
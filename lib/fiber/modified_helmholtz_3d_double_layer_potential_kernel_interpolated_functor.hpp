@@ -30,6 +30,8 @@
 
 #include "../common/complex_aux.hpp"
 
+#include <algorithm>
+
 namespace Fiber {
 
 /** \ingroup modified_helmholtz_3d
@@ -55,10 +57,9 @@ public:
 
   ModifiedHelmholtz3dDoubleLayerPotentialKernelInterpolatedFunctor(
       ValueType waveNumber, CoordinateType maxDist, int interpPtsPerWavelength)
-      : m_waveNumber(waveNumber) {
-    initializeInterpolatorForModifiedHelmholtz3dKernels(
-        waveNumber, maxDist, interpPtsPerWavelength, m_interpolator);
-  }
+      : m_waveNumber(waveNumber),
+        m_interpolator(sharedInterpolatorForModifiedHelmholtz3dKernels(
+            waveNumber, maxDist, interpPtsPerWavelength)) {}
 
   int kernelCount() const { return 1; }
   int kernelRowCount(int /* kernelIndex */) const { return 1; }
@@ -70,6 +71,8 @@ public:
     trialGeomDeps |= GLOBALS | NORMALS;
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   ValueType waveNumber() const { return m_waveNumber; }
 
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
@@ -86,13 +89,58 @@ public:
       numeratorSum += diff * trialGeomData.normal(coordIndex);
     }
     CoordinateType dist = sqrt(distSq);
-    ValueType v = m_interpolator.evaluate(dist);
+    ValueType v = m_interpolator->evaluate(dist);
     result[0](0, 0) =
         numeratorSum /
         (static_cast<CoordinateType>(-4.0 * M_PI) * distSq * dist) *
         (m_waveNumber * dist + static_cast<CoordinateType>(1.0)) * v;
   }
 
+  void evaluateBatch(
+      const BatchedGeometricalData<CoordinateType> &testGeomData,
+      const BatchedGeometricalData<CoordinateType> &trialGeomData,
+      ValueType *result) const {
+    // Distances are interpolated in chunks of test points
+    const size_t chunkSize = 64;
+    CoordinateType distances[chunkSize];
+    CoordinateType numerators[chunkSize];
+
+    const size_t testPointCount = testGeomData.pointCount;
+    const CoordinateType *testX = testGeomData.globals[0];
+    const CoordinateType *testY = testGeomData.globals[1];
+    const CoordinateType *testZ = testGeomData.globals[2];
+    const CoordinateType factor =
+        static_cast<CoordinateType>(-1. / (4. * M_PI));
+
+    for (size_t trialIndex = 0; trialIndex < trialGeomData.pointCount;
+         ++trialIndex) {
+      const CoordinateType trialX = trialGeomData.globals[0][trialIndex];
+      const CoordinateType trialY = trialGeomData.globals[1][trialIndex];
+      const CoordinateType trialZ = trialGeomData.globals[2][trialIndex];
+      const CoordinateType trialNormalX = trialGeomData.normals[0][trialIndex];
+      const CoordinateType trialNormalY = trialGeomData.normals[1][trialIndex];
+      const CoordinateType trialNormalZ = trialGeomData.normals[2][trialIndex];
+      ValueType *column = result + trialIndex * testPointCount;
+      for (size_t start = 0; start < testPointCount; start += chunkSize) {
+        const size_t count = std::min(chunkSize, testPointCount - start);
+        for (size_t i = 0; i < count; ++i) {
+          const CoordinateType diffX = trialX - testX[start + i];
+          const CoordinateType diffY = trialY - testY[start + i];
+          const CoordinateType diffZ = trialZ - testZ[start + i];
+          distances[i] = sqrt(diffX * diffX + diffY * diffY + diffZ * diffZ);
+          numerators[i] =
+              diffX * trialNormalX + diffY * trialNormalY + diffZ * trialNormalZ;
+        }
+        m_interpolator->evaluate(distances, count, column + start);
+        for (size_t i = 0; i < count; ++i)
+          column[start + i] *=
+              factor * numerators[i] /
+              (distances[i] * distances[i] * distances[i]) *
+              (m_waveNumber * distances[i] + static_cast<CoordinateType>(1.));
+      }
+    }
+  }
+
   CoordinateType estimateRelativeScale(CoordinateType distance) const {
     // This function is called rarely, invoking exp() here does little harm.
     return exp(-realPart(m_waveNumber) * distance);
@@ -101,7 +149,7 @@ public:
 private:
   /** \cond PRIVATE */
   ValueType m_waveNumber;
-  HermiteInterpolator<ValueType> m_interpolator;
+  shared_ptr<const HermiteInterpolator<ValueType>> m_interpolator;
   /** \endcond */
 };
 
@@ -64,6 +64,8 @@ public:
     m_slpKernel.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   ValueType waveNumber() const { return m_slpKernel.waveNumber(); }
 
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
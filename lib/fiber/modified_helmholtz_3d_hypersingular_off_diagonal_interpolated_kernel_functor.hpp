@@ -56,10 +56,9 @@ public:
 
   explicit ModifiedHelmholtz3dHypersingularOffDiagonalInterpolatedKernelFunctor(
       ValueType waveNumber, CoordinateType maxDist, int interpPtsPerWavelength)
-      : m_waveNumber(waveNumber) {
-    initializeInterpolatorForModifiedHelmholtz3dKernels(
-        waveNumber, maxDist, interpPtsPerWavelength, m_interpolator);
-  }
+      : m_waveNumber(waveNumber),
+        m_interpolator(sharedInterpolatorForModifiedHelmholtz3dKernels(
+            waveNumber, maxDist, interpPtsPerWavelength)) {}
 
   int kernelCount() const { return 1; }
   int kernelRowCount(int /* kernelIndex */) const { return 1; }
@@ -71,6 +70,8 @@ public:
     trialGeomDeps |= GLOBALS | NORMALS;
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   ValueType waveNumber() const { return m_waveNumber; }
 
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
@@ -95,7 +96,7 @@ public:
     }
     CoordinateType distance = sqrt(distanceSq);
     ValueType kr = waveNumber * distance;
-    ValueType v = m_interpolator.evaluate(distance);
+    ValueType v = m_interpolator->evaluate(distance);
     const CoordinateType ONE = 1., THREE = 3.;
     result[0](0, 0) =
         static_cast<CoordinateType>(1.0 / (4.0 * M_PI)) /
@@ -112,7 +113,7 @@ public:
 private:
   /** \cond PRIVATE */
   ValueType m_waveNumber;
-  HermiteInterpolator<ValueType> m_interpolator;
+  shared_ptr<const HermiteInterpolator<ValueType>> m_interpolator;
   /** \endcond */
 };
 
@@ -30,6 +30,8 @@
 
 #include "../common/complex_aux.hpp"
 
+#include <algorithm>
+
 namespace Fiber {
 
 /** \ingroup modified_helmholtz_3d
@@ -55,10 +57,9 @@ public:
 
   ModifiedHelmholtz3dSingleLayerPotentialKernelInterpolatedFunctor(
       ValueType waveNumber, CoordinateType maxDist, int interpPtsPerWavelength)
-      : m_waveNumber(waveNumber) {
-    initializeInterpolatorForModifiedHelmholtz3dKernels(
-        waveNumber, maxDist, interpPtsPerWavelength, m_interpolator);
-  }
+      : m_waveNumber(waveNumber),
+        m_interpolator(sharedInterpolatorForModifiedHelmholtz3dKernels(
+            waveNumber, maxDist, interpPtsPerWavelength)) {}
 
   int kernelCount() const { return 1; }
   int kernelRowCount(int /* kernelIndex */) const { return 1; }
@@ -70,6 +71,8 @@ public:
     trialGeomDeps |= GLOBALS;
   }
 
+  bool isInvariantUnderRigidMotions() const { return true; }
+
   ValueType waveNumber() const { return m_waveNumber; }
 
   template <template <typename T> class CollectionOf2dSlicesOfNdArrays>
@@ -85,11 +88,47 @@ public:
       sum += diff * diff;
     }
     CoordinateType distance = sqrt(sum);
-    ValueType v = m_interpolator.evaluate(distance);
+    ValueType v = m_interpolator->evaluate(distance);
     result[0](0, 0) =
         static_cast<CoordinateType>(1.0 / (4.0 * M_PI)) / distance * v;
   }
 
+  void evaluateBatch(
+      const BatchedGeometricalData<CoordinateType> &testGeomData,
+      const BatchedGeometricalData<CoordinateType> &trialGeomData,
+      ValueType *result) const {
+    // Distances are interpolated in chunks of test points
+    const size_t chunkSize = 64;
+    CoordinateType distances[chunkSize];
+
+    const size_t testPointCount = testGeomData.pointCount;
+    const CoordinateType *testX = testGeomData.globals[0];
+    const CoordinateType *testY = testGeomData.globals[1];
+    const CoordinateType *testZ = testGeomData.globals[2];
+    const CoordinateType factor =
+        static_cast<CoordinateType>(1. / (4. * M_PI));
+
+    for (size_t trialIndex = 0; trialIndex < trialGeomData.pointCount;
+         ++trialIndex) {
+      const CoordinateType trialX = trialGeomData.globals[0][trialIndex];
+      const CoordinateType trialY = trialGeomData.globals[1][trialIndex];
+      const CoordinateType trialZ = trialGeomData.globals[2][trialIndex];
+      ValueType *column = result + trialIndex * testPointCount;
+      for (size_t start = 0; start < testPointCount; start += chunkSize) {
+        const size_t count = std::min(chunkSize, testPointCount - start);
+        for (size_t i = 0; i < count; ++i) {
+          const CoordinateType diffX = testX[start + i] - trialX;
+          const CoordinateType diffY = testY[start + i] - trialY;
+          const CoordinateType diffZ = testZ[start + i] - trialZ;
+          distances[i] = sqrt(diffX * diffX + diffY * diffY + diffZ * diffZ);
+        }
+        m_interpolator->evaluate(distances, count, column + start);
+        for (size_t i = 0; i < count; ++i)
+          column[start + i] *= factor / distances[i];
+      }
+    }
+  }
+
   CoordinateType estimateRelativeScale(CoordinateType distance) const {
     // This function is called rarely, invoking exp() here does little harm.
     return exp(-realPart(m_waveNumber) * distance);
@@ -98,7 +137,7 @@ public:
 private:
   /** \cond PRIVATE */
   ValueType m_waveNumber;
-  HermiteInterpolator<ValueType> m_interpolator;
+  shared_ptr<const HermiteInterpolator<ValueType>> m_interpolator;
   /** \endcond */
 };
 
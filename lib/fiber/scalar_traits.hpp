@@ -34,12 +34,15 @@ namespace Fiber {
  *  This struct is specialized for the scalar types \c float, \c double,
  *  <tt>std::complex<float></tt> and <tt>std::complex<double></tt>. Each
  *  specialization <tt>ScalarTraits<T></tt> provides the typedefs \c RealType
- *  (denoting the real type of the same precision as \c T) and \c ComplexType
- *  (denoting the complex type of the same precision as \c T). */
+ *  (denoting the real type of the same precision as \c T), \c ComplexType
+ *  (denoting the complex type of the same precision as \c T) and
+ *  \c SinglePrecisionType (denoting the real or complex type, like \c T, of
+ *  single precision). */
 template <typename T> struct ScalarTraits {
 
   typedef T RealType;
   typedef T ComplexType;
+  typedef T SinglePrecisionType;
 
   ScalarTraits() {
     static_assert(
@@ -51,21 +54,25 @@ template <typename T> struct ScalarTraits {
 template <> struct ScalarTraits<float> {
   typedef float RealType;
   typedef std::complex<float> ComplexType;
+  typedef float SinglePrecisionType;
 };
 
 template <> struct ScalarTraits<double> {
   typedef double RealType;
   typedef std::complex<double> ComplexType;
+  typedef float SinglePrecisionType;
 };
 
 template <> struct ScalarTraits<std::complex<float>> {
   typedef float RealType;
   typedef std::complex<float> ComplexType;
+  typedef std::complex<float> SinglePrecisionType;
 };
 
 template <> struct ScalarTraits<std::complex<double>> {
   typedef double RealType;
   typedef std::complex<double> ComplexType;
+  typedef std::complex<float> SinglePrecisionType;
 };
 
 /** \brief "Larger" of the types U and V. */
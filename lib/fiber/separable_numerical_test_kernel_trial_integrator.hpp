@@ -26,6 +26,7 @@
 #include "bempp/common/config_opencl.hpp"
 
 #include "test_kernel_trial_integrator.hpp"
+#include "shared_ptr.hpp"
 
 #include <tbb/enumerable_thread_specific.h>
 
@@ -36,6 +37,9 @@ class OpenClHandler;
 template <typename CoordinateType> class CollectionOfShapesetTransformations;
 template <typename ValueType> class CollectionOfKernels;
 template <typename CoordinateType> class RawGridGeometry;
+template <typename CoordinateType> class GeometricalData;
+template <typename CoordinateType> class GeometricalDataStore;
+template <typename T> class _3dArray;
 template <typename BasisFunctionType, typename KernelType, typename ResultType>
 class TestKernelTrialIntegral;
 /** \endcond */
@@ -93,6 +97,12 @@ private:
                     LocalDofIndex localDofIndexB,
                     const std::vector<arma::Mat<ResultType> *> &result) const;
 
+  void integrateCpuBatched(
+      CallVariant callVariant, const std::vector<int> &elementIndicesA,
+      int elementIndexB, const Shapeset<BasisFunctionType> &basisA,
+      const Shapeset<BasisFunctionType> &basisB, LocalDofIndex localDofIndexB,
+      const std::vector<arma::Mat<ResultType> *> &result) const;
+
   void integrateCl(CallVariant callVariant,
                    const std::vector<int> &elementIndicesA, int elementIndexB,
                    const Shapeset<BasisFunctionType> &basisA,
@@ -110,12 +120,14 @@ private:
                    const Shapeset<BasisFunctionType> &trialShapeset,
                    const std::vector<arma::Mat<ResultType> *> &result) const;
 
+  bool canUseFusedIntegration() const;
+  bool canUseBatchedIntegration() const;
+  void weightScalarValues(const _3dArray<BasisFunctionType> &values,
+                          const GeometricalData<CoordinateType> &geomData,
+                          const std::vector<CoordinateType> &quadWeights,
+                          arma::Mat<CoordinateType> &result) const;
+
   void precalculateGeometricalData();
-  void precalculateGeometricalDataOnSingleGrid(
-      const arma::Mat<CoordinateType> &localQuadPoints,
-      const GeometryFactory &geometryFactory,
-      const RawGridGeometry<CoordinateType> &rawGeometry, size_t geomDeps,
-      std::vector<GeometricalData<CoordinateType>> &geomData);
 
   /**
    * \brief Returns an OpenCL code snippet containing the clIntegrate
@@ -143,9 +155,15 @@ private:
 
   const OpenClHandler &m_openClHandler;
   bool m_cacheGeometricalData;
-
-  std::vector<GeometricalData<CoordinateType>> m_cachedTestGeomData;
-  std::vector<GeometricalData<CoordinateType>> m_cachedTrialGeomData;
+  // True if the integral is evaluated by CollectionOfKernels::integrateOnGrid()
+  bool m_fusedIntegration;
+  // True if the integrals over many element pairs sharing one element can be
+  // evaluated together by matrix-matrix products with the tables of test and
+  // trial function values on the reference element
+  bool m_batchedIntegration;
+
+  shared_ptr<const GeometricalDataStore<CoordinateType>> m_testGeomDataStore;
+  shared_ptr<const GeometricalDataStore<CoordinateType>> m_trialGeomDataStore;
   mutable tbb::enumerable_thread_specific<GeometricalData<CoordinateType>>
   m_testGeomData, m_trialGeomData;
 
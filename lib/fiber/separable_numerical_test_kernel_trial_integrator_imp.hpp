@@ -33,15 +33,20 @@
 #include "conjugate.hpp"
 #include "collection_of_shapeset_transformations.hpp"
 #include "geometrical_data.hpp"
+#include "geometrical_data_store.hpp"
 #include "collection_of_kernels.hpp"
 #include "opencl_handler.hpp"
 #include "raw_grid_geometry.hpp"
 #include "test_kernel_trial_integral.hpp"
+#include "typical_test_scalar_kernel_trial_integral.hpp"
 #include "types.hpp"
+#include "../common/complex_aux.hpp"
 #include "CL/separable_numerical_double_integrator.cl.str"
 
 #include "../common/auto_timer.hpp"
 
+#include <algorithm>
+#include <boost/type_traits/is_same.hpp>
 #include <cassert>
 #include <memory>
 
@@ -77,7 +82,9 @@ SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
       m_testTransformations(testTransformations), m_kernels(kernels),
       m_trialTransformations(trialTransformations), m_integral(integral),
       m_openClHandler(openClHandler),
-      m_cacheGeometricalData(cacheGeometricalData) {
+      m_cacheGeometricalData(cacheGeometricalData),
+      m_fusedIntegration(canUseFusedIntegration()),
+      m_batchedIntegration(canUseBatchedIntegration()) {
   if (localTestQuadPoints.n_cols != testQuadWeights.size())
     throw std::invalid_argument(
         "SeparableNumericalTestKernelTrialIntegrator::"
@@ -124,44 +131,75 @@ SeparableNumericalTestKernelTrialIntegrator<
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
-void SeparableNumericalTestKernelTrialIntegrator<
+bool SeparableNumericalTestKernelTrialIntegrator<
     BasisFunctionType, KernelType, ResultType,
-    GeometryFactory>::precalculateGeometricalData() {
-  size_t testBasisDeps = 0, trialBasisDeps = 0; // ignored in this function
-  size_t testGeomDeps = 0, trialGeomDeps = 0;
+    GeometryFactory>::canUseFusedIntegration() const {
+  // The fused path handles integrals of a scalar kernel against real scalar
+  // functions; whether the kernel supports it is decided by
+  // CollectionOfKernels::integrateOnGrid().
+  typedef TypicalTestScalarKernelTrialIntegralBase<BasisFunctionType,
+                                                   KernelType, ResultType>
+  TypicalIntegral;
+  return boost::is_same<BasisFunctionType, CoordinateType>::value &&
+         m_testTransformations.transformationCount() == 1 &&
+         m_testTransformations.resultDimension(0) == 1 &&
+         m_trialTransformations.transformationCount() == 1 &&
+         m_trialTransformations.resultDimension(0) == 1 &&
+         dynamic_cast<const TypicalIntegral *>(&m_integral);
+}
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+bool SeparableNumericalTestKernelTrialIntegrator<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::canUseBatchedIntegration() const {
+  // Besides the conditions of the fused path, the transformed test and trial
+  // functions must not depend on the geometry of the elements, so that their
+  // values at the quadrature points are the same on all elements
+  size_t testBasisDeps = 0, trialBasisDeps = 0;
+  size_t testGeomDeps = 0, trialGeomDeps = 0;
   m_testTransformations.addDependencies(testBasisDeps, testGeomDeps);
   m_trialTransformations.addDependencies(trialBasisDeps, trialGeomDeps);
-  m_kernels.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
-  m_integral.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
-
-  precalculateGeometricalDataOnSingleGrid(
-      m_localTestQuadPoints, m_testGeometryFactory, m_testRawGeometry,
-      testGeomDeps, m_cachedTestGeomData);
-  precalculateGeometricalDataOnSingleGrid(
-      m_localTrialQuadPoints, m_trialGeometryFactory, m_trialRawGeometry,
-      trialGeomDeps, m_cachedTrialGeomData);
+  return canUseFusedIntegration() && testGeomDeps == 0 && trialGeomDeps == 0;
 }
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
                                                  ResultType, GeometryFactory>::
-    precalculateGeometricalDataOnSingleGrid(
-        const arma::Mat<CoordinateType> &localQuadPoints,
-        const GeometryFactory &geometryFactory,
-        const RawGridGeometry<CoordinateType> &rawGeometry, size_t geomDeps,
-        std::vector<GeometricalData<CoordinateType>> &geomData) {
-  geomData.resize(rawGeometry.elementCount());
+    weightScalarValues(const _3dArray<BasisFunctionType> &values,
+                       const GeometricalData<CoordinateType> &geomData,
+                       const std::vector<CoordinateType> &quadWeights,
+                       arma::Mat<CoordinateType> &result) const {
+  const size_t dofCount = values.extent(1);
+  const size_t pointCount = values.extent(2);
+  result.set_size(pointCount, dofCount);
+  for (size_t dof = 0; dof < dofCount; ++dof)
+    for (size_t point = 0; point < pointCount; ++point)
+      result(point, dof) = realPart(values(0, dof, point)) *
+                           geomData.integrationElements(point) *
+                           quadWeights[point];
+}
 
-  typedef typename GeometryFactory::Geometry Geometry;
-  std::unique_ptr<Geometry> geometry = geometryFactory.make();
-  for (size_t e = 0; e < rawGeometry.elementCount(); ++e) {
-    rawGeometry.setupGeometry(e, *geometry);
-    geometry->getData(geomDeps, localQuadPoints, geomData[e]);
-    if (geomDeps & DOMAIN_INDEX)
-      geomData[e].domainIndex = rawGeometry.domainIndex(e);
-  }
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+void SeparableNumericalTestKernelTrialIntegrator<
+    BasisFunctionType, KernelType, ResultType,
+    GeometryFactory>::precalculateGeometricalData() {
+  size_t testBasisDeps = 0, trialBasisDeps = 0; // ignored in this function
+  size_t testGeomDeps = 0, trialGeomDeps = 0;
+
+  m_testTransformations.addDependencies(testBasisDeps, testGeomDeps);
+  m_trialTransformations.addDependencies(trialBasisDeps, trialGeomDeps);
+  m_kernels.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
+  m_integral.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
+
+  m_testGeomDataStore = GeometricalDataStore<CoordinateType>::get(
+      m_testGeometryFactory, m_testRawGeometry, m_localTestQuadPoints,
+      testGeomDeps);
+  m_trialGeomDataStore = GeometricalDataStore<CoordinateType>::get(
+      m_trialGeometryFactory, m_trialRawGeometry, m_localTrialQuadPoints,
+      trialGeomDeps);
 }
 
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
@@ -213,6 +251,15 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
   const int testDofCount = callVariant == TEST_TRIAL ? dofCountA : dofCountB;
   const int trialDofCount = callVariant == TEST_TRIAL ? dofCountB : dofCountA;
 
+  // Pairs of low-order elements are cheaper to integrate one by one
+  // (possibly on the fused path)
+  if (m_batchedIntegration && m_cacheGeometricalData && elementACount > 1 &&
+      std::max(testDofCount, trialDofCount) > 3) {
+    integrateCpuBatched(callVariant, elementIndicesA, elementIndexB, basisA,
+                        basisB, localDofIndexB, result);
+    return;
+  }
+
   BasisData<BasisFunctionType> testBasisData, trialBasisData;
   GeometricalData<CoordinateType> *testGeomData = &m_testGeomData.local();
   GeometricalData<CoordinateType> *trialGeomData = &m_trialGeomData.local();
@@ -246,6 +293,8 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
 
   CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
   CollectionOf4dArrays<KernelType> kernelValues;
+  arma::Mat<CoordinateType> weightedTestValues, weightedTrialValues;
+  arma::Mat<KernelType> fusedResult;
 
   for (size_t i = 0; i < result.size(); ++i) {
     assert(result[i]);
@@ -260,7 +309,7 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
     basisB.evaluate(trialBasisDeps, m_localTrialQuadPoints, localDofIndexB,
                     trialBasisData);
     if (m_cacheGeometricalData)
-      constTrialGeomData = &m_cachedTrialGeomData[elementIndexB];
+      constTrialGeomData = &m_trialGeomDataStore->elementData(elementIndexB);
     else {
       geometryB->getData(trialGeomDeps, m_localTrialQuadPoints, *trialGeomData);
       if (trialGeomDeps & DOMAIN_INDEX)
@@ -274,7 +323,7 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
     basisB.evaluate(testBasisDeps, m_localTestQuadPoints, localDofIndexB,
                     testBasisData);
     if (m_cacheGeometricalData)
-      constTestGeomData = &m_cachedTestGeomData[elementIndexB];
+      constTestGeomData = &m_testGeomDataStore->elementData(elementIndexB);
     else {
       geometryB->getData(testGeomDeps, m_localTestQuadPoints, *testGeomData);
       if (testGeomDeps & DOMAIN_INDEX)
@@ -291,7 +340,7 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
       rawGeometryA->setupGeometry(elementIndexA, *geometryA);
     if (callVariant == TEST_TRIAL) {
       if (m_cacheGeometricalData)
-        constTestGeomData = &m_cachedTestGeomData[elementIndicesA[indexA]];
+        constTestGeomData = &m_testGeomDataStore->elementData(elementIndexA);
       else {
         geometryA->getData(testGeomDeps, m_localTestQuadPoints, *testGeomData);
         if (testGeomDeps & DOMAIN_INDEX)
@@ -301,7 +350,8 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
                                      testValues);
     } else {
       if (m_cacheGeometricalData)
-        constTrialGeomData = &m_cachedTrialGeomData[elementIndicesA[indexA]];
+        constTrialGeomData =
+            &m_trialGeomDataStore->elementData(elementIndexA);
       else {
         geometryA->getData(trialGeomDeps, m_localTrialQuadPoints,
                            *trialGeomData);
@@ -312,6 +362,19 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
                                       trialValues);
     }
 
+    if (m_fusedIntegration) {
+      weightScalarValues(testValues[0], *constTestGeomData, m_testQuadWeights,
+                         weightedTestValues);
+      weightScalarValues(trialValues[0], *constTrialGeomData,
+                         m_trialQuadWeights, weightedTrialValues);
+      if (m_kernels.integrateOnGrid(*constTestGeomData, *constTrialGeomData,
+                                    weightedTestValues, weightedTrialValues,
+                                    fusedResult)) {
+        *result[indexA] =
+            arma::conv_to<arma::Mat<ResultType>>::from(fusedResult);
+        continue;
+      }
+    }
     m_kernels.evaluateOnGrid(*constTestGeomData, *constTrialGeomData,
                              kernelValues);
     m_integral.evaluateWithTensorQuadratureRule(
@@ -320,6 +383,122 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
   }
 }
 
+template <typename BasisFunctionType, typename KernelType, typename ResultType,
+          typename GeometryFactory>
+void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
+                                                 ResultType, GeometryFactory>::
+    integrateCpuBatched(CallVariant callVariant,
+                        const std::vector<int> &elementIndicesA,
+                        int elementIndexB,
+                        const Shapeset<BasisFunctionType> &basisA,
+                        const Shapeset<BasisFunctionType> &basisB,
+                        LocalDofIndex localDofIndexB,
+                        const std::vector<arma::Mat<ResultType> *> &result)
+    const {
+  // The integral over a pair of elements (x, y) is
+  //   sum_{p, q} phi_i(p) [w_p J_x(p) K(x_p, y_q) w_q J_y(q)] psi_j(q),
+  // where only the bracketed factor depends on the elements. The weighted
+  // kernel blocks of a chunk of pairs are placed side by side and contracted
+  // with the table of test function values by a single matrix product; the
+  // partial results are then stacked and contracted with the table of trial
+  // function values by another one.
+  const int testPointCount = m_localTestQuadPoints.n_cols;
+  const int trialPointCount = m_localTrialQuadPoints.n_cols;
+  const int elementACount = elementIndicesA.size();
+  const int maxChunkSize = 64;
+
+  const Shapeset<BasisFunctionType> &testShapeset =
+      callVariant == TEST_TRIAL ? basisA : basisB;
+  const Shapeset<BasisFunctionType> &trialShapeset =
+      callVariant == TEST_TRIAL ? basisB : basisA;
+  const LocalDofIndex testDofs =
+      callVariant == TEST_TRIAL ? ALL_DOFS : localDofIndexB;
+  const LocalDofIndex trialDofs =
+      callVariant == TEST_TRIAL ? localDofIndexB : ALL_DOFS;
+  const int firstTestElementIndex =
+      callVariant == TEST_TRIAL ? elementIndicesA[0] : elementIndexB;
+  const int firstTrialElementIndex =
+      callVariant == TEST_TRIAL ? elementIndexB : elementIndicesA[0];
+
+  // Evaluate the function tables. The transformations do not depend on the
+  // geometry, so the data of any element can be passed to them.
+  size_t testBasisDeps = 0, trialBasisDeps = 0;
+  size_t testGeomDeps = 0, trialGeomDeps = 0;
+  m_testTransformations.addDependencies(testBasisDeps, testGeomDeps);
+  m_trialTransformations.addDependencies(trialBasisDeps, trialGeomDeps);
+
+  BasisData<BasisFunctionType> testBasisData, trialBasisData;
+  CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
+  testShapeset.evaluate(testBasisDeps, m_localTestQuadPoints, testDofs,
+                        testBasisData);
+  trialShapeset.evaluate(trialBasisDeps, m_localTrialQuadPoints, trialDofs,
+                         trialBasisData);
+  m_testTransformations.evaluate(
+      testBasisData, m_testGeomDataStore->elementData(firstTestElementIndex),
+      testValues);
+  m_trialTransformations.evaluate(
+      trialBasisData, m_trialGeomDataStore->elementData(firstTrialElementIndex),
+      trialValues);
+
+  const int testDofCount = testValues[0].extent(1);
+  const int trialDofCount = trialValues[0].extent(1);
+  arma::Mat<KernelType> testTable(testDofCount, testPointCount);
+  for (int point = 0; point < testPointCount; ++point)
+    for (int dof = 0; dof < testDofCount; ++dof)
+      testTable(dof, point) = testValues[0](0, dof, point);
+  arma::Mat<KernelType> trialTable(trialPointCount, trialDofCount);
+  for (int dof = 0; dof < trialDofCount; ++dof)
+    for (int point = 0; point < trialPointCount; ++point)
+      trialTable(point, dof) = trialValues[0](0, dof, point);
+
+  CollectionOf4dArrays<KernelType> kernelValues;
+  std::vector<CoordinateType> testWeights(testPointCount);
+  arma::Mat<KernelType> kernelBlocks, partialProducts, stackedProducts,
+      products;
+  for (int chunkStart = 0; chunkStart < elementACount;
+       chunkStart += maxChunkSize) {
+    const int chunkSize = std::min(maxChunkSize, elementACount - chunkStart);
+    kernelBlocks.set_size(testPointCount, trialPointCount * chunkSize);
+    for (int i = 0; i < chunkSize; ++i) {
+      const int elementIndexA = elementIndicesA[chunkStart + i];
+      const GeometricalData<CoordinateType> &testGeomData =
+          m_testGeomDataStore->elementData(
+              callVariant == TEST_TRIAL ? elementIndexA : elementIndexB);
+      const GeometricalData<CoordinateType> &trialGeomData =
+          m_trialGeomDataStore->elementData(
+              callVariant == TEST_TRIAL ? elementIndexB : elementIndexA);
+      m_kernels.evaluateOnGrid(testGeomData, trialGeomData, kernelValues);
+      const _4dArray<KernelType> &values = kernelValues[0];
+      for (int testPoint = 0; testPoint < testPointCount; ++testPoint)
+        testWeights[testPoint] = m_testQuadWeights[testPoint] *
+                                 testGeomData.integrationElements(testPoint);
+      for (int trialPoint = 0; trialPoint < trialPointCount; ++trialPoint) {
+        const CoordinateType trialWeight =
+            m_trialQuadWeights[trialPoint] *
+            trialGeomData.integrationElements(trialPoint);
+        KernelType *column =
+            kernelBlocks.colptr(i * trialPointCount + trialPoint);
+        for (int testPoint = 0; testPoint < testPointCount; ++testPoint)
+          column[testPoint] = values(0, 0, testPoint, trialPoint) *
+                              (testWeights[testPoint] * trialWeight);
+      }
+    }
+
+    partialProducts = testTable * kernelBlocks;
+    stackedProducts.set_size(testDofCount * chunkSize, trialPointCount);
+    for (int i = 0; i < chunkSize; ++i)
+      for (int trialPoint = 0; trialPoint < trialPointCount; ++trialPoint)
+        for (int dof = 0; dof < testDofCount; ++dof)
+          stackedProducts(i * testDofCount + dof, trialPoint) =
+              partialProducts(dof, i * trialPointCount + trialPoint);
+    products = stackedProducts * trialTable;
+
+    for (int i = 0; i < chunkSize; ++i)
+      *result[chunkStart + i] = arma::conv_to<arma::Mat<ResultType>>::from(
+          products.rows(i * testDofCount, (i + 1) * testDofCount - 1));
+  }
+}
+
 template <typename BasisFunctionType, typename KernelType, typename ResultType,
           typename GeometryFactory>
 void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
@@ -740,6 +919,8 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
 
   CollectionOf3dArrays<BasisFunctionType> testValues, trialValues;
   CollectionOf4dArrays<KernelType> kernelValues;
+  arma::Mat<CoordinateType> weightedTestValues, weightedTrialValues;
+  arma::Mat<KernelType> fusedResult;
 
   for (size_t i = 0; i < result.size(); ++i) {
     assert(result[i]);
@@ -756,8 +937,9 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
     const int testElementIndex = elementIndexPairs[pairIndex].first;
     const int trialElementIndex = elementIndexPairs[pairIndex].second;
     if (m_cacheGeometricalData) {
-      constTestGeomData = &m_cachedTestGeomData[testElementIndex];
-      constTrialGeomData = &m_cachedTrialGeomData[trialElementIndex];
+      constTestGeomData = &m_testGeomDataStore->elementData(testElementIndex);
+      constTrialGeomData =
+          &m_trialGeomDataStore->elementData(trialElementIndex);
     } else {
       m_testRawGeometry.setupGeometry(testElementIndex, *testGeometry);
       m_trialRawGeometry.setupGeometry(trialElementIndex, *trialGeometry);
@@ -776,6 +958,19 @@ void SeparableNumericalTestKernelTrialIntegrator<BasisFunctionType, KernelType,
     m_trialTransformations.evaluate(trialBasisData, *constTrialGeomData,
                                     trialValues);
 
+    if (m_fusedIntegration) {
+      weightScalarValues(testValues[0], *constTestGeomData, m_testQuadWeights,
+                         weightedTestValues);
+      weightScalarValues(trialValues[0], *constTrialGeomData,
+                         m_trialQuadWeights, weightedTrialValues);
+      if (m_kernels.integrateOnGrid(*constTestGeomData, *constTrialGeomData,
+                                    weightedTestValues, weightedTrialValues,
+                                    fusedResult)) {
+        *result[pairIndex] =
+            arma::conv_to<arma::Mat<ResultType>>::from(fusedResult);
+        continue;
+      }
+    }
     m_kernels.evaluateOnGrid(*constTestGeomData, *constTrialGeomData,
                              kernelValues);
     m_integral.evaluateWithTensorQuadratureRule(
@@ -0,0 +1,64 @@
+// Copyright (C) 2011-2012 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_treecode_options_hpp
+#define fiber_treecode_options_hpp
+
+#include "../common/common.hpp"
+
+namespace Fiber {
+
+/** \brief Parameters of the octree Chebyshev treecode used to evaluate
+ *  potentials and to apply weak forms of boundary operators.
+ *
+ *  Both uses are implemented by ChebyshevTreecode. See
+ *  EvaluatorForIntegralOperators::evaluateWithTreecode() and
+ *  AssemblyOptions::switchToTreecodeMode(). */
+struct TreecodeOptions {
+  TreecodeOptions() {
+    expansionOrder = 6;
+    maxPointsPerLeaf = 128;
+    eta = 1.5;
+    maxLevel = 20;
+    quadratureOrderIncrement = 2;
+  }
+
+  /** \brief Number of Chebyshev nodes per dimension of the interpolants of
+   *  the far field in each box. */
+  int expansionOrder;
+  /** \brief Maximum number of quadrature and evaluation points in a leaf of
+   *  the octree. */
+  int maxPointsPerLeaf;
+  /** \brief Admissibility parameter: two boxes interact through the
+   *  interpolant if their diameter is at most eta times their distance. */
+  double eta;
+  /** \brief Maximum depth of the octree. */
+  int maxLevel;
+  /** \brief Order of the quadrature rules used for far-field interactions
+   *  of weak forms, relative to the polynomial order of the basis
+   *  functions.
+   *
+   *  Only used by the treecode assembly mode of boundary operators. */
+  int quadratureOrderIncrement;
+};
+
+} // namespace Fiber
+
+#endif
@@ -0,0 +1,104 @@
+// Copyright (C) 2011-2012 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_weak_form_kernel_trial_integral_hpp
+#define fiber_weak_form_kernel_trial_integral_hpp
+
+#include "kernel_trial_integral.hpp"
+
+namespace Fiber {
+
+/** \cond FORWARD_DECL */
+template <typename CoordinateType> class CollectionOfShapesetTransformations;
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+class TestKernelTrialIntegral;
+/** \endcond */
+
+/** \brief Kernel-trial integral obtained from the weak form of an integral
+ *  operator.
+ *
+ *  The integrand of a weak form is linear in the values of the test function
+ *  transformations. Substituting unit vectors for these values produces a
+ *  vector-valued potential with one component per component of each test
+ *  transformation. Its value at a test point \f$x\f$ is contracted with the
+ *  (conjugated) values of the test function transformations at \f$x\f$ to
+ *  give the integrand of the weak form integrated over the trial element.
+ *
+ *  This allows potential evaluators such as ChebyshevTreecode to evaluate
+ *  weak forms point by point. The integrand of the weak form may not depend
+ *  on any geometrical data of the test point apart from the global
+ *  coordinates used by the kernels.
+ *
+ *  In contrast to other kernel-trial integrals, the \p weights passed to
+ *  evaluate() are the "raw" quadrature weights; the integration elements
+ *  are taken from the trial geometrical data. */
+template <typename BasisFunctionType_, typename KernelType_,
+          typename ResultType_>
+class WeakFormKernelTrialIntegral
+    : public KernelTrialIntegral<BasisFunctionType_, KernelType_,
+                                 ResultType_> {
+  typedef KernelTrialIntegral<BasisFunctionType_, KernelType_, ResultType_>
+  Base;
+
+public:
+  typedef typename Base::CoordinateType CoordinateType;
+  typedef typename Base::BasisFunctionType BasisFunctionType;
+  typedef typename Base::KernelType KernelType;
+  typedef typename Base::ResultType ResultType;
+  typedef TestKernelTrialIntegral<BasisFunctionType, KernelType, ResultType>
+  WeakFormIntegral;
+
+  /** \brief Constructor.
+   *
+   *  Both arguments must outlive the object. */
+  WeakFormKernelTrialIntegral(
+      const WeakFormIntegral &integral,
+      const CollectionOfShapesetTransformations<CoordinateType> &
+          testTransformations);
+
+  virtual int resultDimension() const;
+
+  virtual void addGeometricalDependencies(size_t &trialGeomDeps) const;
+
+  virtual void
+  evaluate(const GeometricalData<CoordinateType> &trialGeomData,
+           const CollectionOf4dArrays<KernelType> &kernels,
+           const CollectionOf2dArrays<ResultType> &trialTransformations,
+           const std::vector<CoordinateType> &weights,
+           _2dArray<ResultType> &result) const;
+
+  virtual void evaluateWithPureWeights(
+      const GeometricalData<CoordinateType> &trialGeomData,
+      const CollectionOf4dArrays<KernelType> &kernels,
+      const CollectionOf3dArrays<BasisFunctionType> &trialTransformations,
+      const std::vector<CoordinateType> &weights,
+      _3dArray<ResultType> &result) const;
+
+private:
+  const WeakFormIntegral &m_integral;
+  const CollectionOfShapesetTransformations<CoordinateType> &
+  m_testTransformations;
+};
+
+} // namespace Fiber
+
+#include "weak_form_kernel_trial_integral_imp.hpp"
+
+#endif
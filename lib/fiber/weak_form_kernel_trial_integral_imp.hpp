@@ -0,0 +1,178 @@
+// Copyright (C) 2011-2012 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#ifndef fiber_weak_form_kernel_trial_integral_imp_hpp
+#define fiber_weak_form_kernel_trial_integral_imp_hpp
+
+#include "weak_form_kernel_trial_integral.hpp" // keep IDEs happy
+
+#include "_2d_array.hpp"
+#include "collection_of_2d_arrays.hpp"
+#include "collection_of_3d_arrays.hpp"
+#include "collection_of_4d_arrays.hpp"
+#include "collection_of_shapeset_transformations.hpp"
+#include "geometrical_data.hpp"
+#include "test_kernel_trial_integral.hpp"
+
+#include "../common/complex_aux.hpp"
+
+#include <stdexcept>
+
+namespace Fiber {
+
+namespace {
+
+// Representation of the values of a charge distribution with values of type
+// ResultType by values of type BasisFunctionType. Complex charges are split
+// into their real and imaginary parts if the basis functions are real.
+template <typename BasisFunctionType, typename ResultType> struct ChargeParts {
+  static const int count = 2;
+
+  static BasisFunctionType part(const ResultType &value, int i) {
+    return i == 0 ? realPart(value) : imagPart(value);
+  }
+
+  static ResultType combine(const arma::Mat<ResultType> &values, int row) {
+    return values(row, 0) + ResultType(0., 1.) * values(row, 1);
+  }
+};
+
+template <typename ValueType> struct ChargeParts<ValueType, ValueType> {
+  static const int count = 1;
+
+  static ValueType part(const ValueType &value, int) { return value; }
+
+  static ValueType combine(const arma::Mat<ValueType> &values, int row) {
+    return values(row, 0);
+  }
+};
+
+} // namespace
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+WeakFormKernelTrialIntegral<BasisFunctionType, KernelType, ResultType>::
+    WeakFormKernelTrialIntegral(
+        const WeakFormIntegral &integral,
+        const CollectionOfShapesetTransformations<CoordinateType> &
+            testTransformations)
+    : m_integral(integral), m_testTransformations(testTransformations) {}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+int WeakFormKernelTrialIntegral<BasisFunctionType, KernelType,
+                                ResultType>::resultDimension() const {
+  int result = 0;
+  for (int i = 0; i < m_testTransformations.transformationCount(); ++i)
+    result += m_testTransformations.resultDimension(i);
+  return result;
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void WeakFormKernelTrialIntegral<BasisFunctionType, KernelType, ResultType>::
+    addGeometricalDependencies(size_t &trialGeomDeps) const {
+  size_t testGeomDeps = 0;
+  m_integral.addGeometricalDependencies(testGeomDeps, trialGeomDeps);
+  if (testGeomDeps & ~size_t(INTEGRATION_ELEMENTS))
+    throw std::invalid_argument(
+        "WeakFormKernelTrialIntegral::addGeometricalDependencies(): "
+        "the integrand may not depend on geometrical data of test points");
+  trialGeomDeps |= INTEGRATION_ELEMENTS;
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void WeakFormKernelTrialIntegral<BasisFunctionType, KernelType, ResultType>::
+    evaluate(const GeometricalData<CoordinateType> &trialGeomData,
+             const CollectionOf4dArrays<KernelType> &kernels,
+             const CollectionOf2dArrays<ResultType> &trialTransformations,
+             const std::vector<CoordinateType> &weights,
+             _2dArray<ResultType> &result) const {
+  typedef ChargeParts<BasisFunctionType, ResultType> Parts;
+
+  const size_t pointCount = kernels[0].extent(2);
+  const size_t trialPointCount = kernels[0].extent(3);
+  const int transformationCount = m_testTransformations.transformationCount();
+  const int componentCount = resultDimension();
+
+  // One test "function" per component of each test transformation, equal
+  // to the corresponding unit vector at the single test point
+  CollectionOf3dArrays<BasisFunctionType> testValues(transformationCount);
+  for (int transf = 0, offset = 0; transf < transformationCount; ++transf) {
+    const int dimCount = m_testTransformations.resultDimension(transf);
+    testValues[transf].set_size(dimCount, componentCount, 1);
+    std::fill(testValues[transf].begin(), testValues[transf].end(), 0.);
+    for (int dim = 0; dim < dimCount; ++dim)
+      testValues[transf](dim, offset + dim, 0) = 1.;
+    offset += dimCount;
+  }
+  GeometricalData<CoordinateType> testGeomData;
+  testGeomData.integrationElements.ones(1);
+  const std::vector<CoordinateType> testWeights(1, 1.);
+
+  // One trial "function" per part of the charge
+  CollectionOf3dArrays<BasisFunctionType> trialValues(
+      trialTransformations.size());
+  for (size_t transf = 0; transf < trialTransformations.size(); ++transf) {
+    const _2dArray<ResultType> &charges = trialTransformations[transf];
+    trialValues[transf].set_size(charges.extent(0), Parts::count,
+                                 trialPointCount);
+    for (size_t point = 0; point < trialPointCount; ++point)
+      for (int part = 0; part < Parts::count; ++part)
+        for (size_t dim = 0; dim < charges.extent(0); ++dim)
+          trialValues[transf](dim, part, point) =
+              Parts::part(charges(dim, point), part);
+  }
+
+  result.set_size(componentCount, pointCount);
+  CollectionOf4dArrays<KernelType> pointKernels(kernels.size());
+  arma::Mat<ResultType> localResult;
+  for (size_t point = 0; point < pointCount; ++point) {
+    for (size_t k = 0; k < kernels.size(); ++k) {
+      const _4dArray<KernelType> &values = kernels[k];
+      pointKernels[k].set_size(values.extent(0), values.extent(1), 1,
+                               trialPointCount);
+      for (size_t trialPoint = 0; trialPoint < trialPointCount; ++trialPoint)
+        for (size_t j = 0; j < values.extent(1); ++j)
+          for (size_t i = 0; i < values.extent(0); ++i)
+            pointKernels[k](i, j, 0, trialPoint) =
+                values(i, j, point, trialPoint);
+    }
+    m_integral.evaluateWithTensorQuadratureRule(
+        testGeomData, trialGeomData, testValues, trialValues, pointKernels,
+        testWeights, weights, localResult);
+    for (int c = 0; c < componentCount; ++c)
+      result(c, point) = Parts::combine(localResult, c);
+  }
+}
+
+template <typename BasisFunctionType, typename KernelType, typename ResultType>
+void WeakFormKernelTrialIntegral<BasisFunctionType, KernelType, ResultType>::
+    evaluateWithPureWeights(
+        const GeometricalData<CoordinateType> &trialGeomData,
+        const CollectionOf4dArrays<KernelType> &kernels,
+        const CollectionOf3dArrays<BasisFunctionType> &trialTransformations,
+        const std::vector<CoordinateType> &weights,
+        _3dArray<ResultType> &result) const {
+  throw std::runtime_error(
+      "WeakFormKernelTrialIntegral::evaluateWithPureWeights(): "
+      "not implemented");
+}
+
+} // namespace Fiber
+
+#endif
@@ -40,6 +40,12 @@ public:
                    int maxBlockSize,
                    const AdmissibilityFunction &admissibilityFunction);
 
+  /** \brief Construct a block cluster tree from an existing tree, e.g. when
+   *  an H-matrix is loaded from a file. */
+  BlockClusterTree(const shared_ptr<const ClusterTree<N>> &rowClusterTree,
+                   const shared_ptr<const ClusterTree<N>> &columnClusterTree,
+                   const shared_ptr<BlockClusterTreeNode<N>> &root);
+
 //  void writeToPdfFile(const std::string &fname, double widthInPoints,
 //                      double heightInPoints) const;
 
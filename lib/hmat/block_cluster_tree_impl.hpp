@@ -27,6 +27,14 @@ BlockClusterTree<N>::BlockClusterTree(
   initializeBlockClusterTree(admissibilityFunction, maxBlockSize);
 }
 
+template <int N>
+BlockClusterTree<N>::BlockClusterTree(
+    const shared_ptr<const ClusterTree<N>> &rowClusterTree,
+    const shared_ptr<const ClusterTree<N>> &columnClusterTree,
+    const shared_ptr<BlockClusterTreeNode<N>> &root)
+    : m_rowClusterTree(rowClusterTree), m_columnClusterTree(columnClusterTree),
+      m_root(root) {}
+
 //template <int N>
 //void BlockClusterTree<N>::writeToPdfFile(const std::string &fname,
 //                                         double widthInPoints,
@@ -112,7 +120,8 @@ BlockClusterTree<N>::columnClusterTree() const {
 template <int N>
 std::vector<shared_ptr<const BlockClusterTreeNode<N>>>
 BlockClusterTree<N>::leafNodes() const {
-  return m_root->leafNodes();
+  shared_ptr<const BlockClusterTreeNode<N>> root = m_root;
+  return root->leafNodes();
 }
 
 template <int N>
@@ -29,6 +29,11 @@ template <int N> class ClusterTree {
 public:
   ClusterTree(const Geometry &geometry, int minBlockSize);
 
+  /** \brief Construct a cluster tree from an existing tree and DOF
+   *  permutation, e.g. when an H-matrix is loaded from a file. */
+  ClusterTree(const shared_ptr<ClusterTreeNode<N>> &root,
+              const DofPermutation &dofPermutation);
+
   const shared_ptr<const ClusterTreeNode<N>> root() const;
   const shared_ptr<ClusterTreeNode<N>> root();
 
@@ -13,6 +13,7 @@
 
 #include <functional>
 #include <cassert>
+#include <stdexcept>
 
 namespace hmat {
 
@@ -28,6 +29,16 @@ ClusterTree<N>::ClusterTree(const Geometry &geometry, int minBlockSize)
   splitClusterTreeByGeometry(geometry, m_dofPermutation, minBlockSize);
 }
 
+template <int N>
+ClusterTree<N>::ClusterTree(const shared_ptr<ClusterTreeNode<N>> &root,
+                            const DofPermutation &dofPermutation)
+    : m_root(root), m_dofPermutation(dofPermutation) {
+
+  if (m_dofPermutation.numberOfDofs() != numberOfDofs())
+    throw std::runtime_error("ClusterTree::ClusterTree(): "
+                             "DOF permutation does not match the tree.");
+}
+
 template <int N> std::size_t ClusterTree<N>::numberOfDofs() const {
   return (m_root->data().indexRange[1] - m_root->data().indexRange[0]);
 }
@@ -175,7 +186,8 @@ template <int N>
 std::vector<shared_ptr<const ClusterTreeNode<N>>>
 ClusterTree<N>::leafNodes() const {
 
-  return m_root->leafNodes;
+  shared_ptr<const ClusterTreeNode<N>> root = m_root;
+  return root->leafNodes();
 }
 
 template <int N>
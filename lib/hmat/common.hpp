@@ -26,6 +26,12 @@ enum TransposeMode {
   CONJTRANS
 };
 
+enum MatrixSymmetry {
+  NOSYMM,
+  SYMM, // A = A^T
+  HERM  // A = A^H
+};
+
 IndexSetType fillIndexRange(std::size_t start, std::size_t stop);
 }
 
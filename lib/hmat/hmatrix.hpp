@@ -9,11 +9,17 @@
 #include "data_accessor.hpp"
 #include "compressed_matrix.hpp"
 #include <armadillo>
-#include <unordered_map>
+#include <tbb/concurrent_queue.h>
+#include <tbb/concurrent_unordered_map.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <utility>
+#include <vector>
 
 namespace hmat {
 
 template <typename ValueType> class HMatrixData;
+template <typename ValueType> class HMatrixDenseData;
+template <typename ValueType> class HMatrixLowRankData;
 template <typename ValueType, int N> class HMatrix;
 
 template <typename ValueType> using DefaultHMatrixType = HMatrix<ValueType, 2>;
@@ -21,9 +27,25 @@ template <typename ValueType> using DefaultHMatrixType = HMatrix<ValueType, 2>;
 template <typename ValueType, int N>
 class HMatrix : public CompressedMatrix<ValueType> {
 public:
-  HMatrix(const shared_ptr<BlockClusterTree<N>> &blockClusterTree);
+  /** \brief Constructor.
+   *
+   *  For a symmetric or Hermitian matrix only the blocks on and above the
+   *  block diagonal are compressed and stored. The remaining blocks are
+   *  applied as the transposes or adjoints of their mirror images. This
+   *  requires identical row and column cluster trees. */
   HMatrix(const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
-          const HMatrixCompressor<ValueType, N> &hMatrixCompressor);
+          MatrixSymmetry symmetry = NOSYMM);
+  HMatrix(const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
+          const HMatrixCompressor<ValueType, N> &hMatrixCompressor,
+          MatrixSymmetry symmetry = NOSYMM);
+
+  /** \brief Construct an H-matrix from the already computed data of its
+   *  stored leaves, e.g. when it is loaded from a file. */
+  HMatrix(const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
+          const std::vector<std::pair<shared_ptr<BlockClusterTreeNode<N>>,
+                                      shared_ptr<HMatrixData<ValueType>>>> &
+              leafData,
+          MatrixSymmetry symmetry = NOSYMM);
 
   std::size_t rows() const override;
   std::size_t columns() const override;
@@ -32,10 +54,52 @@ public:
   bool isInitialized() const;
   void reset();
 
+  MatrixSymmetry symmetry() const;
+
+  /** \brief Return true if the block is stored by the matrix.
+   *
+   *  For symmetric and Hermitian matrices this is false for blocks below
+   *  the block diagonal. */
+  bool isStoredBlock(const BlockClusterTreeNode<N> &node) const;
+
+  /** \brief Truncate the ranks of all low-rank blocks in parallel.
+   *
+   *  See HMatrixLowRankData::recompress(). */
+  void recompress(double eps);
+
+  /** \brief Merge sibling low-rank blocks where this saves memory.
+   *
+   *  The block cluster tree is traversed bottom-up. If all children of a
+   *  node are low-rank leaves, their joint representation is recompressed
+   *  to the accuracy eps. If it needs less storage than the children, the
+   *  children are removed from the tree and the node becomes a low-rank
+   *  leaf. */
+  void coarsen(double eps);
+
+  /** \brief Return the memory used by the blocks of the matrix. */
+  double memSizeKb() const;
+
+  shared_ptr<const BlockClusterTree<N>> blockClusterTree() const;
+
+  /** \brief Return the data of a leaf of the block cluster tree. */
+  shared_ptr<const HMatrixData<ValueType>>
+  data(const shared_ptr<const BlockClusterTreeNode<N>> &leafNode) const;
+
   void apply(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
              TransposeMode trans, ValueType alpha, ValueType beta) const
       override;
 
+  /** \brief Enable or disable the multithreaded matrix-vector product.
+   *
+   *  In parallel mode the products of the leaves are computed in parallel
+   *  and then summed by the leaves of the output cluster tree, so that each
+   *  thread writes to its own range of the result. The permuted vectors
+   *  and the leaf products are stored in workspaces that are reused by
+   *  later calls. The function may be called concurrently; each concurrent
+   *  call takes its own workspace. Parallel mode is enabled by default. */
+  void enableParallelApply(bool value = true);
+  bool isParallelApplyEnabled() const;
+
   arma::Mat<ValueType> permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
                                             RowColSelector rowOrColumn) const
       override;
@@ -44,9 +108,86 @@ public:
                            RowColSelector rowOrColumn) const override;
 
 private:
+  struct ApplyLeaf {
+    IndexRangeType rowRange;
+    IndexRangeType columnRange;
+    const HMatrixDenseData<ValueType> *denseData;
+    const HMatrixLowRankData<ValueType> *lowRankData;
+    bool diagonal;
+  };
+
+  struct ApplyScheduleEntry {
+    std::size_t leafIndex;
+    std::size_t offset; // position of the output range inside the leaf
+  };
+
+  struct ApplyScheduleGroup {
+    IndexRangeType outputRange;
+    std::vector<ApplyScheduleEntry> entries;
+  };
+
+  // Buffers of one call to applyParallel()
+  struct ApplyWorkspace {
+    arma::Mat<ValueType> xPermuted;
+    arma::Mat<ValueType> yPermuted;
+    // Products of the stored leaves and of their mirror images with the
+    // corresponding ranges of xPermuted
+    std::vector<arma::Mat<ValueType>> leafProducts;
+    std::vector<arma::Mat<ValueType>> mirroredLeafProducts;
+  };
+
+  // Buffers used by a thread while it multiplies a single leaf
+  struct ApplyThreadBuffers {
+    std::vector<ValueType> input;
+    std::vector<ValueType> inner;
+  };
+
+  void initializeApplySchedule();
+  void createApplySchedule(const ClusterTree<N> &outputClusterTree,
+                           RowColSelector rowOrColumn,
+                           std::vector<ApplyScheduleGroup> &schedule) const;
+
+  void applySerial(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
+                   TransposeMode trans, ValueType alpha, ValueType beta) const;
+  void applyParallel(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
+                     TransposeMode trans, ValueType alpha,
+                     ValueType beta) const;
+  void applyLeaf(const ApplyLeaf &leaf, TransposeMode mode,
+                 const arma::Mat<ValueType> &xPermuted,
+                 arma::Mat<ValueType> &product) const;
+
+  // Mode in which the stored blocks are applied and mode in which their
+  // mirror images below the block diagonal are applied
+  TransposeMode directTransposeMode(TransposeMode trans) const;
+  TransposeMode mirroredTransposeMode(TransposeMode trans) const;
+
+  void permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
+                            RowColSelector rowOrColumn,
+                            arma::Mat<ValueType> &result) const;
+  void permuteMatToOriginalDofs(const arma::Mat<ValueType> &mat,
+                                RowColSelector rowOrColumn,
+                                arma::Mat<ValueType> &result) const;
+
+  typedef tbb::concurrent_unordered_map<
+      shared_ptr<BlockClusterTreeNode<N>>, shared_ptr<HMatrixData<ValueType>>,
+      std::hash<shared_ptr<BlockClusterTreeNode<N>>>> ParallelDataContainer;
+
   shared_ptr<BlockClusterTree<N>> m_blockClusterTree;
-  std::unordered_map<shared_ptr<BlockClusterTreeNode<N>>,
-                     shared_ptr<HMatrixData<ValueType>>> m_hMatrixData;
+  ParallelDataContainer m_hMatrixData;
+  MatrixSymmetry m_symmetry;
+
+  bool m_parallelApply;
+  std::vector<ApplyLeaf> m_applyLeaves;
+  std::vector<ApplyScheduleGroup> m_rowApplySchedule;
+  std::vector<ApplyScheduleGroup> m_columnApplySchedule;
+  // Workspaces not used by any running call to applyParallel(). A call
+  // from a task of an enclosing parallel loop can be interrupted by
+  // another call on the same thread, so the workspaces cannot be
+  // thread-specific.
+  mutable tbb::concurrent_queue<shared_ptr<ApplyWorkspace>> m_applyWorkspaces;
+  // Used only in code that does not spawn tasks, so thread-specific
+  mutable tbb::enumerable_thread_specific<ApplyThreadBuffers>
+      m_applyThreadBuffers;
 };
 }
 
@@ -7,35 +7,72 @@
 #include "hmatrix_compressor.hpp"
 #include "hmatrix_dense_compressor.hpp"
 #include "data_accessor.hpp"
-#include <set>
+#include "scalar_traits.hpp"
+#include <vector>
 
 namespace hmat {
 
+enum AcaPivoting {
+  PARTIAL_PIVOTING, // next row from the largest entry of the last column
+  ACA_PLUS          // additionally track a reference row and column
+};
+
 template <typename ValueType, int N>
 class HMatrixAcaCompressor : public HMatrixCompressor<ValueType, N> {
 public:
   HMatrixAcaCompressor(const DataAccessor<ValueType, N> &dataAccessor,
                        double eps, unsigned int maxRank,
-                       unsigned int resizeThreshold = 10);
+                       unsigned int resizeThreshold = 10,
+                       AcaPivoting pivoting = PARTIAL_PIVOTING);
 
   void compressBlock(const BlockClusterTreeNode<N> &blockClusterTreeNode,
                      shared_ptr<HMatrixData<ValueType>> &hMatrixData) const
       override;
 
 private:
+  typedef typename ScalarTraits<ValueType>::RealType RealType;
+
+  std::size_t
+  partiallyPivotedAca(const BlockClusterTreeNode<N> &blockClusterTreeNode,
+                      arma::Mat<ValueType> &A, arma::Mat<ValueType> &B) const;
+
+  std::size_t acaPlus(const BlockClusterTreeNode<N> &blockClusterTreeNode,
+                      arma::Mat<ValueType> &A, arma::Mat<ValueType> &B) const;
+
+  void evaluateRow(const BlockClusterTreeNode<N> &blockClusterTreeNode,
+                   std::size_t row, arma::Mat<ValueType> &data,
+                   const arma::Mat<ValueType> &A, const arma::Mat<ValueType> &B,
+                   std::size_t rank) const;
+
+  void evaluateColumn(const BlockClusterTreeNode<N> &blockClusterTreeNode,
+                      std::size_t column, arma::Mat<ValueType> &data,
+                      const arma::Mat<ValueType> &A,
+                      const arma::Mat<ValueType> &B, std::size_t rank) const;
+
   void evaluateMatMinusLowRank(
       const BlockClusterTreeNode<N> &blockClusterTreeNode,
       const IndexRangeType &rowIndexRange,
       const IndexRangeType &columnIndexRange, arma::Mat<ValueType> &data,
-      const arma::Mat<ValueType> &A, const arma::Mat<ValueType> &B) const;
+      const arma::Mat<ValueType> &A, const arma::Mat<ValueType> &B,
+      std::size_t rank) const;
+
+  bool addCross(const arma::Mat<ValueType> &newCol,
+                const arma::Mat<ValueType> &newRow, arma::Mat<ValueType> &A,
+                arma::Mat<ValueType> &B, std::size_t &rank,
+                RealType &frobeniusNormSquared) const;
 
-  static std::size_t randomIndex(const IndexRangeType &range,
-                                 std::set<std::size_t> &previousIndices);
+  static std::size_t maxAbsIndex(const arma::Mat<ValueType> &data,
+                                 const std::vector<bool> &usedIndices,
+                                 RealType &maxValue);
+  static std::size_t minAbsIndex(const arma::Mat<ValueType> &data,
+                                 const std::vector<bool> &usedIndices);
+  static std::size_t firstUnusedIndex(const std::vector<bool> &usedIndices);
 
   const DataAccessor<ValueType, N> &m_dataAccessor;
   double m_eps;
   unsigned int m_maxRank;
   unsigned int m_resizeThreshold;
+  AcaPivoting m_pivoting;
   HMatrixDenseCompressor<ValueType, N> m_hMatrixDenseCompressor;
 };
 }
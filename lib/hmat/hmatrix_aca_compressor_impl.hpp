@@ -6,7 +6,6 @@
 #include "hmatrix_aca_compressor.hpp"
 #include "hmatrix_low_rank_data.hpp"
 #include "scalar_traits.hpp"
-#include <random>
 #include <complex>
 #include <cmath>
 #include <algorithm>
@@ -40,93 +39,265 @@ void HMatrixAcaCompressor<ValueType, N>::compressBlock(
   arma::Mat<ValueType> &B =
       static_cast<HMatrixLowRankData<ValueType> *>(hMatrixData.get())->B();
 
-  A.resize(numberOfRows, m_resizeThreshold);
-  B.resize(m_resizeThreshold, numberOfColumns);
+  A.zeros(numberOfRows, m_resizeThreshold);
+  B.zeros(m_resizeThreshold, numberOfColumns);
 
-  std::set<std::size_t> previousRowIndices;
-  std::set<std::size_t> previousColumnIndices;
+  std::size_t rankCount;
+  if (m_pivoting == ACA_PLUS)
+    rankCount = acaPlus(blockClusterTreeNode, A, B);
+  else
+    rankCount = partiallyPivotedAca(blockClusterTreeNode, A, B);
+
+  if (A.n_cols - rankCount > 0) {
+    A.shed_cols(rankCount, A.n_cols - 1);
+    B.shed_rows(rankCount, B.n_rows - 1);
+  }
+}
+
+template <typename ValueType, int N>
+std::size_t HMatrixAcaCompressor<ValueType, N>::partiallyPivotedAca(
+    const BlockClusterTreeNode<N> &blockClusterTreeNode,
+    arma::Mat<ValueType> &A, arma::Mat<ValueType> &B) const {
+
+  const std::size_t numberOfRows = A.n_rows;
+  const std::size_t numberOfColumns = B.n_cols;
 
   std::size_t iterationLimit =
       std::min(static_cast<std::size_t>(m_maxRank),
                std::min(numberOfRows, numberOfColumns));
 
+  std::vector<bool> usedRows(numberOfRows, false);
+  std::vector<bool> usedColumns(numberOfColumns, false);
+
   std::size_t rankCount = 0;
+  std::size_t zeroRowCount = 0;
+  RealType frobeniusNormSquared = 0;
 
-  std::size_t sizeMultiplier = 0;
+  arma::Mat<ValueType> newRow;
+  arma::Mat<ValueType> newCol;
 
-  for (int i = 0; i < iterationLimit; ++i) {
+  std::size_t row = 0;
 
-    std::size_t row = randomIndex(rowClusterRange, previousRowIndices);
+  while (rankCount < iterationLimit) {
 
-    // Compute complete row
+    usedRows[row] = true;
+    evaluateRow(blockClusterTreeNode, row, newRow, A, B, rankCount);
 
-    arma::Mat<ValueType> newRow;
-    arma::Mat<ValueType> newCol;
+    RealType maxValue;
+    std::size_t column = maxAbsIndex(newRow, usedColumns, maxValue);
+    if (column == numberOfColumns)
+      break;
+
+    if (maxValue < 1E-12) {
+      // Row is effectively zero. Continue with the next unused row, but
+      // give up if this happens too often.
+      if (++zeroRowCount == iterationLimit)
+        break;
+      row = firstUnusedIndex(usedRows);
+      if (row == numberOfRows)
+        break;
+      continue;
+    }
+
+    newRow = newRow / newRow(0, column);
+    usedColumns[column] = true;
+
+    evaluateColumn(blockClusterTreeNode, column, newCol, A, B, rankCount);
+
+    if (addCross(newCol, newRow, A, B, rankCount, frobeniusNormSquared))
+      break;
+
+    // The next row is the one with the largest entry of the new column.
+    row = maxAbsIndex(newCol, usedRows, maxValue);
+    if (row == numberOfRows)
+      break;
+  }
+  return rankCount;
+}
 
-    IndexRangeType rowIndexRange = {{row, row + 1}};
-    IndexRangeType columnIndexRange = columnClusterRange;
+template <typename ValueType, int N>
+std::size_t HMatrixAcaCompressor<ValueType, N>::acaPlus(
+    const BlockClusterTreeNode<N> &blockClusterTreeNode,
+    arma::Mat<ValueType> &A, arma::Mat<ValueType> &B) const {
 
-    evaluateMatMinusLowRank(blockClusterTreeNode, rowIndexRange,
-                            columnIndexRange, newRow, A, B);
+  const std::size_t numberOfRows = A.n_rows;
+  const std::size_t numberOfColumns = B.n_cols;
 
-    arma::uword maxRowInd;
-    arma::uword maxColInd;
+  std::size_t iterationLimit =
+      std::min(static_cast<std::size_t>(m_maxRank),
+               std::min(numberOfRows, numberOfColumns));
 
-    arma::Mat<typename ScalarTraits<ValueType>::RealType> absMat =
-        arma::abs(newRow);
+  std::vector<bool> usedRows(numberOfRows, false);
+  std::vector<bool> usedColumns(numberOfColumns, false);
 
-    if (absMat.max(maxRowInd, maxColInd) < 1E-12)
-      continue; // Row is effectively zero
+  std::size_t rankCount = 0;
+  RealType frobeniusNormSquared = 0;
 
-    auto pivot = newRow(0, maxColInd);
+  arma::Mat<ValueType> newRow;
+  arma::Mat<ValueType> newCol;
 
-    newRow = newRow / (pivot);
+  // The reference column is the first column of the block. The reference
+  // row is where the reference column is smallest, which makes it unlikely
+  // that both are dominated by the same cross.
 
-    // Now evaluate column
+  arma::Mat<ValueType> referenceColumnData;
+  arma::Mat<ValueType> referenceRowData;
 
-    maxColInd += columnClusterRange[0]; // Map back to original variables
-    rowIndexRange = rowClusterRange;
-    columnIndexRange = {{maxColInd, maxColInd + 1}};
+  std::size_t referenceColumn = 0;
+  evaluateColumn(blockClusterTreeNode, referenceColumn, referenceColumnData, A,
+                 B, rankCount);
+  std::size_t referenceRow = minAbsIndex(referenceColumnData, usedRows);
+  evaluateRow(blockClusterTreeNode, referenceRow, referenceRowData, A, B,
+              rankCount);
 
-    evaluateMatMinusLowRank(blockClusterTreeNode, rowIndexRange,
-                            columnIndexRange, newCol, A, B);
+  while (rankCount < iterationLimit) {
 
-    auto frobeniousNorm = hMatrixData->frobeniusNorm();
+    RealType maxColumnValue;
+    RealType maxRowValue;
+    std::size_t rowCandidate =
+        maxAbsIndex(referenceColumnData, usedRows, maxColumnValue);
+    std::size_t columnCandidate =
+        maxAbsIndex(referenceRowData, usedColumns, maxRowValue);
 
-    if (rankCount == A.n_cols) {
-      sizeMultiplier++;
-      A.insert_cols(sizeMultiplier * m_resizeThreshold, m_resizeThreshold);
-      B.insert_rows(sizeMultiplier * m_resizeThreshold, m_resizeThreshold);
+    if (rowCandidate == numberOfRows || columnCandidate == numberOfColumns)
+      break;
+    if (std::max(maxColumnValue, maxRowValue) < 1E-12)
+      break; // Both references are effectively zero
+
+    std::size_t row;
+    std::size_t column;
+    RealType maxValue;
+
+    if (maxRowValue > maxColumnValue) {
+      column = columnCandidate;
+      evaluateColumn(blockClusterTreeNode, column, newCol, A, B, rankCount);
+      row = maxAbsIndex(newCol, usedRows, maxValue);
+      if (row == numberOfRows)
+        break;
+      evaluateRow(blockClusterTreeNode, row, newRow, A, B, rankCount);
+    } else {
+      row = rowCandidate;
+      evaluateRow(blockClusterTreeNode, row, newRow, A, B, rankCount);
+      column = maxAbsIndex(newRow, usedColumns, maxValue);
+      if (column == numberOfColumns)
+        break;
+      evaluateColumn(blockClusterTreeNode, column, newCol, A, B, rankCount);
     }
 
-    A.col(rankCount) = newCol;
-    B.row(rankCount) = newRow;
+    auto pivot = newRow(0, column);
+    if (std::abs(pivot) < 1E-12)
+      break;
+
+    newRow = newRow / pivot;
+    usedRows[row] = true;
+    usedColumns[column] = true;
 
-    rankCount++;
+    referenceColumnData -= newCol * newRow(0, referenceColumn);
+    referenceRowData -= newCol(referenceRow, 0) * newRow;
 
-    if (arma::norm(newCol, 2) * arma::norm(newRow, 2) < m_eps * frobeniousNorm)
+    if (addCross(newCol, newRow, A, B, rankCount, frobeniusNormSquared))
       break;
+
+    if (column == referenceColumn ||
+        arma::abs(referenceColumnData).max() < 1E-12) {
+      referenceColumn = firstUnusedIndex(usedColumns);
+      if (referenceColumn == numberOfColumns)
+        break;
+      evaluateColumn(blockClusterTreeNode, referenceColumn,
+                     referenceColumnData, A, B, rankCount);
+    }
+    if (row == referenceRow || arma::abs(referenceRowData).max() < 1E-12) {
+      referenceRow = minAbsIndex(referenceColumnData, usedRows);
+      if (referenceRow == numberOfRows)
+        break;
+      evaluateRow(blockClusterTreeNode, referenceRow, referenceRowData, A, B,
+                  rankCount);
+    }
   }
-  if (A.n_cols - rankCount > 0) {
-    A.shed_cols(rankCount, A.n_cols - 1);
-    B.shed_rows(rankCount, B.n_rows - 1);
-  }
+  return rankCount;
 }
 
 template <typename ValueType, int N>
 HMatrixAcaCompressor<ValueType, N>::HMatrixAcaCompressor(
     const DataAccessor<ValueType, N> &dataAccessor, double eps,
-    unsigned int maxRank, unsigned int resizeThreshold)
+    unsigned int maxRank, unsigned int resizeThreshold, AcaPivoting pivoting)
     : m_dataAccessor(dataAccessor), m_eps(eps), m_maxRank(maxRank),
-      m_resizeThreshold(resizeThreshold),
+      m_resizeThreshold(resizeThreshold), m_pivoting(pivoting),
       m_hMatrixDenseCompressor(dataAccessor) {}
 
+template <typename ValueType, int N>
+bool HMatrixAcaCompressor<ValueType, N>::addCross(
+    const arma::Mat<ValueType> &newCol, const arma::Mat<ValueType> &newRow,
+    arma::Mat<ValueType> &A, arma::Mat<ValueType> &B, std::size_t &rank,
+    RealType &frobeniusNormSquared) const {
+
+  if (rank == A.n_cols) {
+    A.insert_cols(A.n_cols, m_resizeThreshold);
+    B.insert_rows(B.n_rows, m_resizeThreshold);
+  }
+
+  RealType newColNorm = arma::norm(newCol, 2);
+  RealType newRowNorm = arma::norm(newRow, 2);
+
+  // Update the Frobenius norm of the approximation incrementally:
+  // |S + ab|^2 = |S|^2 + 2 Re sum_j (a_j^H a)(b_j^H b) + |a|^2 |b|^2
+
+  if (rank > 0) {
+    arma::Mat<ValueType> columnProducts = A.cols(0, rank - 1).t() * newCol;
+    arma::Mat<ValueType> rowProducts =
+        arma::conj(B.rows(0, rank - 1)) * newRow.st();
+    frobeniusNormSquared +=
+        2 * std::real(arma::accu(columnProducts % rowProducts));
+  }
+  frobeniusNormSquared += newColNorm * newColNorm * newRowNorm * newRowNorm;
+
+  A.col(rank) = newCol;
+  B.row(rank) = newRow;
+  ++rank;
+
+  return newColNorm * newRowNorm <= m_eps * std::sqrt(frobeniusNormSquared);
+}
+
+template <typename ValueType, int N>
+void HMatrixAcaCompressor<ValueType, N>::evaluateRow(
+    const BlockClusterTreeNode<N> &blockClusterTreeNode, std::size_t row,
+    arma::Mat<ValueType> &data, const arma::Mat<ValueType> &A,
+    const arma::Mat<ValueType> &B, std::size_t rank) const {
+
+  auto rowClusterRange =
+      blockClusterTreeNode.data().rowClusterTreeNode->data().indexRange;
+  auto columnClusterRange =
+      blockClusterTreeNode.data().columnClusterTreeNode->data().indexRange;
+
+  IndexRangeType rowIndexRange = {
+      {rowClusterRange[0] + row, rowClusterRange[0] + row + 1}};
+  evaluateMatMinusLowRank(blockClusterTreeNode, rowIndexRange,
+                          columnClusterRange, data, A, B, rank);
+}
+
+template <typename ValueType, int N>
+void HMatrixAcaCompressor<ValueType, N>::evaluateColumn(
+    const BlockClusterTreeNode<N> &blockClusterTreeNode, std::size_t column,
+    arma::Mat<ValueType> &data, const arma::Mat<ValueType> &A,
+    const arma::Mat<ValueType> &B, std::size_t rank) const {
+
+  auto rowClusterRange =
+      blockClusterTreeNode.data().rowClusterTreeNode->data().indexRange;
+  auto columnClusterRange =
+      blockClusterTreeNode.data().columnClusterTreeNode->data().indexRange;
+
+  IndexRangeType columnIndexRange = {
+      {columnClusterRange[0] + column, columnClusterRange[0] + column + 1}};
+  evaluateMatMinusLowRank(blockClusterTreeNode, rowClusterRange,
+                          columnIndexRange, data, A, B, rank);
+}
+
 template <typename ValueType, int N>
 void HMatrixAcaCompressor<ValueType, N>::evaluateMatMinusLowRank(
     const BlockClusterTreeNode<N> &blockClusterTreeNode,
     const IndexRangeType &rowIndexRange, const IndexRangeType &columnIndexRange,
     arma::Mat<ValueType> &data, const arma::Mat<ValueType> &A,
-    const arma::Mat<ValueType> &B) const {
+    const arma::Mat<ValueType> &B, std::size_t rank) const {
 
   auto rowClusterRange =
       blockClusterTreeNode.data().rowClusterTreeNode->data().indexRange;
@@ -136,44 +307,62 @@ void HMatrixAcaCompressor<ValueType, N>::evaluateMatMinusLowRank(
   m_dataAccessor.computeMatrixBlock(rowIndexRange, columnIndexRange,
                                     blockClusterTreeNode, data);
 
+  if (rank == 0)
+    return;
+
   auto rowStart = rowIndexRange[0] - rowClusterRange[0];
   auto rowEnd = rowIndexRange[1] - rowClusterRange[0];
 
   auto colStart = columnIndexRange[0] - columnClusterRange[0];
   auto colEnd = columnIndexRange[1] - columnClusterRange[0];
 
-  data = data - A.submat(rowStart, 0, rowEnd - 1, A.n_cols - 1) *
-                    B.submat(0, colStart, B.n_rows - 1, colEnd - 1);
+  data = data - A.submat(rowStart, 0, rowEnd - 1, rank - 1) *
+                    B.submat(0, colStart, rank - 1, colEnd - 1);
 }
 
 template <typename ValueType, int N>
-std::size_t HMatrixAcaCompressor<ValueType, N>::randomIndex(
-    const IndexRangeType &range, std::set<std::size_t> &previousIndices) {
-
-  std::size_t numberOfPossibleIndices =
-      range[1] - range[0] - previousIndices.size();
-  static std::random_device generator;
-  std::uniform_int_distribution<std::size_t> distribution(
-      0, numberOfPossibleIndices - 1);
-
-  std::size_t ind = distribution(generator); // New random position
-
-  // Turn the random position into a previously not used index in the range.
+std::size_t HMatrixAcaCompressor<ValueType, N>::maxAbsIndex(
+    const arma::Mat<ValueType> &data, const std::vector<bool> &usedIndices,
+    RealType &maxValue) {
+
+  std::size_t index = usedIndices.size();
+  maxValue = 0;
+  for (std::size_t i = 0; i < usedIndices.size(); ++i) {
+    if (usedIndices[i])
+      continue;
+    RealType value = std::abs(data(i));
+    if (index == usedIndices.size() || value > maxValue) {
+      index = i;
+      maxValue = value;
+    }
+  }
+  return index;
+}
 
-  std::size_t newIndex = range[0];
+template <typename ValueType, int N>
+std::size_t HMatrixAcaCompressor<ValueType, N>::minAbsIndex(
+    const arma::Mat<ValueType> &data, const std::vector<bool> &usedIndices) {
 
-  std::size_t count = 0;
-  while (count <= ind) {
-    if (!previousIndices.count(newIndex)) {
-      count++;
-      if (count <= ind)
-        newIndex++;
+  std::size_t index = usedIndices.size();
+  RealType minValue = 0;
+  for (std::size_t i = 0; i < usedIndices.size(); ++i) {
+    if (usedIndices[i])
       continue;
+    RealType value = std::abs(data(i));
+    if (index == usedIndices.size() || value < minValue) {
+      index = i;
+      minValue = value;
     }
-    newIndex++;
   }
-  previousIndices.insert(newIndex);
-  return newIndex;
+  return index;
+}
+
+template <typename ValueType, int N>
+std::size_t HMatrixAcaCompressor<ValueType, N>::firstUnusedIndex(
+    const std::vector<bool> &usedIndices) {
+
+  return std::find(begin(usedIndices), end(usedIndices), false) -
+         begin(usedIndices);
 }
 }
 
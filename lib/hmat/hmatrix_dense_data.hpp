@@ -12,6 +12,15 @@ namespace hmat {
 template <typename ValueType>
 class HMatrixDenseData : public HMatrixData<ValueType> {
 public:
+  HMatrixDenseData();
+
+  /** \brief Construct a block whose entries are stored in external memory.
+   *
+   *  The column-major array A is used without copying. It must stay valid
+   *  as long as memoryOwner is alive. */
+  HMatrixDenseData(ValueType *A, std::size_t rows, std::size_t cols,
+                   const shared_ptr<void> &memoryOwner);
+
   void apply(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
              TransposeMode trans, ValueType alpha, ValueType beta) const
       override;
@@ -33,6 +42,7 @@ public:
 
 private:
   arma::Mat<ValueType> m_A;
+  shared_ptr<void> m_memoryOwner;
 };
 }
 
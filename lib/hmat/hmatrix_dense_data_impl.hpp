@@ -10,6 +10,14 @@
 
 namespace hmat {
 
+template <typename ValueType> HMatrixDenseData<ValueType>::HMatrixDenseData() {}
+
+template <typename ValueType>
+HMatrixDenseData<ValueType>::HMatrixDenseData(
+    ValueType *A, std::size_t rows, std::size_t cols,
+    const shared_ptr<void> &memoryOwner)
+    : m_A(A, rows, cols, false, false), m_memoryOwner(memoryOwner) {}
+
 template <typename ValueType>
 void HMatrixDenseData<ValueType>::apply(const arma::Mat<ValueType> &X,
                                         arma::Mat<ValueType> &Y,
@@ -6,24 +6,60 @@
 #include "hmatrix.hpp"
 #include "hmatrix_data.hpp"
 #include "hmatrix_dense_data.hpp"
+#include "hmatrix_low_rank_data.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <tbb/concurrent_queue.h>
 
 namespace hmat {
 
 template <typename ValueType, int N>
 HMatrix<ValueType, N>::HMatrix(
-    const shared_ptr<BlockClusterTree<N>> &blockClusterTree)
-    : m_blockClusterTree(blockClusterTree) {}
+    const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
+    MatrixSymmetry symmetry)
+    : m_blockClusterTree(blockClusterTree), m_symmetry(symmetry),
+      m_parallelApply(true) {
+
+  if (m_symmetry != NOSYMM &&
+      m_blockClusterTree->rowClusterTree() !=
+          m_blockClusterTree->columnClusterTree())
+    throw std::runtime_error("HMatrix::HMatrix(): "
+                             "Symmetric H-matrices require identical row and "
+                             "column cluster trees.");
+}
 
 template <typename ValueType, int N>
 HMatrix<ValueType, N>::HMatrix(
     const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
-    const HMatrixCompressor<ValueType, N> &hMatrixCompressor)
-    : HMatrix<ValueType, N>(blockClusterTree) {
+    const HMatrixCompressor<ValueType, N> &hMatrixCompressor,
+    MatrixSymmetry symmetry)
+    : HMatrix<ValueType, N>(blockClusterTree, symmetry) {
   initialize(hMatrixCompressor);
 }
 
+template <typename ValueType, int N>
+HMatrix<ValueType, N>::HMatrix(
+    const shared_ptr<BlockClusterTree<N>> &blockClusterTree,
+    const std::vector<std::pair<shared_ptr<BlockClusterTreeNode<N>>,
+                                shared_ptr<HMatrixData<ValueType>>>> &leafData,
+    MatrixSymmetry symmetry)
+    : HMatrix<ValueType, N>(blockClusterTree, symmetry) {
+
+  for (const auto &elem : leafData) {
+    if (!elem.first->isLeaf() || !isStoredBlock(*elem.first))
+      throw std::runtime_error("HMatrix::HMatrix(): "
+                               "Data given for a block that is not a stored "
+                               "leaf.");
+    m_hMatrixData.insert(elem);
+  }
+  initializeApplySchedule();
+}
+
 template <typename ValueType, int N>
 std::size_t HMatrix<ValueType, N>::rows() const {
   return m_blockClusterTree->rows();
@@ -40,14 +76,282 @@ void HMatrix<ValueType, N>::initialize(
 
   reset();
 
-  for (auto node : m_blockClusterTree->leafNodes()) {
-    shared_ptr<HMatrixData<ValueType>> nodeData;
-    hMatrixCompressor.compressBlock(*node, nodeData);
-    m_hMatrixData[node] = nodeData;
-  }
+  auto leafNodes = m_blockClusterTree->leafNodes();
+  leafNodes.erase(
+      std::remove_if(begin(leafNodes), end(leafNodes),
+                     [this](const shared_ptr<BlockClusterTreeNode<N>> &node) {
+                       return !isStoredBlock(*node);
+                     }),
+      end(leafNodes));
+
+  // Compress the largest admissible blocks first. The small dense blocks
+  // at the end of the queue are then used to balance the load between
+  // the threads.
+
+  std::sort(begin(leafNodes), end(leafNodes),
+            [](const shared_ptr<BlockClusterTreeNode<N>> &node1,
+               const shared_ptr<BlockClusterTreeNode<N>> &node2) -> bool {
+
+    if (node1->data().admissible != node2->data().admissible)
+      return node1->data().admissible;
+
+    IndexRangeType rowRange1, columnRange1, rowRange2, columnRange2;
+    std::size_t rows1, columns1, rows2, columns2;
+    getBlockClusterTreeNodeDimensions(*node1, rowRange1, columnRange1, rows1,
+                                      columns1);
+    getBlockClusterTreeNodeDimensions(*node2, rowRange2, columnRange2, rows2,
+                                      columns2);
+    return rows1 * columns1 > rows2 * columns2;
+  });
+
+  tbb::concurrent_queue<std::size_t> leafIndexQueue;
+  for (std::size_t i = 0; i < leafNodes.size(); ++i)
+    leafIndexQueue.push(i);
+
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, leafNodes.size()),
+      [&leafNodes, &leafIndexQueue, &hMatrixCompressor,
+       this](const tbb::blocked_range<std::size_t> &r) {
+        for (std::size_t i = r.begin(); i != r.end(); ++i) {
+          // The range only determines how many blocks a task compresses.
+          // Which blocks are compressed is determined by the queue.
+          std::size_t leafIndex;
+          if (!leafIndexQueue.try_pop(leafIndex))
+            throw std::runtime_error("HMatrix::initialize(): "
+                                     "Leaf index queue is empty.");
+          shared_ptr<HMatrixData<ValueType>> nodeData;
+          hMatrixCompressor.compressBlock(*leafNodes[leafIndex], nodeData);
+          m_hMatrixData.insert(std::make_pair(leafNodes[leafIndex], nodeData));
+        }
+      });
+
+  initializeApplySchedule();
 }
 template <typename ValueType, int N> void HMatrix<ValueType, N>::reset() {
   m_hMatrixData.clear();
+  m_applyLeaves.clear();
+  m_rowApplySchedule.clear();
+  m_columnApplySchedule.clear();
+}
+
+template <typename ValueType, int N>
+MatrixSymmetry HMatrix<ValueType, N>::symmetry() const {
+  return m_symmetry;
+}
+
+template <typename ValueType, int N>
+bool HMatrix<ValueType, N>::isStoredBlock(
+    const BlockClusterTreeNode<N> &node) const {
+
+  if (m_symmetry == NOSYMM)
+    return true;
+  return node.data().rowClusterTreeNode->data().indexRange[0] <=
+         node.data().columnClusterTreeNode->data().indexRange[0];
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::recompress(double eps) {
+
+  std::vector<HMatrixLowRankData<ValueType> *> lowRankBlocks;
+  for (const auto &elem : m_hMatrixData) {
+    auto lowRankData =
+        dynamic_cast<HMatrixLowRankData<ValueType> *>(elem.second.get());
+    if (lowRankData)
+      lowRankBlocks.push_back(lowRankData);
+  }
+
+  tbb::parallel_for(tbb::blocked_range<std::size_t>(0, lowRankBlocks.size()),
+                    [&lowRankBlocks, eps](
+                        const tbb::blocked_range<std::size_t> &r) {
+    for (std::size_t i = r.begin(); i != r.end(); ++i)
+      lowRankBlocks[i]->recompress(eps);
+  });
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::coarsen(double eps) {
+
+  // Returns true if the node is a low-rank leaf after coarsening.
+  std::function<bool(const shared_ptr<BlockClusterTreeNode<N>> &)> coarsenImpl;
+
+  coarsenImpl = [this, eps, &coarsenImpl](
+      const shared_ptr<BlockClusterTreeNode<N>> &node) -> bool {
+
+    if (node->isLeaf()) {
+      auto it = m_hMatrixData.find(node);
+      return (it != m_hMatrixData.end() &&
+              dynamic_cast<HMatrixLowRankData<ValueType> *>(it->second.get()));
+    }
+
+    bool childrenAreLowRank = true;
+    for (int i = 0; i < N * N; ++i)
+      if (!coarsenImpl(node->child(i)))
+        childrenAreLowRank = false;
+
+    if (!childrenAreLowRank)
+      return false;
+
+    const auto &rowRange =
+        node->data().rowClusterTreeNode->data().indexRange;
+    const auto &columnRange =
+        node->data().columnClusterTreeNode->data().indexRange;
+
+    std::size_t jointRank = 0;
+    double childrenMemSizeKb = 0;
+    for (int i = 0; i < N * N; ++i) {
+      const auto &childData = m_hMatrixData.find(node->child(i))->second;
+      jointRank += childData->rank();
+      childrenMemSizeKb += childData->memSizeKb();
+    }
+
+    // Stack the factors of the children into factors of the parent block.
+
+    shared_ptr<HMatrixLowRankData<ValueType>> jointData(
+        new HMatrixLowRankData<ValueType>());
+    jointData->A().zeros(rowRange[1] - rowRange[0], jointRank);
+    jointData->B().zeros(jointRank, columnRange[1] - columnRange[0]);
+
+    std::size_t offset = 0;
+    for (int i = 0; i < N * N; ++i) {
+      auto child = node->child(i);
+      auto childData = static_cast<const HMatrixLowRankData<ValueType> *>(
+          m_hMatrixData.find(child)->second.get());
+      std::size_t childRank = childData->rank();
+      if (childRank == 0)
+        continue;
+      const auto &childRowRange =
+          child->data().rowClusterTreeNode->data().indexRange;
+      const auto &childColumnRange =
+          child->data().columnClusterTreeNode->data().indexRange;
+      jointData->A().submat(childRowRange[0] - rowRange[0], offset,
+                            childRowRange[1] - rowRange[0] - 1,
+                            offset + childRank - 1) = childData->A();
+      jointData->B().submat(offset, childColumnRange[0] - columnRange[0],
+                            offset + childRank - 1,
+                            childColumnRange[1] - columnRange[0] - 1) =
+          childData->B();
+      offset += childRank;
+    }
+
+    jointData->recompress(eps);
+
+    if (jointData->memSizeKb() >= childrenMemSizeKb)
+      return false;
+
+    for (int i = 0; i < N * N; ++i)
+      m_hMatrixData.unsafe_erase(node->child(i));
+    node->removeChildren();
+    node->data().admissible = true;
+    m_hMatrixData.insert(std::make_pair(
+        node, static_cast<shared_ptr<HMatrixData<ValueType>>>(jointData)));
+    return true;
+  };
+
+  coarsenImpl(m_blockClusterTree->root());
+
+  initializeApplySchedule();
+}
+
+template <typename ValueType, int N>
+double HMatrix<ValueType, N>::memSizeKb() const {
+
+  double result = 0;
+  for (const auto &elem : m_hMatrixData)
+    result += elem.second->memSizeKb();
+  return result;
+}
+
+template <typename ValueType, int N>
+shared_ptr<const BlockClusterTree<N>>
+HMatrix<ValueType, N>::blockClusterTree() const {
+  return m_blockClusterTree;
+}
+
+template <typename ValueType, int N>
+shared_ptr<const HMatrixData<ValueType>> HMatrix<ValueType, N>::data(
+    const shared_ptr<const BlockClusterTreeNode<N>> &leafNode) const {
+
+  auto it = m_hMatrixData.find(
+      const_pointer_cast<BlockClusterTreeNode<N>>(leafNode));
+  if (it == m_hMatrixData.end())
+    throw std::runtime_error("HMatrix::data(): "
+                             "Node is not a leaf of the H-matrix.");
+  return it->second;
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::enableParallelApply(bool value) {
+  m_parallelApply = value;
+}
+
+template <typename ValueType, int N>
+bool HMatrix<ValueType, N>::isParallelApplyEnabled() const {
+  return m_parallelApply;
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::initializeApplySchedule() {
+
+  m_applyLeaves.clear();
+
+  for (const auto &elem : m_hMatrixData) {
+    ApplyLeaf leaf;
+    leaf.rowRange = elem.first->data().rowClusterTreeNode->data().indexRange;
+    leaf.columnRange =
+        elem.first->data().columnClusterTreeNode->data().indexRange;
+    leaf.denseData =
+        dynamic_cast<const HMatrixDenseData<ValueType> *>(elem.second.get());
+    leaf.lowRankData =
+        dynamic_cast<const HMatrixLowRankData<ValueType> *>(elem.second.get());
+    if (!leaf.denseData && !leaf.lowRankData)
+      throw std::runtime_error("HMatrix::initializeApplySchedule(): "
+                               "Unsupported type of leaf data.");
+    leaf.diagonal = (leaf.rowRange == leaf.columnRange);
+    m_applyLeaves.push_back(leaf);
+  }
+
+  createApplySchedule(*(m_blockClusterTree->rowClusterTree()), ROW,
+                      m_rowApplySchedule);
+  createApplySchedule(*(m_blockClusterTree->columnClusterTree()), COL,
+                      m_columnApplySchedule);
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::createApplySchedule(
+    const ClusterTree<N> &outputClusterTree, RowColSelector rowOrColumn,
+    std::vector<ApplyScheduleGroup> &schedule) const {
+
+  // The leaves of the output cluster tree partition the output vector into
+  // disjoint ranges. Every block is split along these ranges.
+
+  auto clusterLeaves = outputClusterTree.leafNodes();
+
+  schedule.clear();
+  schedule.resize(clusterLeaves.size());
+
+  std::vector<std::size_t> rangeStarts(clusterLeaves.size());
+  for (std::size_t i = 0; i < clusterLeaves.size(); ++i) {
+    schedule[i].outputRange = clusterLeaves[i]->data().indexRange;
+    rangeStarts[i] = schedule[i].outputRange[0];
+  }
+
+  for (std::size_t leafIndex = 0; leafIndex < m_applyLeaves.size();
+       ++leafIndex) {
+    const auto &range = (rowOrColumn == ROW)
+                            ? m_applyLeaves[leafIndex].rowRange
+                            : m_applyLeaves[leafIndex].columnRange;
+    auto first = std::lower_bound(begin(rangeStarts), end(rangeStarts),
+                                  range[0]) -
+                 begin(rangeStarts);
+    for (std::size_t group = first;
+         group < schedule.size() && schedule[group].outputRange[0] < range[1];
+         ++group) {
+      ApplyScheduleEntry entry;
+      entry.leafIndex = leafIndex;
+      entry.offset = schedule[group].outputRange[0] - range[0];
+      schedule[group].entries.push_back(entry);
+    }
+  }
 }
 
 template <typename ValueType, int N>
@@ -60,7 +364,24 @@ arma::Mat<ValueType>
 HMatrix<ValueType, N>::permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
                                             RowColSelector rowOrColumn) const {
 
-  arma::Mat<ValueType> permutedDofs(mat.n_rows, mat.n_cols);
+  arma::Mat<ValueType> permutedDofs;
+  permuteMatToHMatDofs(mat, rowOrColumn, permutedDofs);
+  return permutedDofs;
+}
+
+template <typename ValueType, int N>
+arma::Mat<ValueType> HMatrix<ValueType, N>::permuteMatToOriginalDofs(
+    const arma::Mat<ValueType> &mat, RowColSelector rowOrColumn) const {
+
+  arma::Mat<ValueType> originalDofs;
+  permuteMatToOriginalDofs(mat, rowOrColumn, originalDofs);
+  return originalDofs;
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::permuteMatToHMatDofs(
+    const arma::Mat<ValueType> &mat, RowColSelector rowOrColumn,
+    arma::Mat<ValueType> &result) const {
 
   shared_ptr<const ClusterTree<N>> clusterTree;
 
@@ -73,20 +394,19 @@ HMatrix<ValueType, N>::permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
     throw std::runtime_error("HMatrix::permuteMatToHMatDofs: "
                              "Input matrix has wrong number of rows.");
 
-  for (std::size_t i = 0; i < mat.n_rows; ++i) {
-    auto permutedIndex = clusterTree->mapOriginalDofToHMatDof(i);
-    for (std::size_t j = 0; j < mat.n_cols; ++j)
-      permutedDofs(permutedIndex, j) = mat(i, j);
-  }
+  // Does not reallocate if result already has the right size
+  result.set_size(mat.n_rows, mat.n_cols);
 
-  return permutedDofs;
+  const auto &originalToHMat = clusterTree->originalDofToHMatDofMap();
+  for (std::size_t j = 0; j < mat.n_cols; ++j)
+    for (std::size_t i = 0; i < mat.n_rows; ++i)
+      result(originalToHMat[i], j) = mat(i, j);
 }
 
 template <typename ValueType, int N>
-arma::Mat<ValueType> HMatrix<ValueType, N>::permuteMatToOriginalDofs(
-    const arma::Mat<ValueType> &mat, RowColSelector rowOrColumn) const {
-
-  arma::Mat<ValueType> originalDofs(mat.n_rows, mat.n_cols);
+void HMatrix<ValueType, N>::permuteMatToOriginalDofs(
+    const arma::Mat<ValueType> &mat, RowColSelector rowOrColumn,
+    arma::Mat<ValueType> &result) const {
 
   shared_ptr<const ClusterTree<N>> clusterTree;
 
@@ -99,13 +419,12 @@ arma::Mat<ValueType> HMatrix<ValueType, N>::permuteMatToOriginalDofs(
     throw std::runtime_error("HMatrix::permuteMatToOriginalDofs: "
                              "Input matrix has wrong number of rows.");
 
-  for (std::size_t i = 0; i < mat.n_rows; ++i) {
-    auto originalIndex = clusterTree->mapHMatDofToOriginalDof(i);
-    for (std::size_t j = 0; j < mat.n_cols; ++j)
-      originalDofs(originalIndex, j) = mat(i, j);
-  }
+  result.set_size(mat.n_rows, mat.n_cols);
 
-  return originalDofs;
+  const auto &hMatToOriginal = clusterTree->hMatDofToOriginalDofMap();
+  for (std::size_t j = 0; j < mat.n_cols; ++j)
+    for (std::size_t i = 0; i < mat.n_rows; ++i)
+      result(hMatToOriginal[i], j) = mat(i, j);
 }
 
 template <typename ValueType, int N>
@@ -113,6 +432,52 @@ void HMatrix<ValueType, N>::apply(const arma::Mat<ValueType> &X,
                                   arma::Mat<ValueType> &Y, TransposeMode trans,
                                   ValueType alpha, ValueType beta) const {
 
+  if (m_parallelApply)
+    applyParallel(X, Y, trans, alpha, beta);
+  else
+    applySerial(X, Y, trans, alpha, beta);
+}
+
+template <typename ValueType, int N>
+TransposeMode
+HMatrix<ValueType, N>::directTransposeMode(TransposeMode trans) const {
+
+  // A symmetric matrix equals its transpose and a Hermitian matrix its
+  // adjoint, so every mode reduces to NOTRANS or CONJ.
+  if (m_symmetry == SYMM) {
+    if (trans == TransposeMode::TRANS)
+      return TransposeMode::NOTRANS;
+    if (trans == TransposeMode::CONJTRANS)
+      return TransposeMode::CONJ;
+  } else if (m_symmetry == HERM) {
+    if (trans == TransposeMode::CONJTRANS)
+      return TransposeMode::NOTRANS;
+    if (trans == TransposeMode::TRANS)
+      return TransposeMode::CONJ;
+  }
+  return trans;
+}
+
+template <typename ValueType, int N>
+TransposeMode
+HMatrix<ValueType, N>::mirroredTransposeMode(TransposeMode trans) const {
+
+  const TransposeMode direct = directTransposeMode(trans);
+  if (m_symmetry == SYMM)
+    return (direct == TransposeMode::NOTRANS) ? TransposeMode::TRANS
+                                              : TransposeMode::CONJTRANS;
+  if (m_symmetry == HERM)
+    return (direct == TransposeMode::NOTRANS) ? TransposeMode::CONJTRANS
+                                              : TransposeMode::TRANS;
+  return direct;
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::applySerial(const arma::Mat<ValueType> &X,
+                                        arma::Mat<ValueType> &Y,
+                                        TransposeMode trans, ValueType alpha,
+                                        ValueType beta) const {
+
   if (beta == ValueType(0))
     Y.zeros();
   else
@@ -121,8 +486,13 @@ void HMatrix<ValueType, N>::apply(const arma::Mat<ValueType> &X,
   arma::Mat<ValueType> xPermuted;
   arma::Mat<ValueType> yPermuted;
 
-  if (trans == TransposeMode::NOTRANS) {
+  const TransposeMode direct = directTransposeMode(trans);
+  const TransposeMode mirrored = mirroredTransposeMode(trans);
+  const bool symmetric = (m_symmetry != NOSYMM);
+  const bool noTranspose =
+      (direct == TransposeMode::NOTRANS || direct == TransposeMode::CONJ);
 
+  if (noTranspose) {
     xPermuted = permuteMatToHMatDofs(X, COL);
     yPermuted = permuteMatToHMatDofs(Y, ROW);
   } else {
@@ -131,29 +501,182 @@ void HMatrix<ValueType, N>::apply(const arma::Mat<ValueType> &X,
   }
 
   std::for_each(begin(m_hMatrixData), end(m_hMatrixData),
-                [trans, alpha, beta, &xPermuted, &yPermuted, this](
-                    const std::pair<shared_ptr<BlockClusterTreeNode<N>>,
-                                    shared_ptr<HMatrixData<ValueType>>>
-                        elem) {
-
-    IndexRangeType inputRange;
-    IndexRangeType outputRange;
-    if (trans == TransposeMode::NOTRANS) {
-      inputRange = elem.first->data().columnClusterTreeNode->data().indexRange;
-      outputRange = elem.first->data().rowClusterTreeNode->data().indexRange;
-    } else {
-      inputRange = elem.first->data().rowClusterTreeNode->data().indexRange;
-      outputRange = elem.first->data().columnClusterTreeNode->data().indexRange;
-    }
+                [direct, mirrored, symmetric, alpha, noTranspose, &xPermuted,
+                 &yPermuted](const std::pair<shared_ptr<BlockClusterTreeNode<N>>,
+                                             shared_ptr<HMatrixData<ValueType>>>
+                                 elem) {
+
+    const IndexRangeType &rowRange =
+        elem.first->data().rowClusterTreeNode->data().indexRange;
+    const IndexRangeType &columnRange =
+        elem.first->data().columnClusterTreeNode->data().indexRange;
+    const IndexRangeType &inputRange = noTranspose ? columnRange : rowRange;
+    const IndexRangeType &outputRange = noTranspose ? rowRange : columnRange;
 
     arma::subview<ValueType> xData =
         xPermuted.rows(inputRange[0], inputRange[1] - 1);
     arma::subview<ValueType> yData =
         yPermuted.rows(outputRange[0], outputRange[1] - 1);
-    elem.second->apply(xData, yData, trans, alpha, 1);
+    elem.second->apply(xData, yData, direct, alpha, 1);
+
+    // The mirror image of an off-diagonal block maps the output range of
+    // the block to its input range.
+    if (symmetric && rowRange != columnRange) {
+      arma::subview<ValueType> xMirrored =
+          xPermuted.rows(outputRange[0], outputRange[1] - 1);
+      arma::subview<ValueType> yMirrored =
+          yPermuted.rows(inputRange[0], inputRange[1] - 1);
+      elem.second->apply(xMirrored, yMirrored, mirrored, alpha, 1);
+    }
   });
 
-  Y = this->permuteMatToOriginalDofs(yPermuted, ROW);
+  Y = this->permuteMatToOriginalDofs(yPermuted, noTranspose ? ROW : COL);
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::applyLeaf(const ApplyLeaf &leaf,
+                                      TransposeMode mode,
+                                      const arma::Mat<ValueType> &xPermuted,
+                                      arma::Mat<ValueType> &product) const {
+
+  // conj(M) x = conj(M conj(x)) and M^T x = conj(M^H conj(x)), so only
+  // products with M and M^H are needed. They are evaluated by BLAS without
+  // forming transposes.
+  const bool adjoint =
+      (mode == TransposeMode::TRANS || mode == TransposeMode::CONJTRANS);
+  const bool conjugate =
+      (mode == TransposeMode::CONJ || mode == TransposeMode::TRANS);
+  const IndexRangeType &inputRange =
+      adjoint ? leaf.rowRange : leaf.columnRange;
+  const IndexRangeType &outputRange =
+      adjoint ? leaf.columnRange : leaf.rowRange;
+  const std::size_t inputCount = inputRange[1] - inputRange[0];
+  const std::size_t outputCount = outputRange[1] - outputRange[0];
+  const std::size_t vectorCount = xPermuted.n_cols;
+
+  // Aliases of the growing thread buffers, so that no memory is allocated
+  // once the buffers have reached their final size
+  ApplyThreadBuffers &buffers = m_applyThreadBuffers.local();
+  if (buffers.input.size() < inputCount * vectorCount)
+    buffers.input.resize(inputCount * vectorCount);
+  arma::Mat<ValueType> x(buffers.input.data(), inputCount, vectorCount,
+                         false /* copy_aux_mem */, true /* strict */);
+  if (conjugate)
+    x = arma::conj(xPermuted.rows(inputRange[0], inputRange[1] - 1));
+  else
+    x = xPermuted.rows(inputRange[0], inputRange[1] - 1);
+
+  // Does not reallocate if product already has the right size
+  product.set_size(outputCount, vectorCount);
+  if (leaf.lowRankData) {
+    const arma::Mat<ValueType> &A = leaf.lowRankData->A();
+    const arma::Mat<ValueType> &B = leaf.lowRankData->B();
+    const std::size_t rank = A.n_cols;
+    if (buffers.inner.size() < rank * vectorCount)
+      buffers.inner.resize(rank * vectorCount);
+    arma::Mat<ValueType> inner(buffers.inner.data(), rank, vectorCount,
+                               false /* copy_aux_mem */, true /* strict */);
+    if (adjoint) {
+      inner = A.t() * x;
+      product = B.t() * inner;
+    } else {
+      inner = B * x;
+      product = A * inner;
+    }
+  } else {
+    const arma::Mat<ValueType> &A = leaf.denseData->A();
+    if (adjoint)
+      product = A.t() * x;
+    else
+      product = A * x;
+  }
+  if (conjugate)
+    product = arma::conj(product);
+}
+
+template <typename ValueType, int N>
+void HMatrix<ValueType, N>::applyParallel(const arma::Mat<ValueType> &X,
+                                          arma::Mat<ValueType> &Y,
+                                          TransposeMode trans, ValueType alpha,
+                                          ValueType beta) const {
+
+  const TransposeMode direct = directTransposeMode(trans);
+  const TransposeMode mirrored = mirroredTransposeMode(trans);
+  const bool symmetric = (m_symmetry != NOSYMM);
+  const bool noTranspose =
+      (direct == TransposeMode::NOTRANS || direct == TransposeMode::CONJ);
+  const std::vector<ApplyScheduleGroup> &schedule =
+      noTranspose ? m_rowApplySchedule : m_columnApplySchedule;
+  // The row and column cluster trees of a symmetric matrix are identical,
+  // so the groups of both schedules cover the same output ranges.
+  const std::vector<ApplyScheduleGroup> &mirroredSchedule =
+      noTranspose ? m_columnApplySchedule : m_rowApplySchedule;
+
+  // Take a workspace left by an earlier call. Its buffers keep their sizes,
+  // so repeated products with the same number of vectors do not allocate.
+  shared_ptr<ApplyWorkspace> workspace;
+  if (!m_applyWorkspaces.try_pop(workspace))
+    workspace.reset(new ApplyWorkspace);
+  arma::Mat<ValueType> &xPermuted = workspace->xPermuted;
+  arma::Mat<ValueType> &yPermuted = workspace->yPermuted;
+  std::vector<arma::Mat<ValueType>> &leafProducts = workspace->leafProducts;
+  std::vector<arma::Mat<ValueType>> &mirroredLeafProducts =
+      workspace->mirroredLeafProducts;
+  leafProducts.resize(m_applyLeaves.size());
+  mirroredLeafProducts.resize(symmetric ? m_applyLeaves.size() : 0);
+
+  permuteMatToHMatDofs(X, noTranspose ? COL : ROW, xPermuted);
+  if (beta == ValueType(0)) {
+    yPermuted.zeros(noTranspose ? rows() : columns(), X.n_cols);
+  } else {
+    permuteMatToHMatDofs(Y, noTranspose ? ROW : COL, yPermuted);
+    yPermuted *= beta;
+  }
+
+  // First pass: multiply every leaf with its range of the input. The
+  // product of a low-rank block is thus formed once, however many output
+  // ranges it spans.
+
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, m_applyLeaves.size()),
+      [&](const tbb::blocked_range<std::size_t> &r) {
+        for (std::size_t i = r.begin(); i != r.end(); ++i) {
+          const ApplyLeaf &leaf = m_applyLeaves[i];
+          applyLeaf(leaf, direct, xPermuted, leafProducts[i]);
+          if (symmetric && !leaf.diagonal)
+            applyLeaf(leaf, mirrored, xPermuted, mirroredLeafProducts[i]);
+        }
+      });
+
+  // Second pass: each output range is owned by exactly one task, so no
+  // locking is necessary.
+
+  tbb::parallel_for(
+      tbb::blocked_range<std::size_t>(0, schedule.size()),
+      [&](const tbb::blocked_range<std::size_t> &r) {
+        for (std::size_t group = r.begin(); group != r.end(); ++group) {
+          const auto &outputRange = schedule[group].outputRange;
+          const std::size_t first = outputRange[0];
+          const std::size_t last = outputRange[1] - 1;
+          const std::size_t count = outputRange[1] - outputRange[0];
+          for (const auto &entry : schedule[group].entries)
+            yPermuted.rows(first, last) +=
+                alpha * leafProducts[entry.leafIndex].rows(
+                            entry.offset, entry.offset + count - 1);
+          if (!symmetric)
+            continue;
+          for (const auto &entry : mirroredSchedule[group].entries) {
+            if (m_applyLeaves[entry.leafIndex].diagonal)
+              continue;
+            yPermuted.rows(first, last) +=
+                alpha * mirroredLeafProducts[entry.leafIndex].rows(
+                            entry.offset, entry.offset + count - 1);
+          }
+        }
+      });
+
+  permuteMatToOriginalDofs(yPermuted, noTranspose ? ROW : COL, Y);
+  m_applyWorkspaces.push(workspace);
 }
 }
 
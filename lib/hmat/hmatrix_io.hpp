@@ -0,0 +1,114 @@
+// vi: set et ts=4 sw=2 sts=2:
+
+#ifndef HMAT_HMATRIX_IO_HPP
+#define HMAT_HMATRIX_IO_HPP
+
+#include "common.hpp"
+#include "hmatrix.hpp"
+#include <complex>
+#include <cstdint>
+#include <string>
+
+namespace hmat {
+
+/** \brief Save an H-matrix to a binary file.
+ *
+ *  The file contains the cluster trees with their DOF permutations, the
+ *  block cluster tree and the data of all stored leaves. The entries of the
+ *  leaves are written as raw column-major arrays in the byte order of the
+ *  machine, each aligned to HMATRIX_FILE_ALIGNMENT bytes, so that
+ *  loadHMatrix() can use them directly from a memory-mapped file. */
+template <typename ValueType, int N>
+void saveHMatrix(const HMatrix<ValueType, N> &hMatrix,
+                 const std::string &fileName);
+
+/** \brief Load an H-matrix saved with saveHMatrix().
+ *
+ *  The file is mapped into memory. The leaves of the returned H-matrix
+ *  refer to the mapped entries without copying them; the mapping is
+ *  released when the last leaf is destroyed. Modifications of the leaves
+ *  are not written back to the file. */
+template <typename ValueType, int N>
+shared_ptr<HMatrix<ValueType, N>> loadHMatrix(const std::string &fileName);
+
+// File format. All offsets are counted in bytes from the start of the file.
+// The nodes of the trees are stored in pre-order; bit i of childMask is set
+// if child i of a node exists.
+
+const std::uint32_t HMATRIX_FILE_VERSION = 1;
+const std::uint32_t HMATRIX_FILE_BYTE_ORDER_MARK = 0x01020304;
+const std::uint64_t HMATRIX_FILE_ALIGNMENT = 64;
+
+struct HMatrixFileHeader {
+  char magic[8]; // "HMATRIX\0"
+  std::uint32_t version;
+  std::uint32_t byteOrderMark;
+  std::uint32_t valueType;
+  std::uint32_t n;
+  std::uint32_t symmetry;
+  std::uint32_t reserved;
+  // Identical offsets if the row and column cluster trees are shared
+  std::uint64_t rowClusterTreeOffset;
+  std::uint64_t columnClusterTreeOffset;
+  std::uint64_t blockClusterTreeOffset;
+  std::uint64_t fileSize;
+};
+
+// Followed by the map from H-matrix DOFs to original DOFs and the nodes
+struct HMatrixFileClusterTreeHeader {
+  std::uint64_t numberOfDofs;
+  std::uint64_t numberOfNodes;
+};
+
+struct HMatrixFileClusterTreeNode {
+  std::uint64_t indexRange[2];
+  double bounds[6];
+  std::uint64_t childMask;
+};
+
+// Followed by the nodes
+struct HMatrixFileBlockClusterTreeHeader {
+  std::uint64_t numberOfNodes;
+};
+
+enum HMatrixFileDataType {
+  HMATRIX_FILE_NO_DATA, // inner node or leaf mirrored by symmetry
+  HMATRIX_FILE_DENSE_DATA,
+  HMATRIX_FILE_LOW_RANK_DATA
+};
+
+struct HMatrixFileBlockClusterTreeNode {
+  std::uint64_t rowClusterTreeNode;    // index in the row cluster tree
+  std::uint64_t columnClusterTreeNode; // index in the column cluster tree
+  std::uint64_t childMask;
+  std::uint32_t admissible;
+  std::uint32_t dataType;
+  std::uint64_t rows;
+  std::uint64_t cols;
+  std::uint64_t rank;
+  // Dense entries, or the factors A and B of a low-rank block
+  std::uint64_t dataOffset[2];
+};
+
+template <typename ValueType> struct HMatrixFileValueType;
+
+template <> struct HMatrixFileValueType<float> {
+  static const std::uint32_t value = 0;
+};
+
+template <> struct HMatrixFileValueType<double> {
+  static const std::uint32_t value = 1;
+};
+
+template <> struct HMatrixFileValueType<std::complex<float>> {
+  static const std::uint32_t value = 2;
+};
+
+template <> struct HMatrixFileValueType<std::complex<double>> {
+  static const std::uint32_t value = 3;
+};
+}
+
+#include "hmatrix_io_impl.hpp"
+
+#endif
@@ -0,0 +1,469 @@
+// vi: set et ts=4 sw=2 sts=2:
+
+#ifndef HMAT_HMATRIX_IO_IMPL_HPP
+#define HMAT_HMATRIX_IO_IMPL_HPP
+
+#include "hmatrix_io.hpp"
+#include "hmatrix_dense_data.hpp"
+#include "hmatrix_low_rank_data.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hmat {
+
+inline std::uint64_t alignHMatrixFileOffset(std::uint64_t offset) {
+  return (offset + HMATRIX_FILE_ALIGNMENT - 1) / HMATRIX_FILE_ALIGNMENT *
+         HMATRIX_FILE_ALIGNMENT;
+}
+
+template <int N>
+void collectClusterTreeNodes(
+    const ClusterTree<N> &clusterTree,
+    std::vector<HMatrixFileClusterTreeNode> &records,
+    std::unordered_map<const ClusterTreeNode<N> *, std::uint64_t> &indices) {
+
+  std::function<void(const shared_ptr<const ClusterTreeNode<N>> &)> visit;
+  visit = [&records, &indices, &visit](
+      const shared_ptr<const ClusterTreeNode<N>> &node) {
+    HMatrixFileClusterTreeNode record;
+    std::memset(&record, 0, sizeof(record));
+    for (int i = 0; i < 2; ++i)
+      record.indexRange[i] = node->data().indexRange[i];
+    for (int i = 0; i < 6; ++i)
+      record.bounds[i] = node->data().boundingBox.bounds()[i];
+    for (int i = 0; i < N; ++i)
+      if (node->hasChild(i))
+        record.childMask |= std::uint64_t(1) << i;
+
+    indices[node.get()] = records.size();
+    records.push_back(record);
+    for (int i = 0; i < N; ++i)
+      if (node->hasChild(i))
+        visit(node->child(i));
+  };
+  visit(clusterTree.root());
+}
+
+template <typename ValueType, int N>
+void saveHMatrix(const HMatrix<ValueType, N> &hMatrix,
+                 const std::string &fileName) {
+
+  auto blockClusterTree = hMatrix.blockClusterTree();
+  auto rowClusterTree = blockClusterTree->rowClusterTree();
+  auto columnClusterTree = blockClusterTree->columnClusterTree();
+  const bool sharedClusterTree = (rowClusterTree == columnClusterTree);
+
+  std::vector<HMatrixFileClusterTreeNode> rowNodes, columnNodes;
+  std::unordered_map<const ClusterTreeNode<N> *, std::uint64_t> rowIndices,
+      columnIndices;
+  collectClusterTreeNodes(*rowClusterTree, rowNodes, rowIndices);
+  if (sharedClusterTree) {
+    columnNodes = rowNodes;
+    columnIndices = rowIndices;
+  } else
+    collectClusterTreeNodes(*columnClusterTree, columnNodes, columnIndices);
+
+  // Layout of the file
+
+  HMatrixFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "HMATRIX", 8);
+  header.version = HMATRIX_FILE_VERSION;
+  header.byteOrderMark = HMATRIX_FILE_BYTE_ORDER_MARK;
+  header.valueType = HMatrixFileValueType<ValueType>::value;
+  header.n = N;
+  header.symmetry = hMatrix.symmetry();
+
+  auto clusterTreeSize = [](const ClusterTree<N> &clusterTree,
+                            std::size_t numberOfNodes) -> std::uint64_t {
+    return sizeof(HMatrixFileClusterTreeHeader) +
+           clusterTree.numberOfDofs() * sizeof(std::uint64_t) +
+           numberOfNodes * sizeof(HMatrixFileClusterTreeNode);
+  };
+
+  header.rowClusterTreeOffset = alignHMatrixFileOffset(sizeof(header));
+  std::uint64_t offset = header.rowClusterTreeOffset +
+                         clusterTreeSize(*rowClusterTree, rowNodes.size());
+  if (sharedClusterTree)
+    header.columnClusterTreeOffset = header.rowClusterTreeOffset;
+  else {
+    header.columnClusterTreeOffset = alignHMatrixFileOffset(offset);
+    offset = header.columnClusterTreeOffset +
+             clusterTreeSize(*columnClusterTree, columnNodes.size());
+  }
+
+  std::vector<HMatrixFileBlockClusterTreeNode> blockNodes;
+  std::vector<shared_ptr<const HMatrixData<ValueType>>> blockData;
+
+  std::function<void(const shared_ptr<const BlockClusterTreeNode<N>> &)> visit;
+  visit = [&](const shared_ptr<const BlockClusterTreeNode<N>> &node) {
+    HMatrixFileBlockClusterTreeNode record;
+    std::memset(&record, 0, sizeof(record));
+    record.rowClusterTreeNode =
+        rowIndices.at(node->data().rowClusterTreeNode.get());
+    record.columnClusterTreeNode =
+        columnIndices.at(node->data().columnClusterTreeNode.get());
+    record.admissible = node->data().admissible;
+    record.dataType = HMATRIX_FILE_NO_DATA;
+    for (int i = 0; i < N * N; ++i)
+      if (node->hasChild(i))
+        record.childMask |= std::uint64_t(1) << i;
+
+    shared_ptr<const HMatrixData<ValueType>> data;
+    if (node->isLeaf() && hMatrix.isStoredBlock(*node)) {
+      data = hMatrix.data(node);
+      record.rows = data->rows();
+      record.cols = data->cols();
+      record.rank = data->rank();
+      if (dynamic_cast<const HMatrixLowRankData<ValueType> *>(data.get()))
+        record.dataType = HMATRIX_FILE_LOW_RANK_DATA;
+      else
+        record.dataType = HMATRIX_FILE_DENSE_DATA;
+    }
+    blockNodes.push_back(record);
+    blockData.push_back(data);
+
+    for (int i = 0; i < N * N; ++i)
+      if (node->hasChild(i))
+        visit(node->child(i));
+  };
+  visit(blockClusterTree->root());
+
+  header.blockClusterTreeOffset = alignHMatrixFileOffset(offset);
+  offset = header.blockClusterTreeOffset +
+           sizeof(HMatrixFileBlockClusterTreeHeader) +
+           blockNodes.size() * sizeof(HMatrixFileBlockClusterTreeNode);
+
+  for (auto &record : blockNodes) {
+    if (record.dataType == HMATRIX_FILE_DENSE_DATA) {
+      record.dataOffset[0] = alignHMatrixFileOffset(offset);
+      offset = record.dataOffset[0] +
+               record.rows * record.cols * sizeof(ValueType);
+    } else if (record.dataType == HMATRIX_FILE_LOW_RANK_DATA) {
+      record.dataOffset[0] = alignHMatrixFileOffset(offset);
+      offset = record.dataOffset[0] +
+               record.rows * record.rank * sizeof(ValueType);
+      record.dataOffset[1] = alignHMatrixFileOffset(offset);
+      offset = record.dataOffset[1] +
+               record.rank * record.cols * sizeof(ValueType);
+    }
+  }
+  header.fileSize = offset;
+
+  // Write the file
+
+  std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary |
+                                           std::ios::trunc);
+  if (!file)
+    throw std::runtime_error("saveHMatrix(): Cannot open file " + fileName +
+                             " for writing.");
+
+  std::uint64_t position = 0;
+  auto write = [&file, &position](const void *data, std::uint64_t size) {
+    file.write(static_cast<const char *>(data), size);
+    position += size;
+  };
+  auto seek = [&file, &position](std::uint64_t target) {
+    static const char zeros[HMATRIX_FILE_ALIGNMENT] = {};
+    while (position < target) {
+      std::uint64_t size =
+          std::min<std::uint64_t>(target - position, HMATRIX_FILE_ALIGNMENT);
+      file.write(zeros, size);
+      position += size;
+    }
+  };
+  auto writeClusterTree = [&write](
+      const ClusterTree<N> &clusterTree,
+      const std::vector<HMatrixFileClusterTreeNode> &nodes) {
+    HMatrixFileClusterTreeHeader treeHeader;
+    treeHeader.numberOfDofs = clusterTree.numberOfDofs();
+    treeHeader.numberOfNodes = nodes.size();
+    write(&treeHeader, sizeof(treeHeader));
+    std::vector<std::uint64_t> permutation(
+        begin(clusterTree.hMatDofToOriginalDofMap()),
+        end(clusterTree.hMatDofToOriginalDofMap()));
+    write(permutation.data(), permutation.size() * sizeof(std::uint64_t));
+    write(nodes.data(), nodes.size() * sizeof(HMatrixFileClusterTreeNode));
+  };
+
+  write(&header, sizeof(header));
+  seek(header.rowClusterTreeOffset);
+  writeClusterTree(*rowClusterTree, rowNodes);
+  if (!sharedClusterTree) {
+    seek(header.columnClusterTreeOffset);
+    writeClusterTree(*columnClusterTree, columnNodes);
+  }
+
+  seek(header.blockClusterTreeOffset);
+  HMatrixFileBlockClusterTreeHeader blockTreeHeader;
+  blockTreeHeader.numberOfNodes = blockNodes.size();
+  write(&blockTreeHeader, sizeof(blockTreeHeader));
+  write(blockNodes.data(),
+        blockNodes.size() * sizeof(HMatrixFileBlockClusterTreeNode));
+
+  for (std::size_t i = 0; i < blockNodes.size(); ++i) {
+    const auto &record = blockNodes[i];
+    if (record.dataType == HMATRIX_FILE_DENSE_DATA) {
+      const auto &A =
+          static_cast<const HMatrixDenseData<ValueType> &>(*blockData[i]).A();
+      seek(record.dataOffset[0]);
+      write(A.memptr(), A.n_elem * sizeof(ValueType));
+    } else if (record.dataType == HMATRIX_FILE_LOW_RANK_DATA) {
+      const auto &lowRankData =
+          static_cast<const HMatrixLowRankData<ValueType> &>(*blockData[i]);
+      seek(record.dataOffset[0]);
+      write(lowRankData.A().memptr(),
+            lowRankData.A().n_elem * sizeof(ValueType));
+      seek(record.dataOffset[1]);
+      write(lowRankData.B().memptr(),
+            lowRankData.B().n_elem * sizeof(ValueType));
+    }
+  }
+
+  file.close();
+  if (!file)
+    throw std::runtime_error("saveHMatrix(): Error while writing file " +
+                             fileName + ".");
+}
+
+template <int N>
+shared_ptr<const ClusterTree<N>> loadClusterTree(
+    const char *memory, std::uint64_t fileSize, std::uint64_t offset,
+    std::vector<shared_ptr<const ClusterTreeNode<N>>> &nodes) {
+
+  auto checkRange = [fileSize](std::uint64_t begin, std::uint64_t size) {
+    if (begin > fileSize || size > fileSize - begin)
+      throw std::runtime_error("loadHMatrix(): File is truncated.");
+  };
+
+  checkRange(offset, sizeof(HMatrixFileClusterTreeHeader));
+  const auto &treeHeader =
+      *reinterpret_cast<const HMatrixFileClusterTreeHeader *>(memory + offset);
+  offset += sizeof(HMatrixFileClusterTreeHeader);
+
+  checkRange(offset, treeHeader.numberOfDofs * sizeof(std::uint64_t));
+  const std::uint64_t *permutation =
+      reinterpret_cast<const std::uint64_t *>(memory + offset);
+  offset += treeHeader.numberOfDofs * sizeof(std::uint64_t);
+
+  checkRange(offset,
+             treeHeader.numberOfNodes * sizeof(HMatrixFileClusterTreeNode));
+  const HMatrixFileClusterTreeNode *records =
+      reinterpret_cast<const HMatrixFileClusterTreeNode *>(memory + offset);
+  if (treeHeader.numberOfNodes == 0)
+    throw std::runtime_error("loadHMatrix(): Cluster tree is empty.");
+
+  DofPermutation dofPermutation(treeHeader.numberOfDofs);
+  for (std::size_t i = 0; i < treeHeader.numberOfDofs; ++i) {
+    if (permutation[i] >= treeHeader.numberOfDofs)
+      throw std::runtime_error("loadHMatrix(): Invalid DOF permutation.");
+    dofPermutation.addDofIndexPair(permutation[i], i);
+  }
+
+  auto nodeData = [](const HMatrixFileClusterTreeNode &record)
+      -> ClusterTreeNodeData {
+    IndexRangeType indexRange{{record.indexRange[0], record.indexRange[1]}};
+    std::array<double, 6> bounds;
+    std::copy(record.bounds, record.bounds + 6, begin(bounds));
+    return ClusterTreeNodeData(indexRange, BoundingBox(bounds));
+  };
+
+  nodes.clear();
+  auto root = make_shared<ClusterTreeNode<N>>(nodeData(records[0]));
+  nodes.push_back(root);
+
+  std::function<void(const shared_ptr<ClusterTreeNode<N>> &, std::uint64_t)>
+      addChildren;
+  addChildren = [&](const shared_ptr<ClusterTreeNode<N>> &node,
+                    std::uint64_t childMask) {
+    for (int i = 0; i < N; ++i)
+      if (childMask & (std::uint64_t(1) << i)) {
+        if (nodes.size() == treeHeader.numberOfNodes)
+          throw std::runtime_error("loadHMatrix(): Invalid cluster tree.");
+        const auto &record = records[nodes.size()];
+        node->addChild(nodeData(record), i);
+        nodes.push_back(node->child(i));
+        addChildren(node->child(i), record.childMask);
+      }
+  };
+  addChildren(root, records[0].childMask);
+
+  if (nodes.size() != treeHeader.numberOfNodes)
+    throw std::runtime_error("loadHMatrix(): Invalid cluster tree.");
+
+  return make_shared<ClusterTree<N>>(root, dofPermutation);
+}
+
+template <typename ValueType, int N>
+shared_ptr<HMatrix<ValueType, N>> loadHMatrix(const std::string &fileName) {
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("loadHMatrix(): Cannot open file " + fileName +
+                             ".");
+  struct stat fileStatus;
+  if (fstat(fd, &fileStatus) != 0) {
+    close(fd);
+    throw std::runtime_error("loadHMatrix(): Cannot read file " + fileName +
+                             ".");
+  }
+  const std::uint64_t fileSize = fileStatus.st_size;
+  if (fileSize < sizeof(HMatrixFileHeader)) {
+    close(fd);
+    throw std::runtime_error("loadHMatrix(): " + fileName +
+                             " is not an H-matrix file.");
+  }
+
+  // A private mapping, so that the leaves can be modified in memory without
+  // changing the file.
+  void *address =
+      mmap(0, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (address == MAP_FAILED)
+    throw std::runtime_error("loadHMatrix(): Cannot map file " + fileName +
+                             " into memory.");
+  shared_ptr<void> mapping(address, [fileSize](void *address) {
+    munmap(address, fileSize);
+  });
+  char *memory = static_cast<char *>(address);
+
+  const auto &header = *reinterpret_cast<const HMatrixFileHeader *>(memory);
+  if (std::memcmp(header.magic, "HMATRIX", 8) != 0)
+    throw std::runtime_error("loadHMatrix(): " + fileName +
+                             " is not an H-matrix file.");
+  if (header.byteOrderMark != HMATRIX_FILE_BYTE_ORDER_MARK)
+    throw std::runtime_error("loadHMatrix(): " + fileName +
+                             " was written with a different byte order.");
+  if (header.version != HMATRIX_FILE_VERSION)
+    throw std::runtime_error("loadHMatrix(): Unsupported version of " +
+                             fileName + ".");
+  if (header.valueType != HMatrixFileValueType<ValueType>::value ||
+      header.n != N)
+    throw std::runtime_error("loadHMatrix(): " + fileName +
+                             " stores a different type of H-matrix.");
+  if (header.fileSize != fileSize)
+    throw std::runtime_error("loadHMatrix(): " + fileName +
+                             " is truncated.");
+  if (header.symmetry > HERM)
+    throw std::runtime_error("loadHMatrix(): Invalid symmetry in " +
+                             fileName + ".");
+
+  std::vector<shared_ptr<const ClusterTreeNode<N>>> rowNodes, columnNodes;
+  auto rowClusterTree = loadClusterTree<N>(
+      memory, fileSize, header.rowClusterTreeOffset, rowNodes);
+  auto columnClusterTree = rowClusterTree;
+  if (header.columnClusterTreeOffset == header.rowClusterTreeOffset)
+    columnNodes = rowNodes;
+  else
+    columnClusterTree = loadClusterTree<N>(
+        memory, fileSize, header.columnClusterTreeOffset, columnNodes);
+
+  auto checkRange = [fileSize](std::uint64_t begin, std::uint64_t size) {
+    if (begin > fileSize || size > fileSize - begin)
+      throw std::runtime_error("loadHMatrix(): File is truncated.");
+  };
+
+  std::uint64_t offset = header.blockClusterTreeOffset;
+  checkRange(offset, sizeof(HMatrixFileBlockClusterTreeHeader));
+  const auto &blockTreeHeader =
+      *reinterpret_cast<const HMatrixFileBlockClusterTreeHeader *>(memory +
+                                                                   offset);
+  offset += sizeof(HMatrixFileBlockClusterTreeHeader);
+  checkRange(offset, blockTreeHeader.numberOfNodes *
+                         sizeof(HMatrixFileBlockClusterTreeNode));
+  const HMatrixFileBlockClusterTreeNode *records =
+      reinterpret_cast<const HMatrixFileBlockClusterTreeNode *>(memory +
+                                                                offset);
+  if (blockTreeHeader.numberOfNodes == 0)
+    throw std::runtime_error("loadHMatrix(): Block cluster tree is empty.");
+
+  typedef std::pair<shared_ptr<BlockClusterTreeNode<N>>,
+                    shared_ptr<HMatrixData<ValueType>>> LeafData;
+  std::vector<LeafData> leafData;
+  std::size_t nodeCount = 0;
+
+  auto nodeData = [&](const HMatrixFileBlockClusterTreeNode &record)
+      -> BlockClusterTreeNodeData<N> {
+    if (record.rowClusterTreeNode >= rowNodes.size() ||
+        record.columnClusterTreeNode >= columnNodes.size())
+      throw std::runtime_error("loadHMatrix(): Invalid block cluster tree.");
+    return BlockClusterTreeNodeData<N>(
+        rowNodes[record.rowClusterTreeNode],
+        columnNodes[record.columnClusterTreeNode], record.admissible != 0);
+  };
+
+  auto readData = [&](const shared_ptr<BlockClusterTreeNode<N>> &node,
+                      const HMatrixFileBlockClusterTreeNode &record) {
+    if (record.dataType == HMATRIX_FILE_NO_DATA)
+      return;
+    const auto &rowRange = node->data().rowClusterTreeNode->data().indexRange;
+    const auto &columnRange =
+        node->data().columnClusterTreeNode->data().indexRange;
+    if (record.rows != rowRange[1] - rowRange[0] ||
+        record.cols != columnRange[1] - columnRange[0])
+      throw std::runtime_error("loadHMatrix(): Invalid leaf dimensions.");
+
+    shared_ptr<HMatrixData<ValueType>> data;
+    if (record.dataType == HMATRIX_FILE_DENSE_DATA) {
+      checkRange(record.dataOffset[0],
+                 record.rows * record.cols * sizeof(ValueType));
+      data.reset(new HMatrixDenseData<ValueType>(
+          reinterpret_cast<ValueType *>(memory + record.dataOffset[0]),
+          record.rows, record.cols, mapping));
+    } else if (record.dataType == HMATRIX_FILE_LOW_RANK_DATA) {
+      checkRange(record.dataOffset[0],
+                 record.rows * record.rank * sizeof(ValueType));
+      checkRange(record.dataOffset[1],
+                 record.rank * record.cols * sizeof(ValueType));
+      data.reset(new HMatrixLowRankData<ValueType>(
+          reinterpret_cast<ValueType *>(memory + record.dataOffset[0]),
+          reinterpret_cast<ValueType *>(memory + record.dataOffset[1]),
+          record.rows, record.cols, record.rank, mapping));
+    } else
+      throw std::runtime_error("loadHMatrix(): Invalid leaf data type.");
+    leafData.push_back(LeafData(node, data));
+  };
+
+  auto root = make_shared<BlockClusterTreeNode<N>>(nodeData(records[0]));
+  nodeCount = 1;
+  readData(root, records[0]);
+
+  std::function<void(const shared_ptr<BlockClusterTreeNode<N>> &,
+                     std::uint64_t)> addChildren;
+  addChildren = [&](const shared_ptr<BlockClusterTreeNode<N>> &node,
+                    std::uint64_t childMask) {
+    for (int i = 0; i < N * N; ++i)
+      if (childMask & (std::uint64_t(1) << i)) {
+        if (nodeCount == blockTreeHeader.numberOfNodes)
+          throw std::runtime_error(
+              "loadHMatrix(): Invalid block cluster tree.");
+        const auto &record = records[nodeCount++];
+        node->addChild(nodeData(record), i);
+        readData(node->child(i), record);
+        addChildren(node->child(i), record.childMask);
+      }
+  };
+  addChildren(root, records[0].childMask);
+
+  if (nodeCount != blockTreeHeader.numberOfNodes)
+    throw std::runtime_error("loadHMatrix(): Invalid block cluster tree.");
+
+  auto blockClusterTree = make_shared<BlockClusterTree<N>>(
+      rowClusterTree, columnClusterTree, root);
+  return make_shared<HMatrix<ValueType, N>>(
+      blockClusterTree, leafData, static_cast<MatrixSymmetry>(header.symmetry));
+}
+}
+
+#endif
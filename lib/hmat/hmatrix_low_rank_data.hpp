@@ -13,6 +13,17 @@ template <typename ValueType>
 class HMatrixLowRankData : public HMatrixData<ValueType> {
 
 public:
+  HMatrixLowRankData();
+
+  /** \brief Construct a block whose factors are stored in external memory.
+   *
+   *  The column-major arrays A (rows x rank) and B (rank x cols) are used
+   *  without copying. They must stay valid as long as memoryOwner is
+   *  alive. */
+  HMatrixLowRankData(ValueType *A, ValueType *B, std::size_t rows,
+                     std::size_t cols, std::size_t rank,
+                     const shared_ptr<void> &memoryOwner);
+
   void apply(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
              TransposeMode trans, ValueType alpha, ValueType beta) const
       override;
@@ -35,9 +46,18 @@ public:
 
   double memSizeKb() const override;
 
+  /** \brief Truncate the rank of the block.
+   *
+   *  Both factors are orthogonalized by QR decompositions and the product
+   *  of the triangular factors is truncated with an SVD. The discarded
+   *  singular values have a Frobenius norm of at most eps times the norm of
+   *  the block. */
+  void recompress(double eps);
+
 private:
   arma::Mat<ValueType> m_A;
   arma::Mat<ValueType> m_B;
+  shared_ptr<void> m_memoryOwner;
 };
 }
 
@@ -4,9 +4,20 @@
 #define HMAT_HMATRIX_DATA_IMPL_HPP
 
 #include "hmatrix_low_rank_data.hpp"
+#include <stdexcept>
 
 namespace hmat {
 
+template <typename ValueType>
+HMatrixLowRankData<ValueType>::HMatrixLowRankData() {}
+
+template <typename ValueType>
+HMatrixLowRankData<ValueType>::HMatrixLowRankData(
+    ValueType *A, ValueType *B, std::size_t rows, std::size_t cols,
+    std::size_t rank, const shared_ptr<void> &memoryOwner)
+    : m_A(A, rows, rank, false, false), m_B(B, rank, cols, false, false),
+      m_memoryOwner(memoryOwner) {}
+
 template <typename ValueType>
 const arma::Mat<ValueType> &HMatrixLowRankData<ValueType>::A() const {
   return m_A;
@@ -64,6 +75,54 @@ double HMatrixLowRankData<ValueType>::memSizeKb() const {
          (1.0 * 1024);
 }
 
+template <typename ValueType>
+void HMatrixLowRankData<ValueType>::recompress(double eps) {
+
+  typedef typename ScalarTraits<ValueType>::RealType RealType;
+
+  if (this->rank() == 0)
+    return;
+
+  // With A = Qa * Ra and B^T = Qb * Rb we have A * B = Qa * (Ra * Rb^T) * Qb^T,
+  // so only the small core matrix Ra * Rb^T needs an SVD.
+
+  arma::Mat<ValueType> Qa, Ra, Qb, Rb;
+  if (!arma::qr_econ(Qa, Ra, m_A) || !arma::qr_econ(Qb, Rb, m_B.st()))
+    throw std::runtime_error("HMatrixLowRankData::recompress(): "
+                             "QR decomposition failed.");
+
+  arma::Mat<ValueType> U, V;
+  arma::Col<RealType> s;
+  if (!arma::svd(U, s, V, arma::Mat<ValueType>(Ra * Rb.st())))
+    throw std::runtime_error("HMatrixLowRankData::recompress(): "
+                             "SVD failed.");
+
+  RealType totalSquared = arma::accu(arma::square(s));
+  RealType discardedSquared = 0;
+  std::size_t newRank = s.n_elem;
+  while (newRank > 0 &&
+         discardedSquared + s(newRank - 1) * s(newRank - 1) <=
+             eps * eps * totalSquared) {
+    discardedSquared += s(newRank - 1) * s(newRank - 1);
+    --newRank;
+  }
+
+  if (newRank >= this->rank())
+    return;
+
+  if (newRank == 0) {
+    m_A.set_size(m_A.n_rows, 0);
+    m_B.set_size(0, m_B.n_cols);
+    return;
+  }
+
+  arma::Col<ValueType> singularValues =
+      arma::conv_to<arma::Col<ValueType>>::from(s.subvec(0, newRank - 1));
+
+  m_A = Qa * U.cols(0, newRank - 1) * arma::diagmat(singularValues);
+  m_B = V.cols(0, newRank - 1).t() * Qb.st();
+}
+
 template <typename ValueType>
 void HMatrixLowRankData<ValueType>::apply(const arma::Mat<ValueType> &X,
                                           arma::Mat<ValueType> &Y,
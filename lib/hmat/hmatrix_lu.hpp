@@ -0,0 +1,108 @@
+// vi: set et ts=4 sw=2 sts=2:
+
+#ifndef HMAT_HMATRIX_LU_HPP
+#define HMAT_HMATRIX_LU_HPP
+
+#include "common.hpp"
+#include "hmatrix.hpp"
+#include "compressed_matrix.hpp"
+#include <armadillo>
+#include <vector>
+
+namespace hmat {
+
+/** \brief Approximate LU decomposition of an H-matrix.
+ *
+ *  The factors are computed with H-arithmetic on a copy of the block
+ *  structure of the H-matrix. Products of blocks are added as low-rank
+ *  updates, which are truncated to the relative accuracy eps after every
+ *  addition. Dense diagonal leaves are factorized with partial pivoting
+ *  inside the leaf.
+ *
+ *  The apply() method applies the inverse of the factorized matrix, so that
+ *  the object can be used as a preconditioner. The row and the column
+ *  cluster tree of the H-matrix must split the diagonal blocks
+ *  identically. */
+template <typename ValueType, int N>
+class HMatrixLu : public CompressedMatrix<ValueType> {
+public:
+  HMatrixLu(const HMatrix<ValueType, N> &hMatrix, double eps);
+
+  std::size_t rows() const override;
+  std::size_t columns() const override;
+
+  /** \brief Return the memory used by the blocks of the factors. */
+  double memSizeKb() const;
+
+  /** \brief Compute Y = alpha * inv(op(A)) * X + beta * Y. */
+  void apply(const arma::Mat<ValueType> &X, arma::Mat<ValueType> &Y,
+             TransposeMode trans, ValueType alpha, ValueType beta) const
+      override;
+
+  arma::Mat<ValueType> permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
+                                            RowColSelector rowOrColumn) const
+      override;
+  arma::Mat<ValueType>
+  permuteMatToOriginalDofs(const arma::Mat<ValueType> &mat,
+                           RowColSelector rowOrColumn) const override;
+
+private:
+  struct Block {
+    IndexRangeType rowRange;
+    IndexRangeType columnRange;
+    shared_ptr<HMatrixDenseData<ValueType>> denseData;
+    shared_ptr<HMatrixLowRankData<ValueType>> lowRankData;
+    std::vector<shared_ptr<Block>> children; // N * N children, row-major
+
+    // Factors of a dense diagonal leaf with L * U = P * A
+    arma::Mat<ValueType> L;
+    arma::Mat<ValueType> U;
+    arma::Mat<ValueType> P;
+
+    bool isLeaf() const { return children.empty(); }
+    Block &child(int i, int j) { return *children[N * i + j]; }
+    const Block &child(int i, int j) const { return *children[N * i + j]; }
+  };
+
+  shared_ptr<Block>
+  copyBlock(const HMatrix<ValueType, N> &hMatrix,
+            const shared_ptr<const BlockClusterTreeNode<N>> &node) const;
+  shared_ptr<Block> transposedBlock(const Block &block, bool conjugate) const;
+
+  // H-arithmetic
+  void factorize(Block &block) const;
+  void solveLower(const Block &L, Block &X) const;
+  void solveUpper(const Block &U, Block &X) const;
+  void multiplyAdd(ValueType alpha, const Block &A, const Block &B,
+                   Block &C) const;
+  void multiplyToLowRank(const Block &A, const Block &B,
+                         HMatrixLowRankData<ValueType> &result) const;
+  void addLowRank(Block &C, const arma::Mat<ValueType> &A,
+                  const arma::Mat<ValueType> &B) const;
+
+  // Products and triangular solves with dense right-hand sides. The rows of
+  // X and Y are counted from the given offsets.
+  void applyBlock(const Block &block, const arma::Mat<ValueType> &X,
+                  arma::Mat<ValueType> &Y, TransposeMode trans,
+                  ValueType alpha, std::size_t inputOffset,
+                  std::size_t outputOffset) const;
+  void solveLowerDense(const Block &L, arma::Mat<ValueType> &X,
+                       std::size_t offset) const;
+  void solveUpperDense(const Block &U, arma::Mat<ValueType> &X,
+                       std::size_t offset) const;
+  void solveLowerTransposedDense(const Block &L, arma::Mat<ValueType> &X,
+                                 std::size_t offset) const;
+  void solveUpperTransposedDense(const Block &U, arma::Mat<ValueType> &X,
+                                 std::size_t offset) const;
+
+  double memSizeKb(const Block &block) const;
+
+  shared_ptr<const BlockClusterTree<N>> m_blockClusterTree;
+  shared_ptr<Block> m_root;
+  double m_eps;
+};
+}
+
+#include "hmatrix_lu_impl.hpp"
+
+#endif
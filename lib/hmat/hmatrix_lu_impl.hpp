@@ -0,0 +1,591 @@
+// vi: set et ts=4 sw=2 sts=2:
+
+#ifndef HMAT_HMATRIX_LU_IMPL_HPP
+#define HMAT_HMATRIX_LU_IMPL_HPP
+
+#include "hmatrix_lu.hpp"
+#include "hmatrix_data.hpp"
+#include "hmatrix_dense_data.hpp"
+#include "hmatrix_low_rank_data.hpp"
+
+#include <stdexcept>
+
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+
+namespace hmat {
+
+template <typename ValueType, int N>
+HMatrixLu<ValueType, N>::HMatrixLu(const HMatrix<ValueType, N> &hMatrix,
+                                   double eps)
+    : m_blockClusterTree(hMatrix.blockClusterTree()), m_eps(eps) {
+
+  if (hMatrix.rows() != hMatrix.columns())
+    throw std::runtime_error("HMatrixLu::HMatrixLu(): "
+                             "H-matrix is not square.");
+  if (!hMatrix.isInitialized())
+    throw std::runtime_error("HMatrixLu::HMatrixLu(): "
+                             "H-matrix is not initialized.");
+
+  m_root = copyBlock(hMatrix, m_blockClusterTree->root());
+  factorize(*m_root);
+}
+
+template <typename ValueType, int N>
+std::size_t HMatrixLu<ValueType, N>::rows() const {
+  return m_blockClusterTree->rows();
+}
+
+template <typename ValueType, int N>
+std::size_t HMatrixLu<ValueType, N>::columns() const {
+  return m_blockClusterTree->columns();
+}
+
+template <typename ValueType, int N>
+double HMatrixLu<ValueType, N>::memSizeKb() const {
+  return memSizeKb(*m_root);
+}
+
+template <typename ValueType, int N>
+double HMatrixLu<ValueType, N>::memSizeKb(const Block &block) const {
+
+  if (!block.isLeaf()) {
+    double result = 0;
+    for (const auto &child : block.children)
+      result += memSizeKb(*child);
+    return result;
+  }
+  if (block.denseData)
+    return block.denseData->memSizeKb();
+  if (block.lowRankData)
+    return block.lowRankData->memSizeKb();
+  return sizeof(ValueType) * (block.L.n_elem + block.U.n_elem) / (1.0 * 1024);
+}
+
+template <typename ValueType, int N>
+shared_ptr<typename HMatrixLu<ValueType, N>::Block>
+HMatrixLu<ValueType, N>::copyBlock(
+    const HMatrix<ValueType, N> &hMatrix,
+    const shared_ptr<const BlockClusterTreeNode<N>> &node) const {
+
+  shared_ptr<Block> block(new Block());
+  block->rowRange = node->data().rowClusterTreeNode->data().indexRange;
+  block->columnRange = node->data().columnClusterTreeNode->data().indexRange;
+
+  if (!node->isLeaf()) {
+    block->children.resize(N * N);
+    for (int i = 0; i < N * N; ++i)
+      if (hMatrix.isStoredBlock(*node->child(i)))
+        block->children[i] = copyBlock(hMatrix, node->child(i));
+
+    // Blocks below the diagonal of a symmetric matrix are not stored.
+    // They are the transposes of their mirror images in the same parent.
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < i; ++j)
+        if (!block->children[N * i + j])
+          block->children[N * i + j] = transposedBlock(
+              *block->children[N * j + i], hMatrix.symmetry() == HERM);
+    return block;
+  }
+
+  auto data = hMatrix.data(node);
+  if (auto denseData =
+          dynamic_cast<const HMatrixDenseData<ValueType> *>(data.get()))
+    block->denseData.reset(new HMatrixDenseData<ValueType>(*denseData));
+  else if (auto lowRankData =
+               dynamic_cast<const HMatrixLowRankData<ValueType> *>(data.get()))
+    block->lowRankData.reset(new HMatrixLowRankData<ValueType>(*lowRankData));
+  else
+    throw std::runtime_error("HMatrixLu::copyBlock(): "
+                             "Unsupported type of leaf data.");
+  return block;
+}
+
+template <typename ValueType, int N>
+shared_ptr<typename HMatrixLu<ValueType, N>::Block>
+HMatrixLu<ValueType, N>::transposedBlock(const Block &block,
+                                         bool conjugate) const {
+
+  shared_ptr<Block> result(new Block());
+  result->rowRange = block.columnRange;
+  result->columnRange = block.rowRange;
+
+  if (!block.isLeaf()) {
+    result->children.resize(N * N);
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        result->children[N * j + i] =
+            transposedBlock(block.child(i, j), conjugate);
+    return result;
+  }
+
+  if (block.denseData) {
+    result->denseData.reset(new HMatrixDenseData<ValueType>());
+    if (conjugate)
+      result->denseData->A() = block.denseData->A().t();
+    else
+      result->denseData->A() = block.denseData->A().st();
+  } else {
+    result->lowRankData.reset(new HMatrixLowRankData<ValueType>());
+    if (conjugate) {
+      result->lowRankData->A() = block.lowRankData->B().t();
+      result->lowRankData->B() = block.lowRankData->A().t();
+    } else {
+      result->lowRankData->A() = block.lowRankData->B().st();
+      result->lowRankData->B() = block.lowRankData->A().st();
+    }
+  }
+  return result;
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::factorize(Block &block) const {
+
+  if (block.rowRange != block.columnRange)
+    throw std::runtime_error("HMatrixLu::factorize(): "
+                             "Diagonal block is not square.");
+
+  if (block.isLeaf()) {
+    arma::Mat<ValueType> A;
+    if (block.denseData)
+      A = block.denseData->A();
+    else
+      A = block.lowRankData->A() * block.lowRankData->B();
+    if (!arma::lu(block.L, block.U, block.P, A))
+      throw std::runtime_error("HMatrixLu::factorize(): "
+                               "LU decomposition of a diagonal block failed.");
+    block.denseData.reset();
+    block.lowRankData.reset();
+    return;
+  }
+
+  for (int i = 0; i < N; ++i) {
+    factorize(block.child(i, i));
+
+    // The off-diagonal blocks of the current block row and column and
+    // the blocks of the Schur complement are independent of each other.
+
+    tbb::parallel_for(tbb::blocked_range<int>(i + 1, N),
+                      [&block, i, this](const tbb::blocked_range<int> &r) {
+      for (int j = r.begin(); j != r.end(); ++j) {
+        solveLower(block.child(i, i), block.child(i, j));
+        solveUpper(block.child(i, i), block.child(j, i));
+      }
+    });
+
+    const int remaining = N - 1 - i;
+    tbb::parallel_for(tbb::blocked_range<int>(0, remaining * remaining),
+                      [&block, i, remaining,
+                       this](const tbb::blocked_range<int> &r) {
+      for (int k = r.begin(); k != r.end(); ++k) {
+        const int j = i + 1 + k / remaining;
+        const int l = i + 1 + k % remaining;
+        multiplyAdd(-1, block.child(j, i), block.child(i, l),
+                    block.child(j, l));
+      }
+    });
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveLower(const Block &L, Block &X) const {
+
+  if (X.isLeaf()) {
+    if (X.denseData)
+      solveLowerDense(L, X.denseData->A(), L.rowRange[0]);
+    else
+      solveLowerDense(L, X.lowRankData->A(), L.rowRange[0]);
+    return;
+  }
+
+  if (L.isLeaf())
+    throw std::runtime_error("HMatrixLu::solveLower(): "
+                             "Incompatible block structure.");
+
+  for (int c = 0; c < N; ++c)
+    for (int i = 0; i < N; ++i) {
+      solveLower(L.child(i, i), X.child(i, c));
+      for (int j = i + 1; j < N; ++j)
+        multiplyAdd(-1, L.child(j, i), X.child(i, c), X.child(j, c));
+    }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveUpper(const Block &U, Block &X) const {
+
+  // X * inv(U) = (inv(U^T) * X^T)^T
+
+  if (X.isLeaf()) {
+    arma::Mat<ValueType> &data =
+        X.denseData ? X.denseData->A() : X.lowRankData->B();
+    arma::Mat<ValueType> transposed = data.st();
+    solveUpperTransposedDense(U, transposed, U.columnRange[0]);
+    data = transposed.st();
+    return;
+  }
+
+  if (U.isLeaf())
+    throw std::runtime_error("HMatrixLu::solveUpper(): "
+                             "Incompatible block structure.");
+
+  for (int r = 0; r < N; ++r)
+    for (int i = 0; i < N; ++i) {
+      solveUpper(U.child(i, i), X.child(r, i));
+      for (int j = i + 1; j < N; ++j)
+        multiplyAdd(-1, X.child(r, i), U.child(i, j), X.child(r, j));
+    }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::multiplyAdd(ValueType alpha, const Block &A,
+                                          const Block &B, Block &C) const {
+
+  if (!A.isLeaf() && !B.isLeaf() && !C.isLeaf()) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        for (int k = 0; k < N; ++k)
+          multiplyAdd(alpha, A.child(i, k), B.child(k, j), C.child(i, j));
+    return;
+  }
+
+  HMatrixLowRankData<ValueType> product;
+  multiplyToLowRank(A, B, product);
+  addLowRank(C, alpha * product.A(), product.B());
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::multiplyToLowRank(
+    const Block &A, const Block &B,
+    HMatrixLowRankData<ValueType> &result) const {
+
+  const std::size_t m = A.rowRange[1] - A.rowRange[0];
+  const std::size_t k = A.columnRange[1] - A.columnRange[0];
+  const std::size_t n = B.columnRange[1] - B.columnRange[0];
+
+  // Products with B are computed as (B^T * X^T)^T
+  const auto multiplyFromRight = [&B, n, this](const arma::Mat<ValueType> &X)
+      -> arma::Mat<ValueType> {
+    arma::Mat<ValueType> product(n, X.n_rows, arma::fill::zeros);
+    applyBlock(B, arma::Mat<ValueType>(X.st()), product, TRANS, 1,
+               B.rowRange[0], B.columnRange[0]);
+    return product.st();
+  };
+  const auto multiplyFromLeft = [&A, m, this](const arma::Mat<ValueType> &X)
+      -> arma::Mat<ValueType> {
+    arma::Mat<ValueType> product(m, X.n_cols, arma::fill::zeros);
+    applyBlock(A, X, product, NOTRANS, 1, A.columnRange[0], A.rowRange[0]);
+    return product;
+  };
+
+  if (A.lowRankData) {
+    result.A() = A.lowRankData->A();
+    result.B() = multiplyFromRight(A.lowRankData->B());
+  } else if (B.lowRankData) {
+    result.A() = multiplyFromLeft(B.lowRankData->A());
+    result.B() = B.lowRankData->B();
+  } else if (A.denseData) {
+    if (k <= m) {
+      result.A() = A.denseData->A();
+      result.B() = multiplyFromRight(arma::eye<arma::Mat<ValueType>>(k, k));
+    } else {
+      result.A() = arma::eye<arma::Mat<ValueType>>(m, m);
+      result.B() = multiplyFromRight(A.denseData->A());
+    }
+  } else if (B.denseData) {
+    if (k <= n) {
+      result.A() = multiplyFromLeft(arma::eye<arma::Mat<ValueType>>(k, k));
+      result.B() = B.denseData->A();
+    } else {
+      result.A() = multiplyFromLeft(B.denseData->A());
+      result.B() = arma::eye<arma::Mat<ValueType>>(n, n);
+    }
+  } else if (!A.isLeaf() && !B.isLeaf()) {
+
+    // Multiply the children and stack the low-rank products into factors
+    // of the whole block.
+
+    std::vector<HMatrixLowRankData<ValueType>> products(N * N * N);
+    std::size_t jointRank = 0;
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        for (int l = 0; l < N; ++l) {
+          auto &product = products[N * (N * i + j) + l];
+          multiplyToLowRank(A.child(i, l), B.child(l, j), product);
+          jointRank += product.rank();
+        }
+
+    result.A().zeros(m, jointRank);
+    result.B().zeros(jointRank, n);
+
+    std::size_t offset = 0;
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        for (int l = 0; l < N; ++l) {
+          const auto &product = products[N * (N * i + j) + l];
+          const std::size_t rank = product.rank();
+          if (rank == 0)
+            continue;
+          const auto &rowRange = A.child(i, l).rowRange;
+          const auto &columnRange = B.child(l, j).columnRange;
+          result.A().submat(rowRange[0] - A.rowRange[0], offset,
+                            rowRange[1] - A.rowRange[0] - 1,
+                            offset + rank - 1) = product.A();
+          result.B().submat(offset, columnRange[0] - B.columnRange[0],
+                            offset + rank - 1,
+                            columnRange[1] - B.columnRange[0] - 1) =
+              product.B();
+          offset += rank;
+        }
+
+    result.recompress(m_eps);
+  } else {
+    throw std::runtime_error("HMatrixLu::multiplyToLowRank(): "
+                             "Factorized diagonal block used as operand.");
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::addLowRank(Block &C, const arma::Mat<ValueType> &A,
+                                         const arma::Mat<ValueType> &B) const {
+
+  if (A.n_cols == 0)
+    return;
+
+  if (!C.isLeaf()) {
+    for (const auto &child : C.children)
+      addLowRank(*child, A.rows(child->rowRange[0] - C.rowRange[0],
+                                child->rowRange[1] - C.rowRange[0] - 1),
+                 B.cols(child->columnRange[0] - C.columnRange[0],
+                        child->columnRange[1] - C.columnRange[0] - 1));
+    return;
+  }
+
+  if (C.denseData) {
+    C.denseData->A() += A * B;
+  } else if (C.lowRankData) {
+    C.lowRankData->A() = arma::join_rows(C.lowRankData->A(), A);
+    C.lowRankData->B() = arma::join_cols(C.lowRankData->B(), B);
+    C.lowRankData->recompress(m_eps);
+  } else {
+    throw std::runtime_error("HMatrixLu::addLowRank(): "
+                             "Cannot update a factorized diagonal block.");
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::applyBlock(const Block &block,
+                                         const arma::Mat<ValueType> &X,
+                                         arma::Mat<ValueType> &Y,
+                                         TransposeMode trans, ValueType alpha,
+                                         std::size_t inputOffset,
+                                         std::size_t outputOffset) const {
+
+  if (!block.isLeaf()) {
+    for (const auto &child : block.children)
+      applyBlock(*child, X, Y, trans, alpha, inputOffset, outputOffset);
+    return;
+  }
+
+  if (X.n_cols == 0)
+    return;
+
+  const bool noTranspose =
+      (trans == TransposeMode::NOTRANS || trans == TransposeMode::CONJ);
+  const auto &inputRange = noTranspose ? block.columnRange : block.rowRange;
+  const auto &outputRange = noTranspose ? block.rowRange : block.columnRange;
+
+  // X and Y may be the same matrix, so the input is copied.
+  arma::Mat<ValueType> xData = X.rows(inputRange[0] - inputOffset,
+                                      inputRange[1] - inputOffset - 1);
+  arma::subview<ValueType> xSub =
+      xData.submat(arma::span::all, arma::span::all);
+  arma::subview<ValueType> ySub = Y.rows(outputRange[0] - outputOffset,
+                                         outputRange[1] - outputOffset - 1);
+
+  if (block.denseData)
+    block.denseData->apply(xSub, ySub, trans, alpha, 1);
+  else if (block.lowRankData)
+    block.lowRankData->apply(xSub, ySub, trans, alpha, 1);
+  else
+    throw std::runtime_error("HMatrixLu::applyBlock(): "
+                             "Factorized diagonal block used as operand.");
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveLowerDense(const Block &L,
+                                              arma::Mat<ValueType> &X,
+                                              std::size_t offset) const {
+
+  if (X.n_cols == 0)
+    return;
+
+  if (L.isLeaf()) {
+    const std::size_t first = L.rowRange[0] - offset;
+    const std::size_t last = L.rowRange[1] - offset - 1;
+    arma::Mat<ValueType> rhs = L.P * X.rows(first, last);
+    X.rows(first, last) = arma::solve(arma::trimatl(L.L), rhs);
+    return;
+  }
+
+  for (int i = 0; i < N; ++i) {
+    solveLowerDense(L.child(i, i), X, offset);
+    for (int j = i + 1; j < N; ++j)
+      applyBlock(L.child(j, i), X, X, NOTRANS, -1, offset, offset);
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveUpperDense(const Block &U,
+                                              arma::Mat<ValueType> &X,
+                                              std::size_t offset) const {
+
+  if (X.n_cols == 0)
+    return;
+
+  if (U.isLeaf()) {
+    const std::size_t first = U.rowRange[0] - offset;
+    const std::size_t last = U.rowRange[1] - offset - 1;
+    arma::Mat<ValueType> rhs = X.rows(first, last);
+    X.rows(first, last) = arma::solve(arma::trimatu(U.U), rhs);
+    return;
+  }
+
+  for (int i = N - 1; i >= 0; --i) {
+    solveUpperDense(U.child(i, i), X, offset);
+    for (int j = 0; j < i; ++j)
+      applyBlock(U.child(j, i), X, X, NOTRANS, -1, offset, offset);
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveLowerTransposedDense(
+    const Block &L, arma::Mat<ValueType> &X, std::size_t offset) const {
+
+  if (X.n_cols == 0)
+    return;
+
+  if (L.isLeaf()) {
+    // The leaf stores L * U = P * A, so inv((P^T * L)^T) = P^T * inv(L^T).
+    const std::size_t first = L.rowRange[0] - offset;
+    const std::size_t last = L.rowRange[1] - offset - 1;
+    arma::Mat<ValueType> transposed = L.L.st();
+    arma::Mat<ValueType> rhs = X.rows(first, last);
+    X.rows(first, last) =
+        L.P.st() * arma::solve(arma::trimatu(transposed), rhs);
+    return;
+  }
+
+  for (int i = N - 1; i >= 0; --i) {
+    solveLowerTransposedDense(L.child(i, i), X, offset);
+    for (int j = 0; j < i; ++j)
+      applyBlock(L.child(i, j), X, X, TRANS, -1, offset, offset);
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::solveUpperTransposedDense(
+    const Block &U, arma::Mat<ValueType> &X, std::size_t offset) const {
+
+  if (X.n_cols == 0)
+    return;
+
+  if (U.isLeaf()) {
+    const std::size_t first = U.rowRange[0] - offset;
+    const std::size_t last = U.rowRange[1] - offset - 1;
+    arma::Mat<ValueType> transposed = U.U.st();
+    arma::Mat<ValueType> rhs = X.rows(first, last);
+    X.rows(first, last) = arma::solve(arma::trimatl(transposed), rhs);
+    return;
+  }
+
+  for (int i = 0; i < N; ++i) {
+    solveUpperTransposedDense(U.child(i, i), X, offset);
+    for (int j = i + 1; j < N; ++j)
+      applyBlock(U.child(i, j), X, X, TRANS, -1, offset, offset);
+  }
+}
+
+template <typename ValueType, int N>
+void HMatrixLu<ValueType, N>::apply(const arma::Mat<ValueType> &X,
+                                    arma::Mat<ValueType> &Y,
+                                    TransposeMode trans, ValueType alpha,
+                                    ValueType beta) const {
+
+  if (X.n_rows != rows())
+    throw std::runtime_error("HMatrixLu::apply(): "
+                             "Input matrix has wrong number of rows.");
+
+  const bool noTranspose =
+      (trans == TransposeMode::NOTRANS || trans == TransposeMode::CONJ);
+  const bool conjugate =
+      (trans == TransposeMode::CONJ || trans == TransposeMode::CONJTRANS);
+
+  // inv(conj(A)) * x = conj(inv(A) * conj(x))
+
+  arma::Mat<ValueType> solution =
+      permuteMatToHMatDofs(X, noTranspose ? ROW : COL);
+  if (conjugate)
+    solution = arma::conj(solution);
+
+  const std::size_t offset = m_root->rowRange[0];
+  if (noTranspose) {
+    solveLowerDense(*m_root, solution, offset);
+    solveUpperDense(*m_root, solution, offset);
+  } else {
+    solveUpperTransposedDense(*m_root, solution, offset);
+    solveLowerTransposedDense(*m_root, solution, offset);
+  }
+
+  if (conjugate)
+    solution = arma::conj(solution);
+  solution = permuteMatToOriginalDofs(solution, noTranspose ? COL : ROW);
+
+  if (beta == ValueType(0))
+    Y = alpha * solution;
+  else
+    Y = alpha * solution + beta * Y;
+}
+
+template <typename ValueType, int N>
+arma::Mat<ValueType>
+HMatrixLu<ValueType, N>::permuteMatToHMatDofs(const arma::Mat<ValueType> &mat,
+                                              RowColSelector rowOrColumn) const {
+
+  shared_ptr<const ClusterTree<N>> clusterTree =
+      (rowOrColumn == ROW) ? m_blockClusterTree->rowClusterTree()
+                           : m_blockClusterTree->columnClusterTree();
+
+  if (clusterTree->numberOfDofs() != mat.n_rows)
+    throw std::runtime_error("HMatrixLu::permuteMatToHMatDofs: "
+                             "Input matrix has wrong number of rows.");
+
+  arma::Mat<ValueType> result(mat.n_rows, mat.n_cols);
+  const auto &originalToHMat = clusterTree->originalDofToHMatDofMap();
+  for (std::size_t j = 0; j < mat.n_cols; ++j)
+    for (std::size_t i = 0; i < mat.n_rows; ++i)
+      result(originalToHMat[i], j) = mat(i, j);
+  return result;
+}
+
+template <typename ValueType, int N>
+arma::Mat<ValueType> HMatrixLu<ValueType, N>::permuteMatToOriginalDofs(
+    const arma::Mat<ValueType> &mat, RowColSelector rowOrColumn) const {
+
+  shared_ptr<const ClusterTree<N>> clusterTree =
+      (rowOrColumn == ROW) ? m_blockClusterTree->rowClusterTree()
+                           : m_blockClusterTree->columnClusterTree();
+
+  if (clusterTree->numberOfDofs() != mat.n_rows)
+    throw std::runtime_error("HMatrixLu::permuteMatToOriginalDofs: "
+                             "Input matrix has wrong number of rows.");
+
+  arma::Mat<ValueType> result(mat.n_rows, mat.n_cols);
+  const auto &hMatToOriginal = clusterTree->hMatDofToOriginalDofMap();
+  for (std::size_t j = 0; j < mat.n_cols; ++j)
+    for (std::size_t i = 0; i < mat.n_rows; ++i)
+      result(hMatToOriginal[i], j) = mat(i, j);
+  return result;
+}
+}
+
+#endif
@@ -12,6 +12,7 @@ namespace hmat {
 
 using boost::shared_ptr;
 using boost::make_shared;
+using boost::const_pointer_cast;
 using boost::enable_shared_from_this;
 using boost::weak_ptr;
 }
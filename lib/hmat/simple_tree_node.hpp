@@ -16,12 +16,14 @@ public:
   const shared_ptr<const SimpleTreeNode<T, N>> root() const;
   const shared_ptr<const SimpleTreeNode<T, N>> child(int i) const;
   const shared_ptr<SimpleTreeNode<T, N>> child(int i);
+  bool hasChild(int i) const;
 
   const T &data() const;
   T &data();
 
   void addChild(const T &child, int i);
   void addSubTree(shared_ptr<SimpleTreeNode<T, N>> &subTree, int i);
+  void removeChildren();
 
   bool isLeaf() const;
 
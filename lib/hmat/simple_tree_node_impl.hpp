@@ -44,6 +44,13 @@ const shared_ptr<SimpleTreeNode<T, N>> SimpleTreeNode<T, N>::child(int i) {
   return m_children[i];
 }
 
+template <typename T, int N>
+bool SimpleTreeNode<T, N>::hasChild(int i) const {
+  assert(i < N);
+
+  return static_cast<bool>(m_children[i]);
+}
+
 template <typename T, int N> const T &SimpleTreeNode<T, N>::data() const {
   return m_data;
 }
@@ -67,6 +74,12 @@ void SimpleTreeNode<T, N>::addSubTree(shared_ptr<SimpleTreeNode<T, N>> &subTree,
   m_children[i] = subTree;
 }
 
+template <typename T, int N> void SimpleTreeNode<T, N>::removeChildren() {
+
+  for (auto &child : m_children)
+    child.reset();
+}
+
 template <typename T, int N> bool SimpleTreeNode<T, N>::isLeaf() const {
 
   for (auto child : m_children)
@@ -80,20 +93,22 @@ template <typename T, int N>
 const std::vector<shared_ptr<const SimpleTreeNode<T, N>>>
 SimpleTreeNode<T, N>::leafNodes() const {
 
-  std::function<void(SimpleTreeNode<T, N> &)> getLeafsImpl;
+  std::function<void(const SimpleTreeNode<T, N> &)> getLeafsImpl;
 
   std::vector<shared_ptr<const SimpleTreeNode<T, N>>> leafVector;
 
-  getLeafsImpl = [&leafVector, &getLeafsImpl](SimpleTreeNode<T, N> &node) {
+  getLeafsImpl =
+      [&leafVector, &getLeafsImpl](const SimpleTreeNode<T, N> &node) {
 
     if (node.isLeaf())
-      leafVector.push_back(node);
+      leafVector.push_back(node.shared_from_this());
     else
       for (int i = 0; i < N; ++i)
         getLeafsImpl(*(node.child(i)));
   };
 
   getLeafsImpl(*this);
+  return leafVector;
 }
 
 template <typename T, int N>
@@ -40,6 +40,7 @@
 #include "../space/space.hpp"
 
 #include <Teuchos_RCPBoostSharedPtrConversions.hpp>
+#include <Thyra_DefaultSpmdMultiVector.hpp>
 #include <Thyra_DefaultSpmdVectorSpace.hpp>
 
 #include <boost/make_shared.hpp>
@@ -49,6 +50,19 @@
 
 namespace Bempp {
 
+namespace {
+
+// Number of threads with which to initialize TBB for the given options
+int maxThreadCount(const Fiber::ParallelizationOptions &parallelOptions) {
+  if (parallelOptions.isOpenClEnabled())
+    return 1;
+  if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
+    return tbb::task_scheduler_init::automatic;
+  return parallelOptions.maxThreadCount();
+}
+
+} // namespace
+
 template <typename ValueType>
 Teuchos::RCP<Thyra::DefaultSpmdVector<ValueType>>
 wrapInTrilinosVector(arma::Col<ValueType> &col) {
@@ -61,6 +75,21 @@ wrapInTrilinosVector(arma::Col<ValueType> &col) {
                          trilinosArray, 1 /* stride */));
 }
 
+template <typename ValueType>
+Teuchos::RCP<Thyra::DefaultSpmdMultiVector<ValueType>>
+wrapInTrilinosMultiVector(arma::Mat<ValueType> &mat) {
+  size_t rowCount = mat.n_rows;
+  size_t colCount = mat.n_cols;
+  Teuchos::ArrayRCP<ValueType> trilinosArray =
+      Teuchos::arcp(mat.memptr(), 0 /* lowerOffset */, rowCount * colCount,
+                    false /* doesn't own memory */);
+  typedef Thyra::DefaultSpmdMultiVector<ValueType> TrilinosMultiVector;
+  return Teuchos::RCP<TrilinosMultiVector>(new TrilinosMultiVector(
+      Thyra::defaultSpmdVectorSpace<ValueType>(rowCount),
+      Thyra::defaultSpmdVectorSpace<ValueType>(colCount), trilinosArray,
+      rowCount /* leadingDim */));
+}
+
 /** \cond HIDDEN_INTERNAL */
 
 template <typename BasisFunctionType, typename ResultType>
@@ -248,23 +277,13 @@ DefaultIterativeSolver<BasisFunctionType, ResultType>::solveImplNonblocked(
   Teuchos::RCP<TrilinosVector> solutionVector =
       wrapInTrilinosVector(armaSolution);
 
-  // Get number of threads
-  Fiber::ParallelizationOptions parallelOptions =
-      boundaryOp->context()->assemblyOptions().parallelizationOptions();
-  int maxThreadCount = 1;
-  if (!parallelOptions.isOpenClEnabled()) {
-    if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
-      maxThreadCount = tbb::task_scheduler_init::automatic;
-    else
-      maxThreadCount = parallelOptions.maxThreadCount();
-  }
-
   // Solve
   Thyra::SolveStatus<MagnitudeType> status;
   {
     // Initialize TBB threads here (to prevent their construction and
     // destruction on every matrix-vector multiplication)
-    tbb::task_scheduler_init scheduler(maxThreadCount);
+    tbb::task_scheduler_init scheduler(maxThreadCount(
+        boundaryOp->context()->assemblyOptions().parallelizationOptions()));
     status = m_impl->solverWrapper->solve(Thyra::NOTRANS, *rhsVector,
                                           solutionVector.ptr());
   }
@@ -276,6 +295,159 @@ DefaultIterativeSolver<BasisFunctionType, ResultType>::solveImplNonblocked(
       status);
 }
 
+template <typename BasisFunctionType, typename ResultType>
+std::vector<Solution<BasisFunctionType, ResultType>>
+DefaultIterativeSolver<BasisFunctionType, ResultType>::solveMultipleRhs(
+    const std::vector<GridFunction<BasisFunctionType, ResultType>> &rhs)
+    const {
+  typedef BoundaryOperator<BasisFunctionType, ResultType> BoundaryOp;
+  typedef typename ScalarTraits<ResultType>::RealType MagnitudeType;
+  typedef Thyra::MultiVectorBase<ResultType> TrilinosMultiVector;
+
+  const BoundaryOp *boundaryOp = boost::get<BoundaryOp>(&m_impl->op);
+  if (!boundaryOp)
+    throw std::logic_error(
+        "DefaultIterativeSolver::solveMultipleRhs(): for solvers "
+        "constructed from a BlockedBoundaryOperator the other "
+        "solveMultipleRhs() overload must be used");
+  if (rhs.empty())
+    return std::vector<Solution<BasisFunctionType, ResultType>>();
+  for (size_t i = 0; i < rhs.size(); ++i)
+    Solver<BasisFunctionType, ResultType>::checkConsistency(*boundaryOp,
+                                                            rhs[i],
+                                                            m_impl->mode);
+
+  // Construct the right-hand-side multivector
+  const size_t dualDofCount = boundaryOp->dualToRange()->globalDofCount();
+  arma::Mat<ResultType> armaProjections(dualDofCount, rhs.size());
+  for (size_t i = 0; i < rhs.size(); ++i)
+    armaProjections.col(i) = rhs[i].projections(boundaryOp->dualToRange());
+  Teuchos::RCP<TrilinosMultiVector> rhsVector;
+  arma::Mat<ResultType> armaRhs;
+  if (m_impl->mode == ConvergenceTestMode::TEST_CONVERGENCE_IN_DUAL_TO_RANGE)
+    rhsVector = wrapInTrilinosMultiVector(armaProjections);
+  else {
+    armaRhs.set_size(boundaryOp->range()->globalDofCount(), rhs.size());
+    rhsVector = wrapInTrilinosMultiVector(armaRhs);
+    boost::get<BoundaryOp>(m_impl->pinvId).weakForm()->apply(
+        Thyra::NOTRANS, *wrapInTrilinosMultiVector(armaProjections),
+        rhsVector.ptr(), 1., 0.);
+  }
+
+  // Construct the solution multivector
+  arma::Mat<ResultType> armaSolution(rhsVector->range()->dim(), rhs.size());
+  armaSolution.fill(static_cast<ResultType>(0.));
+  Teuchos::RCP<TrilinosMultiVector> solutionVector =
+      wrapInTrilinosMultiVector(armaSolution);
+
+  // Solve
+  Thyra::SolveStatus<MagnitudeType> status;
+  {
+    tbb::task_scheduler_init scheduler(maxThreadCount(
+        boundaryOp->context()->assemblyOptions().parallelizationOptions()));
+    status = m_impl->solverWrapper->solve(Thyra::NOTRANS, *rhsVector,
+                                          solutionVector.ptr());
+  }
+
+  // Construct grid functions and return
+  std::vector<Solution<BasisFunctionType, ResultType>> solutions;
+  for (size_t i = 0; i < rhs.size(); ++i)
+    solutions.push_back(Solution<BasisFunctionType, ResultType>(
+        GridFunction<BasisFunctionType, ResultType>(
+            boundaryOp->context(), boundaryOp->domain(),
+            arma::Col<ResultType>(armaSolution.col(i))),
+        status));
+  return solutions;
+}
+
+template <typename BasisFunctionType, typename ResultType>
+std::vector<BlockedSolution<BasisFunctionType, ResultType>>
+DefaultIterativeSolver<BasisFunctionType, ResultType>::solveMultipleRhs(
+    const std::vector<std::vector<GridFunction<BasisFunctionType, ResultType>>>
+        &rhs) const {
+  typedef BlockedBoundaryOperator<BasisFunctionType, ResultType> BoundaryOp;
+  typedef typename ScalarTraits<ResultType>::RealType MagnitudeType;
+  typedef Thyra::MultiVectorBase<ResultType> TrilinosMultiVector;
+
+  const BoundaryOp *boundaryOp = boost::get<BoundaryOp>(&m_impl->op);
+  if (!boundaryOp)
+    throw std::logic_error(
+        "DefaultIterativeSolver::solveMultipleRhs(): for solvers "
+        "constructed from a (non-blocked) BoundaryOperator the other "
+        "solveMultipleRhs() overload must be used");
+  if (rhs.empty())
+    return std::vector<BlockedSolution<BasisFunctionType, ResultType>>();
+
+  // Construct the right-hand-side multivector; column i contains the
+  // projections of all blocks of the ith right-hand side
+  arma::Mat<ResultType> armaProjections(
+      boundaryOp->totalGlobalDofCountInDualsToRanges(), rhs.size());
+  for (size_t i = 0; i < rhs.size(); ++i) {
+    std::vector<GridFunction<BasisFunctionType, ResultType>> canonicalRhs =
+        Solver<BasisFunctionType, ResultType>::canonicalizeBlockedRhs(
+            *boundaryOp, rhs[i], m_impl->mode);
+    Solver<BasisFunctionType, ResultType>::checkConsistency(
+        *boundaryOp, canonicalRhs, m_impl->mode);
+    for (size_t block = 0, start = 0; block < canonicalRhs.size(); ++block) {
+      const arma::Col<ResultType> &chunkProjections =
+          canonicalRhs[block].projections(boundaryOp->dualToRange(block));
+      size_t chunkSize = chunkProjections.n_rows;
+      armaProjections.submat(start, i, start + chunkSize - 1, i) =
+          chunkProjections;
+      start += chunkSize;
+    }
+  }
+  Teuchos::RCP<TrilinosMultiVector> rhsVector;
+  arma::Mat<ResultType> armaRhs;
+  if (m_impl->mode == ConvergenceTestMode::TEST_CONVERGENCE_IN_DUAL_TO_RANGE)
+    rhsVector = wrapInTrilinosMultiVector(armaProjections);
+  else {
+    armaRhs.set_size(boundaryOp->totalGlobalDofCountInRanges(), rhs.size());
+    rhsVector = wrapInTrilinosMultiVector(armaRhs);
+    boost::get<BoundaryOp>(m_impl->pinvId).weakForm()->apply(
+        Thyra::NOTRANS, *wrapInTrilinosMultiVector(armaProjections),
+        rhsVector.ptr(), 1., 0.);
+  }
+
+  // Construct the solution multivector
+  arma::Mat<ResultType> armaSolution(
+      boundaryOp->totalGlobalDofCountInDomains(), rhs.size());
+  armaSolution.fill(static_cast<ResultType>(0.));
+  Teuchos::RCP<TrilinosMultiVector> solutionVector =
+      wrapInTrilinosMultiVector(armaSolution);
+
+  // Get context of the first non-empty operator
+  size_t rowCount = boundaryOp->rowCount();
+  shared_ptr<const Context<BasisFunctionType, ResultType>> context;
+  for (size_t row = 0; row < rowCount; ++row)
+    if (boundaryOp->block(row, 0).context()) {
+      context = boundaryOp->block(row, 0).context();
+      break;
+    }
+  assert(context);
+
+  // Solve
+  Thyra::SolveStatus<MagnitudeType> status;
+  {
+    tbb::task_scheduler_init scheduler(maxThreadCount(
+        context->assemblyOptions().parallelizationOptions()));
+    status = m_impl->solverWrapper->solve(Thyra::NOTRANS, *rhsVector,
+                                          solutionVector.ptr());
+  }
+
+  // Convert chunks of the solution vectors into grid functions
+  std::vector<BlockedSolution<BasisFunctionType, ResultType>> solutions;
+  for (size_t i = 0; i < rhs.size(); ++i) {
+    std::vector<GridFunction<BasisFunctionType, ResultType>> solutionFunctions;
+    Solver<BasisFunctionType, ResultType>::constructBlockedGridFunction(
+        arma::Col<ResultType>(armaSolution.col(i)), *boundaryOp,
+        solutionFunctions);
+    solutions.push_back(BlockedSolution<BasisFunctionType, ResultType>(
+        solutionFunctions, status));
+  }
+  return solutions;
+}
+
 template <typename BasisFunctionType, typename ResultType>
 BlockedSolution<BasisFunctionType, ResultType>
 DefaultIterativeSolver<BasisFunctionType, ResultType>::solveImplBlocked(
@@ -340,23 +512,13 @@ DefaultIterativeSolver<BasisFunctionType, ResultType>::solveImplBlocked(
     }
   assert(context);
 
-  // Get number of threads
-  Fiber::ParallelizationOptions parallelOptions =
-      context->assemblyOptions().parallelizationOptions();
-  int maxThreadCount = 1;
-  if (!parallelOptions.isOpenClEnabled()) {
-    if (parallelOptions.maxThreadCount() == ParallelizationOptions::AUTO)
-      maxThreadCount = tbb::task_scheduler_init::automatic;
-    else
-      maxThreadCount = parallelOptions.maxThreadCount();
-  }
-
   // Solve
   Thyra::SolveStatus<MagnitudeType> status;
   {
     // Initialize TBB threads here (to prevent their construction and
     // destruction on every matrix-vector multiplication)
-    tbb::task_scheduler_init scheduler(maxThreadCount);
+    tbb::task_scheduler_init scheduler(maxThreadCount(
+        context->assemblyOptions().parallelizationOptions()));
     status = m_impl->solverWrapper->solve(Thyra::NOTRANS, *rhsVector,
                                           solutionVector.ptr());
   }
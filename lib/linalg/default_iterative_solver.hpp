@@ -128,6 +128,42 @@ public:
   void initializeSolver(const Teuchos::RCP<Teuchos::ParameterList> &paramList,
                         const Preconditioner<ResultType> &preconditioner);
 
+  /** \brief Solve a non-blocked boundary integral equation for several
+    * right-hand sides at once.
+    *
+    * All right-hand sides are passed to the Belos solver as a single
+    * multivector, so that operators supporting it (e.g. H-matrices) are
+    * applied to all of them with matrix-matrix products.
+    *
+    * \param[in] rhs
+    *   <tt>vector</tt> of GridFunctions representing the right-hand sides.
+    *
+    * \return A <tt>vector</tt> of Solution objects, one for each right-hand
+    * side. All solutions share the status reported by the solver.
+    */
+  std::vector<Solution<BasisFunctionType, ResultType>> solveMultipleRhs(
+      const std::vector<GridFunction<BasisFunctionType, ResultType>> &rhs)
+      const;
+
+  /** \brief Solve a blocked boundary integral equation for several
+    * right-hand sides at once.
+    *
+    * The right-hand sides are passed to the Belos solver as a single
+    * multivector, as in the non-blocked overload.
+    *
+    * \param[in] rhs
+    *   <tt>vector</tt> of right-hand sides. Each of them is a
+    *   <tt>vector</tt> of GridFunctions, one for each block row of the
+    *   operator, as in Solver::solve(). Null grid functions are treated as
+    *   zero.
+    *
+    * \return A <tt>vector</tt> of BlockedSolution objects, one for each
+    * right-hand side. All solutions share the status reported by the solver.
+    */
+  std::vector<BlockedSolution<BasisFunctionType, ResultType>>
+  solveMultipleRhs(const std::vector<
+      std::vector<GridFunction<BasisFunctionType, ResultType>>> &rhs) const;
+
 private:
   virtual Solution<BasisFunctionType, ResultType> solveImplNonblocked(
       const GridFunction<BasisFunctionType, ResultType> &rhs) const;
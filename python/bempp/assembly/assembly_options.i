@@ -57,6 +57,8 @@ namespace Bempp
     %feature("compactdefaultargs") enableSingularIntegralCaching;
     %feature("compactdefaultargs") enableSparseStorageOfMassMatrices;
     %feature("compactdefaultargs") enableJointAssembly;
+    %feature("compactdefaultargs") enableTiledDenseAssembly;
+    %feature("compactdefaultargs") enableMixedPrecision;
     %feature("compactdefaultargs") enableBlasInQuadrature;
 }
 
@@ -0,0 +1,21 @@
+%{
+#include "assembly/discrete_hmat_boundary_operator.hpp"
+  %}
+
+namespace Bempp {
+
+#define shared_ptr boost::shared_ptr
+template <typename ValueType>
+void saveHMatOperator(
+    const shared_ptr<const DiscreteBoundaryOperator<ValueType> >& op,
+    const std::string& fileName);
+
+template <typename ValueType>
+shared_ptr<const DiscreteBoundaryOperator<ValueType> >
+loadHMatOperator(const std::string& fileName);
+#undef shared_ptr
+
+BEMPP_INSTANTIATE_SYMBOL_TEMPLATED_ON_VALUE(saveHMatOperator)
+BEMPP_INSTANTIATE_SYMBOL_TEMPLATED_ON_VALUE(loadHMatOperator)
+
+}
@@ -140,6 +140,7 @@ UNIQUE_PTR_TYPEMAPS_FOR_CLASS_TEMPLATED_ON_RESULT(Bempp::InterpolatedFunction)
 %feature("autodoc", 2);
 
 // Fiber
+%include "fiber/treecode_options.i"
 %include "fiber/opencl_options.i"
 %include "fiber/parallelization_options.i"
 %include "fiber/quadrature_options.i"
@@ -196,6 +197,7 @@ UNIQUE_PTR_TYPEMAPS_FOR_CLASS_TEMPLATED_ON_RESULT(Bempp::InterpolatedFunction)
 %include "assembly/discrete_aca_boundary_operator.i"
 %include "assembly/discrete_dense_boundary_operator.i"
 %include "assembly/discrete_inverse_sparse_boundary_operator.i"
+%include "assembly/discrete_hmat_boundary_operator.i"
 
 // Linear algebra
 %include "linalg/parameter_list.i"
@@ -0,0 +1,5 @@
+%{
+#include "fiber/treecode_options.hpp"
+%}
+
+%include "fiber/treecode_options.hpp"
@@ -2688,6 +2688,44 @@ def discreteSparseInverse(op):
     name = 'discreteSparseInverse'
     return _constructObjectTemplatedOnValue(core, name, op.valueType(), op)
 
+def saveHMatOperator(op, fileName):
+    """
+    Save a discrete boundary operator stored as an H-matrix to a binary file.
+
+    The file contains the block cluster tree, the DOF permutations and the
+    data of all blocks, so that the operator can be restored with
+    loadHMatOperator() without reassembling it.
+
+    *Parameters:*
+       - op (DiscreteBoundaryOperator)
+           A discrete boundary operator assembled in HMAT mode.
+       - fileName (string)
+           Name of the file to write.
+    """
+    name = 'saveHMatOperator'
+    return _constructObjectTemplatedOnValue(core, name, op.valueType(), op,
+                                            fileName)
+
+def loadHMatOperator(fileName, valueType='float64'):
+    """
+    Load a discrete boundary operator saved with saveHMatOperator().
+
+    The file is mapped into memory, so that loading does not copy the blocks
+    of the H-matrix.
+
+    *Parameters:*
+       - fileName (string)
+           Name of the file to read.
+       - valueType (string)
+           Type of the entries of the operator. Must match the type of the
+           saved operator. Allowed values: "float32", "float64",
+           "complex64" and "complex128".
+
+    *Returns* a DiscreteBoundaryOperator_ValueType object.
+    """
+    name = 'loadHMatOperator'
+    return _constructObjectTemplatedOnValue(core, name, valueType, fileName)
+
 def discreteOperatorToPreconditioner(op):
     """
     Create a preconditioner from a discrete boundary operator.
@@ -25,6 +25,17 @@ options['JointAssembly'] = {
     'default': False,
     'doc': 'Integral operator superpositions are assembled jointly',
 }
+options['TiledDenseAssembly'] = {
+    'type': 'cbool',
+    'default': False,
+    'doc': 'Dense weak forms are assembled in cache-sized tiles without locks',
+}
+options['MixedPrecision'] = {
+    'type': 'cbool',
+    'default': False,
+    'doc': 'Kernels are evaluated in single precision during regular '
+           'quadrature',
+}
 options['BlasInQuadrature'] = {
     'type': 'BlasQuadrature',
     'default': 'BLAS_QUADRATURE_AUTO',
@@ -147,7 +158,7 @@ options['accuracy'] = {
 assembly_options = [
     'Verbosity', 'uniform_quadrature', 'BlasInQuadrature',
     'SingularIntegralCaching', 'SparseStorageOfLocalOperators',
-    'JointAssembly'
+    'JointAssembly', 'TiledDenseAssembly', 'MixedPrecision'
 ]
 aca_ops = [
     'eps', 'eta', 'scaling', 'minimumBlockSize', 'maximumBlockSize',
@@ -20,8 +20,10 @@
 
 #include "../type_template.hpp"
 #include "../check_arrays_are_close.hpp"
+#include "../random_arrays.hpp"
 
 #include "bempp/common/config_ahmed.hpp"
+#include "assembly/abstract_boundary_operator_pseudoinverse.hpp"
 #include "assembly/blocked_boundary_operator.hpp"
 #include "assembly/blocked_operator_structure.hpp"
 #include "assembly/context.hpp"
@@ -30,6 +32,7 @@
 #include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
 #include "assembly/modified_helmholtz_3d_single_layer_boundary_operator.hpp"
 #include "assembly/numerical_quadrature_strategy.hpp"
+#include "common/global_parameters.hpp"
 #include "grid/grid_factory.hpp"
 #include "grid/grid.hpp"
 #include "space/piecewise_constant_scalar_space.hpp"
@@ -1490,4 +1493,147 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(asDiscreteAcaBoundaryOperator_produces_correct_wea
 
 
 #endif // WITH_AHMED
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(blocked_boundary_operator_with_shared_hmat_blocks_is_applied_correctly,
+                              ValueType, result_types)
+{
+    // space | PL | PL
+    // ------+----+---
+    // PC    |  V |  V
+    // PC    |  V |  V
+    //
+    // All blocks share the same H-matrix, which is thus applied
+    // concurrently from the tasks processing the block rows.
+
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+
+    shared_ptr<Space<BFT> > pwiseConstants(
+        new PiecewiseConstantScalarSpace<BFT>(grid));
+    shared_ptr<Space<BFT> > pwiseLinears(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+
+    ParameterList parameters = GlobalParameters::parameterList();
+    parameters.set("boundaryOperatorAssemblyType", std::string("hmat"));
+    parameters.set("verbosityLevel", static_cast<int>(-5));
+    shared_ptr<Context<BFT, RT> > context(new Context<BFT, RT>(parameters));
+
+    BoundaryOperator<BFT, RT> op = laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+        context, pwiseLinears, pwiseLinears, pwiseConstants);
+
+    BlockedOperatorStructure<BFT, RT> structure;
+    structure.setBlock(0, 0, op);
+    structure.setBlock(0, 1, op);
+    structure.setBlock(1, 0, op);
+    structure.setBlock(1, 1, op);
+    Bempp::BlockedBoundaryOperator<BFT, RT> blockedOp(structure);
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > discreteOp = op.weakForm();
+    shared_ptr<const DiscreteBoundaryOperator<RT> > discreteBlockedOp =
+        blockedOp.weakForm();
+    const int n = discreteOp->rowCount();
+    const RT alpha = 2.;
+    const RT beta = 0.5;
+
+    const TranspositionMode modes[] = {NO_TRANSPOSE, TRANSPOSE};
+    const int vectorCounts[] = {1, 3};
+    for (int m = 0; m < 2; ++m)
+        for (int v = 0; v < 2; ++v) {
+            arma::Mat<RT> x = generateRandomMatrix<RT>(2 * n, vectorCounts[v]);
+            arma::Mat<RT> y = generateRandomMatrix<RT>(2 * n, vectorCounts[v]);
+
+            // Serial reference: apply the blocks one after another
+            arma::Mat<RT> x0 = x.rows(0, n - 1), x1 = x.rows(n, 2 * n - 1);
+            arma::Mat<RT> expected0 = y.rows(0, n - 1);
+            arma::Mat<RT> expected1 = y.rows(n, 2 * n - 1);
+            discreteOp->apply(modes[m], x0, expected0, alpha, beta);
+            discreteOp->apply(modes[m], x1, expected0, alpha, 1.);
+            discreteOp->apply(modes[m], x0, expected1, alpha, beta);
+            discreteOp->apply(modes[m], x1, expected1, alpha, 1.);
+            arma::Mat<RT> expected = arma::join_cols(expected0, expected1);
+
+            discreteBlockedOp->apply(modes[m], x, y, alpha, beta);
+
+            BOOST_CHECK(check_arrays_are_close<ValueType>(
+                            y, expected,
+                            100. * std::numeric_limits<RealType>::epsilon()));
+        }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(blocked_boundary_operator_with_shared_sparse_inverse_blocks_is_applied_correctly,
+                              ValueType, result_types)
+{
+    // space | PL   | PL
+    // ------+------+-----
+    // PL    | Id^-1| Id^-1
+    // PL    | Id^-1| Id^-1
+    //
+    // All blocks share the same sparse LU decomposition, whose solver is
+    // thus called concurrently from the tasks processing the block rows.
+
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-1.msh", false /* verbose */);
+
+    shared_ptr<Space<BFT> > pwiseLinears(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+        new NumericalQuadratureStrategy<BFT, RT>);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+    BoundaryOperator<BFT, RT> op = pseudoinverse(identityOperator<BFT, RT>(
+        context, pwiseLinears, pwiseLinears, pwiseLinears));
+
+    BlockedOperatorStructure<BFT, RT> structure;
+    structure.setBlock(0, 0, op);
+    structure.setBlock(0, 1, op);
+    structure.setBlock(1, 0, op);
+    structure.setBlock(1, 1, op);
+    Bempp::BlockedBoundaryOperator<BFT, RT> blockedOp(structure);
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > discreteOp = op.weakForm();
+    shared_ptr<const DiscreteBoundaryOperator<RT> > discreteBlockedOp =
+        blockedOp.weakForm();
+    const int n = discreteOp->rowCount();
+    const RT alpha = 2.;
+    const RT beta = 0.5;
+
+    // Repeat the product to give the row tasks a chance to overlap
+    for (int i = 0; i < 10; ++i) {
+        arma::Col<RT> x = generateRandomVector<RT>(2 * n);
+        arma::Col<RT> y = generateRandomVector<RT>(2 * n);
+
+        // Serial reference: apply the blocks one after another
+        arma::Col<RT> x0 = x.rows(0, n - 1), x1 = x.rows(n, 2 * n - 1);
+        arma::Col<RT> expected0 = y.rows(0, n - 1);
+        arma::Col<RT> expected1 = y.rows(n, 2 * n - 1);
+        discreteOp->apply(NO_TRANSPOSE, x0, expected0, alpha, beta);
+        discreteOp->apply(NO_TRANSPOSE, x1, expected0, alpha, 1.);
+        discreteOp->apply(NO_TRANSPOSE, x0, expected1, alpha, beta);
+        discreteOp->apply(NO_TRANSPOSE, x1, expected1, alpha, 1.);
+        arma::Col<RT> expected = arma::join_cols(expected0, expected1);
+
+        discreteBlockedOp->apply(NO_TRANSPOSE, x, y, alpha, beta);
+
+        BOOST_CHECK(check_arrays_are_close<ValueType>(
+                        y, expected,
+                        100. * std::numeric_limits<RealType>::epsilon()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
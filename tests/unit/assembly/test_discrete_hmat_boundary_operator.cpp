@@ -0,0 +1,445 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../check_arrays_are_close.hpp"
+#include "../random_arrays.hpp"
+
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/discrete_hmat_boundary_operator.hpp"
+#include "assembly/helmholtz_3d_single_layer_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/symmetry.hpp"
+#include "common/global_parameters.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid.hpp"
+#include "hmat/hmatrix.hpp"
+#include "hmat/hmatrix_low_rank_data.hpp"
+#include "space/piecewise_constant_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <cstdio>
+#include <string>
+
+using namespace Bempp;
+
+namespace
+{
+
+template <typename BFT>
+shared_ptr<Space<BFT> > makeSphereSpace()
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+    return shared_ptr<Space<BFT> >(new PiecewiseConstantScalarSpace<BFT>(grid));
+}
+
+// Default H-matrix parameters with the accuracy eps
+ParameterList defaultHMatParameters(double eps)
+{
+    ParameterList hMatParameters =
+        GlobalParameters::parameterList().sublist("HMatParameters");
+    hMatParameters.set("eps", eps);
+    return hMatParameters;
+}
+
+// Context in which weak forms are assembled as H-matrices
+template <typename BFT, typename RT>
+shared_ptr<Context<BFT, RT> > makeHMatContext(
+        const ParameterList& hMatParameters)
+{
+    ParameterList parameters = GlobalParameters::parameterList();
+    parameters.set("boundaryOperatorAssemblyType", std::string("hmat"));
+    parameters.set("verbosityLevel", static_cast<int>(-5));
+    parameters.sublist("HMatParameters").setParameters(hMatParameters);
+    return shared_ptr<Context<BFT, RT> >(new Context<BFT, RT>(parameters));
+}
+
+template <typename BFT, typename RT>
+shared_ptr<Context<BFT, RT> > makeHMatContext(double eps)
+{
+    return makeHMatContext<BFT, RT>(defaultHMatParameters(eps));
+}
+
+template <typename BFT, typename RT>
+shared_ptr<Context<BFT, RT> > makeDenseContext()
+{
+    ParameterList parameters = GlobalParameters::parameterList();
+    parameters.set("boundaryOperatorAssemblyType", std::string("dense"));
+    parameters.set("verbosityLevel", static_cast<int>(-5));
+    return shared_ptr<Context<BFT, RT> >(new Context<BFT, RT>(parameters));
+}
+
+// Weak form of the single-layer operator on a sphere, assembled as an
+// H-matrix
+template <typename BFT, typename RT>
+shared_ptr<const DiscreteBoundaryOperator<RT> > assembleHMatWeakForm(
+        const ParameterList& hMatParameters)
+{
+    shared_ptr<Space<BFT> > pwiseConstants = makeSphereSpace<BFT>();
+    BoundaryOperator<BFT, RT> op =
+        laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+            makeHMatContext<BFT, RT>(hMatParameters),
+            pwiseConstants, pwiseConstants, pwiseConstants);
+    return op.weakForm();
+}
+
+template <typename BFT, typename RT>
+shared_ptr<const DiscreteBoundaryOperator<RT> > assembleHMatWeakForm(
+        double eps = 1e-3)
+{
+    return assembleHMatWeakForm<BFT, RT>(defaultHMatParameters(eps));
+}
+
+// Weak form of the single-layer operator on a sphere, assembled as a dense
+// matrix
+template <typename BFT, typename RT>
+arma::Mat<RT> assembleDenseWeakForm()
+{
+    shared_ptr<Space<BFT> > pwiseConstants = makeSphereSpace<BFT>();
+    BoundaryOperator<BFT, RT> op =
+        laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+            makeDenseContext<BFT, RT>(),
+            pwiseConstants, pwiseConstants, pwiseConstants);
+    return op.weakForm()->asMatrix();
+}
+
+// Parameters under which many blocks of the single-layer operator on the
+// sphere are compressed, with ranks limited only by the accuracy eps
+ParameterList compressionTestHMatParameters(double eps)
+{
+    ParameterList hMatParameters = defaultHMatParameters(eps);
+    hMatParameters.set("minBlockSize", static_cast<unsigned int>(16));
+    hMatParameters.set("maxRank", static_cast<unsigned int>(1000));
+    return hMatParameters;
+}
+
+template <typename ValueType>
+typename ScalarTraits<ValueType>::RealType relativeDifference(
+        const arma::Mat<ValueType>& result,
+        const arma::Mat<ValueType>& expected)
+{
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+// Sum of the ranks of the low-rank leaves of the H-matrix stored by op
+template <typename RT>
+size_t totalLowRankBlockRank(
+        const shared_ptr<const DiscreteBoundaryOperator<RT> >& op)
+{
+    shared_ptr<const hmat::DefaultHMatrixType<RT> > hMatrix =
+        dynamic_pointer_cast<const hmat::DefaultHMatrixType<RT> >(
+            DiscreteHMatBoundaryOperator<RT>::castToHMat(op)
+                ->compressedMatrix());
+    BOOST_REQUIRE(hMatrix);
+
+    size_t result = 0;
+    const std::vector<shared_ptr<const hmat::BlockClusterTreeNode<2> > >
+        leaves = hMatrix->blockClusterTree()->leafNodes();
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        if (!hMatrix->isStoredBlock(*leaves[i]))
+            continue;
+        shared_ptr<const hmat::HMatrixLowRankData<RT> > lowRankData =
+            dynamic_pointer_cast<const hmat::HMatrixLowRankData<RT> >(
+                hMatrix->data(leaves[i]));
+        if (lowRankData)
+            result += lowRankData->rank();
+    }
+    return result;
+}
+
+// Number of leaves of the block cluster tree of the H-matrix stored by op
+template <typename RT>
+size_t leafCount(const shared_ptr<const DiscreteBoundaryOperator<RT> >& op)
+{
+    shared_ptr<const hmat::DefaultHMatrixType<RT> > hMatrix =
+        dynamic_pointer_cast<const hmat::DefaultHMatrixType<RT> >(
+            DiscreteHMatBoundaryOperator<RT>::castToHMat(op)
+                ->compressedMatrix());
+    BOOST_REQUIRE(hMatrix);
+    return hMatrix->blockClusterTree()->leafNodes().size();
+}
+
+template <typename BFT, typename RT>
+BoundaryOperator<BFT, RT> laplaceSingleLayerOperator(
+        const shared_ptr<Context<BFT, RT> >& context,
+        const shared_ptr<Space<BFT> >& space, int symmetry)
+{
+    return laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+        context, space, space, space, "SLP", symmetry);
+}
+
+// The Helmholtz single-layer operator is complex symmetric, but not
+// Hermitian
+template <typename BFT, typename RT>
+BoundaryOperator<BFT, RT> helmholtzSingleLayerOperator(
+        const shared_ptr<Context<BFT, RT> >& context,
+        const shared_ptr<Space<BFT> >& space, int symmetry)
+{
+    return helmholtz3dSingleLayerBoundaryOperator<BFT>(
+        context, space, space, space, RT(1., 0.), "SLP", symmetry);
+}
+
+template <typename RT>
+arma::Mat<RT> applyMatrix(const arma::Mat<RT>& matrix,
+                          TranspositionMode trans, const arma::Mat<RT>& x)
+{
+    if (trans == NO_TRANSPOSE)
+        return matrix * x;
+    else if (trans == CONJUGATE)
+        return arma::conj(matrix) * x;
+    else if (trans == TRANSPOSE)
+        return matrix.st() * x;
+    else
+        return matrix.t() * x;
+}
+
+// Assemble the operator created by makeOperator with the given symmetry
+// as an H-matrix, of which only the upper block triangle is stored, and
+// compare its action in all transposition modes with that of the dense
+// weak form assembled without symmetry
+template <typename BFT, typename RT, typename OperatorFactory>
+void symmetric_hmat_operator_agrees_with_dense_operator(
+        OperatorFactory makeOperator, int symmetry)
+{
+    const double eps = 1e-4;
+    shared_ptr<Space<BFT> > pwiseConstants = makeSphereSpace<BFT>();
+    BoundaryOperator<BFT, RT> hMatOp = makeOperator(
+        makeHMatContext<BFT, RT>(eps), pwiseConstants, symmetry);
+    BoundaryOperator<BFT, RT> denseOp = makeOperator(
+        makeDenseContext<BFT, RT>(), pwiseConstants, NO_SYMMETRY);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > hMatWeakForm =
+        hMatOp.weakForm();
+    const arma::Mat<RT> denseWeakForm = denseOp.weakForm()->asMatrix();
+
+    const TranspositionMode modes[] = {
+        NO_TRANSPOSE, CONJUGATE, TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 4; ++m) {
+        const arma::Mat<RT> x =
+            generateRandomMatrix<RT>(hMatWeakForm->columnCount(), 3);
+        const arma::Mat<RT> y =
+            generateRandomMatrix<RT>(hMatWeakForm->rowCount(), 3);
+        const arma::Mat<RT> expected =
+            RT(2.) * applyMatrix(denseWeakForm, modes[m], x) + RT(0.5) * y;
+        arma::Mat<RT> result = y;
+        hMatWeakForm->apply(modes[m], x, result, 2., 0.5);
+
+        BOOST_CHECK_LT(relativeDifference<RT>(result, expected), 10. * eps);
+    }
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(DiscreteHMatBoundaryOperator)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(saved_and_loaded_operator_is_applied_like_the_original,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > original =
+        assembleHMatWeakForm<BFT, RT>();
+    const std::string fileName = "hmat_operator_round_trip.bin";
+    saveHMatOperator(original, fileName);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > loaded =
+        loadHMatOperator<RT>(fileName);
+
+    BOOST_CHECK_EQUAL(loaded->rowCount(), original->rowCount());
+    BOOST_CHECK_EQUAL(loaded->columnCount(), original->columnCount());
+
+    const TranspositionMode modes[] = {NO_TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 2; ++m) {
+        arma::Mat<RT> x =
+            generateRandomMatrix<RT>(original->columnCount(), 2);
+        arma::Mat<RT> expected =
+            generateRandomMatrix<RT>(original->rowCount(), 2);
+        arma::Mat<RT> result = expected;
+        original->apply(modes[m], x, expected, 1., 0.5);
+        loaded->apply(modes[m], x, result, 1., 0.5);
+
+        BOOST_CHECK(check_arrays_are_close<ValueType>(
+                        result, expected,
+                        10. * std::numeric_limits<RealType>::epsilon()));
+    }
+
+    loaded.reset();
+    std::remove(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(approximate_lu_inverse_solves_the_system,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const double eps = 1e-4;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > op =
+        assembleHMatWeakForm<BFT, RT>(eps);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > luInverse =
+        hmatOperatorApproximateLuInverse(op, eps);
+
+    arma::Mat<RT> b = generateRandomMatrix<RT>(op->rowCount(), 2);
+    arma::Mat<RT> x(op->columnCount(), 2);
+    luInverse->apply(NO_TRANSPOSE, b, x, 1., 0.);
+    arma::Mat<RT> residual = b;
+    op->apply(NO_TRANSPOSE, x, residual, 1., -1.);
+
+    // The truncation errors of the factors are amplified by the condition
+    // number of the matrix, which is moderate for this grid
+    const RealType relativeResidual =
+        arma::norm(residual, "fro") / arma::norm(b, "fro");
+    BOOST_CHECK_LT(relativeResidual, 100. * eps);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(aca_plus_compression_agrees_with_dense_assembly_and_plain_aca,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const double eps = 1e-4;
+    ParameterList acaParameters = compressionTestHMatParameters(eps);
+    acaParameters.set("compressionAlgorithm", std::string("aca"));
+    ParameterList acaPlusParameters = compressionTestHMatParameters(eps);
+    acaPlusParameters.set("compressionAlgorithm", std::string("aca+"));
+
+    const arma::Mat<RT> dense = assembleDenseWeakForm<BFT, RT>();
+    const arma::Mat<RT> aca =
+        assembleHMatWeakForm<BFT, RT>(acaParameters)->asMatrix();
+    const arma::Mat<RT> acaPlus =
+        assembleHMatWeakForm<BFT, RT>(acaPlusParameters)->asMatrix();
+
+    BOOST_CHECK_LT(relativeDifference<RT>(acaPlus, dense), 10. * eps);
+    BOOST_CHECK_LT(relativeDifference<RT>(aca, dense), 10. * eps);
+    BOOST_CHECK_LT(relativeDifference<RT>(acaPlus, aca), 20. * eps);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(recompression_reduces_ranks_within_accuracy,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const double eps = 1e-4;
+    ParameterList parameters = compressionTestHMatParameters(eps);
+    parameters.set("recompress", false);
+    ParameterList recompressionParameters = compressionTestHMatParameters(eps);
+    recompressionParameters.set("recompress", true);
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > original =
+        assembleHMatWeakForm<BFT, RT>(parameters);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > recompressed =
+        assembleHMatWeakForm<BFT, RT>(recompressionParameters);
+
+    // ACA overestimates the ranks needed for the accuracy eps, which the
+    // truncated SVD attains
+    const size_t originalRank = totalLowRankBlockRank<RT>(original);
+    const size_t recompressedRank = totalLowRankBlockRank<RT>(recompressed);
+    BOOST_CHECK_GT(originalRank, 0u);
+    BOOST_CHECK_LT(recompressedRank, originalRank);
+
+    const arma::Mat<RT> dense = assembleDenseWeakForm<BFT, RT>();
+    BOOST_CHECK_LT(relativeDifference<RT>(recompressed->asMatrix(), dense),
+                   10. * eps);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(coarsened_operator_is_applied_like_the_dense_operator,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const double eps = 1e-4;
+    ParameterList parameters = compressionTestHMatParameters(eps);
+    parameters.set("coarsening", false);
+    ParameterList coarseningParameters = compressionTestHMatParameters(eps);
+    coarseningParameters.set("coarsening", true);
+
+    shared_ptr<const DiscreteBoundaryOperator<RT> > original =
+        assembleHMatWeakForm<BFT, RT>(parameters);
+    shared_ptr<const DiscreteBoundaryOperator<RT> > coarsened =
+        assembleHMatWeakForm<BFT, RT>(coarseningParameters);
+    BOOST_CHECK_LT(leafCount<RT>(coarsened), leafCount<RT>(original));
+
+    // The products are computed from the leaves of the coarsened tree
+    const arma::Mat<RT> dense = assembleDenseWeakForm<BFT, RT>();
+    const TranspositionMode modes[] = {NO_TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 2; ++m) {
+        const arma::Mat<RT> x =
+            generateRandomMatrix<RT>(coarsened->columnCount(), 2);
+        arma::Mat<RT> result(coarsened->rowCount(), 2);
+        coarsened->apply(modes[m], x, result, 1., 0.);
+        const arma::Mat<RT> expected =
+            (modes[m] == NO_TRANSPOSE) ? arma::Mat<RT>(dense * x)
+                                       : arma::Mat<RT>(dense.t() * x);
+        BOOST_CHECK_LT(relativeDifference<RT>(result, expected), 10. * eps);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(symmetric_real_operator_agrees_with_dense_operator_in_all_transposition_modes,
+                              ValueType, real_result_types)
+{
+    typedef ValueType RT;
+    typedef ValueType BFT;
+
+    symmetric_hmat_operator_agrees_with_dense_operator<BFT, RT>(
+        laplaceSingleLayerOperator<BFT, RT>, SYMMETRIC);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(symmetric_complex_operator_agrees_with_dense_operator_in_all_transposition_modes,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    symmetric_hmat_operator_agrees_with_dense_operator<BFT, RT>(
+        helmholtzSingleLayerOperator<BFT, RT>, SYMMETRIC);
+}
+
+// The weak form of the Laplace single-layer operator is real symmetric and
+// therefore Hermitian. Stored as a complex H-matrix, its blocks below the
+// block diagonal are applied as the adjoints of the stored blocks.
+BOOST_AUTO_TEST_CASE_TEMPLATE(hermitian_complex_operator_agrees_with_dense_operator_in_all_transposition_modes,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    symmetric_hmat_operator_agrees_with_dense_operator<BFT, RT>(
+        laplaceSingleLayerOperator<BFT, RT>, HERMITIAN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -243,6 +243,82 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_apply_works_correctly_for_alpha_equal_to_2
                                            10. * std::numeric_limits<CT>::epsilon()));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_multivector_apply_agrees_with_dense_matrix_for_all_transposition_modes, ResultType, result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteSparseBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+    arma::Mat<RT> mat = dop->asMatrix();
+
+    RT alpha(2.);
+    RT beta(3.);
+
+    const TranspositionMode modes[] = {
+        NO_TRANSPOSE, TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 3; ++m) {
+        arma::Mat<RT> opMat;
+        if (modes[m] == NO_TRANSPOSE)
+            opMat = mat;
+        else if (modes[m] == TRANSPOSE)
+            opMat = mat.st();
+        else
+            opMat = mat.t();
+
+        arma::Mat<RT> x = generateRandomMatrix<RT>(opMat.n_cols, 3);
+        arma::Mat<RT> y = generateRandomMatrix<RT>(opMat.n_rows, 3);
+
+        arma::Mat<RT> expected = alpha * opMat * x + beta * y;
+
+        dop->apply(modes[m], x, y, alpha, beta);
+
+        BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                               10. * std::numeric_limits<CT>::epsilon()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(builtin_multivector_apply_agrees_with_dense_matrix_for_all_transposition_modes_and_complex_coefficients, ResultType, complex_result_types)
+{
+    std::srand(1);
+
+    typedef ResultType RT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType BFT;
+    typedef typename Fiber::ScalarTraits<RT>::RealType CT;
+
+    DiscreteSparseBoundaryOperatorFixture<BFT, RT> fixture;
+    shared_ptr<const DiscreteBoundaryOperator<RT> > dop = fixture.op.weakForm();
+    arma::Mat<RT> mat = dop->asMatrix();
+
+    RT alpha(2., 3.);
+    RT beta(4., -5.);
+
+    const TranspositionMode modes[] = {
+        NO_TRANSPOSE, TRANSPOSE, CONJUGATE_TRANSPOSE};
+    for (int m = 0; m < 3; ++m) {
+        arma::Mat<RT> opMat;
+        if (modes[m] == NO_TRANSPOSE)
+            opMat = mat;
+        else if (modes[m] == TRANSPOSE)
+            opMat = mat.st();
+        else
+            opMat = mat.t();
+
+        arma::Mat<RT> x = generateRandomMatrix<RT>(opMat.n_cols, 3);
+        arma::Mat<RT> y = generateRandomMatrix<RT>(opMat.n_rows, 3);
+
+        arma::Mat<RT> expected = alpha * opMat * x + beta * y;
+
+        dop->apply(modes[m], x, y, alpha, beta);
+
+        BOOST_CHECK(check_arrays_are_close<RT>(y, expected,
+                                               10. * std::numeric_limits<CT>::epsilon()));
+    }
+}
+
 #ifdef WITH_AHMED
 BOOST_AUTO_TEST_CASE_TEMPLATE(asDiscreteAcaBoundaryOperator_works_correctly, ResultType, result_types)
 {
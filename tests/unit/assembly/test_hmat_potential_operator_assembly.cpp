@@ -0,0 +1,176 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../random_arrays.hpp"
+
+#include "assembly/assembled_potential_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/evaluation_options.hpp"
+#include "assembly/grid_function.hpp"
+#include "assembly/helmholtz_3d_single_layer_potential_operator.hpp"
+#include "assembly/laplace_3d_double_layer_potential_operator.hpp"
+#include "assembly/laplace_3d_single_layer_potential_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "common/global_parameters.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Bempp;
+
+namespace
+{
+
+const double hMatEps = 1e-4;
+
+EvaluationOptions hMatEvaluationOptions()
+{
+    ParameterList hMatParameters =
+        GlobalParameters::parameterList().sublist("HMatParameters");
+    hMatParameters.set("eps", hMatEps);
+    // Small blocks, so that the sphere is split into many admissible blocks
+    hMatParameters.set("minBlockSize", static_cast<unsigned int>(16));
+    hMatParameters.set("eta", 0.8);
+
+    EvaluationOptions options;
+    options.setVerbosityLevel(VerbosityLevel::LOW);
+    options.switchToHMatMode(hMatParameters);
+    return options;
+}
+
+// Points at distances between 1.1 and 3 from the centre of the unit sphere
+template <typename CoordinateType>
+arma::Mat<CoordinateType> evaluationPoints(int pointCount)
+{
+    arma::Mat<CoordinateType> points =
+        generateRandomMatrix<CoordinateType>(3, pointCount) - 0.5;
+    const arma::Row<CoordinateType> radii =
+        1.1 + 1.9 * generateRandomMatrix<CoordinateType>(1, pointCount);
+    for (int i = 0; i < pointCount; ++i)
+        points.col(i) *= radii(i) / arma::norm(points.col(i), 2);
+    return points;
+}
+
+template <typename ValueType>
+typename ScalarTraits<ValueType>::RealType relativeDifference(
+        const arma::Mat<ValueType>& result, const arma::Mat<ValueType>& expected)
+{
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+// Assemble op for a space of piecewise linears on the sphere in the HMAT and
+// DENSE evaluation modes and compare the matrices and the potentials of a
+// random charge distribution
+template <typename BFT, typename RT>
+void hmat_and_dense_potential_operators_agree(
+        const PotentialOperator<BFT, RT>& op)
+{
+    typedef typename ScalarTraits<RT>::RealType CT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+    shared_ptr<Space<BFT> > pwiseLinears(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+
+    NumericalQuadratureStrategy<BFT, RT> quadStrategy;
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(make_shared_from_ref(quadStrategy),
+                             assemblyOptions));
+
+    shared_ptr<const arma::Mat<CT> > points(
+        new arma::Mat<CT>(evaluationPoints<CT>(400)));
+
+    EvaluationOptions denseOptions;
+    denseOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    const EvaluationOptions hMatOptions = hMatEvaluationOptions();
+
+    AssembledPotentialOperator<BFT, RT> denseOp =
+        op.assemble(pwiseLinears, points, quadStrategy, denseOptions);
+    AssembledPotentialOperator<BFT, RT> hMatOp =
+        op.assemble(pwiseLinears, points, quadStrategy, hMatOptions);
+    BOOST_CHECK_EQUAL(hMatOp.discreteOperator()->rowCount(),
+                      denseOp.discreteOperator()->rowCount());
+    BOOST_CHECK_EQUAL(hMatOp.discreteOperator()->columnCount(),
+                      denseOp.discreteOperator()->columnCount());
+    BOOST_CHECK_LT(relativeDifference<RT>(
+                       hMatOp.discreteOperator()->asMatrix(),
+                       denseOp.discreteOperator()->asMatrix()),
+                   10. * hMatEps);
+
+    GridFunction<BFT, RT> charge(
+        context, pwiseLinears,
+        generateRandomVector<RT>(pwiseLinears->globalDofCount()));
+    const arma::Mat<RT> expected =
+        op.evaluateAtPoints(charge, *points, quadStrategy, denseOptions);
+    const arma::Mat<RT> result =
+        op.evaluateAtPoints(charge, *points, quadStrategy, hMatOptions);
+    BOOST_CHECK_LT(relativeDifference<RT>(result, expected), 10. * hMatEps);
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(HMatPotentialOperatorAssembly)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(hmat_mode_agrees_with_dense_mode_for_laplace_single_layer_potential,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Laplace3dSingleLayerPotentialOperator<BFT, RT> op;
+    hmat_and_dense_potential_operators_agree<BFT, RT>(op);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(hmat_mode_agrees_with_dense_mode_for_laplace_double_layer_potential,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Laplace3dDoubleLayerPotentialOperator<BFT, RT> op;
+    hmat_and_dense_potential_operators_agree<BFT, RT>(op);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(hmat_mode_agrees_with_dense_mode_for_helmholtz_single_layer_potential,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Helmholtz3dSingleLayerPotentialOperator<BFT> op(RT(2., 0.));
+    hmat_and_dense_potential_operators_agree<BFT, RT>(op);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
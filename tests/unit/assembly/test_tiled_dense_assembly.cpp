@@ -0,0 +1,127 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../check_arrays_are_close.hpp"
+
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid.hpp"
+#include "space/piecewise_constant_scalar_space.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <limits>
+
+using namespace Bempp;
+
+namespace
+{
+
+template <typename BFT>
+shared_ptr<Space<BFT> > makeSpace(const shared_ptr<Grid>& grid,
+                                  int polynomialOrder)
+{
+    if (polynomialOrder == 0)
+        return shared_ptr<Space<BFT> >(
+            new PiecewiseConstantScalarSpace<BFT>(grid));
+    return shared_ptr<Space<BFT> >(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+}
+
+// Weak form of the Laplace single-layer operator assembled in dense mode,
+// with tiles of tileSize DOFs or, if tileSize is 0, without tiles
+template <typename BFT, typename RT>
+arma::Mat<RT> assembleWeakForm(int testOrder, int trialOrder, int tileSize)
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+        new NumericalQuadratureStrategy<BFT, RT>);
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    if (tileSize != 0) {
+        assemblyOptions.enableTiledDenseAssembly();
+        assemblyOptions.setDenseAssemblyTileSize(tileSize);
+    }
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+    shared_ptr<Space<BFT> > testSpace = makeSpace<BFT>(grid, testOrder);
+    shared_ptr<Space<BFT> > trialSpace = makeSpace<BFT>(grid, trialOrder);
+    BoundaryOperator<BFT, RT> op =
+        laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+            context, trialSpace, testSpace, testSpace);
+    return op.weakForm()->asMatrix();
+}
+
+template <typename RT>
+void tiled_and_untiled_assembly_agree(int testOrder, int trialOrder)
+{
+    typedef typename ScalarTraits<RT>::RealType RealType;
+    typedef RealType BFT;
+
+    const arma::Mat<RT> expected =
+        assembleWeakForm<BFT, RT>(testOrder, trialOrder, 0);
+    // Small tiles, so that many elements straddle tiles, and tiles sized to
+    // the cache
+    const int tileSizes[] = {16, AssemblyOptions::AUTO};
+    for (int i = 0; i < 2; ++i) {
+        const arma::Mat<RT> result =
+            assembleWeakForm<BFT, RT>(testOrder, trialOrder, tileSizes[i]);
+        BOOST_CHECK(check_arrays_are_close<RT>(
+                        result, expected,
+                        100. * std::numeric_limits<RealType>::epsilon()));
+    }
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(TiledDenseAssembly)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(tiled_and_untiled_assembly_agree_for_piecewise_constants,
+                              ResultType, result_types)
+{
+    tiled_and_untiled_assembly_agree<ResultType>(0, 0);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(tiled_and_untiled_assembly_agree_for_piecewise_linears,
+                              ResultType, result_types)
+{
+    tiled_and_untiled_assembly_agree<ResultType>(1, 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(tiled_and_untiled_assembly_agree_for_different_test_and_trial_spaces,
+                              ResultType, result_types)
+{
+    tiled_and_untiled_assembly_agree<ResultType>(1, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../random_arrays.hpp"
+
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/laplace_3d_double_layer_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid.hpp"
+#include "space/piecewise_constant_scalar_space.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Bempp;
+
+namespace
+{
+
+shared_ptr<Grid> loadSphere()
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    return GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+}
+
+// Small leaves, so that most interactions go through the far field
+TreecodeOptions testTreecodeOptions()
+{
+    TreecodeOptions treecodeOptions;
+    treecodeOptions.expansionOrder = 8;
+    treecodeOptions.maxPointsPerLeaf = 32;
+    treecodeOptions.eta = 1.;
+    return treecodeOptions;
+}
+
+// Relative difference between the treecode-mode and dense-mode weak forms of
+// the operator created by makeOperator, applied to random vectors
+template <typename BFT, typename RT, typename OperatorFactory>
+typename ScalarTraits<RT>::RealType relativeApplyError(
+        const OperatorFactory &makeOperator)
+{
+    AccuracyOptions accuracyOptions;
+    accuracyOptions.doubleRegular.setRelativeQuadratureOrder(2);
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+                new NumericalQuadratureStrategy<BFT, RT>(accuracyOptions));
+
+    AssemblyOptions assemblyOptionsDense;
+    assemblyOptionsDense.setVerbosityLevel(VerbosityLevel::LOW);
+    shared_ptr<Context<BFT, RT> > contextDense(
+        new Context<BFT, RT>(quadStrategy, assemblyOptionsDense));
+
+    AssemblyOptions assemblyOptionsTreecode;
+    assemblyOptionsTreecode.setVerbosityLevel(VerbosityLevel::LOW);
+    assemblyOptionsTreecode.switchToTreecodeMode(testTreecodeOptions());
+    shared_ptr<Context<BFT, RT> > contextTreecode(
+        new Context<BFT, RT>(quadStrategy, assemblyOptionsTreecode));
+
+    // The treecode-mode weak form refers to the kernels of its abstract
+    // operator, so opTreecode must stay alive while the weak form is applied
+    BoundaryOperator<BFT, RT> opDense = makeOperator(contextDense);
+    BoundaryOperator<BFT, RT> opTreecode = makeOperator(contextTreecode);
+    arma::Mat<RT> weakFormDense = opDense.weakForm()->asMatrix();
+
+    arma::Mat<RT> x = generateRandomMatrix<RT>(weakFormDense.n_cols, 2);
+    arma::Mat<RT> expected = weakFormDense * x;
+    arma::Mat<RT> result(weakFormDense.n_rows, 2);
+    result.fill(0.);
+    opTreecode.weakForm()->apply(NO_TRANSPOSE, x, result, 1., 0.);
+
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+template <typename BFT, typename RT>
+struct SingleLayerFactory
+{
+    BoundaryOperator<BFT, RT> operator()(
+            const shared_ptr<const Context<BFT, RT> > &context) const
+    {
+        shared_ptr<Space<BFT> > pwiseConstants(
+            new PiecewiseConstantScalarSpace<BFT>(loadSphere()));
+        return laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+            context, pwiseConstants, pwiseConstants, pwiseConstants);
+    }
+};
+
+template <typename BFT, typename RT>
+struct DoubleLayerFactory
+{
+    BoundaryOperator<BFT, RT> operator()(
+            const shared_ptr<const Context<BFT, RT> > &context) const
+    {
+        shared_ptr<Grid> grid = loadSphere();
+        shared_ptr<Space<BFT> > pwiseConstants(
+            new PiecewiseConstantScalarSpace<BFT>(grid));
+        shared_ptr<Space<BFT> > pwiseLinears(
+            new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+        return laplace3dDoubleLayerBoundaryOperator<BFT, RT>(
+            context, pwiseLinears, pwiseLinears, pwiseConstants);
+    }
+};
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(TreecodeModeAssembly)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_single_layer_operator_agrees_with_dense_assembly,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const RealType error =
+        relativeApplyError<BFT, RT>(SingleLayerFactory<BFT, RT>());
+    BOOST_CHECK_LT(error, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_double_layer_operator_agrees_with_dense_assembly,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const RealType error =
+        relativeApplyError<BFT, RT>(DoubleLayerFactory<BFT, RT>());
+    BOOST_CHECK_LT(error, 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../random_arrays.hpp"
+
+#include "assembly/context.hpp"
+#include "assembly/evaluation_options.hpp"
+#include "assembly/grid_function.hpp"
+#include "assembly/helmholtz_3d_double_layer_potential_operator.hpp"
+#include "assembly/helmholtz_3d_single_layer_potential_operator.hpp"
+#include "assembly/laplace_3d_double_layer_potential_operator.hpp"
+#include "assembly/laplace_3d_single_layer_potential_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+
+using namespace Bempp;
+
+namespace
+{
+
+// Small leaves, so that most interactions go through the interpolants
+TreecodeOptions testTreecodeOptions()
+{
+    TreecodeOptions treecodeOptions;
+    treecodeOptions.expansionOrder = 8;
+    treecodeOptions.maxPointsPerLeaf = 32;
+    treecodeOptions.eta = 1.;
+    return treecodeOptions;
+}
+
+// Points at distances between 1.25 and 3 from the centre of the unit sphere
+template <typename CoordinateType>
+arma::Mat<CoordinateType> evaluationPoints(int pointCount)
+{
+    arma::Mat<CoordinateType> points =
+        generateRandomMatrix<CoordinateType>(3, pointCount) - 0.5;
+    const arma::Row<CoordinateType> radii =
+        1.25 + 1.75 * generateRandomMatrix<CoordinateType>(1, pointCount);
+    for (int i = 0; i < pointCount; ++i)
+        points.col(i) *= radii(i) / arma::norm(points.col(i), 2);
+    return points;
+}
+
+// Relative difference between the potentials of a random charge
+// distribution on the sphere evaluated by op in the treecode and dense modes
+template <typename BFT, typename RT>
+typename ScalarTraits<RT>::RealType relativeEvaluationError(
+        const PotentialOperator<BFT, RT> &op)
+{
+    typedef typename ScalarTraits<RT>::RealType CT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+    shared_ptr<Space<BFT> > pwiseLinears(
+        new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+
+    NumericalQuadratureStrategy<BFT, RT> quadStrategy;
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(make_shared_from_ref(quadStrategy),
+                             assemblyOptions));
+
+    GridFunction<BFT, RT> charge(
+        context, pwiseLinears,
+        generateRandomVector<RT>(pwiseLinears->globalDofCount()));
+    const arma::Mat<CT> points = evaluationPoints<CT>(500);
+
+    EvaluationOptions denseOptions;
+    denseOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    EvaluationOptions treecodeOptions;
+    treecodeOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    treecodeOptions.switchToTreecodeMode(testTreecodeOptions());
+
+    const arma::Mat<RT> expected =
+        op.evaluateAtPoints(charge, points, quadStrategy, denseOptions);
+    const arma::Mat<RT> result =
+        op.evaluateAtPoints(charge, points, quadStrategy, treecodeOptions);
+
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(TreecodePotentialEvaluation)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_agrees_with_dense_mode_for_laplace_single_layer_potential,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Laplace3dSingleLayerPotentialOperator<BFT, RT> op;
+    BOOST_CHECK_LT((relativeEvaluationError<BFT, RT>(op)), 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_agrees_with_dense_mode_for_laplace_double_layer_potential,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Laplace3dDoubleLayerPotentialOperator<BFT, RT> op;
+    BOOST_CHECK_LT((relativeEvaluationError<BFT, RT>(op)), 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_agrees_with_dense_mode_for_helmholtz_single_layer_potential,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    // Low frequency: the sphere is about a third of a wavelength across
+    Helmholtz3dSingleLayerPotentialOperator<BFT> op(RT(1., 0.));
+    BOOST_CHECK_LT((relativeEvaluationError<BFT, RT>(op)), 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(treecode_mode_agrees_with_dense_mode_for_helmholtz_double_layer_potential,
+                              ValueType, complex_result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    Helmholtz3dDoubleLayerPotentialOperator<BFT> op(RT(1., 0.));
+    BOOST_CHECK_LT((relativeEvaluationError<BFT, RT>(op)), 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,251 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+
+#include "assembly/boundary_operator.hpp"
+#include "assembly/context.hpp"
+#include "assembly/discrete_boundary_operator.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/local_assembler_construction_helper.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "common/scalar_traits.hpp"
+#include "fiber/accuracy_options.hpp"
+#include "fiber/adaptive_quadrature_descriptor_selector_factory.hpp"
+#include "fiber/adaptive_quadrature_descriptor_selector_for_integral_operators.hpp"
+#include "fiber/default_double_quadrature_rule_family.hpp"
+#include "fiber/default_quadrature_descriptor_selector_factory.hpp"
+#include "fiber/default_single_quadrature_rule_family.hpp"
+#include "fiber/quadrature_descriptor_selector_for_integral_operators.hpp"
+#include "fiber/raw_grid_geometry.hpp"
+#include "fiber/shapeset.hpp"
+#include "grid/geometry_factory.hpp"
+#include "grid/grid.hpp"
+#include "grid/grid_factory.hpp"
+#include "space/piecewise_constant_scalar_space.hpp"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <algorithm>
+
+using namespace Bempp;
+
+namespace
+{
+
+template <typename BFT>
+class SelectorManager
+{
+public:
+    typedef typename ScalarTraits<BFT>::RealType CT;
+    typedef Fiber::QuadratureDescriptorSelectorForIntegralOperators<CT>
+    Selector;
+    typedef std::vector<const Fiber::Shapeset<BFT>*> ShapesetPtrVector;
+
+    explicit SelectorManager(const shared_ptr<Space<BFT> >& space_) :
+        space(space_)
+    {
+        shared_ptr<GeometryFactory> geometryFactory;
+        LocalAssemblerConstructionHelper::collectGridData(
+            *space, rawGeometry, geometryFactory);
+        LocalAssemblerConstructionHelper::collectShapesets(*space, shapesets);
+    }
+
+    shared_ptr<Selector> makeSelector(
+            const Fiber::QuadratureDescriptorSelectorFactory<BFT>& factory)
+        const
+    {
+        return factory.makeQuadratureDescriptorSelectorForIntegralOperators(
+            rawGeometry, rawGeometry, shapesets, shapesets);
+    }
+
+    // Largest increase of the regular quadrature order over the order of
+    // the shape functions chosen by selector for a pair of disjoint elements
+    int maxRegularOrderIncrement(const Selector& selector) const
+    {
+        const int elementCount = rawGeometry->elementCount();
+        int result = 0;
+        for (int testIndex = 0; testIndex < elementCount; ++testIndex)
+            for (int trialIndex = 0; trialIndex < elementCount; ++trialIndex) {
+                const Fiber::DoubleQuadratureDescriptor desc =
+                    selector.quadratureDescriptor(testIndex, trialIndex, -1.);
+                if (desc.topology.type == Fiber::ElementPairTopology::Disjoint)
+                    result = std::max(
+                        result,
+                        desc.testOrder - (*shapesets)[testIndex]->order());
+            }
+        return result;
+    }
+
+    // Total number of quadrature points used by selector for the regular
+    // integrals over all pairs of disjoint elements
+    size_t regularQuadraturePointCount(const Selector& selector) const
+    {
+        Fiber::DefaultDoubleQuadratureRuleFamily<CT> ruleFamily;
+        const int elementCount = rawGeometry->elementCount();
+        size_t result = 0;
+        arma::Mat<CT> testPoints, trialPoints;
+        std::vector<CT> testWeights, trialWeights;
+        bool isTensor;
+        for (int testIndex = 0; testIndex < elementCount; ++testIndex)
+            for (int trialIndex = 0; trialIndex < elementCount; ++trialIndex) {
+                const Fiber::DoubleQuadratureDescriptor desc =
+                    selector.quadratureDescriptor(testIndex, trialIndex, -1.);
+                if (desc.topology.type != Fiber::ElementPairTopology::Disjoint)
+                    continue;
+                ruleFamily.fillQuadraturePointsAndWeights(
+                    desc, testPoints, trialPoints, testWeights, trialWeights,
+                    isTensor);
+                result += isTensor ? testWeights.size() * trialWeights.size()
+                                   : testWeights.size();
+            }
+        return result;
+    }
+
+    shared_ptr<Space<BFT> > space;
+    shared_ptr<Fiber::RawGridGeometry<CT> > rawGeometry;
+    shared_ptr<ShapesetPtrVector> shapesets;
+};
+
+// Weak form of the Laplace single-layer operator on space assembled in
+// dense mode with regular quadrature orders chosen by factory
+template <typename BFT, typename RT>
+arma::Mat<RT> assembleWeakForm(
+        const shared_ptr<Space<BFT> >& space,
+        const shared_ptr<const Fiber::QuadratureDescriptorSelectorFactory<BFT> >&
+        factory)
+{
+    typedef typename ScalarTraits<BFT>::RealType CT;
+
+    shared_ptr<NumericalQuadratureStrategy<BFT, RT> > quadStrategy(
+        new NumericalQuadratureStrategy<BFT, RT>(
+            factory,
+            boost::make_shared<Fiber::DefaultSingleQuadratureRuleFamily<CT> >(),
+            boost::make_shared<Fiber::DefaultDoubleQuadratureRuleFamily<CT> >()));
+    AssemblyOptions assemblyOptions;
+    assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+    shared_ptr<Context<BFT, RT> > context(
+        new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+    BoundaryOperator<BFT, RT> op =
+        laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+            context, space, space, space);
+    return op.weakForm()->asMatrix();
+}
+
+template <typename ValueType>
+typename ScalarTraits<ValueType>::RealType relativeDifference(
+        const arma::Mat<ValueType>& result,
+        const arma::Mat<ValueType>& expected)
+{
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(AdaptiveQuadratureDescriptorSelectorForIntegralOperators)
+
+// The adaptive selector is compared with the default selector using, for
+// all pairs of disjoint elements, the largest order chosen by the adaptive
+// one. This is the uniform order needed to meet the tolerance for the
+// closest elements; the adaptive selector should reach the same accuracy
+// with fewer quadrature points by lowering the orders of distant pairs.
+BOOST_AUTO_TEST_CASE_TEMPLATE(adaptive_selector_meets_tolerance_with_fewer_points_than_default_selector,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    const RealType tolerance = 1e-4;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-2.msh", false /* verbose */);
+    shared_ptr<Space<BFT> > pwiseConstants(
+        new PiecewiseConstantScalarSpace<BFT>(grid));
+    SelectorManager<BFT> manager(pwiseConstants);
+
+    shared_ptr<const Fiber::QuadratureDescriptorSelectorFactory<BFT> >
+        adaptiveFactory(
+            new Fiber::AdaptiveQuadratureDescriptorSelectorFactory<BFT>(
+                tolerance));
+    const int orderIncrement = manager.maxRegularOrderIncrement(
+        *manager.makeSelector(*adaptiveFactory));
+
+    AccuracyOptionsEx defaultAccuracyOptions;
+    defaultAccuracyOptions.setDoubleRegular(orderIncrement);
+    shared_ptr<const Fiber::QuadratureDescriptorSelectorFactory<BFT> >
+        defaultFactory(
+            new Fiber::DefaultQuadratureDescriptorSelectorFactory<BFT>(
+                defaultAccuracyOptions));
+    AccuracyOptionsEx referenceAccuracyOptions;
+    referenceAccuracyOptions.setDoubleRegular(orderIncrement + 4);
+    shared_ptr<const Fiber::QuadratureDescriptorSelectorFactory<BFT> >
+        referenceFactory(
+            new Fiber::DefaultQuadratureDescriptorSelectorFactory<BFT>(
+                referenceAccuracyOptions));
+
+    BOOST_CHECK_LT(manager.regularQuadraturePointCount(
+                       *manager.makeSelector(*adaptiveFactory)),
+                   manager.regularQuadraturePointCount(
+                       *manager.makeSelector(*defaultFactory)));
+
+    const arma::Mat<RT> adaptive =
+        assembleWeakForm<BFT, RT>(pwiseConstants, adaptiveFactory);
+    const arma::Mat<RT> byDefault =
+        assembleWeakForm<BFT, RT>(pwiseConstants, defaultFactory);
+    const arma::Mat<RT> reference =
+        assembleWeakForm<BFT, RT>(pwiseConstants, referenceFactory);
+    BOOST_CHECK_LT(relativeDifference<RT>(adaptive, reference), tolerance);
+    BOOST_CHECK_LT(relativeDifference<RT>(adaptive, byDefault), tolerance);
+}
+
+BOOST_AUTO_TEST_CASE(kernel_approximation_degree_decreases_with_distance)
+{
+    typedef double BFT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-1.msh", false /* verbose */);
+    SelectorManager<BFT> manager(shared_ptr<Space<BFT> >(
+        new PiecewiseConstantScalarSpace<BFT>(grid)));
+    AccuracyOptionsEx accuracyOptions;
+    const Fiber::AdaptiveQuadratureDescriptorSelectorForIntegralOperators<BFT>
+        selector(manager.rawGeometry, manager.rawGeometry,
+                 manager.shapesets, manager.shapesets, accuracyOptions,
+                 1e-6, 0., 20);
+
+    const int nearDegree = selector.kernelApproximationDegree(1., 1.5, 20);
+    const int farDegree = selector.kernelApproximationDegree(1., 10., 20);
+    BOOST_CHECK_GT(nearDegree, farDegree);
+    BOOST_CHECK_GE(farDegree, 0);
+    BOOST_CHECK_LE(nearDegree, 20);
+    // The maximum degree caps the result
+    BOOST_CHECK_EQUAL(selector.kernelApproximationDegree(1., 1., 3), 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
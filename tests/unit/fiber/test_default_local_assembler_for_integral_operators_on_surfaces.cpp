@@ -44,11 +44,31 @@
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/version.hpp>
 #include <complex>
+#include <string>
 
 using namespace Bempp;
 
 const int N_ELEMENTS_X = 2, N_ELEMENTS_Y = 3;
 
+shared_ptr<Grid> createGrid()
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+
+    const int dimGrid = 2;
+    typedef double ctype;
+    arma::Col<double> lowerLeft(dimGrid);
+    arma::Col<double> upperRight(dimGrid);
+    arma::Col<unsigned int> nElements(dimGrid);
+    lowerLeft.fill(0);
+    upperRight.fill(1);
+    nElements(0) = N_ELEMENTS_X;
+    nElements(1) = N_ELEMENTS_Y;
+
+    return GridFactory::createStructuredGrid(
+                params, lowerLeft, upperRight, nElements);
+}
+
 /** \brief Fixture class. */
 template <typename BFT, typename RT>
 class DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager
@@ -62,10 +82,12 @@ public:
     typedef Fiber::RawGridGeometry<CT> RawGridGeometry;
 
     DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager(
-            bool cacheSingularIntegrals)
+            bool cacheSingularIntegrals,
+            shared_ptr<Grid> grid = shared_ptr<Grid>())
     {
-        // Create a Bempp grid
-        shared_ptr<Grid> grid = createGrid();
+        // Create a Bempp grid, unless one is given
+        if (!grid)
+            grid = createGrid();
 
         // Create context
         Fiber::AccuracyOptions options;
@@ -101,26 +123,6 @@ public:
         assembler = op.makeAssembler(*quadStrategy, assemblyOptions);
     }
 
-private:
-    shared_ptr<Grid> createGrid() {
-        GridParameters params;
-        params.topology = GridParameters::TRIANGULAR;
-
-        const int dimGrid = 2;
-        typedef double ctype;
-        arma::Col<double> lowerLeft(dimGrid);
-        arma::Col<double> upperRight(dimGrid);
-        arma::Col<unsigned int> nElements(dimGrid);
-        lowerLeft.fill(0);
-        upperRight.fill(1);
-        nElements(0) = N_ELEMENTS_X;
-        nElements(1) = N_ELEMENTS_Y;
-
-        return GridFactory::createStructuredGrid(
-                    params, lowerLeft, upperRight, nElements);
-    }
-
-public:
     shared_ptr<PiecewiseConstantSpace> piecewiseConstantSpace;
     shared_ptr<PiecewiseLinearSpace> piecewiseLinearSpace;
     BoundaryOperator<BFT, RT> bop;
@@ -355,12 +357,19 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(
             ResultType>(true);
 }
 
+shared_ptr<Grid> importGrid(const std::string& fileName)
+{
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    return GridFactory::importGmshGrid(params, fileName, false /* verbose */);
+}
+
 template <typename ResultType>
 void
 evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results(
-        bool cacheSingularIntegrals)
+        const shared_ptr<Grid>& grid)
 {
-    const int elementCount = N_ELEMENTS_X * N_ELEMENTS_Y * 2;
+    const int elementCount = grid->leafView()->entityCount(0);
     const int testIndexCount = elementCount, trialIndexCount = elementCount;
     std::vector<int> testIndices(testIndexCount);
     for (int i = 0; i < testIndexCount; ++i)
@@ -375,20 +384,96 @@ evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_res
     {
         DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager<
                 typename ScalarTraits<ResultType>::RealType, ResultType> mgr(
-                    true);
+                    true, grid);
         mgr.assembler->evaluateLocalWeakForms(testIndices, trialIndices,
                                               resultWithCaching);
     }
     {
         DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager<
             typename ScalarTraits<ResultType>::RealType, ResultType> mgr(
-                false);
+                false, grid);
         mgr.assembler->evaluateLocalWeakForms(testIndices, trialIndices,
                                               resultWithoutCaching);
     }
 
-        BOOST_CHECK(check_arrays_are_close<ResultType>(
+    BOOST_CHECK(check_arrays_are_close<ResultType>(
                     resultWithCaching, resultWithoutCaching, 1e-6));
 }
 
+// All elements of the structured grid are congruent, so the singular
+// integrals of most adjacent pairs are copied from a representative pair
+BOOST_AUTO_TEST_CASE_TEMPLATE(
+        evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results_on_structured_grid,
+        ResultType, result_types)
+{
+    evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results<
+            ResultType>(createGrid());
+}
+
+// Congruent pairs of elements lying in different domains must not share
+// their singular integrals
+BOOST_AUTO_TEST_CASE_TEMPLATE(
+        evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results_on_grid_with_domains,
+        ResultType, result_types)
+{
+    evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results<
+            ResultType>(importGrid("meshes/cube-domains.msh"));
+}
+
+// The elements of a refined icosahedron have several shapes, so some
+// adjacent pairs are congruent and some are not
+BOOST_AUTO_TEST_CASE_TEMPLATE(
+        evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results_on_sphere,
+        ResultType, result_types)
+{
+    evaluateLocalWeakForms_with_and_without_singular_integral_caching_gives_same_results<
+            ResultType>(importGrid("meshes/sphere-ico-1.msh"));
+}
+
+// The cache is looked up by a binary search over the test elements adjacent
+// to each trial element. Request the pairs in an order unrelated to that of
+// the cache, including pairs of distant elements that are not cached.
+BOOST_AUTO_TEST_CASE_TEMPLATE(
+        cached_local_weak_forms_are_found_for_element_indices_in_any_order,
+        ResultType, result_types)
+{
+    typedef typename ScalarTraits<ResultType>::RealType RealType;
+
+    shared_ptr<Grid> grid = importGrid("meshes/sphere-ico-1.msh");
+    const int elementCount = grid->leafView()->entityCount(0);
+    std::vector<int> indices(elementCount);
+    for (int i = 0; i < elementCount; ++i)
+        indices[i] = i;
+    std::vector<int> testIndices(indices.rbegin(), indices.rend());
+    // A permutation, since the grid has 80 elements and 7 is coprime to 80
+    std::vector<int> trialIndices(elementCount);
+    for (int i = 0; i < elementCount; ++i)
+        trialIndices[i] = (7 * i) % elementCount;
+
+    Fiber::_2dArray<arma::Mat<ResultType> > resultWithCaching;
+    Fiber::_2dArray<arma::Mat<ResultType> > resultWithoutCaching;
+    {
+        DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager<
+                RealType, ResultType> mgr(true, grid);
+        mgr.assembler->evaluateLocalWeakForms(testIndices, trialIndices,
+                                              resultWithCaching);
+    }
+    {
+        DefaultLocalAssemblerForIntegralOperatorsOnSurfacesManager<
+                RealType, ResultType> mgr(false, grid);
+        mgr.assembler->evaluateLocalWeakForms(indices, indices,
+                                              resultWithoutCaching);
+    }
+
+    Fiber::_2dArray<arma::Mat<ResultType> > expected(elementCount,
+                                                     elementCount);
+    for (int testI = 0; testI < elementCount; ++testI)
+        for (int trialI = 0; trialI < elementCount; ++trialI)
+            expected(testI, trialI) = resultWithoutCaching(
+                        testIndices[testI], trialIndices[trialI]);
+
+    BOOST_CHECK(check_arrays_are_close<ResultType>(
+                    resultWithCaching, expected, 1e-6));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
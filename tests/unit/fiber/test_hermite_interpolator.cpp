@@ -0,0 +1,138 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "assembly/helmholtz_3d_operators_common.hpp"
+#include "fiber/hermite_interpolator.hpp"
+#include "fiber/initialize_interpolator_for_modified_helmholtz_3d_kernels.hpp"
+
+#include "../type_template.hpp"
+#include "../check_arrays_are_close.hpp"
+#include "../random_arrays.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <complex>
+#include <limits>
+
+namespace
+{
+
+const double maxDist = 20.;
+
+// Distances covering the whole interpolation range, including both of its
+// ends, points close to the origin and nodes of the interpolation grid
+template <typename CoordinateType>
+arma::Col<CoordinateType> interpolationPoints(int nodeCount)
+{
+    const int pointCount = 100;
+    arma::Col<CoordinateType> points =
+        maxDist * generateRandomVector<CoordinateType>(pointCount);
+    points(0) = 0.;
+    points(1) = maxDist;
+    points.rows(2, 11) *= 0.01;
+    for (int i = 12; i < 20; ++i)
+        points(i) = maxDist * (i - 12) / CoordinateType(nodeCount - 1);
+    return points;
+}
+
+// Compare the values of the interpolant of exp(-waveNumber * r) obtained
+// with the batched and the scalar overloads of HermiteInterpolator::evaluate()
+// and with the exact function
+template <typename ValueType>
+void batched_and_scalar_interpolation_agree_with_exact_function(
+        ValueType waveNumber)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    const int interpPtsPerWavelength =
+        Bempp::DEFAULT_HELMHOLTZ_INTERPOLATION_DENSITY;
+    const CoordinateType wavelength = 2. * M_PI / std::abs(waveNumber);
+    const int nodeCount = maxDist / wavelength * interpPtsPerWavelength + 1;
+
+    shared_ptr<const Fiber::HermiteInterpolator<ValueType> > interpolator =
+        Fiber::sharedInterpolatorForModifiedHelmholtz3dKernels(
+            waveNumber, CoordinateType(maxDist), interpPtsPerWavelength);
+    const arma::Col<CoordinateType> points =
+        interpolationPoints<CoordinateType>(nodeCount);
+    const int pointCount = points.n_rows;
+
+    arma::Col<ValueType> batched(pointCount), scalar(pointCount),
+        exact(pointCount);
+    interpolator->evaluate(points.memptr(), pointCount, batched.memptr());
+    for (int i = 0; i < pointCount; ++i) {
+        scalar(i) = interpolator->evaluate(points(i));
+        exact(i) = exp(-waveNumber * points(i));
+    }
+
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    batched, scalar,
+                    10. * std::numeric_limits<CoordinateType>::epsilon()));
+    BOOST_CHECK(check_arrays_are_close<ValueType>(
+                    batched, exact,
+                    50. * std::numeric_limits<CoordinateType>::epsilon()));
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(HermiteInterpolator)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(batched_evaluation_agrees_with_scalar_evaluation_and_exact_function_for_real_wave_number,
+                              ValueType, kernel_types)
+{
+    batched_and_scalar_interpolation_agree_with_exact_function<ValueType>(
+        ValueType(1.));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(batched_evaluation_agrees_with_scalar_evaluation_and_exact_function_for_imag_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    batched_and_scalar_interpolation_agree_with_exact_function<ValueType>(
+        ValueType(0., -1.));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(batched_evaluation_agrees_with_scalar_evaluation_and_exact_function_for_complex_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    batched_and_scalar_interpolation_agree_with_exact_function<ValueType>(
+        ValueType(0.5, -1.));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(interpolators_with_equal_parameters_are_shared,
+                              ValueType, kernel_types)
+{
+    typedef typename Fiber::ScalarTraits<ValueType>::RealType CoordinateType;
+    const int interpPtsPerWavelength =
+        Bempp::DEFAULT_HELMHOLTZ_INTERPOLATION_DENSITY;
+    shared_ptr<const Fiber::HermiteInterpolator<ValueType> > first =
+        Fiber::sharedInterpolatorForModifiedHelmholtz3dKernels(
+            ValueType(1.), CoordinateType(maxDist), interpPtsPerWavelength);
+    shared_ptr<const Fiber::HermiteInterpolator<ValueType> > second =
+        Fiber::sharedInterpolatorForModifiedHelmholtz3dKernels(
+            ValueType(1.), CoordinateType(maxDist), interpPtsPerWavelength);
+    shared_ptr<const Fiber::HermiteInterpolator<ValueType> > other =
+        Fiber::sharedInterpolatorForModifiedHelmholtz3dKernels(
+            ValueType(2.), CoordinateType(maxDist), interpPtsPerWavelength);
+    BOOST_CHECK(first == second);
+    BOOST_CHECK(first != other);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
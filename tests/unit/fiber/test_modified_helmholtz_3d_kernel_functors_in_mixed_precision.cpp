@@ -0,0 +1,150 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "fiber/geometrical_data.hpp"
+#include "fiber/modified_helmholtz_3d_adjoint_double_layer_potential_kernel_functor.hpp"
+#include "fiber/modified_helmholtz_3d_double_layer_potential_kernel_functor.hpp"
+#include "fiber/modified_helmholtz_3d_single_layer_potential_kernel_functor.hpp"
+
+#include "../type_template.hpp"
+#include "../random_arrays.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <complex>
+#include <limits>
+
+namespace
+{
+
+// Random points in the cube [offset, offset + 1]^3 with random unit normals.
+// evaluateBatch() expects each coordinate to be stored contiguously, so
+// points are stored in the rows of the matrices.
+template <typename CoordinateType>
+struct RandomPoints
+{
+    RandomPoints(int pointCount, CoordinateType offset) :
+        globals(generateRandomMatrix<CoordinateType>(pointCount, 3) + offset),
+        normals(generateRandomMatrix<CoordinateType>(pointCount, 3) - 0.5)
+    {
+        for (int i = 0; i < pointCount; ++i)
+            normals.row(i) /= arma::norm(normals.row(i), 2);
+        data.pointCount = pointCount;
+        for (int dim = 0; dim < 3; ++dim) {
+            data.globals[dim] = globals.colptr(dim);
+            data.normals[dim] = normals.colptr(dim);
+        }
+    }
+
+    arma::Mat<CoordinateType> globals, normals;
+    Fiber::BatchedGeometricalData<CoordinateType> data;
+};
+
+// Relative difference between the kernel values evaluated by functors
+// constructed with and without the mixedPrecision flag. Test points lie in
+// the unit cube and trial points at distances between about 0.9 and 4.3
+// from them.
+template <typename Functor>
+typename Functor::CoordinateType mixedPrecisionError(
+        typename Functor::ValueType waveNumber)
+{
+    typedef typename Functor::ValueType ValueType;
+    typedef typename Functor::CoordinateType CoordinateType;
+
+    const int testPointCount = 40, trialPointCount = 30;
+    RandomPoints<CoordinateType> testPoints(testPointCount, 0.);
+    RandomPoints<CoordinateType> trialPoints(trialPointCount, 1.5);
+
+    const Functor doublePrecisionFunctor(waveNumber, false);
+    const Functor mixedPrecisionFunctor(waveNumber, true);
+    arma::Mat<ValueType> expected(testPointCount, trialPointCount);
+    arma::Mat<ValueType> result(testPointCount, trialPointCount);
+    doublePrecisionFunctor.evaluateBatch(testPoints.data, trialPoints.data,
+                                         expected.memptr());
+    mixedPrecisionFunctor.evaluateBatch(testPoints.data, trialPoints.data,
+                                        result.memptr());
+    return arma::norm(result - expected, "fro") /
+           arma::norm(expected, "fro");
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(ModifiedHelmholtz3dKernelFunctorsInMixedPrecision)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(single_layer_agrees_with_full_precision_for_real_wave_number,
+                              ValueType, kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dSingleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(1.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(double_layer_agrees_with_full_precision_for_real_wave_number,
+                              ValueType, kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dDoubleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(1.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(adjoint_double_layer_agrees_with_full_precision_for_real_wave_number,
+                              ValueType, kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dAdjointDoubleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(1.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+// With kappa = -ik the kernels are those of the Helmholtz equation; several
+// wavelengths fit between the test and trial points
+BOOST_AUTO_TEST_CASE_TEMPLATE(single_layer_agrees_with_full_precision_for_imag_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dSingleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(0., -10.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(double_layer_agrees_with_full_precision_for_imag_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dDoubleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(0., -10.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(adjoint_double_layer_agrees_with_full_precision_for_imag_wave_number,
+                              ValueType, complex_kernel_types)
+{
+    typedef Fiber::ModifiedHelmholtz3dAdjointDoubleLayerPotentialKernelFunctor<ValueType>
+            Functor;
+    BOOST_CHECK_LT(mixedPrecisionError<Functor>(ValueType(0., -10.)),
+                   100. * std::numeric_limits<float>::epsilon());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,228 @@
+// Copyright (C) 2011-2014 by the BEM++ Authors
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "../type_template.hpp"
+#include "../check_arrays_are_close.hpp"
+
+#include "assembly/context.hpp"
+#include "assembly/general_elementary_singular_integral_operator_imp.hpp"
+#include "assembly/laplace_3d_single_layer_boundary_operator.hpp"
+#include "assembly/numerical_quadrature_strategy.hpp"
+#include "common/scalar_traits.hpp"
+#include "fiber/local_assembler_for_integral_operators.hpp"
+#include "grid/grid.hpp"
+#include "grid/grid_factory.hpp"
+#include "grid/grid_view.hpp"
+#include "space/piecewise_constant_scalar_space.hpp"
+#include "space/piecewise_linear_continuous_scalar_space.hpp"
+#include "space/piecewise_polynomial_continuous_scalar_space.hpp"
+
+#include "common/armadillo_fwd.hpp"
+#include <boost/test/unit_test.hpp>
+#include <boost/test/test_case_template.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <algorithm>
+#include <complex>
+#include <limits>
+
+using namespace Bempp;
+
+namespace
+{
+
+template <typename BFT>
+shared_ptr<Space<BFT> > makeSpace(const shared_ptr<Grid>& grid,
+                                  int polynomialOrder)
+{
+    if (polynomialOrder == 0)
+        return shared_ptr<Space<BFT> >(
+            new PiecewiseConstantScalarSpace<BFT>(grid));
+    if (polynomialOrder == 1)
+        return shared_ptr<Space<BFT> >(
+            new PiecewiseLinearContinuousScalarSpace<BFT>(grid));
+    return shared_ptr<Space<BFT> >(
+        new PiecewisePolynomialContinuousScalarSpace<BFT>(
+            grid, polynomialOrder));
+}
+
+/** \brief Local assembler of the Laplace single-layer operator.
+ *
+ *  With BLAS enabled in quadrature the operator uses a "typical" integral,
+ *  for which the separable integrator fuses kernel evaluation and
+ *  quadrature (and batches element pairs with more than three functions).
+ *  With BLAS disabled it uses a generic integrand functor, which the
+ *  integrator evaluates pair by pair without fusion. */
+template <typename BFT, typename RT>
+class LocalAssemblerManager
+{
+public:
+    typedef typename ScalarTraits<RT>::RealType CT;
+    typedef ElementaryIntegralOperator<BFT, CT, RT> Operator;
+    typedef NumericalQuadratureStrategy<BFT, RT> QuadratureStrategy;
+
+    LocalAssemblerManager(const shared_ptr<Grid>& grid,
+                          int testOrder, int trialOrder, bool useBlas)
+    {
+        quadStrategy.reset(new QuadratureStrategy);
+
+        AssemblyOptions assemblyOptions;
+        assemblyOptions.setVerbosityLevel(VerbosityLevel::LOW);
+        assemblyOptions.enableBlasInQuadrature(
+            useBlas ? AssemblyOptions::YES : AssemblyOptions::NO);
+        context.reset(new Context<BFT, RT>(quadStrategy, assemblyOptions));
+
+        trialSpace = makeSpace<BFT>(grid, trialOrder);
+        testSpace = makeSpace<BFT>(grid, testOrder);
+        bop = laplace3dSingleLayerBoundaryOperator<BFT, RT>(
+                    context, trialSpace, testSpace, testSpace, "SLP");
+        const Operator& op =
+            static_cast<const Operator&>(*bop.abstractOperator());
+        assembler = op.makeAssembler(*quadStrategy, assemblyOptions);
+    }
+
+    shared_ptr<Space<BFT> > testSpace, trialSpace;
+    shared_ptr<QuadratureStrategy> quadStrategy;
+    shared_ptr<Context<BFT, RT> > context;
+    BoundaryOperator<BFT, RT> bop;
+    std::unique_ptr<typename Operator::LocalAssembler> assembler;
+};
+
+template <typename ValueType>
+typename ScalarTraits<ValueType>::RealType maxAbs(
+        const std::vector<arma::Mat<ValueType> >& arrays)
+{
+    typename ScalarTraits<ValueType>::RealType result = 0.;
+    for (size_t i = 0; i < arrays.size(); ++i)
+        if (!arrays[i].is_empty())
+            result = std::max(result, arma::abs(arrays[i]).max());
+    return result;
+}
+
+// Compare the local weak forms of the element pairs (A, B), with A running
+// over elementIndicesA and B over several elements, obtained by the
+// specialized and generic integration paths. Adjacent pairs are integrated
+// by the nonseparable integrator on both paths; all other pairs exercise
+// the separable one.
+template <typename RT>
+void specialized_and_generic_integration_agree(
+        int testOrder, int trialOrder,
+        const std::vector<int>& elementIndicesA)
+{
+    typedef typename ScalarTraits<RT>::RealType RealType;
+    typedef RealType BFT;
+
+    GridParameters params;
+    params.topology = GridParameters::TRIANGULAR;
+    shared_ptr<Grid> grid = GridFactory::importGmshGrid(
+        params, "meshes/sphere-ico-1.msh", false /* verbose */);
+
+    LocalAssemblerManager<BFT, RT> specialized(grid, testOrder, trialOrder,
+                                               true /* BLAS */);
+    LocalAssemblerManager<BFT, RT> generic(grid, testOrder, trialOrder,
+                                           false /* BLAS */);
+
+    const Fiber::CallVariant callVariants[] = {
+        Fiber::TEST_TRIAL, Fiber::TRIAL_TEST};
+    const int elementIndicesB[] = {0, 17, 55};
+    const Fiber::LocalDofIndex localDofIndicesB[] = {Fiber::ALL_DOFS, 0};
+    std::vector<arma::Mat<RT> > expected, result;
+    for (int v = 0; v < 2; ++v)
+        for (int b = 0; b < 3; ++b)
+            for (int d = 0; d < 2; ++d) {
+                generic.assembler->evaluateLocalWeakForms(
+                    callVariants[v], elementIndicesA, elementIndicesB[b],
+                    localDofIndicesB[d], expected);
+                specialized.assembler->evaluateLocalWeakForms(
+                    callVariants[v], elementIndicesA, elementIndicesB[b],
+                    localDofIndicesB[d], result);
+                const RealType tolerance =
+                    1000. * std::numeric_limits<RealType>::epsilon() *
+                    maxAbs(expected);
+                BOOST_CHECK(check_arrays_are_close<RT>(
+                                result, expected, tolerance));
+            }
+}
+
+std::vector<int> allElementsOfSphere()
+{
+    // sphere-ico-1.msh has 80 elements
+    std::vector<int> indices(80);
+    for (size_t i = 0; i < indices.size(); ++i)
+        indices[i] = i;
+    return indices;
+}
+
+std::vector<int> singleElementOfSphere()
+{
+    return std::vector<int>(1, 42);
+}
+
+} // namespace
+
+// Tests
+
+BOOST_AUTO_TEST_SUITE(SeparableNumericalTestKernelTrialIntegrator)
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(fused_and_generic_integration_agree_for_1x1_functions,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        0, 0, allElementsOfSphere());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(fused_and_generic_integration_agree_for_3x3_functions,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        1, 1, allElementsOfSphere());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(fused_and_generic_integration_agree_for_3x1_functions,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        1, 0, allElementsOfSphere());
+}
+
+// Quadratic elements have 6 functions, so pairs with several elements A are
+// integrated in batches
+BOOST_AUTO_TEST_CASE_TEMPLATE(batched_and_unbatched_integration_agree_for_6x6_functions,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        2, 2, allElementsOfSphere());
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(batched_and_unbatched_integration_agree_for_6x3_functions,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        2, 1, allElementsOfSphere());
+}
+
+// A single element A is integrated pair by pair even if it is quadratic
+BOOST_AUTO_TEST_CASE_TEMPLATE(unbatched_integration_of_single_element_pair_agrees_with_generic_integration,
+                              ResultType, result_types)
+{
+    specialized_and_generic_integration_agree<ResultType>(
+        2, 2, singleElementOfSphere());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -355,6 +355,47 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(boundary_operator_agrees_with_2x2_blocked_boundary
     }
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(blocked_solve_for_multiple_rhs_agrees_with_separate_solves,
+                              ValueType, result_types)
+{
+    typedef ValueType RT;
+    typedef typename ScalarTraits<ValueType>::RealType RealType;
+    typedef RealType BFT;
+
+    typedef Bempp::DefaultIterativeSolver<BFT, RT> IterSolver;
+    const RealType solverTol = 1e-5;
+
+    Laplace3dDirichletFixture<BFT, RT> fixture;
+
+    // Diagonal 2x2 ([A, 0; 0, A]) blocked operator
+    BlockedOperatorStructure<BFT, RT> structure;
+    structure.setBlock(0, 0, fixture.lhsOp);
+    structure.setBlock(1, 1, fixture.lhsOp);
+    BlockedBoundaryOperator<BFT, RT> lhsBlockedOp(structure);
+
+    std::vector<std::vector<GridFunction<BFT, RT> > > blockedRhs(
+        2, std::vector<GridFunction<BFT, RT> >(2));
+    blockedRhs[0][0] = fixture.rhs;
+    blockedRhs[0][1] = 2. * fixture.rhs;
+    blockedRhs[1][0] = 3. * fixture.rhs; // blockedRhs[1][1] is zero
+
+    IterSolver solver(
+        lhsBlockedOp, ConvergenceTestMode::TEST_CONVERGENCE_IN_DUAL_TO_RANGE);
+    solver.initializeSolver(defaultGmresParameterList(solverTol));
+    std::vector<BlockedSolution<BFT, RT> > solutions =
+        solver.solveMultipleRhs(blockedRhs);
+    BOOST_REQUIRE_EQUAL(solutions.size(), 2u);
+
+    for (size_t i = 0; i < blockedRhs.size(); ++i) {
+        BlockedSolution<BFT, RT> expected = solver.solve(blockedRhs[i]);
+        for (size_t block = 0; block < 2; ++block)
+            BOOST_CHECK(check_arrays_are_close<ValueType>(
+                            solutions[i].gridFunction(block).coefficients(),
+                            expected.gridFunction(block).coefficients(),
+                            solverTol * 10));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #endif